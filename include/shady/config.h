@@ -33,6 +33,9 @@ struct ArenaConfig_ {
     bool allow_fold;
     bool validate_builtin_types; // do @Builtins variables need to match their type in builtins.h ?
     bool is_simt;
+    /// Allows nodes to be constructed from several threads at once, at the cost of some locking.
+    /// Only the IR construction API is covered, the rest of the arena state stays single-threaded.
+    bool thread_safe;
 
     struct {
         bool physical;
@@ -97,6 +100,12 @@ struct CompilerConfig_ {
             bool delete_unused_instructions;
         } cleanup;
         bool inline_everything;
+        struct {
+            /// Lets the passes that only touch a few nodes rewrite into the arena they read from instead of a fresh copy
+            bool enabled;
+            /// Fraction of the nodes in an arena that must be dead before its module gets copied into a fresh one
+            float compaction_threshold;
+        } in_place;
     } optimisations;
 
     struct {
@@ -115,6 +124,13 @@ struct CompilerConfig_ {
         bool print_generated, print_builtin, print_internal;
     } logging;
 
+    struct {
+        /// Prints a table with the time taken by each pass and the size of the IR after it on stderr
+        bool enabled;
+        /// If set, the same statistics also get written to this file as JSON
+        String json_output;
+    } pass_stats;
+
     struct {
         String entry_point;
         ExecutionModel execution_model;
@@ -123,6 +139,13 @@ struct CompilerConfig_ {
 
     TargetConfig target;
 
+    struct {
+        /// Where compiled outputs are kept across runs, no caching happens if this is NULL
+        String directory;
+        /// Past this many bytes, the least recently used entries get evicted
+        size_t max_size;
+    } cache;
+
     struct {
         struct { void* uptr; void (*fn)(void*, String, Module*); } after_pass;
     } hooks;
@@ -20,6 +20,8 @@ typedef enum {
     IncorrectLogLevel = 16,
     InvalidTarget,
     ClangInvocationFailed,
+    IncompatibleBinaryModule,
+    OutputFileIOError,
 } ShadyErrorCodes;
 
 typedef enum {
@@ -27,12 +29,19 @@ typedef enum {
     SrcSlim,
     SrcSPIRV,
     SrcLLVM,
+    /// Modules written by shd_driver_save_binary_module
+    SrcShadyBinary,
 } SourceLanguage;
 
 SourceLanguage shd_driver_guess_source_language(const char* filename);
 ShadyErrorCodes shd_driver_load_source_file(const CompilerConfig* config, SourceLanguage lang, size_t len, const char* file_contents, String name, Module** mod);
 ShadyErrorCodes shd_driver_load_source_file_from_filename(const CompilerConfig* config, const char* filename, String name, Module** mod);
 
+/// Saves a module in the binary format, which loads much faster than re-parsing the source it came from.
+ShadyErrorCodes shd_driver_save_binary_module(Module* mod, const char* filename);
+/// Maps the file in memory and rebuilds the module from it in a single pass.
+ShadyErrorCodes shd_driver_load_binary_module_from_filename(const char* filename, String name, Module** mod);
+
 typedef enum {
     TgtAuto,
     TgtC,
@@ -61,6 +70,8 @@ typedef struct {
     const char* shd_output_filename;
     const char* cfg_output_filename;
     const char* loop_tree_output_filename;
+    /// Makes the IR arena thread-safe, so function-local passes can run on several threads
+    bool parallel_passes;
 } DriverConfig;
 
 DriverConfig shd_default_driver_config(void);
@@ -76,5 +87,28 @@ typedef enum CompilationResult_ {
 } CompilationResult;
 
 CompilationResult shd_run_compiler_passes(CompilerConfig* config, Module** pmod);
+/// Frees what shd_run_compiler_passes keeps around between compilations on the calling thread (ie the builtin modules
+/// it parsed). Threads that compile should call this before they exit, compiling again afterwards is fine.
+void shd_destroy_compiler_thread_caches(void);
+
+/// Identifies a compilation on disk: the input module, the parts of the config that affect the output and the compiler version.
+typedef struct {
+    /// Names the entry, this alone can collide.
+    uint64_t hash;
+    /// Everything that went into the hash, stored in the entry and compared on lookup. NULL if caching is disabled.
+    size_t size;
+    char* data;
+} CompileCacheKey;
+/// Whether config->cache is set up, and nothing in the config needs the passes to actually run.
+bool shd_is_compile_cache_enabled(const CompilerConfig* config);
+/// @p variant tells apart outputs produced from the same module, ie the backend and its own settings.
+CompileCacheKey shd_compile_cache_key(const CompilerConfig* config, Module* mod, String variant);
+void shd_destroy_compile_cache_key(CompileCacheKey key);
+/// Returns false on a miss or if caching is disabled, @p output must be freed by the caller otherwise.
+bool shd_compile_cache_lookup(const CompilerConfig* config, CompileCacheKey key, size_t* size, char** output);
+/// Removes the entry for @p key, for callers that found its contents unusable (ie a module that doesn't deserialize).
+void shd_compile_cache_evict(const CompilerConfig* config, CompileCacheKey key);
+/// Adds an entry to the cache, then evicts the least recently used ones if it grew past config->cache.max_size.
+void shd_compile_cache_store(const CompilerConfig* config, CompileCacheKey key, size_t size, const char* data);
 
 #endif
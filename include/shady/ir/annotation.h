@@ -3,6 +3,37 @@
 
 #include "shady/ir/base.h"
 
+/// Annotations the compiler itself queries, these get a bit in a per-declaration mask so looking them up is O(1).
+#define WELL_KNOWN_ANNOTATIONS(A) \
+A(EntryPoint) \
+A(Exported) \
+A(Internal) \
+A(Leaf) \
+A(MaybeLeaf) \
+A(Inline) \
+A(NoInline) \
+A(Builtin) \
+A(Logical) \
+A(Generated) \
+A(Restructure) \
+A(Structured) \
+A(RetainAfterSpecialization) \
+A(SkipOnInfer) \
+A(DisablePass) \
+A(DisableOpt) \
+
+typedef enum {
+    AnnNone,
+#define A(name) Ann##name,
+    WELL_KNOWN_ANNOTATIONS(A)
+#undef A
+} WellKnownAnnotation;
+
+WellKnownAnnotation shd_well_known_annotation_from_string(const char*);
+String shd_get_well_known_annotation_name(WellKnownAnnotation);
+/// Like shd_lookup_annotation, but checks the declaration's annotation mask first.
+const Node* shd_lookup_well_known_annotation(const Node* decl, WellKnownAnnotation);
+
 const Node* shd_lookup_annotation(const Node* decl, const char* name);
 const Node* shd_lookup_annotation_list(Nodes annotations, const char* name);
 const Node* shd_get_annotation_value(const Node* annotation);
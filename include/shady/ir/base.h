@@ -44,6 +44,22 @@ Nodes shd_concat_nodes(IrArena* arena, Nodes a, Nodes b);
 Nodes shd_change_node_at_index(IrArena* arena, Nodes old, size_t i, const Node* n);
 bool shd_find_in_nodes(Nodes nodes, const Node* n);
 
+/// Growable, mutable list of nodes that is only interned once it is finished.
+/// Use this instead of repeatedly calling shd_nodes_append & co in a loop, which interns every intermediate list.
+/// Zero-initialising one gives an empty builder.
+typedef struct {
+    size_t count;
+    size_t space;
+    const Node** nodes;
+} NodesBuilder;
+
+NodesBuilder shd_nodes_builder_from(Nodes initial);
+void shd_nodes_builder_append(NodesBuilder* builder, const Node* n);
+void shd_nodes_builder_append_nodes(NodesBuilder* builder, Nodes nodes);
+void shd_nodes_builder_set(NodesBuilder* builder, size_t i, const Node* n);
+/// Interns the contents and releases the builder's storage
+Nodes shd_nodes_builder_finish(IrArena* arena, NodesBuilder* builder);
+
 String string_sized(IrArena*, size_t size, const char* start);
 String string(IrArena*, const char*);
 
@@ -12,4 +12,11 @@ Node* shd_module_get_declaration(const Module* m, String name);
 
 void shd_module_link(Module* dst, Module* src);
 
+/// Writes @p m and everything reachable from it in a compact binary form, the result must be freed by the caller.
+void shd_serialize_module(Module* m, size_t* size, char** output);
+/// Rebuilds a module written by shd_serialize_module in a new arena, returns NULL if it was written by an incompatible build
+/// or is corrupt (ie truncated).
+/// @p name overrides the name the module was saved with, if set.
+Module* shd_deserialize_module(size_t size, const char* data, String name);
+
 #endif
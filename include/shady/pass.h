@@ -7,13 +7,27 @@
 #include "shady/rewrite.h"
 
 typedef Module* (RewritePass)(const CompilerConfig* config, Module* src);
-typedef bool (OptPass)(const CompilerConfig* config, Module** m);
+/// Function-local optimisation: rewrites the body of @p fn in place (see shd_create_in_place_rewriter), returns whether it changed anything.
+typedef bool (OptPass)(const CompilerConfig* config, Module* m, Node* fn);
 
 void shd_run_pass_impl(const CompilerConfig* config, Module** pmod, IrArena* initial_arena, RewritePass pass, String pass_name);
 #define RUN_PASS(pass_name) shd_run_pass_impl(config, pmod, initial_arena, pass_name, #pass_name);
 
-void shd_apply_opt_impl(const CompilerConfig* config, bool* todo, Module** m, OptPass pass, String pass_name);
-#define APPLY_OPT(pass_name) shd_apply_opt_impl(config, &todo, &m, pass_name, #pass_name);
+/// Whether @p m lives in an arena the pass manager created itself, as opposed to the caller's: only those can be changed in place.
+bool shd_is_pass_owned_module(Module* m);
+/// Arena a pass should build its output module in: the one @p src lives in if in-place passes are enabled and the pass manager owns it, a fresh one with the same config otherwise.
+IrArena* shd_get_pass_dst_arena(const CompilerConfig* config, Module* src);
+typedef struct ThreadPool_ ThreadPool;
+/// Threads that shd_rewrite_module can spread the work of function-local passes over, for the whole of
+/// shd_run_compiler_passes. NULL outside of it, or if the module it works on isn't in a thread-safe arena.
+ThreadPool* shd_get_pass_thread_pool(void);
+
+/// Copies the live part of @p src into a fresh arena once enough of the nodes in its arena are dead (see CompilerConfig.optimisations.in_place), returns @p src as-is otherwise.
+/// Modules in arenas the pass manager does not own are always copied.
+Module* shd_compact_module(const CompilerConfig* config, Module* src);
+
+void shd_apply_opt_impl(const CompilerConfig* config, bool* todo, Module* m, Node* fn, OptPass pass, String pass_name);
+#define APPLY_OPT(pass_name) shd_apply_opt_impl(config, &todo, m, fn, pass_name, #pass_name);
 
 #endif
 
@@ -4,10 +4,17 @@
 #include "shady/ir/grammar.h"
 
 typedef struct Rewriter_ Rewriter;
+typedef struct NodeMap_ NodeMap;
 
 typedef const Node* (*RewriteNodeFn)(Rewriter*, const Node*);
 typedef const Node* (*RewriteOpFn)(Rewriter*, NodeClass, String, const Node*);
 
+/// Rewriting a node that has a mem operand first rewrites the nodes of its mem chain that aren't in the map yet, oldest
+/// to newest, without recursion. The rewrite function is thus called on the predecessors of a node before the node itself,
+/// and can't change how they get rewritten from there: mappings for nodes of a chain, including the AbsMem it starts
+/// from, have to be registered before anything further down that chain gets rewritten.
+/// Deep expressions are handled the same way: past a certain recursion depth, the values a node depends on that aren't
+/// in the map yet get rewritten, operands first, before the rewrite function is called on the node.
 const Node* shd_rewrite_node(Rewriter* rewriter, const Node* node);
 const Node* shd_rewrite_node_with_fn(Rewriter* rewriter, const Node* node, RewriteNodeFn fn);
 
@@ -31,13 +38,21 @@ struct Rewriter_ {
     struct {
         bool search_map;
         bool write_map;
+        /// Set by passes that only ever rewrite declarations through shd_recreate_node_head/body, and whose function
+        /// bodies can be rewritten independently of each other. This lets shd_rewrite_module process them in parallel.
+        bool function_local;
+        /// Size of the context struct this rewriter is placed at the start of, every worker thread gets its own copy.
+        size_t context_size;
+        /// Source and destination are the same module, and declarations are left as they are instead of being
+        /// rewritten, see shd_create_in_place_rewriter.
+        bool in_place;
     } config;
 
     Rewriter* parent;
 
-    struct Dict* map;
+    NodeMap* map;
     bool own_decls;
-    struct Dict* decls_map;
+    NodeMap* decls_map;
 };
 
 Rewriter shd_create_rewriter_base(Module* src, Module* dst);
@@ -49,6 +64,18 @@ Rewriter shd_create_children_rewriter(Rewriter* parent);
 Rewriter shd_create_decl_rewriter(Rewriter* parent);
 void shd_destroy_rewriter(Rewriter* r);
 
+/// Rewriter for changing the bodies of functions of @p m without copying the module, see shd_rewrite_fn_body_in_place.
+Rewriter shd_create_in_place_rewriter(Module* m, RewriteNodeFn fn);
+/// Rewrites the body of @p fn with @p r, an in-place rewriter (or a child of one), and replaces it.
+/// @p fn keeps its identity and its params, so nothing that refers to it has to change. Its cached analyses and the
+/// call graphs of its arena are dropped.
+void shd_rewrite_fn_body_in_place(Rewriter* r, Node* fn);
+
+/// Rewrites the exported declarations of the source module, and whatever they reference.
+/// For function-local rewriters on thread-safe arenas, the heads of all declarations are created first, and then
+/// function bodies get rewritten on the threads of shd_get_pass_thread_pool, each with a child of @p rewriter.
+/// The declarations serial mode wouldn't have rewritten are dropped afterwards, and the others are put in the order it
+/// would have created them in, so the resulting module is the same either way.
 void shd_rewrite_module(Rewriter* rewriter);
 
 /// Rewrites a node using the rewriter to provide the node and type operands
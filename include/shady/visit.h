@@ -21,6 +21,25 @@ void shd_visit_nodes(Visitor* visitor, Nodes nodes);
 void shd_visit_op(Visitor* visitor, NodeClass op_class, String op_name, const Node* op, size_t i);
 void shd_visit_ops(Visitor* visitor, NodeClass op_class, String op_name, Nodes ops);
 
+/// Explicit-stack traversal, for graphs too deep to recurse over (ie long mem chains in fully unrolled code).
+/// Every node reachable from the roots through operands not in exclude is expanded exactly once.
+typedef struct IterativeVisitor_ IterativeVisitor;
+typedef bool (*IterativeVisitFilterFn)(IterativeVisitor*, const Node*);
+typedef void (*IterativeVisitEdgeFn)(IterativeVisitor*, const Node* user, NodeClass, String, const Node* op, size_t);
+typedef void (*IterativeVisitNodeFn)(IterativeVisitor*, const Node*);
+
+struct IterativeVisitor_ {
+    NodeClass exclude;
+    /// Optional, nodes it returns false for are neither expanded nor visited
+    IterativeVisitFilterFn filter_fn;
+    /// Optional, called for each operand of a node when it gets expanded, before the operand itself is expanded
+    IterativeVisitEdgeFn visit_edge_fn;
+    /// Optional, called once per node, after all of its operands have been visited (post-order)
+    IterativeVisitNodeFn visit_post_fn;
+};
+
+void shd_visit_iteratively(IterativeVisitor* visitor, Nodes roots);
+
 // visits the abstractions in the function, starting with the entry block (ie the function itself)
 void shd_visit_function_rpo(Visitor* visitor, const Node* function);
 void shd_visit_function_bodies_rpo(Visitor* visitor, const Node* function);
@@ -2,10 +2,12 @@
 
 #include "../shady/type.h"
 #include "../shady/ir_private.h"
+#include "../shady/node_map.h"
 #include "../shady/transform/ir_gen_helpers.h"
 #include "../shady/passes/passes.h"
 #include "../shady/analysis/cfg.h"
 #include "../shady/analysis/scheduler.h"
+#include "../shady/analysis/manager.h"
 
 #include "shady_cuda_prelude_src.h"
 #include "shady_cuda_builtins_src.h"
@@ -27,15 +29,15 @@ bool shd_compare_node(Node** pa, Node** pb);
 
 void register_emitted(Emitter* emitter, FnEmitter* fn, const Node* node, CTerm as) {
     //assert(as.value || as.var);
-    shd_dict_insert(const Node*, CTerm, fn ? fn->emitted_terms : emitter->emitted_terms, node, as);
+    shd_node_map_insert(CTerm, fn ? fn->emitted_terms : emitter->emitted_terms, node, as);
 }
 
 CTerm* lookup_existing_term(Emitter* emitter, FnEmitter* fn, const Node* node) {
     CTerm* found = NULL;
     if (fn)
-        found = shd_dict_find_value(const Node*, CTerm, fn->emitted_terms, node);
+        found = shd_node_map_find(CTerm, fn->emitted_terms, node);
     if (!found)
-        found = shd_dict_find_value(const Node*, CTerm, emitter->emitted_terms, node);
+        found = shd_node_map_find(CTerm, emitter->emitted_terms, node);
     return found;
 }
 
@@ -306,10 +308,10 @@ void c_emit_decl(Emitter* emitter, const Node* decl) {
             const Node* body = decl->payload.fun.body;
             if (body) {
                 FnEmitter fn = {
-                    .cfg = build_fn_cfg(decl),
-                    .emitted_terms = shd_new_dict(Node*, CTerm, (HashFn) shd_hash_node, (CmpFn) shd_compare_node),
+                    .cfg = shd_get_fn_cfg(decl),
+                    .emitted_terms = shd_new_node_map(CTerm),
                 };
-                fn.scheduler = new_scheduler(fn.cfg);
+                fn.scheduler = shd_get_scheduler(fn.cfg);
                 fn.instruction_printers = calloc(sizeof(Printer*), fn.cfg->size);
                 // for (size_t i = 0; i < fn.cfg->size; i++)
                 //     fn.instruction_printers[i] = open_growy_as_printer(new_growy());
@@ -328,7 +330,7 @@ void c_emit_decl(Emitter* emitter, const Node* decl) {
                     fn_body = shd_format_string_arena(emitter->arena->arena, "if ((lanemask() >> programIndex) & 1u) { %s}", fn_body);
                     // I hate everything about this too.
                 } else if (emitter->config.dialect == CDialect_CUDA) {
-                    if (shd_lookup_annotation(decl, "EntryPoint")) {
+                    if (shd_lookup_well_known_annotation(decl, AnnEntryPoint)) {
                         // fn_body = format_string_arena(emitter->arena->arena, "\n__shady_entry_point_init();%s", fn_body);
                         if (emitter->use_private_globals) {
                             fn_body = shd_format_string_arena(emitter->arena->arena, "\n__shady_PrivateGlobals __shady_private_globals_alloc;\n __shady_PrivateGlobals* __shady_private_globals = &__shady_private_globals_alloc;\n%s", fn_body);
@@ -342,9 +344,7 @@ void c_emit_decl(Emitter* emitter, const Node* decl) {
                 shd_printer_deindent(emitter->fn_defs);
                 shd_print(emitter->fn_defs, "\n}");
 
-                destroy_scheduler(fn.scheduler);
-                destroy_cfg(fn.cfg);
-                shd_destroy_dict(fn.emitted_terms);
+                shd_destroy_node_map(fn.emitted_terms);
                 free(fn.instruction_printers);
             }
 
@@ -437,7 +437,7 @@ void shd_emit_c(const CompilerConfig* compiler_config, CEmitterConfig config, Mo
         .type_decls = shd_new_printer_from_growy(type_decls_g),
         .fn_decls = shd_new_printer_from_growy(fn_decls_g),
         .fn_defs = shd_new_printer_from_growy(fn_defs_g),
-        .emitted_terms = shd_new_dict(Node*, CTerm, (HashFn) shd_hash_node, (CmpFn) shd_compare_node),
+        .emitted_terms = shd_new_node_map(CTerm),
         .emitted_types = shd_new_dict(Node*, String, (HashFn) shd_hash_node, (CmpFn) shd_compare_node),
     };
 
@@ -526,7 +526,7 @@ void shd_emit_c(const CompilerConfig* compiler_config, CEmitterConfig config, Mo
     shd_destroy_growy(fn_defs_g);
 
     shd_destroy_dict(emitter.emitted_types);
-    shd_destroy_dict(emitter.emitted_terms);
+    shd_destroy_node_map(emitter.emitted_terms);
 
     *output_size = shd_growy_size(final) - 1;
     *output = shd_growy_deconstruct(final);
@@ -11,6 +11,7 @@
 
 typedef struct CFG_ CFG;
 typedef struct Scheduler_ Scheduler;
+typedef struct NodeMap_ NodeMap;
 
 /// SSA-like things, you can read them
 typedef String CValue;
@@ -42,7 +43,7 @@ typedef struct {
         Phis selection, loop_continue, loop_break;
     } phis;
 
-    struct Dict* emitted_terms;
+    NodeMap* emitted_terms;
     struct Dict* emitted_types;
 
     int total_workgroup_size;
@@ -53,7 +54,7 @@ typedef struct {
 } Emitter;
 
 typedef struct {
-    struct Dict* emitted_terms;
+    NodeMap* emitted_terms;
     Printer** instruction_printers;
     CFG* cfg;
     Scheduler* scheduler;
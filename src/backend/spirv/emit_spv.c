@@ -3,7 +3,9 @@
 #include "shady/ir/builtin.h"
 
 #include "../shady/ir_private.h"
+#include "../shady/node_map.h"
 #include "../shady/analysis/cfg.h"
+#include "../shady/analysis/manager.h"
 #include "../shady/passes/passes.h"
 #include "../shady/type.h"
 
@@ -33,16 +35,16 @@ void spv_register_emitted(Emitter* emitter, FnBuilder* fn_builder, const Node* n
         if (name)
             spvb_name(emitter->file_builder, id, name);
     }
-    struct Dict* map = fn_builder ? fn_builder->emitted : emitter->global_node_ids;
-    shd_dict_insert_get_result(struct Node*, SpvId, map, node, id);
+    NodeMap* map = fn_builder ? fn_builder->emitted : emitter->global_node_ids;
+    shd_node_map_insert(SpvId, map, node, id);
 }
 
 SpvId* spv_search_emitted(Emitter* emitter, FnBuilder* fn_builder, const Node* node) {
     SpvId* found = NULL;
     if (fn_builder)
-        found = shd_dict_find_value(const Node*, SpvId, fn_builder->emitted, node);
+        found = shd_node_map_find(SpvId, fn_builder->emitted, node);
     if (!found)
-        found = shd_dict_find_value(const Node*, SpvId, emitter->global_node_ids, node);
+        found = shd_node_map_find(SpvId, emitter->global_node_ids, node);
     return found;
 }
 
@@ -68,8 +70,8 @@ static void emit_basic_block(Emitter* emitter, FnBuilder* fn_builder, const CFNo
 
     spv_emit_terminator(emitter, fn_builder, bb_builder, bb_node, body);
 
-    for (size_t i = 0; i < shd_list_count(cf_node->dominates); i++) {
-        CFNode* dominated = shd_read_list(CFNode*, cf_node->dominates)[i];
+    for (size_t i = 0; i < cf_node->dominates.count; i++) {
+        CFNode* dominated = cf_node->dominates.nodes[i];
         emit_basic_block(emitter, fn_builder, dominated);
     }
 
@@ -84,10 +86,10 @@ static void emit_function(Emitter* emitter, const Node* node) {
     SpvId fn_id = spv_find_emitted(emitter, NULL, node);
     FnBuilder fn_builder = {
         .base = spvb_begin_fn(emitter->file_builder, fn_id, spv_emit_type(emitter, fn_type), spv_types_to_codom(emitter, node->payload.fun.return_types)),
-        .emitted = shd_new_dict(Node*, SpvId, (HashFn) shd_hash_node, (CmpFn) shd_compare_node),
-        .cfg = build_fn_cfg(node),
+        .emitted = shd_new_node_map(SpvId),
+        .cfg = shd_get_fn_cfg(node),
     };
-    fn_builder.scheduler = new_scheduler(fn_builder.cfg);
+    fn_builder.scheduler = shd_get_scheduler(fn_builder.cfg);
     fn_builder.per_bb = calloc(sizeof(*fn_builder.per_bb), fn_builder.cfg->size);
 
     Nodes params = node->payload.fun.params;
@@ -139,13 +141,11 @@ static void emit_function(Emitter* emitter, const Node* node) {
     }
 
     free(fn_builder.per_bb);
-    destroy_scheduler(fn_builder.scheduler);
-    destroy_cfg(fn_builder.cfg);
-    shd_destroy_dict(fn_builder.emitted);
+    shd_destroy_node_map(fn_builder.emitted);
 }
 
 SpvId spv_emit_decl(Emitter* emitter, const Node* decl) {
-    SpvId* existing = shd_dict_find_value(const Node*, SpvId, emitter->global_node_ids, decl);
+    SpvId* existing = shd_node_map_find(SpvId, emitter->global_node_ids, decl);
     if (existing)
         return *existing;
 
@@ -266,7 +266,7 @@ static void emit_entry_points(Emitter* emitter, Nodes declarations) {
         if (decl->tag != Function_TAG) continue;
         SpvId fn_id = spv_find_emitted(emitter, NULL, decl);
 
-        const Node* entry_point = shd_lookup_annotation(decl, "EntryPoint");
+        const Node* entry_point = shd_lookup_well_known_annotation(decl, AnnEntryPoint);
         if (entry_point) {
             ExecutionModel execution_model = shd_execution_model_from_string(shd_get_string_literal(emitter->arena, shd_get_annotation_value(entry_point)));
             assert(execution_model != EmNone);
@@ -341,7 +341,7 @@ void emit_spirv(const CompilerConfig* config, Module* mod, size_t* output_size,
         .arena = arena,
         .configuration = config,
         .file_builder = file_builder,
-        .global_node_ids = shd_new_dict(Node*, SpvId, (HashFn) shd_hash_node, (CmpFn) shd_compare_node),
+        .global_node_ids = shd_new_node_map(SpvId),
         .bb_builders = shd_new_dict(Node*, BBBuilder, (HashFn) shd_hash_node, (CmpFn) shd_compare_node),
         .num_entry_pts = 0,
     };
@@ -364,7 +364,7 @@ void emit_spirv(const CompilerConfig* config, Module* mod, size_t* output_size,
     *output_size = spvb_finish(file_builder, output);
 
     // cleanup the emitter
-    shd_destroy_dict(emitter.global_node_ids);
+    shd_destroy_node_map(emitter.global_node_ids);
     shd_destroy_dict(emitter.bb_builders);
     shd_destroy_dict(emitter.extended_instruction_sets);
 
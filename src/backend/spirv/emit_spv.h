@@ -8,6 +8,7 @@
 
 typedef struct CFG_ CFG;
 typedef struct Scheduler_ Scheduler;
+typedef struct NodeMap_ NodeMap;
 
 typedef SpvbFileBuilder* FileBuilder;
 typedef SpvbBasicBlockBuilder* BBBuilder;
@@ -16,7 +17,7 @@ typedef struct {
     SpvbFnBuilder* base;
     CFG* cfg;
     Scheduler* scheduler;
-    struct Dict* emitted;
+    NodeMap* emitted;
     struct {
         SpvId continue_id;
         BBBuilder continue_builder;
@@ -29,7 +30,7 @@ typedef struct Emitter_ {
     const CompilerConfig* configuration;
     FileBuilder file_builder;
     SpvId void_t;
-    struct Dict* global_node_ids;
+    NodeMap* global_node_ids;
 
     struct Dict* bb_builders;
 
@@ -3,8 +3,8 @@
 
 #include "../shady/type.h"
 #include "../shady/transform/ir_gen_helpers.h"
+#include "../shady/node_map.h"
 
-#include "dict.h"
 #include "portability.h"
 #include "log.h"
 
@@ -24,8 +24,7 @@ static const Node* process(Context* ctx, const Node* node) {
             Node* newfun = shd_recreate_node_head(r, node);
             if (get_abstraction_body(node)) {
                 Context functx = *ctx;
-                functx.rewriter.map = shd_clone_dict(functx.rewriter.map);
-                shd_dict_clear(functx.rewriter.map);
+                functx.rewriter.map = shd_new_node_map(Node*);
                 shd_register_processed_list(&functx.rewriter, get_abstraction_params(node), get_abstraction_params(newfun));
                 functx.bb = begin_body_with_mem(a, shd_get_abstraction_mem(newfun));
                 Node* post_prelude = basic_block(a, shd_empty(a), "post-prelude");
@@ -33,7 +32,7 @@ static const Node* process(Context* ctx, const Node* node) {
                 shd_set_abstraction_body(post_prelude, shd_rewrite_node(&functx.rewriter, get_abstraction_body(node)));
                 shd_set_abstraction_body(newfun, finish_body(functx.bb, jump_helper(a, bb_mem(functx.bb), post_prelude,
                                                                                     shd_empty(a))));
-                shd_destroy_dict(functx.rewriter.map);
+                shd_destroy_node_map(functx.rewriter.map);
             }
             return newfun;
         }
@@ -108,18 +107,24 @@ Module* shd_spvbe_pass_lift_globals_ssbo(SHADY_UNUSED const CompilerConfig* conf
     shd_rewrite_module(&ctx.rewriter);
 
     lifted_globals_count = 0;
+    NodesBuilder initial_values = { 0 };
     for (size_t i = 0; i < old_decls.count; i++) {
         const Node* odecl = old_decls.nodes[i];
         if (odecl->tag != GlobalVariable_TAG || odecl->payload.global_variable.address_space != AsGlobal)
             continue;
         if (odecl->payload.global_variable.init)
-            ctx.lifted_globals_decl->payload.global_variable.annotations = shd_nodes_append(a, ctx.lifted_globals_decl->payload.global_variable.annotations, annotation_values(a, (AnnotationValues) {
+            shd_nodes_builder_append(&initial_values, annotation_values(a, (AnnotationValues) {
                 .name = "InitialValue",
                 .values = mk_nodes(a, shd_int32_literal(a, lifted_globals_count), shd_rewrite_node(&ctx.rewriter, odecl->payload.global_variable.init))
             }));
 
         lifted_globals_count++;
     }
+    // without any lifted globals, there is nothing to annotate and the builder is still empty
+    if (ctx.lifted_globals_decl) {
+        Nodes* decl_annotations = &ctx.lifted_globals_decl->payload.global_variable.annotations;
+        *decl_annotations = shd_concat_nodes(a, *decl_annotations, shd_nodes_builder_finish(a, &initial_values));
+    }
 
     shd_destroy_rewriter(&ctx.rewriter);
     return dst;
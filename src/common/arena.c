@@ -5,13 +5,27 @@
 #include <assert.h>
 #include <string.h>
 
-#define alloc_size 1024 * 1024
+// blocks start small so that short-lived arenas (ie in analyses) don't pay for a megabyte each, and double up to this
+#define min_block_size 16 * 1024
+#define max_block_size 1024 * 1024
+
+typedef struct {
+    void* data;
+    size_t size;
+} Block;
 
 typedef struct Arena_ {
-    int nblocks;
-    int maxblocks;
-    void** blocks;
-    size_t available;
+    size_t nblocks;
+    size_t maxblocks;
+    Block* blocks;
+    /// Blocks past this index are free to be reused, the last one in use is the one we bump-allocate into
+    size_t blocks_in_use;
+    size_t used;
+
+    /// Allocations too big for a regular block get their own
+    size_t nlarge;
+    size_t maxlarge;
+    Block* large;
 } Arena;
 
 inline static size_t round_up(size_t a, size_t b) {
@@ -23,64 +37,132 @@ Arena* shd_new_arena(void) {
     Arena* arena = malloc(sizeof(Arena));
     *arena = (Arena) {
         .nblocks = 0,
-        .maxblocks = 256,
-        .blocks = malloc(256 * sizeof(void*)),
-        .available = 0,
+        .maxblocks = 32,
+        .blocks = malloc(32 * sizeof(Block)),
+        .blocks_in_use = 0,
+        .used = 0,
+        .nlarge = 0,
+        .maxlarge = 0,
+        .large = NULL,
     };
-    for (int i = 0; i < arena->maxblocks; i++)
-        arena->blocks[i] = NULL;
     return arena;
 }
 
 void shd_destroy_arena(Arena* arena) {
-    for (int i = 0; i < arena->nblocks; i++) {
-        free(arena->blocks[i]);
+    for (size_t i = 0; i < arena->nblocks; i++) {
+        free(arena->blocks[i].data);
+    }
+    for (size_t i = 0; i < arena->nlarge; i++) {
+        free(arena->large[i].data);
     }
     free(arena->blocks);
+    free(arena->large);
     free(arena);
 }
 
-static void* new_block(Arena* arena, size_t size) {
+static void* alloc_large(Arena* arena, size_t size) {
+    if (arena->nlarge == arena->maxlarge) {
+        arena->maxlarge = arena->maxlarge ? arena->maxlarge * 2 : 8;
+        arena->large = realloc(arena->large, arena->maxlarge * sizeof(Block));
+    }
+    void* allocated = malloc(size);
+    assert(allocated);
+    arena->large[arena->nlarge++] = (Block) { .data = allocated, .size = size };
+    return allocated;
+}
+
+static void new_block(Arena* arena, size_t size) {
     assert(arena->nblocks <= arena->maxblocks);
     // we need more storage for the block pointers themselves !
     if (arena->nblocks == arena->maxblocks) {
         arena->maxblocks *= 2;
-        arena->blocks = realloc(arena->blocks, arena->maxblocks * sizeof(void*));
+        arena->blocks = realloc(arena->blocks, arena->maxblocks * sizeof(Block));
     }
 
-    void* allocated = malloc(size);
+    size_t block_size = min_block_size;
+    for (size_t i = 0; i < arena->nblocks && block_size < max_block_size; i++)
+        block_size *= 2;
+    if (block_size < size)
+        block_size = size;
+
+    void* allocated = malloc(block_size);
     assert(allocated);
-    arena->blocks[arena->nblocks++] = allocated;
-    return allocated;
+    arena->blocks[arena->nblocks++] = (Block) { .data = allocated, .size = block_size };
 }
 
-void* shd_arena_alloc(Arena* arena, size_t size) {
+void* shd_arena_alloc_uninit(Arena* arena, size_t size) {
     size = round_up(size, (size_t) sizeof(max_align_t));
     if (size == 0)
         return NULL;
-    if (size > alloc_size) {
-        void* allocated = new_block(arena, size);
-        memset(allocated, 0, size);
-        // swap the last two blocks
-        if (arena->nblocks >= 2) {
-            void* swap = arena->blocks[arena->nblocks - 1];
-            arena->blocks[arena->nblocks - 1] = arena->blocks[arena->nblocks - 2];
-            arena->blocks[arena->nblocks - 2] = swap;
-        }
-        return allocated;
-    }
+    if (size > max_block_size)
+        return alloc_large(arena, size);
 
-    // arena is full
-    if (size > arena->available) {
-        new_block(arena, alloc_size);
-        arena->available = alloc_size;
+    // current block is full, move on to the next one that fits
+    if (arena->blocks_in_use == 0 || arena->used + size > arena->blocks[arena->blocks_in_use - 1].size) {
+        while (arena->blocks_in_use < arena->nblocks && arena->blocks[arena->blocks_in_use].size < size)
+            arena->blocks_in_use++;
+        if (arena->blocks_in_use == arena->nblocks)
+            new_block(arena, size);
+        arena->blocks_in_use++;
+        arena->used = 0;
     }
 
-    assert(size <= arena->available);
+    Block* block = &arena->blocks[arena->blocks_in_use - 1];
+    assert(arena->used + size <= block->size);
+    void* allocated = (void*) ((size_t) block->data + arena->used);
+    arena->used += size;
+    return allocated;
+}
 
-    size_t in_block = alloc_size - arena->available;
-    void* allocated = (void*) ((size_t) arena->blocks[arena->nblocks - 1] + in_block);
-    memset(allocated, 0, size);
-    arena->available -= size;
+void* shd_arena_alloc(Arena* arena, size_t size) {
+    void* allocated = shd_arena_alloc_uninit(arena, size);
+    if (allocated)
+        memset(allocated, 0, size);
     return allocated;
 }
+
+ArenaMark shd_arena_mark(const Arena* arena) {
+    return (ArenaMark) {
+        .blocks_in_use = arena->blocks_in_use,
+        .used = arena->used,
+        .large_count = arena->nlarge,
+    };
+}
+
+void shd_arena_rewind(Arena* arena, ArenaMark mark) {
+    assert(mark.blocks_in_use <= arena->blocks_in_use && mark.large_count <= arena->nlarge);
+    assert(mark.blocks_in_use < arena->blocks_in_use || mark.used <= arena->used);
+    for (size_t i = mark.large_count; i < arena->nlarge; i++)
+        free(arena->large[i].data);
+    arena->nlarge = mark.large_count;
+    arena->blocks_in_use = mark.blocks_in_use;
+    arena->used = mark.used;
+}
+
+void shd_arena_reset(Arena* arena) {
+    shd_arena_rewind(arena, (ArenaMark) { 0 });
+}
+
+size_t shd_arena_reserved_bytes(const Arena* arena) {
+    size_t total = 0;
+    for (size_t i = 0; i < arena->nblocks; i++)
+        total += arena->blocks[i].size;
+    for (size_t i = 0; i < arena->nlarge; i++)
+        total += arena->large[i].size;
+    return total;
+}
+
+static SHADY_THREAD_LOCAL Arena* scratch_arena = NULL;
+
+Arena* shd_get_scratch_arena(void) {
+    if (!scratch_arena)
+        scratch_arena = shd_new_arena();
+    return scratch_arena;
+}
+
+void shd_destroy_scratch_arena(void) {
+    if (!scratch_arena)
+        return;
+    shd_destroy_arena(scratch_arena);
+    scratch_arena = NULL;
+}
@@ -7,6 +7,31 @@ typedef struct Arena_ Arena;
 
 Arena* shd_new_arena(void);
 void shd_destroy_arena(Arena* arena);
+/// Zero-initialised allocation
 void* shd_arena_alloc(Arena* arena, size_t size);
+/// Like shd_arena_alloc, but the memory is left uninitialised: for callers that overwrite it immediately.
+void* shd_arena_alloc_uninit(Arena* arena, size_t size);
+
+/// Opaque position in an arena, everything allocated after it can be released at once by rewinding to it.
+typedef struct {
+    size_t blocks_in_use;
+    size_t used;
+    size_t large_count;
+} ArenaMark;
+
+ArenaMark shd_arena_mark(const Arena* arena);
+/// Releases everything allocated since @p mark was taken. Blocks are kept around for reuse rather than freed.
+void shd_arena_rewind(Arena* arena, ArenaMark mark);
+/// Rewinds the arena all the way to its empty state.
+void shd_arena_reset(Arena* arena);
+/// How much memory the arena is holding on to, including blocks kept around for reuse.
+size_t shd_arena_reserved_bytes(const Arena* arena);
+
+/// Returns an arena private to the calling thread, for temporaries that don't outlive a function call.
+/// It is shared by everything up the call stack, so users must take a mark before allocating and rewind to it
+/// before returning. Its blocks get reused from one borrow to the next, until the thread is done with it.
+Arena* shd_get_scratch_arena(void);
+/// Frees the scratch arena of the calling thread, if it has one. Threads started with shd_spawn_thread do this on exit.
+void shd_destroy_scratch_arena(void);
 
 #endif
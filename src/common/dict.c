@@ -7,6 +7,11 @@
 #include <string.h>
 #include <assert.h>
 
+#if !defined(SHADY_DICT_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SHADY_DICT_SSE2
+#include <emmintrin.h>
+#endif
+
 inline static size_t div_roundup(size_t a, size_t b) {
     if (a % b == 0)
         return a / b;
@@ -23,15 +28,20 @@ inline static size_t maxof(size_t a, size_t b) {
     return a > b ? a : b;
 }
 
+// The table is split in groups of GROUP_WIDTH slots, each slot has a control byte and the control bytes of a group
+// are contiguous, so a whole group can be matched against a hash fragment in one go.
+// A control byte is either EMPTY, DELETED, or the 7 low bits of the hash of the key living in that slot.
+// Groups are probed quadratically, and a lookup stops at the first group that has an EMPTY slot.
+#define GROUP_WIDTH 16
+
+#define CTRL_EMPTY ((uint8_t) 0x80)
+#define CTRL_DELETED ((uint8_t) 0xFE)
+
+// size is a power of two, and never smaller than a couple groups
 static size_t init_size = 32;
 
-struct BucketTag {
-    bool is_present;
-    bool is_thombstone;
-#ifdef GOBLIB_DICT_DEBUG
-    KeyHash cached_hash;
-#endif
-};
+/// One bit per slot in the group
+typedef uint32_t GroupMask;
 
 struct Dict {
     size_t entries_count;
@@ -42,115 +52,138 @@ struct Dict {
     size_t value_size;
 
     size_t value_offset;
-    size_t tag_offset;
     size_t bucket_entry_size;
 
     KeyHash (*hash_fn) (void*);
     bool (*cmp_fn) (void*, void*);
+    uint8_t* ctrl;
     void* alloc;
 };
 
-#ifdef GOBLIB_DICT_DEBUG
-static size_t dict_count_sanity(struct Dict* dict) {
-    size_t i = 0;
-    size_t count = 0;
-    while (dict_iter(dict, &i, NULL, NULL)) {
-        count++;
-    }
-    return count;
-}
-
-static void validate_hashmap_integrity(const struct Dict* dict) {
-    const size_t alloc_base = (size_t) dict->alloc;
-    for (size_t i = 0; i < dict->size; i++) {
-        size_t bucket = alloc_base + i * dict->bucket_entry_size;
-        void* in_dict_key = (void*) bucket;
-        struct BucketTag tag = *(struct BucketTag*) (void*) (bucket + dict->tag_offset);
-        if (tag.is_present) {
-            KeyHash fresh_hash = dict->hash_fn(in_dict_key);
-            if (fresh_hash != tag.cached_hash) {
-                error("hash changed under our noses");
-            }
-        }
-    }
+inline static unsigned first_bit(GroupMask mask) {
+    assert(mask);
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned) index;
+#else
+    return (unsigned) __builtin_ctz(mask);
+#endif
 }
 
-static void dump_dict_keys(struct Dict* dict) {
-    const size_t alloc_base = (size_t) dict->alloc;
-    for (size_t i = 0; i < dict->size; i++) {
-        size_t bucket = alloc_base + i * dict->bucket_entry_size;
-        void* in_dict_key = (void*) bucket;
-        struct BucketTag tag = *(struct BucketTag*) (void*) (bucket + dict->tag_offset);
-        if (tag.is_present) {
-            KeyHash hash = dict->hash_fn(in_dict_key);
-            printf("@i = %zu, hash = %d\n", i, hash);
-        }
-    }
+#ifdef SHADY_DICT_SSE2
+inline static GroupMask group_match(const uint8_t* group, uint8_t h2) {
+    __m128i ctrl = _mm_loadu_si128((const __m128i*) group);
+    return (GroupMask) _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char) h2)));
+}
+
+inline static GroupMask group_match_empty(const uint8_t* group) {
+    return group_match(group, CTRL_EMPTY);
+}
+
+inline static GroupMask group_match_empty_or_deleted(const uint8_t* group) {
+    // both have their top bit set, unlike full slots
+    __m128i ctrl = _mm_loadu_si128((const __m128i*) group);
+    return (GroupMask) _mm_movemask_epi8(ctrl);
+}
+#else
+inline static GroupMask group_match(const uint8_t* group, uint8_t h2) {
+    GroupMask mask = 0;
+    for (unsigned i = 0; i < GROUP_WIDTH; i++)
+        mask |= (GroupMask) (group[i] == h2) << i;
+    return mask;
+}
+
+inline static GroupMask group_match_empty(const uint8_t* group) {
+    return group_match(group, CTRL_EMPTY);
+}
+
+inline static GroupMask group_match_empty_or_deleted(const uint8_t* group) {
+    GroupMask mask = 0;
+    for (unsigned i = 0; i < GROUP_WIDTH; i++)
+        mask |= (GroupMask) (group[i] >> 7) << i;
+    return mask;
 }
 #endif
 
+inline static bool is_full(uint8_t ctrl) {
+    return (ctrl & 0x80) == 0;
+}
+
+/// The user-provided hash functions are of varying quality (some are the identity, some are pointers), and we want
+/// the bits we use for picking groups and the fragments stored in the control bytes to be uncorrelated.
+inline static KeyHash mix_hash(KeyHash h) {
+    // MurmurHash3 finalizer
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+inline static uint8_t hash_fragment(KeyHash hash) {
+    return (uint8_t) (hash & 0x7F);
+}
+
+inline static size_t home_group(const struct Dict* dict, KeyHash hash) {
+    return (hash >> 7) & (dict->size / GROUP_WIDTH - 1);
+}
+
+inline static void* slot_key(const struct Dict* dict, size_t slot) {
+    return (void*) ((size_t) dict->alloc + slot * dict->bucket_entry_size);
+}
+
+inline static size_t max_load(size_t size) {
+    return size - size / 8;
+}
+
+static void alloc_table(struct Dict* dict, size_t size) {
+    assert(size >= GROUP_WIDTH && (size & (size - 1)) == 0);
+    dict->size = size;
+    dict->entries_count = 0;
+    dict->thombstones_count = 0;
+    dict->ctrl = malloc(size);
+    memset(dict->ctrl, CTRL_EMPTY, size);
+    dict->alloc = malloc(size * dict->bucket_entry_size);
+}
+
 struct Dict* shd_new_dict_impl(size_t key_size, size_t value_size, size_t key_align, size_t value_align, KeyHash (*hash_fn)(void*), bool (*cmp_fn) (void*, void*)) {
     // offset of key is obviously zero
     size_t value_offset = align_offset(key_size, value_align);
-    size_t tag_offset = align_offset(value_offset + value_size, alignof(struct BucketTag));
-
-    size_t bucket_entry_size = tag_offset + sizeof(struct BucketTag);
+    size_t bucket_entry_size = value_offset + value_size;
 
     // Add extra padding at the end of each entry if required...
-    size_t max_align = maxof(maxof(key_align, value_align), alignof(struct BucketTag));
+    size_t max_align = maxof(key_align, value_align);
     bucket_entry_size = align_offset(bucket_entry_size, max_align);
 
     struct Dict* dict = (struct Dict*) malloc(sizeof(struct Dict));
     *dict = (struct Dict) {
-        .entries_count = 0,
-        .thombstones_count = 0,
-        .size = init_size,
-
         .key_size = key_size,
         .value_size = value_size,
 
         .value_offset = value_offset,
-        .tag_offset = tag_offset,
         .bucket_entry_size = bucket_entry_size,
 
         .hash_fn = hash_fn,
         .cmp_fn = cmp_fn,
-
-        .alloc = malloc(bucket_entry_size * init_size)
     };
-    // zero-init
-    memset(dict->alloc, 0, bucket_entry_size * init_size);
+    alloc_table(dict, init_size);
     return dict;
 }
 
 struct Dict* shd_clone_dict(struct Dict* source) {
     struct Dict* dict = (struct Dict*) malloc(sizeof(struct Dict));
-    *dict = (struct Dict) {
-        .entries_count = source->entries_count,
-        .thombstones_count = source->thombstones_count,
-        .size = source->size,
-
-        .key_size = source->key_size,
-        .value_size = source->value_size,
-
-        .value_offset = source->value_offset,
-        .tag_offset = source->tag_offset,
-        .bucket_entry_size = source->bucket_entry_size,
-
-        .hash_fn = source->hash_fn,
-        .cmp_fn = source->cmp_fn,
-
-        .alloc = malloc(source->bucket_entry_size * source->size)
-    };
+    *dict = *source;
+    dict->ctrl = malloc(source->size);
+    memcpy(dict->ctrl, source->ctrl, source->size);
+    dict->alloc = malloc(source->bucket_entry_size * source->size);
     memcpy(dict->alloc, source->alloc, source->bucket_entry_size * source->size);
-#ifdef GOBLIB_DICT_DEBUG
-    validate_hashmap_integrity(dict);
-    validate_hashmap_integrity(source);
-#endif
     return dict;
 }
 
 void shd_destroy_dict(struct Dict* dict) {
+    free(dict->ctrl);
     free(dict->alloc);
     free(dict);
 }
@@ -158,42 +191,48 @@ void shd_destroy_dict(struct Dict* dict) {
 void shd_dict_clear(struct Dict* dict) {
     dict->entries_count = 0;
     dict->thombstones_count = 0;
-    memset(dict->alloc, 0, dict->bucket_entry_size * dict->size);
+    memset(dict->ctrl, CTRL_EMPTY, dict->size);
 }
 
 size_t shd_dict_count(struct Dict* dict) {
     return dict->entries_count;
 }
 
-void* shd_dict_find_impl(struct Dict* dict, void* key) {
-#ifdef GOBLIB_DICT_DEBUG_PARANOID
-    validate_hashmap_integrity(dict);
-#endif
-    KeyHash hash = dict->hash_fn(key);
-    size_t pos = hash % dict->size;
-    const size_t init_pos = pos;
-    const size_t alloc_base = (size_t) dict->alloc;
-    while (true) {
-        size_t bucket = alloc_base + pos * dict->bucket_entry_size;
-
-        void* in_dict_key = (void*) bucket;
-        struct BucketTag* tag = (struct BucketTag*) (void*) (bucket + dict->tag_offset);
-        if (tag->is_present || tag->is_thombstone) {
-            // If the key is identical, we found our guy !
-            if (tag->is_present && dict->cmp_fn(in_dict_key, key))
-                return in_dict_key;
-
-            // Otherwise, do a crappy linear scan...
-            pos++;
-            if (pos == dict->size)
-                pos = 0;
-
-            // Make sure to die if we go full circle
-            if (pos == init_pos)
-                break;
-        } else break;
+/// Returns the slot holding @p key, or SIZE_MAX.
+/// If @p first_available is not NULL, it gets the first slot in the probe sequence that can take the key.
+static size_t find_slot(struct Dict* dict, void* key, KeyHash hash, size_t* first_available) {
+    const size_t groups_mask = dict->size / GROUP_WIDTH - 1;
+    const uint8_t h2 = hash_fragment(hash);
+    size_t group = home_group(dict, hash);
+    if (first_available)
+        *first_available = SIZE_MAX;
+    // triangular numbers visit every group exactly once when the group count is a power of two
+    for (size_t i = 0; i <= groups_mask; i++) {
+        const uint8_t* ctrl = dict->ctrl + group * GROUP_WIDTH;
+        GroupMask candidates = group_match(ctrl, h2);
+        while (candidates) {
+            size_t slot = group * GROUP_WIDTH + first_bit(candidates);
+            if (dict->cmp_fn(slot_key(dict, slot), key))
+                return slot;
+            candidates &= candidates - 1;
+        }
+        if (first_available && *first_available == SIZE_MAX) {
+            GroupMask available = group_match_empty_or_deleted(ctrl);
+            if (available)
+                *first_available = group * GROUP_WIDTH + first_bit(available);
+        }
+        if (group_match_empty(ctrl))
+            break;
+        group = (group + i + 1) & groups_mask;
     }
-    return NULL;
+    return SIZE_MAX;
+}
+
+void* shd_dict_find_impl(struct Dict* dict, void* key) {
+    size_t slot = find_slot(dict, key, mix_hash(dict->hash_fn(key)), NULL);
+    if (slot == SIZE_MAX)
+        return NULL;
+    return slot_key(dict, slot);
 }
 
 void* shd_dict_find_value_impl(struct Dict* dict, void* key) {
@@ -204,17 +243,18 @@ void* shd_dict_find_value_impl(struct Dict* dict, void* key) {
 }
 
 bool shd_dict_remove_impl(struct Dict* dict, void* key) {
-    void* found = shd_dict_find_impl(dict, key);
-    if (found) {
-        struct BucketTag* tag = (void *) (((size_t) found) + dict->tag_offset);
-        assert(tag->is_present && !tag->is_thombstone);
-        tag->is_present = false;
-        tag->is_thombstone = true;
+    size_t slot = find_slot(dict, key, mix_hash(dict->hash_fn(key)), NULL);
+    if (slot == SIZE_MAX)
+        return false;
+    // If the group still has an empty slot, no lookup ever went past it, so we don't need a thombstone
+    if (group_match_empty(dict->ctrl + (slot / GROUP_WIDTH) * GROUP_WIDTH)) {
+        dict->ctrl[slot] = CTRL_EMPTY;
+    } else {
+        dict->ctrl[slot] = CTRL_DELETED;
         dict->thombstones_count++;
-        dict->entries_count--;
-        return true;
     }
-    return false;
+    dict->entries_count--;
+    return true;
 }
 
 static bool dict_insert(struct Dict* dict, void* key, void* value, void** out_ptr);
@@ -236,150 +276,117 @@ void* shd_dict_insert_get_value_impl(struct Dict* dict, void* key, void* value)
     return (void*) ((size_t)do_care + dict->value_offset);
 }
 
-static void rehash(struct Dict* dict, void* old_alloc, size_t old_size) {
+static void rehash(struct Dict* dict, const uint8_t* old_ctrl, void* old_alloc, size_t old_size) {
     const size_t alloc_base = (size_t) old_alloc;
-    // Go over all the old entries and add them back
+    // Go over all the old entries and add them back, they are known to be unique so we only look for free slots
+    const size_t groups_mask = dict->size / GROUP_WIDTH - 1;
     for (size_t pos = 0; pos < old_size; pos++) {
-        size_t bucket = alloc_base + pos * dict->bucket_entry_size;
-
-        struct BucketTag* tag = (struct BucketTag*) (void*) (bucket + dict->tag_offset);
-        if (tag->is_present) {
-            void* key = (void*) bucket;
-            void* value = (void*) (bucket + dict->value_offset);
-            bool fresh = shd_dict_insert_impl(dict, key, value);
-            assert(fresh);
+        if (!is_full(old_ctrl[pos]))
+            continue;
+        void* key = (void*) (alloc_base + pos * dict->bucket_entry_size);
+        KeyHash hash = mix_hash(dict->hash_fn(key));
+        size_t group = home_group(dict, hash);
+        for (size_t i = 0;; i++) {
+            GroupMask available = group_match_empty(dict->ctrl + group * GROUP_WIDTH);
+            if (available) {
+                size_t slot = group * GROUP_WIDTH + first_bit(available);
+                dict->ctrl[slot] = hash_fragment(hash);
+                memcpy(slot_key(dict, slot), key, dict->bucket_entry_size);
+                dict->entries_count++;
+                break;
+            }
+            group = (group + i + 1) & groups_mask;
         }
     }
 }
 
-static void grow_and_rehash(struct Dict* dict) {
+static void resize_and_rehash(struct Dict* dict) {
     size_t old_entries_count = shd_dict_count(dict);
 
+    uint8_t* old_ctrl = dict->ctrl;
     void* old_alloc = dict->alloc;
     size_t old_size = dict->size;
 
-    dict->entries_count = 0;
-    dict->thombstones_count = 0;
-    dict->size *= 2;
-    dict->alloc = malloc(dict->size * dict->bucket_entry_size);
-    // zero-allocated so all the bucket flags are false
-    memset(dict->alloc, 0, dict->size * dict->bucket_entry_size);
-
-    rehash(dict, old_alloc, old_size);
-#ifdef GOBLIB_DICT_DEBUG
-    assert(dict_count_sanity(dict) == entries_count_dict(dict));
-#endif
+    // if thombstones are what is filling the table up, we can get rid of them without growing
+    size_t new_size = old_entries_count >= max_load(old_size) / 2 ? old_size * 2 : old_size;
+    alloc_table(dict, new_size);
+    rehash(dict, old_ctrl, old_alloc, old_size);
     assert(old_entries_count == shd_dict_count(dict));
 
+    free(old_ctrl);
     free(old_alloc);
 }
 
 static bool dict_insert(struct Dict* dict, void* key, void* value, void** out_ptr) {
-    float load_factor = (float) (dict->entries_count + dict->thombstones_count) / (float) dict->size;
-    if (load_factor > 0.6)
-        grow_and_rehash(dict);
-
-    KeyHash hash = dict->hash_fn(key);
-    size_t pos = hash % dict->size;
-    const size_t init_pos = pos;
-    const size_t alloc_base = (size_t) dict->alloc;
-
-    enum { Inserting, Overwriting, Moving } mode;
-
-    size_t first_available_pos = SIZE_MAX;
-
-    // Find an empty spot...
-    while (true) {
-        size_t bucket = alloc_base + pos * dict->bucket_entry_size;
-
-        struct BucketTag tag = *(struct BucketTag*) (void*) (bucket + dict->tag_offset);
-        if (!tag.is_present) {
-            if (first_available_pos == SIZE_MAX)
-                first_available_pos = pos;
-            if (!tag.is_thombstone) {
-                mode = Inserting;
-                break;
+    KeyHash hash = mix_hash(dict->hash_fn(key));
+
+    size_t first_available;
+    size_t slot = find_slot(dict, key, hash, &first_available);
+    bool fresh = slot == SIZE_MAX;
+    if (fresh) {
+        // reusing a thombstone does not make the table any fuller
+        if (first_available == SIZE_MAX || dict->ctrl[first_available] == CTRL_EMPTY) {
+            if (dict->entries_count + dict->thombstones_count + 1 > max_load(dict->size)) {
+                resize_and_rehash(dict);
+                find_slot(dict, key, hash, &first_available);
             }
-        } else {
-            void* in_dict_key = (void*) bucket;
-            if (dict->cmp_fn(in_dict_key, key)) {
-                if (first_available_pos == SIZE_MAX)
-                    first_available_pos = pos;
-                mode = (first_available_pos == pos) ? Overwriting : Moving;
-                break;
-            }
-        }
-
-        pos++;
-        if (pos == dict->size)
-            pos = 0;
-        if (pos == init_pos) {
-            assert(first_available_pos != SIZE_MAX);
-            mode = Inserting;
-            break;
         }
-    }
-    assert(first_available_pos < dict->size);
-    assert(pos < dict->size);
-
-    size_t dst_bucket = alloc_base + first_available_pos * dict->bucket_entry_size;
-    struct BucketTag* dst_tag = (struct BucketTag*) (void*) (dst_bucket + dict->tag_offset);
-    void* in_dict_key = (void*) dst_bucket;
-    void* in_dict_value = (void*) (dst_bucket + dict->value_offset);
-
-    if (dst_tag->is_thombstone)
-        dict->thombstones_count--;
-
-    if (mode == Moving) {
-        size_t src_bucket = alloc_base + pos * dict->bucket_entry_size;
-        struct BucketTag* src_tag = (struct BucketTag*) (void*) (src_bucket + dict->tag_offset);
-        assert(src_tag->is_present && dst_tag->is_thombstone);
-        src_tag->is_thombstone = true;
-        src_tag->is_present = false;
-    } else if (mode == Overwriting) {
-        assert(dst_tag->is_present);
-    } else {
+        slot = first_available;
+        assert(slot < dict->size && !is_full(dict->ctrl[slot]));
+        if (dict->ctrl[slot] == CTRL_DELETED)
+            dict->thombstones_count--;
+        dict->ctrl[slot] = hash_fragment(hash);
         dict->entries_count++;
     }
 
-    dst_tag->is_present = true;
-    dst_tag->is_thombstone = false;
-#ifdef GOBLIB_DICT_DEBUG
-    dst_tag->cached_hash = hash;
-#endif
+    void* in_dict_key = slot_key(dict, slot);
     memcpy(in_dict_key, key, dict->key_size);
     if (dict->value_size)
-        memcpy(in_dict_value, value, dict->value_size);
+        memcpy((void*) ((size_t) in_dict_key + dict->value_offset), value, dict->value_size);
     *out_ptr = in_dict_key;
+    return fresh;
+}
 
-#ifdef GOBLIB_DICT_DEBUG
-    validate_hashmap_integrity(dict);
-#endif
-
-    return mode == Inserting;
+DictStats shd_dict_stats(struct Dict* dict) {
+    DictStats stats = {
+        .entries_count = dict->entries_count,
+        .thombstones_count = dict->thombstones_count,
+        .buckets_count = dict->size,
+    };
+    const size_t groups_mask = dict->size / GROUP_WIDTH - 1;
+    for (size_t pos = 0; pos < dict->size; pos++) {
+        if (!is_full(dict->ctrl[pos]))
+            continue;
+        KeyHash hash = mix_hash(dict->hash_fn(slot_key(dict, pos)));
+        size_t group = home_group(dict, hash);
+        size_t probe_length = 0;
+        while (group != pos / GROUP_WIDTH) {
+            group = (group + probe_length + 1) & groups_mask;
+            probe_length++;
+        }
+        if (probe_length > 0)
+            stats.collisions_count++;
+        stats.total_probe_length += probe_length;
+        if (probe_length > stats.max_probe_length)
+            stats.max_probe_length = probe_length;
+    }
+    return stats;
 }
 
 bool shd_dict_iter(struct Dict* dict, size_t* iterator_state, void* key, void* value) {
-    bool found_something = false;
-    while (!found_something) {
-        if (*iterator_state >= dict->size) {
-            return false;
-        }
-        const size_t alloc_base = (size_t) dict->alloc;
-        size_t bucket = alloc_base + (*iterator_state) * dict->bucket_entry_size;
-        struct BucketTag* tag = (struct BucketTag*) (void*) (bucket + dict->tag_offset);
-        if (tag->is_present) {
-            found_something = true;
-            void* in_dict_key = (void*) bucket;
-            if (key)
-                memcpy(key, in_dict_key, dict->key_size);
-            void* in_dict_value = (void*) (bucket + dict->value_offset);
-            if (value && dict->value_size > 0)
-                memcpy(value, in_dict_value, dict->value_size);
-        }
-        (*iterator_state)++;
+    while (*iterator_state < dict->size) {
+        size_t pos = (*iterator_state)++;
+        if (!is_full(dict->ctrl[pos]))
+            continue;
+        void* in_dict_key = slot_key(dict, pos);
+        if (key)
+            memcpy(key, in_dict_key, dict->key_size);
+        void* in_dict_value = (void*) ((size_t) in_dict_key + dict->value_offset);
+        if (value && dict->value_size > 0)
+            memcpy(value, in_dict_value, dict->value_size);
+        return true;
     }
-    return true;
+    return false;
 }
 
 #include "murmur3.h"
@@ -396,6 +403,21 @@ KeyHash shd_hash_murmur(const void* data, size_t size) {
     return final;
 }
 
+inline static uint32_t rotl32(uint32_t x, int r) {
+    return (x << r) | (x >> (32 - r));
+}
+
+KeyHash shd_hash_combine(KeyHash seed, KeyHash value) {
+    // this is the block mixing step of MurmurHash3_x86_32
+    value *= 0xcc9e2d51;
+    value = rotl32(value, 15);
+    value *= 0x1b873593;
+
+    seed ^= value;
+    seed = rotl32(seed, 13);
+    return seed * 5 + 0xe6546b64;
+}
+
 KeyHash shd_hash_ptr(void** p) {
     return shd_hash_murmur(p, sizeof(void*));
 }
@@ -46,7 +46,23 @@ void* shd_dict_insert_get_key_impl(struct Dict*, void* key, void* value);
 #define  shd_set_insert_get_result(K, dict, key)           shd_dict_insert_impl(dict, (void*) (&(key)), NULL)
 bool shd_dict_insert_impl(struct Dict*, void* key, void* value);
 
+typedef struct {
+    size_t entries_count;
+    size_t thombstones_count;
+    size_t buckets_count;
+    /// Entries that did not land in the group of buckets their hash points to
+    size_t collisions_count;
+    /// Probe lengths count the groups visited before reaching the entry, so an entry in its home group has zero
+    size_t total_probe_length;
+    size_t max_probe_length;
+} DictStats;
+
+/// Walks the whole table and rehashes every key, meant for diagnostics only.
+DictStats shd_dict_stats(struct Dict* dict);
+
 KeyHash shd_hash_murmur(const void* data, size_t size);
+/// Order-sensitive mix of @p value into @p seed: unlike xor, swapping or repeating inputs changes the result.
+KeyHash shd_hash_combine(KeyHash seed, KeyHash value);
 
 KeyHash shd_hash_ptr(void**);
 bool shd_compare_ptrs(void**, void**);
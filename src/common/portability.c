@@ -1,5 +1,8 @@
+#include "portability.h"
+
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <assert.h>
 
 // Fix for allowing terminal colors on MINGW64
@@ -31,7 +34,7 @@ void shd_platform_specific_terminal_init_extras(void) {
 #include <stdint.h>
 #if defined(__MINGW64__) | defined(__MINGW32__)
 #include <pthread.h>
-uint64_t get_time_nano() {
+uint64_t shd_get_time_nano(void) {
     struct timespec t;
     clock_gettime(CLOCK_REALTIME, &t);
     return t.tv_sec * 1000000000 + t.tv_nsec;
@@ -67,4 +70,145 @@ const char* shd_get_executable_location(void) {
 #endif
     assert(final_len <= len);
     return buf;
-}
\ No newline at end of file
+}
+#ifdef WIN32
+bool shd_map_file(const char* filename, size_t* size, const void** data) {
+    HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (!mapping)
+        return false;
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    // the view keeps the mapping alive
+    CloseHandle(mapping);
+    if (!view)
+        return false;
+    *size = (size_t) file_size.QuadPart;
+    *data = view;
+    return true;
+}
+
+void shd_unmap_file(const void* data, SHADY_UNUSED size_t size) {
+    UnmapViewOfFile(data);
+}
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+bool shd_map_file(const char* filename, size_t* size, const void** data) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void* mapped = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return false;
+    *size = (size_t) st.st_size;
+    *data = mapped;
+    return true;
+}
+
+void shd_unmap_file(const void* data, size_t size) {
+    munmap((void*) data, size);
+}
+#endif
+
+#ifdef WIN32
+bool shd_create_directory(const char* path) {
+    return CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+}
+
+bool shd_replace_file(const char* src, const char* dst) {
+    return MoveFileExA(src, dst, MOVEFILE_REPLACE_EXISTING);
+}
+
+bool shd_touch_file(const char* filename) {
+    HANDLE file = CreateFileA(filename, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    bool ok = SetFileTime(file, NULL, NULL, &now);
+    CloseHandle(file);
+    return ok;
+}
+
+bool shd_list_files(const char* path, FileVisitFn fn, void* uptr) {
+    size_t len = strlen(path);
+    char* pattern = calloc(len + 3, 1);
+    memcpy(pattern, path, len);
+    memcpy(pattern + len, "\\*", 2);
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(pattern, &data);
+    free(pattern);
+    if (find == INVALID_HANDLE_VALUE)
+        return false;
+    do {
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            continue;
+        uint64_t size = ((uint64_t) data.nFileSizeHigh << 32) | data.nFileSizeLow;
+        uint64_t time = ((uint64_t) data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+        fn(uptr, data.cFileName, (size_t) size, time);
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+    return true;
+}
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+bool shd_create_directory(const char* path) {
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+bool shd_replace_file(const char* src, const char* dst) {
+    return rename(src, dst) == 0;
+}
+
+bool shd_touch_file(const char* filename) {
+    // NULL times means 'now'
+    return utimensat(AT_FDCWD, filename, NULL, 0) == 0;
+}
+
+bool shd_list_files(const char* path, FileVisitFn fn, void* uptr) {
+    DIR* dir = opendir(path);
+    if (!dir)
+        return false;
+    size_t path_len = strlen(path);
+    struct dirent* entry;
+    while ((entry = readdir(dir))) {
+        size_t name_len = strlen(entry->d_name);
+        char* full_path = calloc(path_len + name_len + 2, 1);
+        memcpy(full_path, path, path_len);
+        full_path[path_len] = '/';
+        memcpy(full_path + path_len + 1, entry->d_name, name_len);
+        struct stat st;
+        bool ok = stat(full_path, &st) == 0;
+        free(full_path);
+        if (!ok || !S_ISREG(st.st_mode))
+            continue;
+#ifdef __APPLE__
+        uint64_t nsec = (uint64_t) st.st_mtimespec.tv_nsec;
+#else
+        uint64_t nsec = (uint64_t) st.st_mtim.tv_nsec;
+#endif
+        fn(uptr, entry->d_name, (size_t) st.st_size, (uint64_t) st.st_mtime * 1000000000 + nsec);
+    }
+    closedir(dir);
+    return true;
+}
+#endif
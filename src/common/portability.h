@@ -3,6 +3,7 @@
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <stdbool.h>
 #ifdef _MSC_VER
 #include <malloc.h>
 #endif
@@ -18,6 +19,7 @@ static_assert(__STDC_VERSION__ >= 201112L, "C11 support is required to build sha
     #define popen _popen
     #define pclose _pclose
     #define SHADY_FALLTHROUGH
+    #define SHADY_THREAD_LOCAL __declspec(thread)
     // It's mid 2022, and this typedef is missing from <stdalign.h>
     // MSVC is not a real C11 compiler.
     typedef double max_align_t;
@@ -29,6 +31,7 @@ static_assert(__STDC_VERSION__ >= 201112L, "C11 support is required to build sha
     #endif
     #define SHADY_UNUSED __attribute__((unused))
     #define SHADY_FALLTHROUGH __attribute__((fallthrough));
+    #define SHADY_THREAD_LOCAL _Thread_local
 #endif
 
 static inline void* shd_alloc_aligned(size_t size, size_t alignment) {
@@ -53,4 +56,19 @@ const char* shd_get_executable_location(void);
 
 void shd_platform_specific_terminal_init_extras(void);
 
+/// Maps a whole file read-only into memory, release it with shd_unmap_file
+bool shd_map_file(const char* filename, size_t* size, const void** data);
+void shd_unmap_file(const void* data, size_t size);
+
+/// Creates a directory, succeeds if it already exists
+bool shd_create_directory(const char* path);
+/// Atomically replaces @p dst with @p src
+bool shd_replace_file(const char* src, const char* dst);
+/// Bumps the last modification time of a file to now
+bool shd_touch_file(const char* filename);
+
+typedef void (*FileVisitFn)(void* uptr, const char* filename, size_t size, uint64_t last_modified);
+/// Calls @p fn with the name (without the directory), size and modification time of every regular file in @p path
+bool shd_list_files(const char* path, FileVisitFn fn, void* uptr);
+
 #endif
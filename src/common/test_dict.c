@@ -10,6 +10,10 @@ KeyHash bad_hash_i32(int* i) {
     return *i;
 }
 
+KeyHash hash_i32(int* i) {
+    return shd_hash_murmur(i, sizeof(int));
+}
+
 bool compare_i32(int* pa, int* pb) {
     return *pa == *pb;
 }
@@ -26,6 +30,128 @@ void shuffle(int arr[]) {
     }
 }
 
+// Reference for the benchmark: the linear probing layout the dict used to have, with a tag next to every entry,
+// no hash bits kept around and every probe going through the comparison function.
+typedef struct {
+    int key;
+    bool is_present;
+    bool is_thombstone;
+} LinearBucket;
+
+typedef struct {
+    size_t size;
+    size_t entries_count;
+    HashFn hash_fn;
+    CmpFn cmp_fn;
+    LinearBucket* buckets;
+} LinearSet;
+
+static void linear_insert(LinearSet* set, int key);
+
+static void linear_grow(LinearSet* set) {
+    LinearBucket* old = set->buckets;
+    size_t old_size = set->size;
+    set->size *= 2;
+    set->entries_count = 0;
+    set->buckets = calloc(set->size, sizeof(LinearBucket));
+    for (size_t i = 0; i < old_size; i++)
+        if (old[i].is_present)
+            linear_insert(set, old[i].key);
+    free(old);
+}
+
+static LinearBucket* linear_probe(LinearSet* set, int key, bool stop_at_thombstones) {
+    size_t pos = set->hash_fn(&key) % set->size;
+    while (true) {
+        LinearBucket* bucket = &set->buckets[pos];
+        if (bucket->is_present && set->cmp_fn(&bucket->key, &key))
+            return bucket;
+        if (!bucket->is_present && (stop_at_thombstones || !bucket->is_thombstone))
+            return bucket;
+        pos = (pos + 1) % set->size;
+    }
+}
+
+static void linear_insert(LinearSet* set, int key) {
+    if ((float) (set->entries_count + 1) / (float) set->size > 0.6f)
+        linear_grow(set);
+    LinearBucket* bucket = linear_probe(set, key, true);
+    if (!bucket->is_present)
+        set->entries_count++;
+    *bucket = (LinearBucket) { .key = key, .is_present = true };
+}
+
+static bool linear_find(LinearSet* set, int key) {
+    return linear_probe(set, key, false)->is_present;
+}
+
+static void linear_remove(LinearSet* set, int key) {
+    LinearBucket* bucket = linear_probe(set, key, false);
+    if (bucket->is_present) {
+        bucket->is_present = false;
+        bucket->is_thombstone = true;
+    }
+}
+
+// Not part of the test itself, run with --bench
+#define BENCH_ENTRIES (1 << 17)
+
+static double elapsed_ms(uint64_t since) {
+    return (double) (shd_get_time_nano() - since) / 1000000.0;
+}
+
+static void benchmark(void) {
+    int* keys = malloc(sizeof(int) * BENCH_ENTRIES);
+    for (int i = 0; i < BENCH_ENTRIES; i++)
+        keys[i] = rand();
+
+    size_t found = 0;
+    uint64_t t = shd_get_time_nano();
+    struct Dict* d = shd_new_set(int, (HashFn) hash_i32, (CmpFn) compare_i32);
+    for (int i = 0; i < BENCH_ENTRIES; i++)
+        shd_set_insert_get_result(int, d, keys[i]);
+    double dict_insert = elapsed_ms(t);
+    t = shd_get_time_nano();
+    for (int i = 0; i < BENCH_ENTRIES; i++) {
+        int miss = keys[i] ^ 0x5555;
+        found += shd_dict_find_key(int, d, keys[i]) != NULL;
+        found += shd_dict_find_key(int, d, miss) != NULL;
+    }
+    double dict_find = elapsed_ms(t);
+    t = shd_get_time_nano();
+    for (int i = 0; i < BENCH_ENTRIES; i += 2)
+        shd_dict_remove(int, d, keys[i]);
+    for (int i = 0; i < BENCH_ENTRIES; i++)
+        found += shd_dict_find_key(int, d, keys[i]) != NULL;
+    double dict_churn = elapsed_ms(t);
+    shd_destroy_dict(d);
+
+    t = shd_get_time_nano();
+    LinearSet l = { .size = 32, .hash_fn = (HashFn) hash_i32, .cmp_fn = (CmpFn) compare_i32, .buckets = calloc(32, sizeof(LinearBucket)) };
+    for (int i = 0; i < BENCH_ENTRIES; i++)
+        linear_insert(&l, keys[i]);
+    double linear_insert_time = elapsed_ms(t);
+    t = shd_get_time_nano();
+    for (int i = 0; i < BENCH_ENTRIES; i++) {
+        int miss = keys[i] ^ 0x5555;
+        found += linear_find(&l, keys[i]);
+        found += linear_find(&l, miss);
+    }
+    double linear_find_time = elapsed_ms(t);
+    t = shd_get_time_nano();
+    for (int i = 0; i < BENCH_ENTRIES; i += 2)
+        linear_remove(&l, keys[i]);
+    for (int i = 0; i < BENCH_ENTRIES; i++)
+        found += linear_find(&l, keys[i]);
+    double linear_churn = elapsed_ms(t);
+    free(l.buckets);
+    free(keys);
+
+    printf("%d entries (%zu hits)    insert     find (hit+miss)  remove+find\n", BENCH_ENTRIES, found);
+    printf("group probing:         %8.3fms %8.3fms        %8.3fms\n", dict_insert, dict_find, dict_churn);
+    printf("linear probing:        %8.3fms %8.3fms        %8.3fms\n", linear_insert_time, linear_find_time, linear_churn);
+}
+
 int main(int argc, char** argv) {
     srand((int) shd_get_time_nano());
     struct Dict* d = shd_new_set(int, (HashFn) bad_hash_i32, (CmpFn) compare_i32);
@@ -86,6 +212,22 @@ int main(int argc, char** argv) {
         assert(shd_dict_find_key(int, d, arr[i]));
     }
 
+    DictStats stats = shd_dict_stats(d);
+    assert(stats.entries_count == TEST_ENTRIES);
+    assert(stats.collisions_count <= stats.entries_count);
+    assert(stats.max_probe_length < stats.buckets_count);
+
     shd_destroy_dict(d);
+
+    // combining hashes must not be commutative nor let duplicates cancel out
+    KeyHash a = shd_hash_murmur(&arr[0], sizeof(int));
+    KeyHash b = shd_hash_murmur(&arr[1], sizeof(int));
+    assert(shd_hash_combine(shd_hash_combine(0, a), b) != shd_hash_combine(shd_hash_combine(0, b), a));
+    assert(shd_hash_combine(shd_hash_combine(0, a), a) != 0);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench") == 0)
+            benchmark();
+    }
     return 0;
 }
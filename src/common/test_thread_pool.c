@@ -0,0 +1,44 @@
+#include "threading.h"
+#include "arena.h"
+#include "log.h"
+
+#include <stdlib.h>
+
+#define THREADS_COUNT 4
+#define JOBS_COUNT 1000
+
+typedef struct {
+    volatile uint32_t calls;
+    /// Set by the job, so that later ones can check they don't run before it is over
+    uint32_t job;
+} Job;
+
+static void run_job(Job* job) {
+    // every thread gets its own scratch arena, which goes away with the thread
+    Arena* scratch = shd_get_scratch_arena();
+    ArenaMark mark = shd_arena_mark(scratch);
+    uint32_t* value = shd_arena_alloc(scratch, sizeof(uint32_t));
+    *value = job->job;
+    shd_atomic_fetch_add_u32(&job->calls, *value == job->job);
+    shd_arena_rewind(scratch, mark);
+}
+
+int main(void) {
+    size_t sizes[] = { 1, THREADS_COUNT };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        ThreadPool* pool = shd_new_thread_pool(sizes[s]);
+        if (shd_get_thread_pool_size(pool) != sizes[s])
+            shd_error("Wrong pool size");
+        Job job = { 0 };
+        for (uint32_t i = 0; i < JOBS_COUNT; i++) {
+            job.job = i;
+            job.calls = 0;
+            shd_thread_pool_run(pool, (ThreadFn) run_job, &job);
+            // the pool only returns once every thread, the calling one included, is done with the job
+            if (job.calls != sizes[s])
+                shd_error("Job %u ran %u times on a pool of %zu threads", i, job.calls, sizes[s]);
+        }
+        shd_destroy_thread_pool(pool);
+    }
+    return 0;
+}
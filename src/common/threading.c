@@ -0,0 +1,282 @@
+#include "threading.h"
+#include "arena.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+#ifdef _WIN32
+#include <windows.h>
+
+struct Mutex_ {
+    SRWLOCK lock;
+};
+
+Mutex* shd_new_mutex(void) {
+    Mutex* mutex = malloc(sizeof(Mutex));
+    InitializeSRWLock(&mutex->lock);
+    return mutex;
+}
+
+void shd_destroy_mutex(Mutex* mutex) {
+    free(mutex);
+}
+
+void shd_mutex_lock(Mutex* mutex) {
+    AcquireSRWLockExclusive(&mutex->lock);
+}
+
+void shd_mutex_unlock(Mutex* mutex) {
+    ReleaseSRWLockExclusive(&mutex->lock);
+}
+
+struct CondVar_ {
+    CONDITION_VARIABLE cond;
+};
+
+CondVar* shd_new_cond_var(void) {
+    CondVar* cond = malloc(sizeof(CondVar));
+    InitializeConditionVariable(&cond->cond);
+    return cond;
+}
+
+void shd_destroy_cond_var(CondVar* cond) {
+    free(cond);
+}
+
+void shd_cond_var_wait(CondVar* cond, Mutex* mutex) {
+    SleepConditionVariableSRW(&cond->cond, &mutex->lock, INFINITE, 0);
+}
+
+void shd_cond_var_broadcast(CondVar* cond) {
+    WakeAllConditionVariable(&cond->cond);
+}
+
+struct Thread_ {
+    HANDLE handle;
+    ThreadFn fn;
+    void* uptr;
+};
+
+static DWORD WINAPI thread_entry(LPVOID param) {
+    Thread* thread = param;
+    thread->fn(thread->uptr);
+    shd_destroy_scratch_arena();
+    return 0;
+}
+
+Thread* shd_spawn_thread(ThreadFn fn, void* uptr) {
+    Thread* thread = malloc(sizeof(Thread));
+    thread->fn = fn;
+    thread->uptr = uptr;
+    thread->handle = CreateThread(NULL, 0, thread_entry, thread, 0, NULL);
+    assert(thread->handle);
+    return thread;
+}
+
+void shd_join_thread(Thread* thread) {
+    WaitForSingleObject(thread->handle, INFINITE);
+    CloseHandle(thread->handle);
+    free(thread);
+}
+
+size_t shd_get_hardware_concurrency(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+}
+
+uint32_t shd_atomic_fetch_add_u32(volatile uint32_t* ptr, uint32_t value) {
+    return (uint32_t) InterlockedExchangeAdd((volatile LONG*) ptr, (LONG) value);
+}
+
+void* shd_atomic_load_ptr(void* volatile* ptr) {
+    return InterlockedCompareExchangePointer(ptr, NULL, NULL);
+}
+
+bool shd_atomic_cas_ptr(void* volatile* ptr, void* expected, void* desired) {
+    return InterlockedCompareExchangePointer(ptr, desired, expected) == expected;
+}
+
+#else
+#include <pthread.h>
+#include <unistd.h>
+
+struct Mutex_ {
+    pthread_mutex_t lock;
+};
+
+Mutex* shd_new_mutex(void) {
+    Mutex* mutex = malloc(sizeof(Mutex));
+    pthread_mutex_init(&mutex->lock, NULL);
+    return mutex;
+}
+
+void shd_destroy_mutex(Mutex* mutex) {
+    pthread_mutex_destroy(&mutex->lock);
+    free(mutex);
+}
+
+void shd_mutex_lock(Mutex* mutex) {
+    pthread_mutex_lock(&mutex->lock);
+}
+
+void shd_mutex_unlock(Mutex* mutex) {
+    pthread_mutex_unlock(&mutex->lock);
+}
+
+struct CondVar_ {
+    pthread_cond_t cond;
+};
+
+CondVar* shd_new_cond_var(void) {
+    CondVar* cond = malloc(sizeof(CondVar));
+    pthread_cond_init(&cond->cond, NULL);
+    return cond;
+}
+
+void shd_destroy_cond_var(CondVar* cond) {
+    pthread_cond_destroy(&cond->cond);
+    free(cond);
+}
+
+void shd_cond_var_wait(CondVar* cond, Mutex* mutex) {
+    pthread_cond_wait(&cond->cond, &mutex->lock);
+}
+
+void shd_cond_var_broadcast(CondVar* cond) {
+    pthread_cond_broadcast(&cond->cond);
+}
+
+struct Thread_ {
+    pthread_t handle;
+    ThreadFn fn;
+    void* uptr;
+};
+
+static void* thread_entry(void* param) {
+    Thread* thread = param;
+    thread->fn(thread->uptr);
+    shd_destroy_scratch_arena();
+    return NULL;
+}
+
+Thread* shd_spawn_thread(ThreadFn fn, void* uptr) {
+    Thread* thread = malloc(sizeof(Thread));
+    thread->fn = fn;
+    thread->uptr = uptr;
+    int result = pthread_create(&thread->handle, NULL, thread_entry, thread);
+    assert(result == 0);
+    (void) result;
+    return thread;
+}
+
+void shd_join_thread(Thread* thread) {
+    pthread_join(thread->handle, NULL);
+    free(thread);
+}
+
+size_t shd_get_hardware_concurrency(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (size_t) count : 1;
+}
+
+uint32_t shd_atomic_fetch_add_u32(volatile uint32_t* ptr, uint32_t value) {
+    return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+}
+
+void* shd_atomic_load_ptr(void* volatile* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+bool shd_atomic_cas_ptr(void* volatile* ptr, void* expected, void* desired) {
+    return __atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+#endif
+
+struct ThreadPool_ {
+    Mutex* lock;
+    CondVar* wake_up;
+    CondVar* all_done;
+
+    size_t threads_count;
+    /// The threads_count - 1 threads besides the one that created the pool
+    Thread** threads;
+
+    /// Bumped for every job, so workers can tell a new one from a spurious wake-up
+    uint64_t job;
+    ThreadFn fn;
+    void* uptr;
+    /// Workers still busy with the current job
+    size_t running;
+    bool quit;
+};
+
+static void thread_pool_worker(ThreadPool* pool) {
+    uint64_t done = 0;
+    shd_mutex_lock(pool->lock);
+    while (true) {
+        while (pool->job == done && !pool->quit)
+            shd_cond_var_wait(pool->wake_up, pool->lock);
+        if (pool->quit)
+            break;
+        done = pool->job;
+        ThreadFn fn = pool->fn;
+        void* uptr = pool->uptr;
+        shd_mutex_unlock(pool->lock);
+        fn(uptr);
+        shd_mutex_lock(pool->lock);
+        if (--pool->running == 0)
+            shd_cond_var_broadcast(pool->all_done);
+    }
+    shd_mutex_unlock(pool->lock);
+}
+
+ThreadPool* shd_new_thread_pool(size_t threads_count) {
+    assert(threads_count > 0);
+    ThreadPool* pool = calloc(1, sizeof(ThreadPool));
+    pool->lock = shd_new_mutex();
+    pool->wake_up = shd_new_cond_var();
+    pool->all_done = shd_new_cond_var();
+    pool->threads_count = threads_count;
+    pool->threads = calloc(threads_count, sizeof(Thread*));
+    for (size_t i = 1; i < threads_count; i++)
+        pool->threads[i] = shd_spawn_thread((ThreadFn) thread_pool_worker, pool);
+    return pool;
+}
+
+void shd_destroy_thread_pool(ThreadPool* pool) {
+    shd_mutex_lock(pool->lock);
+    pool->quit = true;
+    shd_cond_var_broadcast(pool->wake_up);
+    shd_mutex_unlock(pool->lock);
+    for (size_t i = 1; i < pool->threads_count; i++)
+        shd_join_thread(pool->threads[i]);
+    free(pool->threads);
+    shd_destroy_cond_var(pool->all_done);
+    shd_destroy_cond_var(pool->wake_up);
+    shd_destroy_mutex(pool->lock);
+    free(pool);
+}
+
+size_t shd_get_thread_pool_size(const ThreadPool* pool) {
+    return pool->threads_count;
+}
+
+void shd_thread_pool_run(ThreadPool* pool, ThreadFn fn, void* uptr) {
+    shd_mutex_lock(pool->lock);
+    assert(pool->running == 0 && "jobs can't be nested");
+    pool->fn = fn;
+    pool->uptr = uptr;
+    pool->running = pool->threads_count - 1;
+    pool->job++;
+    shd_cond_var_broadcast(pool->wake_up);
+    shd_mutex_unlock(pool->lock);
+
+    fn(uptr);
+
+    shd_mutex_lock(pool->lock);
+    while (pool->running > 0)
+        shd_cond_var_wait(pool->all_done, pool->lock);
+    shd_mutex_unlock(pool->lock);
+}
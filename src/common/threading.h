@@ -0,0 +1,48 @@
+#ifndef SHADY_THREADING_H
+#define SHADY_THREADING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct Mutex_ Mutex;
+
+Mutex* shd_new_mutex(void);
+void shd_destroy_mutex(Mutex* mutex);
+void shd_mutex_lock(Mutex* mutex);
+void shd_mutex_unlock(Mutex* mutex);
+
+typedef struct CondVar_ CondVar;
+
+CondVar* shd_new_cond_var(void);
+void shd_destroy_cond_var(CondVar* cond);
+/// Unlocks @p mutex while waiting, and locks it again before returning. Wake-ups can be spurious.
+void shd_cond_var_wait(CondVar* cond, Mutex* mutex);
+void shd_cond_var_broadcast(CondVar* cond);
+
+typedef struct Thread_ Thread;
+typedef void (*ThreadFn)(void* uptr);
+
+Thread* shd_spawn_thread(ThreadFn fn, void* uptr);
+/// Waits for the thread to be done and frees it.
+void shd_join_thread(Thread* thread);
+size_t shd_get_hardware_concurrency(void);
+
+/// Threads kept around to run jobs on, so that they don't have to be started again for each of them.
+typedef struct ThreadPool_ ThreadPool;
+
+/// The calling thread counts as one of the @p threads_count, it takes part in every job it submits.
+ThreadPool* shd_new_thread_pool(size_t threads_count);
+void shd_destroy_thread_pool(ThreadPool* pool);
+size_t shd_get_thread_pool_size(const ThreadPool* pool);
+/// Calls @p fn on every thread of the pool, including the calling one, and waits for all of them to return.
+/// Only the thread that created the pool may submit jobs to it.
+void shd_thread_pool_run(ThreadPool* pool, ThreadFn fn, void* uptr);
+
+/// Returns the value before the addition.
+uint32_t shd_atomic_fetch_add_u32(volatile uint32_t* ptr, uint32_t value);
+void* shd_atomic_load_ptr(void* volatile* ptr);
+/// Returns whether @p ptr contained @p expected and got swapped with @p desired.
+bool shd_atomic_cas_ptr(void* volatile* ptr, void* expected, void* desired);
+
+#endif
@@ -111,6 +111,7 @@ void shd_parse_compiler_config_args(CompilerConfig* config, int* pargc, char** a
     int argc = *pargc;
 
     bool help = false;
+    bool compaction_threshold_set = false;
     for (int i = 1; i < argc; i++) {
         if (argv[i] == NULL)
             continue;
@@ -154,6 +155,41 @@ void shd_parse_compiler_config_args(CompilerConfig* config, int* pargc, char** a
                 default: break;
             }
             config->specialization.execution_model = em;
+        } else if (strcmp(argv[i], "--time-passes") == 0 || strcmp(argv[i], "--pass-stats") == 0) {
+            config->pass_stats.enabled = true;
+        } else if (strcmp(argv[i], "--pass-stats-json") == 0) {
+            argv[i] = NULL;
+            i++;
+            if (i == argc)
+                shd_error("Missing pass statistics output filename");
+            config->pass_stats.enabled = true;
+            config->pass_stats.json_output = argv[i];
+        } else if (strcmp(argv[i], "--in-place-passes") == 0) {
+            config->optimisations.in_place.enabled = true;
+        } else if (strcmp(argv[i], "--compaction-threshold") == 0) {
+            argv[i] = NULL;
+            i++;
+            if (i == argc)
+                shd_error("Missing compaction threshold");
+            char* end;
+            float threshold = strtof(argv[i], &end);
+            // written so that NaN fails it too
+            if (end == argv[i] || *end != '\0' || !(threshold > 0.0f && threshold <= 1.0f))
+                shd_error("Compaction threshold must be a number in (0, 1], got '%s'", argv[i]);
+            config->optimisations.in_place.compaction_threshold = threshold;
+            compaction_threshold_set = true;
+        } else if (strcmp(argv[i], "--cache-dir") == 0) {
+            argv[i] = NULL;
+            i++;
+            if (i == argc)
+                shd_error("Missing cache directory");
+            config->cache.directory = argv[i];
+        } else if (strcmp(argv[i], "--cache-max-size") == 0) {
+            argv[i] = NULL;
+            i++;
+            if (i == argc)
+                shd_error("Missing cache size");
+            config->cache.max_size = (size_t) strtoull(argv[i], NULL, 10) * 1024 * 1024;
         } else if (strcmp(argv[i], "--word-size") == 0) {
             argv[i] = NULL;
             i++;
@@ -171,6 +207,9 @@ void shd_parse_compiler_config_args(CompilerConfig* config, int* pargc, char** a
         argv[i] = NULL;
     }
 
+    if (compaction_threshold_set && !config->optimisations.in_place.enabled)
+        shd_error("--compaction-threshold only applies to passes rewriting in place, which --in-place-passes enables");
+
     if (help) {
         shd_error_print("  --shd_print-internal                          Includes internal functions in the debug output\n");
         shd_error_print("  --shd_print-generated                         Includes generated functions in the debug output\n");
@@ -184,6 +223,12 @@ void shd_parse_compiler_config_args(CompilerConfig* config, int* pargc, char** a
 #undef EM
         shd_error_print("  --subgroup-size N                         Sets the subgroup size the program will be specialized for.\n");
         shd_error_print("  --lift-join-points                        Forcefully lambda-lifts all join points. Can help with reconvergence issues.\n");
+        shd_error_print("  --time-passes, --pass-stats               Prints how long each pass took and how big the IR got on stderr\n");
+        shd_error_print("  --pass-stats-json <filename>              Also writes these statistics to a JSON file\n");
+        shd_error_print("  --in-place-passes                         Lets passes that change little rewrite the IR in place instead of copying it\n");
+        shd_error_print("  --compaction-threshold <(0..1]>           Fraction of dead nodes that triggers a copy of the IR with --in-place-passes (default=0.5)\n");
+        shd_error_print("  --cache-dir <path>                        Keeps compiled outputs in this directory and reuses them across runs\n");
+        shd_error_print("  --cache-max-size <MiB>                    Evicts the least recently used cached outputs past this size (default=256)\n");
     }
 
     shd_pack_remaining_args(pargc, argv);
@@ -217,6 +262,8 @@ DriverConfig shd_default_driver_config(void) {
 
 void shd_destroy_driver_config(DriverConfig* config) {
     shd_destroy_list(config->input_filenames);
+    // the driver is done compiling
+    shd_destroy_compiler_thread_caches();
 }
 
 void shd_parse_driver_args(DriverConfig* args, int* pargc, char** argv) {
@@ -280,6 +327,8 @@ void shd_parse_driver_args(DriverConfig* args, int* pargc, char** argv) {
             invalid_target:
             shd_error_print("--target must be followed with a valid target (see help for list of targets)");
             exit(InvalidTarget);
+        } else if (strcmp(argv[i], "--parallel-passes") == 0) {
+            args->parallel_passes = true;
         } else if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
             help = true;
             continue;
@@ -297,6 +346,7 @@ void shd_parse_driver_args(DriverConfig* args, int* pargc, char** argv) {
         shd_error_print("  --dump-cfg <filename>                     Dumps the control flow graph of the final IR\n");
         shd_error_print("  --dump-loop-tree <filename>\n");
         shd_error_print("  --dump-ir <filename>                      Dumps the final IR\n");
+        shd_error_print("  --parallel-passes                         Rewrites functions on several threads in the passes that allow it\n");
     }
 
     shd_pack_remaining_args(pargc, argv);
@@ -10,6 +10,7 @@
 #include "list.h"
 #include "util.h"
 #include "log.h"
+#include "portability.h"
 
 #include <stdlib.h>
 #include <assert.h>
@@ -34,6 +35,8 @@ SourceLanguage shd_driver_guess_source_language(const char* filename) {
         return SrcSlim;
     else if (shd_string_ends_with(filename, ".slim"))
         return SrcShadyIR;
+    else if (shd_string_ends_with(filename, ".shdb"))
+        return SrcShadyBinary;
 
     shd_warn_print("unknown filename extension '%s', interpreting as Slim sourcecode by default.", filename);
     return SrcSlim;
@@ -58,6 +61,12 @@ ShadyErrorCodes shd_driver_load_source_file(const CompilerConfig* config, Source
 #endif
             break;
         }
+        case SrcShadyBinary: {
+            *mod = shd_deserialize_module(len, file_contents, name);
+            if (!*mod)
+                return IncompatibleBinaryModule;
+            break;
+        }
         case SrcShadyIR:
         case SrcSlim: {
             SlimParserConfig pconfig = {
@@ -73,6 +82,8 @@ ShadyErrorCodes shd_driver_load_source_file(const CompilerConfig* config, Source
 ShadyErrorCodes shd_driver_load_source_file_from_filename(const CompilerConfig* config, const char* filename, String name, Module** mod) {
     ShadyErrorCodes err;
     SourceLanguage lang = shd_driver_guess_source_language(filename);
+    if (lang == SrcShadyBinary)
+        return shd_driver_load_binary_module_from_filename(filename, name, mod);
     size_t len;
     char* contents;
     assert(filename);
@@ -93,6 +104,36 @@ ShadyErrorCodes shd_driver_load_source_file_from_filename(const CompilerConfig*
     return err;
 }
 
+ShadyErrorCodes shd_driver_save_binary_module(Module* mod, const char* filename) {
+    size_t size;
+    char* data;
+    shd_serialize_module(mod, &size, &data);
+    bool ok = shd_write_file(filename, size, data);
+    free(data);
+    if (!ok) {
+        shd_error_print("Failed to write binary module to '%s'\n", filename);
+        return OutputFileIOError;
+    }
+    return NoError;
+}
+
+ShadyErrorCodes shd_driver_load_binary_module_from_filename(const char* filename, String name, Module** mod) {
+    size_t size;
+    const void* data;
+    if (!shd_map_file(filename, &size, &data)) {
+        shd_error_print("Failed to map file '%s'\n", filename);
+        return InputFileIOError;
+    }
+    *mod = shd_deserialize_module(size, data, name);
+    // nothing in the module points into the file, it can go away straight away
+    shd_unmap_file(data, size);
+    if (!*mod) {
+        shd_error_print("'%s' was written by an incompatible version of shady\n", filename);
+        return IncompatibleBinaryModule;
+    }
+    return NoError;
+}
+
 ShadyErrorCodes shd_driver_load_source_files(DriverConfig* args, Module* mod) {
     if (shd_list_count(args->input_filenames) == 0) {
         shd_error_print("Missing input file. See --help for proper usage");
@@ -114,10 +155,48 @@ ShadyErrorCodes shd_driver_load_source_files(DriverConfig* args, Module* mod) {
     return NoError;
 }
 
+static void write_output_file(const char* filename, size_t size, const char* data) {
+    FILE* f = fopen(filename, "wb");
+    fwrite(data, size, 1, f);
+    fclose(f);
+    shd_debug_print("Wrote result to %s\n", filename);
+}
+
 ShadyErrorCodes shd_driver_compile(DriverConfig* args, Module* mod) {
     shd_debugv_print("Parsed program successfully: \n");
     shd_log_module(DEBUGV, &args->config, mod);
 
+    if (args->output_filename) {
+        if (args->target == TgtAuto)
+            args->target = shd_guess_target(args->output_filename);
+        switch (args->target) {
+            case TgtC: args->c_emitter_config.dialect = CDialect_C11; break;
+            case TgtGLSL: args->c_emitter_config.dialect = CDialect_GLSL; break;
+            case TgtISPC: args->c_emitter_config.dialect = CDialect_ISPC; break;
+            default: break;
+        }
+    }
+
+    // the cache only holds the final output, the other dumps need the compiled module
+    bool use_cache = args->output_filename && !args->cfg_output_filename && !args->loop_tree_output_filename && !args->shd_output_filename;
+    CompileCacheKey cache_key = { 0 };
+    if (use_cache) {
+        CEmitterConfig* c = &args->c_emitter_config;
+        String variant = shd_format_string_new("target=%d dialect=%d sized=%d compound=%d decay=%d glsl=%d", args->target, c->dialect, c->explicitly_sized_types, c->allow_compound_literals, c->decay_unsized_arrays, c->glsl_version);
+        cache_key = shd_compile_cache_key(&args->config, mod, variant);
+        free((void*) variant);
+
+        size_t output_size;
+        char* output_buffer;
+        if (shd_compile_cache_lookup(&args->config, cache_key, &output_size, &output_buffer)) {
+            write_output_file(args->output_filename, output_size, output_buffer);
+            free(output_buffer);
+            shd_destroy_compile_cache_key(cache_key);
+            shd_destroy_ir_arena(shd_module_get_arena(mod));
+            return NoError;
+        }
+    }
+
     CompilationResult result = shd_run_compiler_passes(&args->config, &mod);
     if (result != CompilationNoError) {
         shd_error_print("Compilation pipeline failed, errcode=%d\n", (int) result);
@@ -155,32 +234,23 @@ ShadyErrorCodes shd_driver_compile(DriverConfig* args, Module* mod) {
     }
 
     if (args->output_filename) {
-        if (args->target == TgtAuto)
-            args->target = shd_guess_target(args->output_filename);
-        FILE* f = fopen(args->output_filename, "wb");
         size_t output_size;
         char* output_buffer;
         switch (args->target) {
             case TgtAuto: SHADY_UNREACHABLE;
             case TgtSPV: emit_spirv(&args->config, mod, &output_size, &output_buffer, NULL); break;
             case TgtC:
-                args->c_emitter_config.dialect = CDialect_C11;
-                shd_emit_c(&args->config, args->c_emitter_config, mod, &output_size, &output_buffer, NULL);
-                break;
             case TgtGLSL:
-                args->c_emitter_config.dialect = CDialect_GLSL;
-                shd_emit_c(&args->config, args->c_emitter_config, mod, &output_size, &output_buffer, NULL);
-                break;
             case TgtISPC:
-                args->c_emitter_config.dialect = CDialect_ISPC;
                 shd_emit_c(&args->config, args->c_emitter_config, mod, &output_size, &output_buffer, NULL);
                 break;
         }
-        shd_debug_print("Wrote result to %s\n", args->output_filename);
-        fwrite(output_buffer, output_size, 1, f);
+        if (use_cache)
+            shd_compile_cache_store(&args->config, cache_key, output_size, output_buffer);
+        write_output_file(args->output_filename, output_size, output_buffer);
         free((void*) output_buffer);
-        fclose(f);
     }
+    shd_destroy_compile_cache_key(cache_key);
     shd_destroy_ir_arena(shd_module_get_arena(mod));
     return NoError;
 }
@@ -16,6 +16,7 @@ int main(int argc, char** argv) {
     shd_driver_parse_input_files(args.input_filenames, &argc, argv);
 
     ArenaConfig aconfig = shd_default_arena_config(&args.config.target);
+    aconfig.thread_safe = args.parallel_passes;
     IrArena* arena = shd_new_ir_arena(&aconfig);
     Module* mod = shd_new_module(arena, "my_module"); // TODO name module after first filename, or perhaps the last one
 
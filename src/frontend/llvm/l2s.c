@@ -78,7 +78,7 @@ static void prepare_bb(Parser* p, FnParseCtx* fn_ctx, BBParseCtx* ctx, LLVMBasic
         LLVMDumpValue((LLVMValueRef)bb);
 
     struct List* phis = shd_new_list(LLVMValueRef);
-    Nodes params = shd_empty(a);
+    NodesBuilder params = { 0 };
     LLVMValueRef instr = LLVMGetFirstInstruction(bb);
     while (instr) {
         switch (LLVMGetInstructionOpcode(instr)) {
@@ -86,7 +86,7 @@ static void prepare_bb(Parser* p, FnParseCtx* fn_ctx, BBParseCtx* ctx, LLVMBasic
                 const Node* nparam = param(a, shd_as_qualified_type(convert_type(p, LLVMTypeOf(instr)), false), "phi");
                 shd_dict_insert(LLVMValueRef, const Node*, p->map, instr, nparam);
                 shd_list_append(LLVMValueRef, phis, instr);
-                params = shd_nodes_append(a, params, nparam);
+                shd_nodes_builder_append(&params, nparam);
                 break;
             }
             default: goto after_phis;
@@ -98,7 +98,7 @@ static void prepare_bb(Parser* p, FnParseCtx* fn_ctx, BBParseCtx* ctx, LLVMBasic
         String name = LLVMGetBasicBlockName(bb);
         if (strlen(name) == 0)
             name = NULL;
-        Node* nbb = basic_block(a, params, name);
+        Node* nbb = basic_block(a, shd_nodes_builder_finish(a, &params), name);
         shd_dict_insert(LLVMValueRef, const Node*, p->map, bb, nbb);
         shd_dict_insert(const Node*, struct List*, fn_ctx->phis, nbb, phis);
         *ctx = (BBParseCtx) {
@@ -154,16 +154,17 @@ const Node* convert_function(Parser* p, LLVMValueRef fn) {
     IrArena* a = shd_module_get_arena(p->dst);
     shd_debug_print("Converting function: %s\n", LLVMGetValueName(fn));
 
-    Nodes params = shd_empty(a);
+    NodesBuilder params_builder = { 0 };
     for (LLVMValueRef oparam = LLVMGetFirstParam(fn); oparam; oparam = LLVMGetNextParam(oparam)) {
         LLVMTypeRef ot = LLVMTypeOf(oparam);
         const Type* t = convert_type(p, ot);
         const Node* nparam = param(a, shd_as_qualified_type(t, false), LLVMGetValueName(oparam));
         shd_dict_insert(LLVMValueRef, const Node*, p->map, oparam, nparam);
-        params = shd_nodes_append(a, params, nparam);
+        shd_nodes_builder_append(&params_builder, nparam);
         if (oparam == LLVMGetLastParam(fn))
             break;
     }
+    Nodes params = shd_nodes_builder_finish(a, &params_builder);
     const Type* fn_type = convert_type(p, LLVMGlobalGetValueType(fn));
     assert(fn_type->tag == FnType_TAG);
     assert(fn_type->payload.fn_type.param_types.count == params.count);
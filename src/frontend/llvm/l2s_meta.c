@@ -103,13 +103,14 @@ LLVM_DI_WITH_PARENT_SCOPES(N)
 
 Nodes scope_to_string(Parser* p, LLVMMetadataRef dbgloc) {
     IrArena* a = shd_module_get_arena(p->dst);
-    Nodes str = shd_empty(a);
+    // walks from the innermost scope outwards, the result goes the other way
+    NodesBuilder scopes = { 0 };
 
     LLVMMetadataRef scope = LLVMDILocationGetScope(dbgloc);
     while (true) {
         if (!scope) break;
 
-        str = shd_nodes_prepend(a, str, shd_uint32_literal(a, convert_metadata(p, scope)->id));
+        shd_nodes_builder_append(&scopes, shd_uint32_literal(a, convert_metadata(p, scope)->id));
 
         // LLVMDumpValue(LLVMMetadataAsValue(p->ctx, scope));
         // printf("\n");
@@ -118,8 +119,13 @@ Nodes scope_to_string(Parser* p, LLVMMetadataRef dbgloc) {
         if (!v) break;
         scope = LLVMValueAsMetadata(v);
     }
+    for (size_t i = 0; i < scopes.count / 2; i++) {
+        const Node* tmp = scopes.nodes[i];
+        shd_nodes_builder_set(&scopes, i, scopes.nodes[scopes.count - 1 - i]);
+        shd_nodes_builder_set(&scopes, scopes.count - 1 - i, tmp);
+    }
     //dump_node(convert_metadata(p, dbgloc));
-    return str;
+    return shd_nodes_builder_finish(a, &scopes);
 }
 
 const Node* convert_metadata(Parser* p, LLVMMetadataRef meta) {
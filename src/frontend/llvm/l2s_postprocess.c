@@ -54,8 +54,8 @@ static const Node* process_node(Context* ctx, const Node* node) {
             return new;
         }
         case Function_TAG: {
-            Nodes new_params = remake_params(ctx, node->payload.fun.params);
-            Nodes old_annotations = node->payload.fun.annotations;
+            NodesBuilder new_params_builder = shd_nodes_builder_from(remake_params(ctx, node->payload.fun.params));
+            NodesBuilder old_annotations_builder = shd_nodes_builder_from(node->payload.fun.annotations);
             ParsedAnnotation* an = find_annotation(ctx->p, node);
             Op primop_intrinsic = PRIMOPS_COUNT;
             while (an) {
@@ -72,13 +72,17 @@ static const Node* process_node(Context* ctx, const Node* node) {
                     assert(i != PRIMOPS_COUNT);
                     primop_intrinsic = op;
                 } else if (strcmp(get_annotation_name(an->payload), "EntryPoint") == 0) {
-                    for (size_t i = 0; i < new_params.count; i++)
-                        new_params = shd_change_node_at_index(a, new_params, i, param(a, shd_as_qualified_type(
-                                get_unqualified_type(new_params.nodes[i]->payload.param.type), true), new_params.nodes[i]->payload.param.name));
+                    for (size_t i = 0; i < new_params_builder.count; i++) {
+                        const Node* old_param = new_params_builder.nodes[i];
+                        shd_nodes_builder_set(&new_params_builder, i, param(a, shd_as_qualified_type(
+                                get_unqualified_type(old_param->payload.param.type), true), old_param->payload.param.name));
+                    }
                 }
-                old_annotations = shd_nodes_append(a, old_annotations, an->payload);
+                shd_nodes_builder_append(&old_annotations_builder, an->payload);
                 an = an->next;
             }
+            Nodes new_params = shd_nodes_builder_finish(a, &new_params_builder);
+            Nodes old_annotations = shd_nodes_builder_finish(a, &old_annotations_builder);
             shd_register_processed_list(r, node->payload.fun.params, new_params);
             Nodes new_annotations = shd_rewrite_nodes(r, old_annotations);
             Node* decl = function(ctx->rewriter.dst_module, new_params, shd_get_abstraction_name(node), new_annotations, shd_rewrite_nodes(&ctx->rewriter, node->payload.fun.return_types));
@@ -101,14 +105,16 @@ static const Node* process_node(Context* ctx, const Node* node) {
             const Type* type = shd_rewrite_node(r, node->payload.global_variable.type);
             ParsedAnnotation* an = find_annotation(ctx->p, node);
             AddressSpace old_as = as;
+            NodesBuilder annotations_builder = shd_nodes_builder_from(annotations);
             while (an) {
-                annotations = shd_nodes_append(a, annotations, shd_rewrite_node(r, an->payload));
+                shd_nodes_builder_append(&annotations_builder, shd_rewrite_node(r, an->payload));
                 if (strcmp(get_annotation_name(an->payload), "Builtin") == 0)
                     old_init = NULL;
                 if (strcmp(get_annotation_name(an->payload), "AddressSpace") == 0)
                     as = shd_get_int_literal_value(*shd_resolve_to_int_literal(shd_get_annotation_value(an->payload)), false);
                 an = an->next;
             }
+            annotations = shd_nodes_builder_finish(a, &annotations_builder);
             Node* decl = global_var(ctx->rewriter.dst_module, annotations, type, get_declaration_name(node), as);
             Node* result = decl;
             if (old_as != as) {
@@ -32,6 +32,18 @@ typedef struct {
     const Node* node;
 } Resolved;
 
+/// Declarations can't be used as operands directly, they need to be wrapped in the reference node matching their kind.
+/// Names are the only way slim code refers to declarations, so doing this here is enough for the output to follow the grammar.
+static const Node* refer_to_decl(IrArena* a, const Node* decl) {
+    switch (decl->tag) {
+        case Constant_TAG:
+        case GlobalVariable_TAG: return ref_decl_helper(a, decl);
+        case Function_TAG: return fn_addr_helper(a, decl);
+        case NominalType_TAG: return type_decl_ref(a, (TypeDeclRef) { .decl = decl });
+        default: shd_error("unknown declaration kind");
+    }
+}
+
 static Resolved resolve_using_name(Context* ctx, const char* name) {
     for (NamedBindEntry* entry = ctx->local_variables; entry != NULL; entry = entry->next) {
         if (strcmp(entry->name, name) == 0) {
@@ -42,30 +54,24 @@ static Resolved resolve_using_name(Context* ctx, const char* name) {
         }
     }
 
-    Nodes new_decls = shd_module_get_declarations(ctx->rewriter.dst_module);
-    for (size_t i = 0; i < new_decls.count; i++) {
-        const Node* decl = new_decls.nodes[i];
-        if (strcmp(get_declaration_name(decl), name) == 0) {
-            return (Resolved) {
-                .is_var = decl->tag == GlobalVariable_TAG,
-                .node = decl
-            };
-        }
+    const Node* decl = shd_module_get_declaration(ctx->rewriter.dst_module, name);
+    if (decl) {
+        return (Resolved) {
+            .is_var = decl->tag == GlobalVariable_TAG,
+            .node = refer_to_decl(ctx->rewriter.dst_arena, decl)
+        };
     }
 
-    Nodes old_decls = shd_module_get_declarations(ctx->rewriter.src_module);
-    for (size_t i = 0; i < old_decls.count; i++) {
-        const Node* old_decl = old_decls.nodes[i];
-        if (strcmp(get_declaration_name(old_decl), name) == 0) {
-            Context top_ctx = *ctx;
-            top_ctx.current_function = NULL;
-            top_ctx.local_variables = NULL;
-            const Node* decl = shd_rewrite_node(&top_ctx.rewriter, old_decl);
-            return (Resolved) {
-                .is_var = decl->tag == GlobalVariable_TAG,
-                .node = decl
-            };
-        }
+    const Node* old_decl = shd_module_get_declaration(ctx->rewriter.src_module, name);
+    if (old_decl) {
+        Context top_ctx = *ctx;
+        top_ctx.current_function = NULL;
+        top_ctx.local_variables = NULL;
+        decl = shd_rewrite_node(&top_ctx.rewriter, old_decl);
+        return (Resolved) {
+            .is_var = decl->tag == GlobalVariable_TAG,
+            .node = refer_to_decl(ctx->rewriter.dst_arena, decl)
+        };
     }
 
     shd_error("could not resolve node %s", name)
@@ -370,6 +376,8 @@ Module* slim_pass_bind(SHADY_UNUSED const CompilerConfig* compiler_config, Modul
     ArenaConfig aconfig = *shd_get_arena_config(shd_module_get_arena(src));
     assert(!src->arena->config.name_bound);
     aconfig.name_bound = true;
+    // references to declarations are wrapped as they get resolved, which used to need a separate normalisation pass
+    aconfig.check_op_classes = true;
     IrArena* a = shd_new_ir_arena(&aconfig);
     Module* dst = shd_new_module(a, shd_module_get_name(src));
 
@@ -2,6 +2,7 @@
 
 #include "../shady/type.h"
 #include "../shady/transform/ir_gen_helpers.h"
+#include "../shady/passes/passes.h"
 
 #include "log.h"
 #include "portability.h"
@@ -30,6 +31,8 @@ typedef struct {
 
     const Node* current_fn;
     const Type* expected_type;
+    /// One declaration per builtin, whatever type it was declared with
+    Node** builtins;
 } Context;
 
 static const Node* infer_value(Context* ctx, const Node* node, const Type* expected_type);
@@ -85,7 +88,7 @@ static const Node* infer_type(Context* ctx, const Type* type) {
 
 static const Node* infer_decl(Context* ctx, const Node* node) {
     assert(is_declaration(node));
-    if (shd_lookup_annotation(node, "SkipOnInfer"))
+    if (shd_lookup_well_known_annotation(node, AnnSkipOnInfer))
         return NULL;
 
     IrArena* a = ctx->rewriter.dst_arena;
@@ -132,6 +135,10 @@ static const Node* infer_decl(Context* ctx, const Node* node) {
         }
         case GlobalVariable_TAG: {
              const GlobalVariable* old_gvar = &node->payload.global_variable;
+             // builtins get the type the target expects, no matter what the source said
+             Node* builtin = shd_rewrite_builtin_global(&ctx->rewriter, ctx->builtins, node);
+             if (builtin)
+                 return builtin;
              const Type* imported_ty = infer(ctx, old_gvar->type, NULL);
              Node* ngvar = global_var(ctx->rewriter.dst_module, infer_nodes(ctx, old_gvar->annotations), imported_ty, old_gvar->name, old_gvar->address_space);
             shd_register_processed(&ctx->rewriter, node, ngvar);
@@ -609,15 +616,19 @@ Module* slim_pass_infer(SHADY_UNUSED const CompilerConfig* config, Module* src)
     assert(!aconfig.check_types);
     aconfig.check_types = true;
     aconfig.allow_fold = true; // TODO was moved here because a refactor, does this cause issues ?
+    // builtins are normalised in this same traversal, rather than in a separate shd_pass_normalize_builtins beforehand
+    aconfig.validate_builtin_types = true;
     IrArena* a = shd_new_ir_arena(&aconfig);
     Module* dst = shd_new_module(a, shd_module_get_name(src));
 
     Context ctx = {
         .rewriter = shd_create_node_rewriter(src, dst, (RewriteNodeFn) process),
+        .builtins = calloc(sizeof(Node*), BuiltinsCount),
     };
     //ctx.rewriter.config.search_map = false;
     //ctx.rewriter.config.write_map = false;
     shd_rewrite_module(&ctx.rewriter);
     shd_destroy_rewriter(&ctx.rewriter);
+    free(ctx.builtins);
     return dst;
 }
@@ -232,19 +232,19 @@ static const Node* accept_numerical_literal(ctxparams) {
 }
 
 static Nodes accept_type_arguments(ctxparams) {
-    Nodes ty_args = shd_empty(arena);
+    NodesBuilder ty_args = { 0 };
     if (accept_token(ctx, lsbracket_tok)) {
         while (true) {
             const Type* t = accept_unqualified_type(ctx);
             expect(t, "unqualified type");
-            ty_args = shd_nodes_append(arena, ty_args, t);
+            shd_nodes_builder_append(&ty_args, t);
             if (accept_token(ctx, comma_tok))
                 continue;
             if (accept_token(ctx, rsbracket_tok))
                 break;
         }
     }
-    return ty_args;
+    return shd_nodes_builder_finish(arena, &ty_args);
 }
 
 static const Node* make_unbound(IrArena* a, const Node* mem, String identifier) {
@@ -920,8 +920,8 @@ static const Node* accept_terminator(ctxparams, BodyBuilder* bb) {
             const Node* inspectee = accept_value(ctx, bb);
             expect(inspectee, "value");
             expect(accept_token(ctx, comma_tok), "','");
-            Nodes values = shd_empty(arena);
-            Nodes cases = shd_empty(arena);
+            NodesBuilder values_builder = { 0 };
+            NodesBuilder cases_builder = { 0 };
             const Node* default_jump;
             while (true) {
                 if (accept_token(ctx, default_tok)) {
@@ -934,10 +934,12 @@ static const Node* accept_terminator(ctxparams, BodyBuilder* bb) {
                 expect(accept_token(ctx, comma_tok), "','");
                 const Node* j = expect_jump(ctx, bb);
                 expect(accept_token(ctx, comma_tok), "','");
-                values = shd_nodes_append(arena, values, value);
-                cases = shd_nodes_append(arena, cases, j);
+                shd_nodes_builder_append(&values_builder, value);
+                shd_nodes_builder_append(&cases_builder, j);
             }
             expect(accept_token(ctx, rpar_tok), "')'");
+            Nodes values = shd_nodes_builder_finish(arena, &values_builder);
+            Nodes cases = shd_nodes_builder_finish(arena, &cases_builder);
 
             return br_switch(arena, (Switch) {
                 .switch_value = shd_first(values),
@@ -1030,8 +1032,8 @@ static const Node* expect_body(ctxparams, const Node* mem, const Node* default_t
     Node* cont_wrapper_case = case_(arena, shd_empty(arena));
     BodyBuilder* cont_wrapper_bb = begin_body_with_mem(arena, shd_get_abstraction_mem(cont_wrapper_case));
 
-    Nodes ids = shd_empty(arena);
-    Nodes conts = shd_empty(arena);
+    NodesBuilder ids = { 0 };
+    NodesBuilder conts = { 0 };
     if (shd_curr_token(tokenizer).tag == cont_tok) {
         while (true) {
             if (!accept_token(ctx, cont_tok))
@@ -1042,12 +1044,12 @@ static const Node* expect_body(ctxparams, const Node* mem, const Node* default_t
             expect_parameters(ctx, &parameters, NULL, bb);
             Node* continuation = basic_block(arena, parameters, name);
             shd_set_abstraction_body(continuation, expect_body(ctx, shd_get_abstraction_mem(continuation), NULL));
-            ids = shd_nodes_append(arena, ids, string_lit_helper(arena, name));
-            conts = shd_nodes_append(arena, conts, continuation);
+            shd_nodes_builder_append(&ids, string_lit_helper(arena, name));
+            shd_nodes_builder_append(&conts, continuation);
         }
     }
 
-    gen_ext_instruction(cont_wrapper_bb, "shady.frontend", SlimOpBindContinuations, unit_type(arena), shd_concat_nodes(arena, ids, conts));
+    gen_ext_instruction(cont_wrapper_bb, "shady.frontend", SlimOpBindContinuations, unit_type(arena), shd_concat_nodes(arena, shd_nodes_builder_finish(arena, &ids), shd_nodes_builder_finish(arena, &conts)));
     expect(accept_token(ctx, rbracket_tok), "']'");
 
     shd_set_abstraction_body(cont_wrapper_case, finish_body_with_jump(cont_wrapper_bb, terminator_case, shd_empty(arena)));
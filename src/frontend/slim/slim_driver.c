@@ -7,11 +7,9 @@
 
 #include "log.h"
 
-/// Removes all Unresolved nodes and replaces them with the appropriate decl/value
+/// Removes all Unresolved nodes and replaces them with the appropriate decl/value, wrapping references to declarations as the grammar expects
 RewritePass slim_pass_bind;
-/// Enforces the grammar, notably by let-binding any intermediary result
-RewritePass slim_pass_normalize;
-/// Makes sure every node is well-typed
+/// Makes sure every node is well-typed, and gives builtins the type the target expects
 RewritePass slim_pass_infer;
 
 void slim_parse_string(const SlimParserConfig* config, const char* contents, Module* mod);
@@ -35,9 +33,6 @@ Module* shd_parse_slim_module(const CompilerConfig* config, const SlimParserConf
     shd_generate_dummy_constants(config, *pmod);
 
     RUN_PASS(slim_pass_bind)
-    RUN_PASS(slim_pass_normalize)
-
-    RUN_PASS(shd_pass_normalize_builtins)
     RUN_PASS(slim_pass_infer)
     RUN_PASS(shd_pass_lower_cf_instrs)
 
@@ -867,7 +867,7 @@ size_t parse_spv_instruction_at(SpvParser* parser, size_t instruction_offset) {
             struct CurrBlock old = parser->current_block;
             parser->current_block.id = result;
 
-            Nodes params = shd_empty(parser->arena);
+            NodesBuilder params = { 0 };
             parser->fun_arg_i = 0;
             while (true) {
                 SpvOp param_op = (parser->words + instruction_offset)[0] & 0xFFFF;
@@ -887,7 +887,7 @@ size_t parse_spv_instruction_at(SpvParser* parser, size_t instruction_offset) {
                 if (is_param) {
                     const Node* param = get_definition_by_id(parser, get_result_defined_at(parser, instruction_offset))->node;
                     assert(param && param->tag == Param_TAG);
-                    params = shd_concat_nodes(parser->arena, params, shd_singleton(param));
+                    shd_nodes_builder_append(&params, param);
                 }
                 size += s;
                 instruction_offset += s;
@@ -898,7 +898,7 @@ size_t parse_spv_instruction_at(SpvParser* parser, size_t instruction_offset) {
             parser->defs[result].type = BB;
             String bb_name = get_name(parser, result);
             bb_name = bb_name ? bb_name : unique_name(parser->arena, "basic_block");
-            Node* block = basic_block(parser->arena, params, bb_name);
+            Node* block = basic_block(parser->arena, shd_nodes_builder_finish(parser->arena, &params), bb_name);
             parser->defs[result].node = block;
 
             BodyBuilder* bb = begin_body_with_mem(parser->arena, shd_get_abstraction_mem(block));
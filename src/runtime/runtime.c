@@ -1,5 +1,7 @@
 #include "runtime_private.h"
 
+#include "shady/driver.h"
+
 #include "log.h"
 #include "list.h"
 #include <stdlib.h>
@@ -53,6 +55,8 @@ void shutdown_runtime(Runtime* runtime) {
         Backend* bk = shd_read_list(Backend*, runtime->backends)[i];
         bk->cleanup(bk);
     }
+    // programs get compiled on the thread that uses the runtime
+    shd_destroy_compiler_thread_caches();
     free(runtime);
 }
 
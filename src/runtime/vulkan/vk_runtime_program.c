@@ -304,7 +304,7 @@ static bool extract_parameters_info(ProgramParamsInfo* parameters, Module* mod)
                 break;
             }
             case Function_TAG: {
-                if (shd_lookup_annotation(node, "EntryPoint")) {
+                if (shd_lookup_well_known_annotation(node, AnnEntryPoint)) {
                     if (node->payload.fun.params.count != 0) {
                         shd_error_print("EntryPoint cannot have parameters\n");
                         return false;
@@ -377,18 +377,76 @@ static bool extract_parameters_info(ProgramParamsInfo* parameters, Module* mod)
     return true;
 }
 
+/// Cache entries hold the SPIR-V followed by the final module in binary form, which extract_parameters_info needs.
+static bool load_cached_program(VkrSpecProgram* spec, const CompilerConfig* config, CompileCacheKey key) {
+    size_t size;
+    char* data;
+    if (!shd_compile_cache_lookup(config, key, &size, &data))
+        return false;
+
+    uint64_t spirv_size;
+    bool ok = size >= sizeof(spirv_size);
+    if (ok) {
+        memcpy(&spirv_size, data, sizeof(spirv_size));
+        ok = spirv_size <= size - sizeof(spirv_size);
+    }
+    Module* final_mod = NULL;
+    if (ok) {
+        size_t offset = sizeof(spirv_size) + spirv_size;
+        final_mod = shd_deserialize_module(size - offset, data + offset, shd_module_get_name(spec->specialized_module));
+        ok = final_mod != NULL;
+    }
+    if (ok) {
+        spec->spirv_size = spirv_size;
+        spec->spirv_bytes = malloc(spirv_size);
+        memcpy(spec->spirv_bytes, data + sizeof(spirv_size), spirv_size);
+        spec->specialized_module = final_mod;
+    } else {
+        // the entry is corrupt, it would only keep getting hit
+        shd_warn_print("Compile cache entry for %016llx is corrupt\n", (unsigned long long) key.hash);
+        shd_compile_cache_evict(config, key);
+    }
+    free(data);
+    return ok;
+}
+
+static void store_cached_program(VkrSpecProgram* spec, const CompilerConfig* config, CompileCacheKey key) {
+    // the module isn't worth serializing if it won't be stored
+    if (!shd_is_compile_cache_enabled(config))
+        return;
+
+    size_t module_size;
+    char* module_data;
+    shd_serialize_module(spec->specialized_module, &module_size, &module_data);
+
+    uint64_t spirv_size = spec->spirv_size;
+    size_t size = sizeof(spirv_size) + spirv_size + module_size;
+    char* data = malloc(size);
+    memcpy(data, &spirv_size, sizeof(spirv_size));
+    memcpy(data + sizeof(spirv_size), spec->spirv_bytes, spirv_size);
+    memcpy(data + sizeof(spirv_size) + spirv_size, module_data, module_size);
+    shd_compile_cache_store(config, key, size, data);
+    free(data);
+    free(module_data);
+}
+
 static bool compile_specialized_program(VkrSpecProgram* spec) {
     CompilerConfig config = get_compiler_config_for_device(spec->device, spec->key.base->base_config);
     config.specialization.entry_point = spec->key.entry_point;
 
-    CHECK(shd_run_compiler_passes(&config, &spec->specialized_module) == CompilationNoError, return false);
+    // restarting an application recompiles the exact same programs, these can come straight off the disk
+    CompileCacheKey cache_key = shd_compile_cache_key(&config, spec->specialized_module, "vk-spirv");
+    if (!load_cached_program(spec, &config, cache_key)) {
+        CHECK(shd_run_compiler_passes(&config, &spec->specialized_module) == CompilationNoError, return false);
 
-    Module* final_mod;
-    emit_spirv(&config, spec->specialized_module, &spec->spirv_size, &spec->spirv_bytes, &final_mod);
-
-    CHECK(extract_parameters_info(&spec->parameters, final_mod), return false);
+        Module* final_mod;
+        emit_spirv(&config, spec->specialized_module, &spec->spirv_size, &spec->spirv_bytes, &final_mod);
+        spec->specialized_module = final_mod;
+        store_cached_program(spec, &config, cache_key);
+    }
+    shd_destroy_compile_cache_key(cache_key);
 
-    spec->specialized_module = final_mod;
+    CHECK(extract_parameters_info(&spec->parameters, spec->specialized_module), return false);
 
     if (spec->key.base->runtime->config.dump_spv) {
         String module_name = shd_module_get_name(spec->specialized_module);
@@ -3,13 +3,14 @@
 #include "log.h"
 
 #include "list.h"
-#include "dict.h"
 #include "arena.h"
 #include "util.h"
 
 #include "../ir_private.h"
+#include "../node_map.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #pragma GCC diagnostic error "-Wswitch"
@@ -28,15 +29,14 @@ struct List* build_cfgs(Module* mod, CFGBuildConfig config) {
     return cfgs;
 }
 
-KeyHash shd_hash_node(const Node**);
-bool shd_compare_node(const Node**, const Node**);
-
 typedef struct {
     Arena* arena;
     const Node* function;
     const Node* entry;
-    struct Dict* nodes;
+    NodeMap* nodes;
     struct List* contents;
+    /// @ref List of @ref CFEdge, in the order they were found
+    struct List* edges;
 
     CFGBuildConfig config;
 
@@ -44,13 +44,13 @@ typedef struct {
     const Node* loop_construct_head;
     const Node* loop_construct_tail;
 
-    struct Dict* join_point_values;
+    NodeMap* join_point_values;
 } CfgBuildContext;
 
 static void process_cf_node(CfgBuildContext* ctx, CFNode* node);
 
 CFNode* cfg_lookup(CFG* cfg, const Node* abs) {
-    CFNode** found = shd_dict_find_value(const Node*, CFNode*, cfg->map, abs);
+    CFNode** found = shd_node_map_find(CFNode*, cfg->map, abs);
     if (found) {
         CFNode* cfnode = *found;
         assert(cfnode->node);
@@ -62,14 +62,10 @@ CFNode* cfg_lookup(CFG* cfg, const Node* abs) {
 }
 
 static CFNode* new_cfnode(Arena* a) {
-    CFNode* new = shd_arena_alloc(a, sizeof(CFNode));
+    CFNode* new = shd_arena_alloc_uninit(a, sizeof(CFNode));
     *new = (CFNode) {
-        .succ_edges = shd_new_list(CFEdge),
-        .pred_edges = shd_new_list(CFEdge),
         .rpo_index = SIZE_MAX,
         .idom = NULL,
-        .dominates = NULL,
-        .structurally_dominates = shd_new_set(const Node*, (HashFn) shd_hash_node, (CmpFn) shd_compare_node),
     };
     return new;
 }
@@ -77,13 +73,13 @@ static CFNode* new_cfnode(Arena* a) {
 static CFNode* get_or_enqueue(CfgBuildContext* ctx, const Node* abs) {
     assert(is_abstraction(abs));
     assert(!is_function(abs) || abs == ctx->function);
-    CFNode** found = shd_dict_find_value(const Node*, CFNode*, ctx->nodes, abs);
+    CFNode** found = shd_node_map_find(CFNode*, ctx->nodes, abs);
     if (found) return *found;
 
     CFNode* new = new_cfnode(ctx->arena);
     new->node = abs;
     assert(abs && new->node);
-    shd_dict_insert(const Node*, CFNode*, ctx->nodes, abs, new);
+    shd_node_map_insert(CFNode*, ctx->nodes, abs, new);
     process_cf_node(ctx, new);
     shd_list_append(Node*, ctx->contents, new);
     return new;
@@ -132,19 +128,13 @@ static void add_edge(CfgBuildContext* ctx, const Node* src, const Node* dst, CFE
         .jump = j,
         .terminator = term,
     };
-    shd_list_append(CFEdge, src_node->succ_edges, edge);
-    shd_list_append(CFEdge, dst_node->pred_edges, edge);
+    shd_list_append(CFEdge, ctx->edges, edge);
 }
 
 static void add_structural_edge(CfgBuildContext* ctx, CFNode* parent, const Node* dst, CFEdgeType type, const Node* term) {
     add_edge(ctx, parent->node, dst, type, term);
 }
 
-static void add_structural_dominance_edge(CfgBuildContext* ctx, CFNode* parent, const Node* dst, CFEdgeType type, const Node* term) {
-    add_edge(ctx, parent->node, dst, type, term);
-    shd_set_insert_get_result(const Node*, parent->structurally_dominates, dst);
-}
-
 static void add_jump_edge(CfgBuildContext* ctx, const Node* src, const Node* j) {
     assert(j->tag == Jump_TAG);
     const Node* target = j->payload.jump.target;
@@ -180,7 +170,7 @@ static void process_cf_node(CfgBuildContext* ctx, CFNode* node) {
             }
             case If_TAG: {
                 if (ctx->config.include_structured_tails)
-                    add_structural_dominance_edge(ctx, node, get_structured_construct_tail(terminator), StructuredTailEdge, terminator);
+                    add_structural_edge(ctx, node, get_structured_construct_tail(terminator), StructuredTailEdge, terminator);
                 CfgBuildContext if_ctx = *ctx;
                 if_ctx.selection_construct_tail = get_structured_construct_tail(terminator);
                 add_structural_edge(&if_ctx, node, terminator->payload.if_instr.if_true, StructuredEnterBodyEdge, terminator);
@@ -192,7 +182,7 @@ static void process_cf_node(CfgBuildContext* ctx, CFNode* node) {
                 return;
             } case Match_TAG: {
                 if (ctx->config.include_structured_tails)
-                    add_structural_dominance_edge(ctx, node, get_structured_construct_tail(terminator), StructuredTailEdge, terminator);
+                    add_structural_edge(ctx, node, get_structured_construct_tail(terminator), StructuredTailEdge, terminator);
                 CfgBuildContext match_ctx = *ctx;
                 match_ctx.selection_construct_tail = get_structured_construct_tail(terminator);
                 for (size_t i = 0; i < terminator->payload.match_instr.cases.count; i++)
@@ -201,7 +191,7 @@ static void process_cf_node(CfgBuildContext* ctx, CFNode* node) {
                 return;
             } case Loop_TAG: {
                 if (ctx->config.include_structured_tails)
-                    add_structural_dominance_edge(ctx, node, get_structured_construct_tail(terminator), StructuredTailEdge, terminator);
+                    add_structural_edge(ctx, node, get_structured_construct_tail(terminator), StructuredTailEdge, terminator);
                 CfgBuildContext loop_ctx = *ctx;
                 loop_ctx.loop_construct_head = terminator->payload.loop_instr.body;
                 loop_ctx.loop_construct_tail = get_structured_construct_tail(terminator);
@@ -211,14 +201,14 @@ static void process_cf_node(CfgBuildContext* ctx, CFNode* node) {
                 const Node* param = shd_first(get_abstraction_params(terminator->payload.control.inside));
                 //CFNode* let_tail_cfnode = get_or_enqueue(ctx, get_structured_construct_tail(terminator));
                 const Node* tail = get_structured_construct_tail(terminator);
-                shd_dict_insert(const Node*, const Node*, ctx->join_point_values, param, tail);
-                add_structural_dominance_edge(ctx, node, terminator->payload.control.inside, StructuredEnterBodyEdge, terminator);
+                shd_node_map_insert(const Node*, ctx->join_point_values, param, tail);
+                add_structural_edge(ctx, node, terminator->payload.control.inside, StructuredEnterBodyEdge, terminator);
                 if (ctx->config.include_structured_tails)
-                    add_structural_dominance_edge(ctx, node, get_structured_construct_tail(terminator), StructuredTailEdge, terminator);
+                    add_structural_edge(ctx, node, get_structured_construct_tail(terminator), StructuredTailEdge, terminator);
                 return;
             } case Join_TAG: {
                 if (ctx->config.include_structured_exits) {
-                    const Node** dst = shd_dict_find_value(const Node*, const Node*, ctx->join_point_values, terminator->payload.join.join_point);
+                    const Node** dst = shd_node_map_find(const Node*, ctx->join_point_values, terminator->payload.join.join_point);
                     if (dst)
                         add_edge(ctx, node->node, *dst, StructuredLeaveBodyEdge, terminator);
                 }
@@ -251,36 +241,66 @@ static void process_cf_node(CfgBuildContext* ctx, CFNode* node) {
     }
 }
 
+/// Stable counting sort of @p edges by the rpo_index of their source, or of their destination if @p by_dst is set.
+/// Points the matching range of every node into the result.
+static CFEdge* group_edges(CFG* cfg, Arena* arena, const CFEdge* edges, size_t count, bool by_dst) {
+    // before the mark, arena might be the scratch one
+    CFEdge* grouped = shd_arena_alloc_uninit(arena, sizeof(CFEdge) * count);
+    Arena* scratch = shd_get_scratch_arena();
+    ArenaMark mark = shd_arena_mark(scratch);
+    size_t* offsets = shd_arena_alloc(scratch, sizeof(size_t) * (cfg->size + 1));
+    for (size_t i = 0; i < count; i++)
+        offsets[(by_dst ? edges[i].dst : edges[i].src)->rpo_index + 1]++;
+    for (size_t i = 0; i < cfg->size; i++)
+        offsets[i + 1] += offsets[i];
+
+    for (size_t i = 0; i < cfg->size; i++) {
+        CFNode* n = shd_read_list(CFNode*, cfg->contents)[i];
+        CFEdges range = {
+            .count = offsets[n->rpo_index + 1] - offsets[n->rpo_index],
+            .edges = grouped + offsets[n->rpo_index],
+        };
+        if (by_dst)
+            n->pred_edges = range;
+        else
+            n->succ_edges = range;
+    }
+    for (size_t i = 0; i < count; i++)
+        grouped[offsets[(by_dst ? edges[i].dst : edges[i].src)->rpo_index]++] = edges[i];
+    shd_arena_rewind(scratch, mark);
+    return grouped;
+}
+
+/// Gives the edges in @p edges a provisional layout, with the nodes numbered in the order they were found.
+/// compute_rpo lays them out again once the RPO is known.
+static void layout_edges(CFG* cfg, Arena* arena, struct List* edges) {
+    for (size_t i = 0; i < cfg->size; i++)
+        shd_read_list(CFNode*, cfg->contents)[i]->rpo_index = i;
+    cfg->edges_count = shd_list_count(edges);
+    cfg->succ_edges = group_edges(cfg, arena, shd_read_list(CFEdge, edges), cfg->edges_count, false);
+    cfg->pred_edges = group_edges(cfg, arena, shd_read_list(CFEdge, edges), cfg->edges_count, true);
+}
+
 /**
  * Invert all edges in this cfg. Used to compute a post dominance tree.
+ * @p edges are the ones that were laid out, they are flipped in place.
  */
-static void flip_cfg(CFG* cfg) {
+static void flip_cfg(CFG* cfg, Arena* arena, struct List* edges) {
     cfg->entry = NULL;
 
+    size_t edges_count = shd_list_count(edges);
+    for (size_t i = 0; i < edges_count; i++) {
+        CFEdge* edge = &shd_read_list(CFEdge, edges)[i];
+        CFNode* tmp = edge->dst;
+        edge->dst = edge->src;
+        edge->src = tmp;
+    }
+
     for (size_t i = 0; i < cfg->size; i++) {
         CFNode* cur = shd_read_list(CFNode*, cfg->contents)[i];
 
-        struct List* tmp = cur->succ_edges;
-        cur->succ_edges = cur->pred_edges;
-        cur->pred_edges = tmp;
-
-        for (size_t j = 0; j < shd_list_count(cur->succ_edges); j++) {
-            CFEdge* edge = &shd_read_list(CFEdge, cur->succ_edges)[j];
-
-            CFNode* tmp2 = edge->dst;
-            edge->dst = edge->src;
-            edge->src = tmp2;
-        }
-
-        for (size_t j = 0; j < shd_list_count(cur->pred_edges); j++) {
-            CFEdge* edge = &shd_read_list(CFEdge, cur->pred_edges)[j];
-
-            CFNode* tmp2 = edge->dst;
-            edge->dst = edge->src;
-            edge->src = tmp2;
-        }
-
-        if (shd_list_count(cur->pred_edges) == 0) {
+        // the current layout has yet to be flipped
+        if (cur->succ_edges.count == 0) {
             if (cfg->entry != NULL) {
                 if (cfg->entry->node) {
                     CFNode* new_entry = new_cfnode(cfg->arena);
@@ -289,8 +309,7 @@ static void flip_cfg(CFG* cfg) {
                         .src = new_entry,
                         .dst = cfg->entry
                     };
-                    shd_list_append(CFEdge, new_entry->succ_edges, prev_entry_edge);
-                    shd_list_append(CFEdge, cfg->entry->pred_edges, prev_entry_edge);
+                    shd_list_append(CFEdge, edges, prev_entry_edge);
                     cfg->entry = new_entry;
                 }
 
@@ -299,8 +318,7 @@ static void flip_cfg(CFG* cfg) {
                     .src = cfg->entry,
                     .dst = cur
                 };
-                shd_list_append(CFEdge, cfg->entry->succ_edges, new_edge);
-                shd_list_append(CFEdge, cur->pred_edges, new_edge);
+                shd_list_append(CFEdge, edges, new_edge);
             } else {
                 cfg->entry = cur;
             }
@@ -312,6 +330,7 @@ static void flip_cfg(CFG* cfg) {
         cfg->size += 1;
         shd_list_append(Node*, cfg->contents, cfg->entry);
     }
+    layout_edges(cfg, arena, edges);
 }
 
 static void validate_cfg(CFG* cfg) {
@@ -321,8 +340,8 @@ static void validate_cfg(CFG* cfg) {
         size_t num_jumps = 0;
         size_t num_exits = 0;
         bool is_tail = false;
-        for (size_t j = 0; j < shd_list_count(node->pred_edges); j++) {
-            CFEdge edge = shd_read_list(CFEdge, node->pred_edges)[j];
+        for (size_t j = 0; j < node->pred_edges.count; j++) {
+            CFEdge edge = node->pred_edges.edges[j];
             switch (edge.type) {
                 case JumpEdge:
                     num_jumps++;
@@ -363,8 +382,8 @@ static void validate_cfg(CFG* cfg) {
 static void mark_reachable(CFNode* n) {
     if (!n->reachable) {
         n->reachable = true;
-        for (size_t i = 0; i < shd_list_count(n->succ_edges); i++) {
-            CFEdge e = shd_read_list(CFEdge, n->succ_edges)[i];
+        for (size_t i = 0; i < n->succ_edges.count; i++) {
+            CFEdge e = n->succ_edges.edges[i];
             if (e.type == StructuredTailEdge)
                 continue;
             mark_reachable(e.dst);
@@ -376,19 +395,21 @@ CFG* build_cfg(const Node* function, const Node* entry, CFGBuildConfig config) {
     assert(function && function->tag == Function_TAG);
     assert(is_abstraction(entry));
     Arena* arena = shd_new_arena();
+    Arena* scratch = shd_get_scratch_arena();
+    ArenaMark mark = shd_arena_mark(scratch);
 
     CfgBuildContext context = {
         .arena = arena,
         .function = function,
         .entry = entry,
-        .nodes = shd_new_dict(const Node*, CFNode*, (HashFn) shd_hash_node, (CmpFn) shd_compare_node),
-        .join_point_values = shd_new_dict(const Node*, const Node*, (HashFn) shd_hash_node, (CmpFn) shd_compare_node),
+        .nodes = shd_new_node_map_in(CFNode*, arena),
+        .join_point_values = shd_new_node_map_in(const Node*, scratch),
         .contents = shd_new_list(CFNode*),
+        .edges = shd_new_list(CFEdge),
         .config = config,
     };
 
     CFNode* entry_node = get_or_enqueue(&context, entry);
-    mark_reachable(entry_node);
     //process_cf_node(&context, entry_node);
 
     //while (entries_count_list(context.queue) > 0) {
@@ -396,11 +417,10 @@ CFG* build_cfg(const Node* function, const Node* entry, CFGBuildConfig config) {
     //    process_cf_node(&context, this);
     //}
 
-    shd_destroy_dict(context.join_point_values);
-
     CFG* cfg = calloc(sizeof(CFG), 1);
     *cfg = (CFG) {
         .arena = arena,
+        .function = function,
         .config = config,
         .entry = entry_node,
         .size = shd_list_count(context.contents),
@@ -410,59 +430,69 @@ CFG* build_cfg(const Node* function, const Node* entry, CFGBuildConfig config) {
         .rpo = NULL
     };
 
+    layout_edges(cfg, scratch, context.edges);
+    mark_reachable(entry_node);
     validate_cfg(cfg);
 
     if (config.flipped)
-        flip_cfg(cfg);
+        flip_cfg(cfg, scratch, context.edges);
+    shd_destroy_list(context.edges);
 
     compute_rpo(cfg);
     compute_domtree(cfg);
 
+    shd_arena_rewind(scratch, mark);
     return cfg;
 }
 
 void destroy_cfg(CFG* cfg) {
-    bool entry_destroyed = false;
-    for (size_t i = 0; i < cfg->size; i++) {
-        CFNode* node = shd_read_list(CFNode*, cfg->contents)[i];
-        entry_destroyed |= node == cfg->entry;
-        shd_destroy_list(node->pred_edges);
-        shd_destroy_list(node->succ_edges);
-        if (node->dominates)
-            shd_destroy_list(node->dominates);
-        if (node->structurally_dominates)
-            shd_destroy_dict(node->structurally_dominates);
-    }
-    if (!entry_destroyed) {
-        shd_destroy_list(cfg->entry->pred_edges);
-        shd_destroy_list(cfg->entry->succ_edges);
-        if (cfg->entry->dominates)
-            shd_destroy_list(cfg->entry->dominates);
-    }
-    shd_destroy_dict(cfg->map);
     shd_destroy_arena(cfg->arena);
     free(cfg->rpo);
     shd_destroy_list(cfg->contents);
     free(cfg);
 }
 
-static size_t post_order_visit(CFG* cfg, CFNode* n, size_t i) {
-    n->rpo_index = -2;
-
-    for (int phase = 0; phase < 2; phase++) {
-        for (size_t j = 0; j < shd_list_count(n->succ_edges); j++) {
-            CFEdge edge = shd_read_list(CFEdge, n->succ_edges)[j];
-            // always visit structured tail edges last
-            if ((edge.type == StructuredTailEdge) == (phase == 0))
+typedef struct {
+    CFNode* node;
+    bool tails;
+    size_t next;
+} PostOrderFrame;
+
+/// Numbers the nodes in post-order, taking structured tail edges only once all the other successors are visited.
+static void post_order_visit(CFG* cfg) {
+    Arena* scratch = shd_get_scratch_arena();
+    ArenaMark mark = shd_arena_mark(scratch);
+    // indexed by the provisional numbering
+    bool* visited = shd_arena_alloc(scratch, sizeof(bool) * cfg->size);
+    PostOrderFrame* stack = shd_arena_alloc_uninit(scratch, sizeof(PostOrderFrame) * cfg->size);
+    size_t top = 0;
+    size_t index = cfg->reachable_size;
+
+    visited[cfg->entry->rpo_index] = true;
+    stack[top++] = (PostOrderFrame) { .node = cfg->entry };
+    while (top > 0) {
+        PostOrderFrame* frame = &stack[top - 1];
+        CFNode* n = frame->node;
+        if (frame->next == n->succ_edges.count) {
+            if (!frame->tails) {
+                frame->tails = true;
+                frame->next = 0;
                 continue;
-            if (edge.dst->rpo_index == SIZE_MAX)
-                i = post_order_visit(cfg, edge.dst, i);
+            }
+            cfg->rpo[--index] = n;
+            top--;
+            continue;
+        }
+        CFEdge edge = n->succ_edges.edges[frame->next++];
+        if ((edge.type == StructuredTailEdge) != frame->tails)
+            continue;
+        if (!visited[edge.dst->rpo_index]) {
+            visited[edge.dst->rpo_index] = true;
+            stack[top++] = (PostOrderFrame) { .node = edge.dst };
         }
     }
-
-    n->rpo_index = i - 1;
-    cfg->rpo[n->rpo_index] = n;
-    return n->rpo_index;
+    assert(index == 0);
+    shd_arena_rewind(scratch, mark);
 }
 
 void compute_rpo(CFG* cfg) {
@@ -475,8 +505,13 @@ void compute_rpo(CFG* cfg) {
     cfg->reachable_size = cfg->size;
 
     cfg->rpo = malloc(sizeof(const CFNode*) * cfg->size);
-    size_t index = post_order_visit(cfg, cfg->entry, cfg->reachable_size);
-    assert(index == 0);
+    post_order_visit(cfg);
+    for (size_t i = 0; i < cfg->size; i++)
+        cfg->rpo[i]->rpo_index = i;
+
+    // the grouping is stable, so the edges of each node keep the order they were found in
+    cfg->succ_edges = group_edges(cfg, cfg->arena, cfg->succ_edges, cfg->edges_count, false);
+    cfg->pred_edges = group_edges(cfg, cfg->arena, cfg->pred_edges, cfg->edges_count, true);
 
     // debug_print("RPO: ");
     // for (size_t i = 0; i < cfg->size; i++) {
@@ -486,8 +521,8 @@ void compute_rpo(CFG* cfg) {
 }
 
 bool is_cfnode_structural_target(CFNode* cfn) {
-    for (size_t i = 0; i < shd_list_count(cfn->pred_edges); i++) {
-        if (shd_read_list(CFEdge, cfn->pred_edges)[i].type != JumpEdge)
+    for (size_t i = 0; i < cfn->pred_edges.count; i++) {
+        if (cfn->pred_edges.edges[i].type != JumpEdge)
             return true;
     }
     return false;
@@ -495,86 +530,203 @@ bool is_cfnode_structural_target(CFNode* cfn) {
 
 CFNode* least_common_ancestor(CFNode* i, CFNode* j) {
     assert(i && j);
-    while (i->rpo_index != j->rpo_index) {
-        while (i->rpo_index < j->rpo_index) j = j->idom;
-        while (i->rpo_index > j->rpo_index) i = i->idom;
-    }
+    while (!cfg_is_dominated(j, i))
+        i = i->idom;
     return i;
 }
 
 bool cfg_is_dominated(CFNode* a, CFNode* b) {
-    while (a) {
-        if (a == b)
-            return true;
-        if (a->idom)
-            a = a->idom;
-        else if (a->structured_idom)
-            a = a->structured_idom;
-        else
-            break;
+    return b->dom_pre_index <= a->dom_pre_index && a->dom_post_index <= b->dom_post_index;
+}
+
+#define NO_NODE SIZE_MAX
+
+/// Scratch state for the Semi-NCA algorithm. Nodes are identified by their position in a depth-first walk, except where noted.
+typedef struct {
+    /// by rpo index: the only predecessor the node gets dominated through, for targets of structured tail edges
+    CFNode** fixed_idom;
+    /// by rpo index
+    size_t* number;
+    CFNode** vertex;
+    size_t* parent;
+    size_t* semi;
+    size_t* label;
+    size_t* ancestor;
+    size_t* idom;
+    size_t* stack;
+    size_t* cursor;
+} DomTreeContext;
+
+/// Tail edges don't count for dominance. The nodes they lead to are instead dominated through their first predecessor in
+/// RPO, and that one only.
+static bool is_dominance_edge(const DomTreeContext* ctx, CFEdge e) {
+    CFNode* fixed = ctx->fixed_idom[e.dst->rpo_index];
+    if (fixed)
+        return e.src == fixed;
+    return e.type != StructuredTailEdge;
+}
+
+static size_t number_nodes(DomTreeContext* ctx, CFG* cfg) {
+    size_t count = 0;
+    size_t top = 0;
+    ctx->number[cfg->entry->rpo_index] = count;
+    ctx->vertex[count] = cfg->entry;
+    ctx->parent[count] = NO_NODE;
+    ctx->stack[top++] = count++;
+    while (top > 0) {
+        size_t v = ctx->stack[top - 1];
+        CFNode* n = ctx->vertex[v];
+        if (ctx->cursor[v] == n->succ_edges.count) {
+            top--;
+            continue;
+        }
+        CFEdge e = n->succ_edges.edges[ctx->cursor[v]++];
+        if (!is_dominance_edge(ctx, e) || ctx->number[e.dst->rpo_index] != NO_NODE)
+            continue;
+        ctx->number[e.dst->rpo_index] = count;
+        ctx->vertex[count] = e.dst;
+        ctx->parent[count] = v;
+        ctx->stack[top++] = count++;
+    }
+    return count;
+}
+
+/// Returns the node with the smallest semi-dominator on the path from @p v to the root of its tree in the forest built
+/// so far, compressing that path along the way.
+static size_t eval(DomTreeContext* ctx, size_t v) {
+    if (ctx->ancestor[v] == NO_NODE)
+        return v;
+    size_t len = 0;
+    for (size_t u = v; ctx->ancestor[ctx->ancestor[u]] != NO_NODE; u = ctx->ancestor[u])
+        ctx->stack[len++] = u;
+    while (len > 0) {
+        size_t u = ctx->stack[--len];
+        size_t a = ctx->ancestor[u];
+        if (ctx->semi[ctx->label[a]] < ctx->semi[ctx->label[u]])
+            ctx->label[u] = ctx->label[a];
+        ctx->ancestor[u] = ctx->ancestor[a];
+    }
+    return ctx->label[v];
+}
+
+/// Numbers the dominator tree in pre- and post-order, for cfg_is_dominated.
+static void number_domtree(DomTreeContext* ctx, CFG* cfg) {
+    size_t pre = 0;
+    size_t post = 0;
+    size_t top = 0;
+    memset(ctx->cursor, 0, sizeof(size_t) * cfg->size);
+    cfg->entry->dom_pre_index = pre++;
+    ctx->stack[top++] = cfg->entry->rpo_index;
+    while (top > 0) {
+        CFNode* n = cfg->rpo[ctx->stack[top - 1]];
+        size_t* cursor = &ctx->cursor[n->rpo_index];
+        if (*cursor == n->dominates.count) {
+            n->dom_post_index = post++;
+            top--;
+            continue;
+        }
+        CFNode* child = n->dominates.nodes[(*cursor)++];
+        child->dom_pre_index = pre++;
+        ctx->stack[top++] = child->rpo_index;
     }
-    return false;
 }
 
+/// Semi-NCA, see "Finding Dominators in Practice" by Georgiadis, Tarjan and Werneck.
 void compute_domtree(CFG* cfg) {
-    for (size_t i = 0; i < cfg->size; i++) {
+    Arena* scratch = shd_get_scratch_arena();
+    ArenaMark mark = shd_arena_mark(scratch);
+    size_t size = cfg->size;
+    DomTreeContext ctx = {
+        .fixed_idom = shd_arena_alloc(scratch, sizeof(CFNode*) * size),
+        .number = shd_arena_alloc_uninit(scratch, sizeof(size_t) * size),
+        .vertex = shd_arena_alloc_uninit(scratch, sizeof(CFNode*) * size),
+        .parent = shd_arena_alloc_uninit(scratch, sizeof(size_t) * size),
+        .semi = shd_arena_alloc_uninit(scratch, sizeof(size_t) * size),
+        .label = shd_arena_alloc_uninit(scratch, sizeof(size_t) * size),
+        .ancestor = shd_arena_alloc_uninit(scratch, sizeof(size_t) * size),
+        .idom = shd_arena_alloc_uninit(scratch, sizeof(size_t) * size),
+        .stack = shd_arena_alloc_uninit(scratch, sizeof(size_t) * size),
+        .cursor = shd_arena_alloc(scratch, sizeof(size_t) * size),
+    };
+
+    for (size_t i = 0; i < size; i++) {
         CFNode* n = shd_read_list(CFNode*, cfg->contents)[i];
+        ctx.number[n->rpo_index] = NO_NODE;
         if (n == cfg->entry/* || !n->reachable*/)
             continue;
         CFNode* structured_idom = NULL;
-        for (size_t j = 0; j < shd_list_count(n->pred_edges); j++) {
-            CFEdge e = shd_read_list(CFEdge, n->pred_edges)[j];
+        for (size_t j = 0; j < n->pred_edges.count; j++) {
+            CFEdge e = n->pred_edges.edges[j];
             if (e.type == StructuredTailEdge) {
                 structured_idom = n->structured_idom = e.src;
                 n->structured_idom_edge = e;
-                continue;
             }
         }
-        for (size_t j = 0; j < shd_list_count(n->pred_edges); j++) {
-            CFEdge e = shd_read_list(CFEdge, n->pred_edges)[j];
+        if (!structured_idom)
+            continue;
+        for (size_t j = 0; j < n->pred_edges.count; j++) {
+            CFEdge e = n->pred_edges.edges[j];
             if (e.src->rpo_index < n->rpo_index) {
-                n->idom = e.src;
-                goto outer_loop;
+                ctx.fixed_idom[n->rpo_index] = e.src;
+                break;
             }
         }
-        if (structured_idom) {
-            continue;
-        }
+        // the DFS that made the RPO got here from somewhere
+        assert(ctx.fixed_idom[n->rpo_index]);
+    }
+
+    size_t count = number_nodes(&ctx, cfg);
+    if (count != size)
         shd_error("no idom found");
-        outer_loop:;
+    for (size_t v = 0; v < count; v++) {
+        ctx.semi[v] = v;
+        ctx.label[v] = v;
+        ctx.ancestor[v] = NO_NODE;
     }
 
-    bool todo = true;
-    while (todo) {
-        todo = false;
-        for (size_t i = 0; i < cfg->size; i++) {
-            CFNode* n = shd_read_list(CFNode*, cfg->contents)[i];
-            if (n == cfg->entry || n->structured_idom)
+    for (size_t w = count - 1; w > 0; w--) {
+        CFNode* n = ctx.vertex[w];
+        for (size_t j = 0; j < n->pred_edges.count; j++) {
+            CFEdge e = n->pred_edges.edges[j];
+            if (!is_dominance_edge(&ctx, e))
                 continue;
-            CFNode* new_idom = NULL;
-            for (size_t j = 0; j < shd_list_count(n->pred_edges); j++) {
-                CFEdge e = shd_read_list(CFEdge, n->pred_edges)[j];
-                 if (e.type == StructuredTailEdge)
-                     continue;
-                CFNode* p = e.src;
-                new_idom = new_idom ? least_common_ancestor(new_idom, p) : p;
-            }
-            assert(new_idom);
-            if (n->idom != new_idom) {
-                n->idom = new_idom;
-                todo = true;
-            }
+            size_t u = eval(&ctx, ctx.number[e.src->rpo_index]);
+            if (ctx.semi[u] < ctx.semi[w])
+                ctx.semi[w] = ctx.semi[u];
         }
+        ctx.ancestor[w] = ctx.parent[w];
     }
 
-    for (size_t i = 0; i < cfg->size; i++) {
+    ctx.idom[0] = NO_NODE;
+    for (size_t w = 1; w < count; w++) {
+        size_t d = ctx.parent[w];
+        while (d > ctx.semi[w])
+            d = ctx.idom[d];
+        ctx.idom[w] = d;
+        ctx.vertex[w]->idom = ctx.vertex[d];
+    }
+
+    // grouped by parent, in RPO, the same way as the edges
+    size_t* children_count = ctx.cursor;
+    memset(children_count, 0, sizeof(size_t) * size);
+    for (size_t i = 0; i < size; i++) {
         CFNode* n = cfg->rpo[i];
-        n->dominates = shd_new_list(CFNode*);
+        if (n->idom)
+            children_count[n->idom->rpo_index]++;
     }
-    for (size_t i = 0; i < cfg->size; i++) {
+    cfg->dominated = shd_arena_alloc_uninit(cfg->arena, sizeof(CFNode*) * (size - 1));
+    size_t offset = 0;
+    for (size_t i = 0; i < size; i++) {
         CFNode* n = cfg->rpo[i];
-        if (!n->idom)
-            continue;
-        shd_list_append(CFNode*, n->idom->dominates, n);
+        n->dominates = (CFNodes) { .count = 0, .nodes = cfg->dominated + offset };
+        offset += children_count[i];
     }
+    for (size_t i = 0; i < size; i++) {
+        CFNode* n = cfg->rpo[i];
+        if (n->idom)
+            n->idom->dominates.nodes[n->idom->dominates.count++] = n;
+    }
+
+    number_domtree(&ctx, cfg);
+    shd_arena_rewind(scratch, mark);
 }
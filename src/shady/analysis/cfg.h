@@ -27,22 +27,28 @@ typedef struct {
     const Node* terminator;
 } CFEdge;
 
+/// A range of @ref CFG.succ_edges or @ref CFG.pred_edges
+typedef struct {
+    size_t count;
+    CFEdge* edges;
+} CFEdges;
+
+/// A range of @ref CFG.dominated
+typedef struct {
+    size_t count;
+    CFNode** nodes;
+} CFNodes;
+
 struct CFNode_ {
     const Node* node;
 
     bool reachable;
 
-    /** @brief Edges where this node is the source
-     *
-     * @ref List of @ref CFEdge
-     */
-    struct List* succ_edges;
+    /// Edges where this node is the source
+    CFEdges succ_edges;
 
-    /** @brief Edges where this node is the destination
-     *
-     * @ref List of @ref CFEdge
-     */
-    struct List* pred_edges;
+    /// Edges where this node is the destination
+    CFEdges pred_edges;
 
     // set by compute_rpo
     size_t rpo_index;
@@ -51,16 +57,16 @@ struct CFNode_ {
     CFNode* idom;
     CFNode* structured_idom;
     CFEdge structured_idom_edge;
+    // set by compute_domtree, position in a depth-first walk of the dominator tree
+    size_t dom_pre_index;
+    size_t dom_post_index;
 
-    /** @brief All Nodes directly dominated by this CFNode.
-     *
-     * @ref List of @ref CFNode*
-     */
-    struct List* dominates;
-    struct Dict* structurally_dominates;
+    /// All Nodes directly dominated by this CFNode, in RPO.
+    CFNodes dominates;
 };
 
 typedef struct Arena_ Arena;
+typedef struct NodeMap_ NodeMap;
 typedef struct LoopTree_ LoopTree;
 
 typedef struct {
@@ -72,6 +78,7 @@ typedef struct {
 
 typedef struct CFG_ {
     Arena* arena;
+    const Node* function;
     CFGBuildConfig config;
     size_t size;
 
@@ -83,14 +90,22 @@ typedef struct CFG_ {
     struct List* contents;
 
     /**
-     * @ref Dict from const @ref Node* to @ref CFNode*
+     * @ref NodeMap from const @ref Node* to @ref CFNode*
      */
-    struct Dict* map;
+    NodeMap* map;
 
     CFNode* entry;
     // set by compute_rpo
     size_t reachable_size;
     CFNode** rpo;
+
+    /// Every edge once, grouped by source in RPO. Set by compute_rpo, like @ref pred_edges.
+    CFEdge* succ_edges;
+    /// Every edge again, grouped by destination.
+    CFEdge* pred_edges;
+    size_t edges_count;
+    /// The children of every node in the dominator tree, grouped by parent. Set by compute_domtree.
+    CFNode** dominated;
 } CFG;
 
 /**
@@ -140,6 +155,7 @@ CFNode* cfg_lookup(CFG* cfg, const Node* abs);
 void compute_rpo(CFG*);
 void compute_domtree(CFG*);
 
+/// Constant time, using the numbering of the dominator tree.
 bool cfg_is_dominated(CFNode* dominated, CFNode* by);
 
 bool is_cfnode_structural_target(CFNode*);
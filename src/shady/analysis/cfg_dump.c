@@ -111,8 +111,8 @@ static void dump_cfg(FILE* output, CFG* cfg) {
         const CFNode* bb_node = shd_read_list(const CFNode*, cfg->contents)[i];
         const CFNode* src_node = bb_node;
 
-        for (size_t j = 0; j < shd_list_count(bb_node->succ_edges); j++) {
-            CFEdge edge = shd_read_list(CFEdge, bb_node->succ_edges)[j];
+        for (size_t j = 0; j < bb_node->succ_edges.count; j++) {
+            CFEdge edge = bb_node->succ_edges.edges[j];
             const CFNode* target_node = edge.dst;
             String edge_color = "black";
             String edge_style = "solid";
@@ -176,8 +176,8 @@ static void dump_domtree_cfnode(Printer* p, CFNode* idom) {
     else
         shd_print(p, "bb_%zu [label=\"%%%d\", shape=box];\n", (size_t) idom, idom->node->id);
 
-    for (size_t i = 0; i < shd_list_count(idom->dominates); i++) {
-        CFNode* child = shd_read_list(CFNode*, idom->dominates)[i];
+    for (size_t i = 0; i < idom->dominates.count; i++) {
+        CFNode* child = idom->dominates.nodes[i];
         dump_domtree_cfnode(p, child);
         shd_print(p, "bb_%zu -> bb_%zu;\n", (size_t) (idom), (size_t) (child));
     }
@@ -1,21 +1,23 @@
 #include "free_frontier.h"
 
+#include "../node_map.h"
+
 #include "shady/visit.h"
 #include "dict.h"
+#include "arena.h"
 
 typedef struct {
     Visitor v;
     Scheduler* scheduler;
     CFG* cfg;
     CFNode* start;
-    struct Dict* seen;
+    NodeMap* seen;
     struct Dict* frontier;
 } FreeFrontierVisitor;
 
 static void visit_free_frontier(FreeFrontierVisitor* v, const Node* node) {
-    if (shd_dict_find_key(const Node*, v->seen, node))
+    if (!shd_node_set_insert(v->seen, node))
         return;
-    shd_set_insert_get_result(const Node*, v->seen, node);
     CFNode* where = schedule_instruction(v->scheduler, node);
     if (where) {
         FreeFrontierVisitor vv = *v;
@@ -42,6 +44,8 @@ KeyHash shd_hash_node(Node** pnode);
 bool shd_compare_node(Node** pa, Node** pb);
 
 struct Dict* free_frontier(Scheduler* scheduler, CFG* cfg, const Node* abs) {
+    Arena* scratch = shd_get_scratch_arena();
+    ArenaMark mark = shd_arena_mark(scratch);
     FreeFrontierVisitor ffv = {
         .v = {
             .visit_node_fn = (VisitNodeFn) visit_free_frontier,
@@ -50,10 +54,10 @@ struct Dict* free_frontier(Scheduler* scheduler, CFG* cfg, const Node* abs) {
         .cfg = cfg,
         .start = cfg_lookup(cfg, abs),
         .frontier = shd_new_set(const Node*, (HashFn) shd_hash_node, (CmpFn) shd_compare_node),
-        .seen = shd_new_set(const Node*, (HashFn) shd_hash_node, (CmpFn) shd_compare_node),
+        .seen = shd_new_node_set_in(scratch),
     };
     if (get_abstraction_body(abs))
         visit_free_frontier(&ffv, get_abstraction_body(abs));
-    shd_destroy_dict(ffv.seen);
+    shd_arena_rewind(scratch, mark);
     return ffv.frontier;
 }
\ No newline at end of file
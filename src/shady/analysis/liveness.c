@@ -0,0 +1,174 @@
+#include "liveness.h"
+
+#include "../node_map.h"
+
+#include "shady/visit.h"
+#include "list.h"
+#include "arena.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+struct Liveness_ {
+    CFG* cfg;
+    /// @ref List of const @ref Node*, the values that are used outside of the block they are defined in
+    struct List* values;
+    /// One bit per value, for each CFNode in RPO
+    uint64_t* live_in;
+    size_t words;
+};
+
+typedef struct {
+    size_t block;
+    size_t value;
+} CrossBlockUse;
+
+typedef struct {
+    IterativeVisitor v;
+    Scheduler* scheduler;
+    /// const @ref Node* -> index in @ref Liveness.values
+    NodeMap* numbering;
+    struct List* values;
+    /// @ref List of @ref CrossBlockUse
+    struct List* uses;
+} LivenessBuilder;
+
+static void record_use(LivenessBuilder* b, const Node* user, NodeClass class, String op_name, const Node* op, size_t i) {
+    if (class != NcValue)
+        return;
+    CFNode* def = schedule_instruction(b->scheduler, op);
+    CFNode* use = schedule_instruction(b->scheduler, user);
+    // top-level values are available everywhere
+    if (!def || !use || def == use)
+        return;
+
+    size_t* found = shd_node_map_find(size_t, b->numbering, op);
+    size_t value;
+    if (found)
+        value = *found;
+    else {
+        value = shd_list_count(b->values);
+        shd_node_map_insert(size_t, b->numbering, op, value);
+        shd_list_append(const Node*, b->values, op);
+    }
+    CrossBlockUse u = { .block = use->rpo_index, .value = value };
+    shd_list_append(CrossBlockUse, b->uses, u);
+}
+
+/// Joins leave through a join point: if its control gets lifted, the tail recovers what it needs on its own, and if it
+/// doesn't, those values are live at the control anyways, through its tail edge.
+static bool is_liveness_edge(CFEdge e) {
+    return !(e.type == StructuredLeaveBodyEdge && e.terminator && e.terminator->tag == Join_TAG);
+}
+
+#define BIT(set, i) (set)[(i) / 64] |= (uint64_t) 1 << ((i) % 64)
+
+Liveness* compute_liveness(CFG* cfg, Scheduler* scheduler) {
+    Arena* scratch = shd_get_scratch_arena();
+    ArenaMark mark = shd_arena_mark(scratch);
+    // this grows while the visitor is borrowing the scratch arena, so it can't live in there
+    LivenessBuilder b = {
+        .v = {
+            .exclude = (NodeClass) ~(NcMem | NcValue | NcJump),
+            .visit_edge_fn = (IterativeVisitEdgeFn) record_use,
+        },
+        .scheduler = scheduler,
+        .numbering = shd_new_node_map(size_t),
+        .values = shd_new_list(const Node*),
+        .uses = shd_new_list(CrossBlockUse),
+    };
+
+    size_t roots_count = 0;
+    const Node** roots = shd_arena_alloc_uninit(scratch, sizeof(const Node*) * cfg->size);
+    for (size_t i = 0; i < cfg->size; i++) {
+        const Node* abs = cfg->rpo[i]->node;
+        if (abs && get_abstraction_body(abs))
+            roots[roots_count++] = get_abstraction_body(abs);
+    }
+    shd_visit_iteratively(&b.v, (Nodes) { .count = roots_count, .nodes = roots });
+    shd_destroy_node_map(b.numbering);
+
+    Liveness* l = calloc(sizeof(Liveness), 1);
+    size_t values_count = shd_list_count(b.values);
+    *l = (Liveness) {
+        .cfg = cfg,
+        .values = b.values,
+        .words = (values_count + 63) / 64,
+    };
+    size_t words = l->words;
+    l->live_in = calloc(sizeof(uint64_t), cfg->size * words + 1);
+
+    uint64_t* gen = shd_arena_alloc(scratch, sizeof(uint64_t) * (cfg->size * words + 1));
+    uint64_t* kill = shd_arena_alloc(scratch, sizeof(uint64_t) * (cfg->size * words + 1));
+    uint64_t* live_out = shd_arena_alloc(scratch, sizeof(uint64_t) * (words + 1));
+    for (size_t i = 0; i < shd_list_count(b.uses); i++) {
+        CrossBlockUse u = shd_read_list(CrossBlockUse, b.uses)[i];
+        BIT(&gen[u.block * words], u.value);
+    }
+    for (size_t i = 0; i < values_count; i++) {
+        CFNode* def = schedule_instruction(scheduler, shd_read_list(const Node*, b.values)[i]);
+        BIT(&kill[def->rpo_index * words], i);
+    }
+    shd_destroy_list(b.uses);
+
+    // visiting successors first makes most of this converge in one pass, loops take a few more
+    bool todo = true;
+    while (todo) {
+        todo = false;
+        for (size_t i = cfg->size; i > 0; i--) {
+            CFNode* n = cfg->rpo[i - 1];
+            memset(live_out, 0, sizeof(uint64_t) * words);
+            for (size_t j = 0; j < n->succ_edges.count; j++) {
+                CFEdge e = n->succ_edges.edges[j];
+                if (!is_liveness_edge(e))
+                    continue;
+                const uint64_t* succ_in = &l->live_in[e.dst->rpo_index * words];
+                for (size_t w = 0; w < words; w++)
+                    live_out[w] |= succ_in[w];
+            }
+            uint64_t* in = &l->live_in[n->rpo_index * words];
+            for (size_t w = 0; w < words; w++) {
+                uint64_t new_in = gen[n->rpo_index * words + w] | (live_out[w] & ~kill[n->rpo_index * words + w]);
+                if (new_in != in[w]) {
+                    in[w] = new_in;
+                    todo = true;
+                }
+            }
+        }
+    }
+
+    shd_arena_rewind(scratch, mark);
+    return l;
+}
+
+#undef BIT
+
+void destroy_liveness(Liveness* l) {
+    shd_destroy_list(l->values);
+    free(l->live_in);
+    free(l);
+}
+
+Nodes get_live_ins(IrArena* a, Liveness* l, const Node* abs) {
+    CFNode* n = cfg_lookup(l->cfg, abs);
+    assert(n);
+    const uint64_t* in = &l->live_in[n->rpo_index * l->words];
+    size_t values_count = shd_list_count(l->values);
+    size_t count = 0;
+    for (size_t i = 0; i < values_count; i++)
+        count += (in[i / 64] >> (i % 64)) & 1;
+
+    Arena* scratch = shd_get_scratch_arena();
+    ArenaMark mark = shd_arena_mark(scratch);
+    const Node** live = shd_arena_alloc_uninit(scratch, sizeof(const Node*) * (count + 1));
+    size_t j = 0;
+    for (size_t i = 0; i < values_count; i++) {
+        if ((in[i / 64] >> (i % 64)) & 1)
+            live[j++] = shd_read_list(const Node*, l->values)[i];
+    }
+    Nodes nodes = shd_nodes(a, count, live);
+    shd_arena_rewind(scratch, mark);
+    return nodes;
+}
@@ -0,0 +1,17 @@
+#ifndef SHADY_LIVENESS_H
+#define SHADY_LIVENESS_H
+
+#include "shady/ir.h"
+#include "cfg.h"
+#include "scheduler.h"
+
+typedef struct Liveness_ Liveness;
+
+/// Backwards dataflow over @p cfg, where values are defined and used wherever @p scheduler puts them.
+Liveness* compute_liveness(CFG* cfg, Scheduler* scheduler);
+void destroy_liveness(Liveness*);
+
+/// The values defined before @p abs that it, or anything that can run after it, still needs. In a stable order.
+Nodes get_live_ins(IrArena* a, Liveness*, const Node* abs);
+
+#endif
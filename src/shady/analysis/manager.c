@@ -0,0 +1,306 @@
+#include "manager.h"
+
+#include "../ir_private.h"
+#include "../node_map.h"
+
+#include "list.h"
+
+#include <stdlib.h>
+#include <assert.h>
+
+typedef struct {
+    CFG* cfg;
+    Scheduler* scheduler;
+    LoopTree* loop_tree;
+    Liveness* liveness;
+} CachedCFG;
+
+typedef struct {
+    /// @ref List of @ref CachedCFG*, one per @ref CFGBuildConfig that was asked for
+    struct List* cfgs;
+    const UsesMap* uses;
+} FnAnalyses;
+
+typedef struct {
+    Module* module;
+    /// A module only ever gets declarations appended, so the graph is stale if this doesn't match anymore
+    size_t decls_count;
+    CallGraph* graph;
+} CachedCallGraph;
+
+struct AnalysisCache_ {
+    /// Function -> @ref FnAnalyses*
+    NodeMap* fns;
+    /// @ref List of @ref CachedCallGraph
+    struct List* callgraphs;
+};
+
+static bool same_cfg_build(CFGBuildConfig a, CFGBuildConfig b) {
+    return a.include_structured_exits == b.include_structured_exits && a.include_structured_tails == b.include_structured_tails && a.flipped == b.flipped;
+}
+
+/// Must be called with the arena lock held
+static AnalysisCache* get_cache(IrArena* a) {
+    if (!a->analyses) {
+        AnalysisCache* cache = calloc(1, sizeof(AnalysisCache));
+        cache->fns = shd_new_node_map(FnAnalyses*);
+        cache->callgraphs = shd_new_list(CachedCallGraph);
+        a->analyses = cache;
+    }
+    return a->analyses;
+}
+
+/// Must be called with the arena lock held
+static FnAnalyses* get_fn_analyses(const Node* fn) {
+    AnalysisCache* cache = get_cache(fn->arena);
+    FnAnalyses** found = shd_node_map_find(FnAnalyses*, cache->fns, fn);
+    if (found)
+        return *found;
+    FnAnalyses* new = calloc(1, sizeof(FnAnalyses));
+    new->cfgs = shd_new_list(CachedCFG*);
+    shd_node_map_insert(FnAnalyses*, cache->fns, fn, new);
+    return new;
+}
+
+static CachedCFG* find_cached_cfg(FnAnalyses* fa, const CFG* cfg) {
+    for (size_t i = 0; i < shd_list_count(fa->cfgs); i++) {
+        CachedCFG* c = shd_read_list(CachedCFG*, fa->cfgs)[i];
+        if (c->cfg == cfg)
+            return c;
+    }
+    return NULL;
+}
+
+static void destroy_cfg_derived(CachedCFG* c) {
+    if (c->liveness)
+        destroy_liveness(c->liveness);
+    if (c->loop_tree)
+        destroy_loop_tree(c->loop_tree);
+    if (c->scheduler)
+        destroy_scheduler(c->scheduler);
+    c->liveness = NULL;
+    c->loop_tree = NULL;
+    c->scheduler = NULL;
+}
+
+static void destroy_cached_cfg(CachedCFG* c) {
+    destroy_cfg_derived(c);
+    destroy_cfg(c->cfg);
+    free(c);
+}
+
+// The analyses themselves are built outside the lock, so that threads rewriting different functions don't serialize
+// on them. If two threads raced to build the same thing, the first one to publish its result wins.
+
+CFG* shd_get_cfg(const Node* fn, CFGBuildConfig config) {
+    assert(fn && fn->tag == Function_TAG);
+    assert(!config.lt && "loop-restricted CFGs are not cached, use build_cfg directly");
+    IrArena* a = fn->arena;
+
+    _shd_lock_ir_arena(a);
+    FnAnalyses* fa = get_fn_analyses(fn);
+    for (size_t i = 0; i < shd_list_count(fa->cfgs); i++) {
+        CachedCFG* c = shd_read_list(CachedCFG*, fa->cfgs)[i];
+        if (same_cfg_build(c->cfg->config, config)) {
+            _shd_unlock_ir_arena(a);
+            return c->cfg;
+        }
+    }
+    _shd_unlock_ir_arena(a);
+
+    CFG* cfg = build_cfg(fn, fn, config);
+
+    _shd_lock_ir_arena(a);
+    fa = get_fn_analyses(fn);
+    for (size_t i = 0; i < shd_list_count(fa->cfgs); i++) {
+        CachedCFG* c = shd_read_list(CachedCFG*, fa->cfgs)[i];
+        if (same_cfg_build(c->cfg->config, config)) {
+            _shd_unlock_ir_arena(a);
+            destroy_cfg(cfg);
+            return c->cfg;
+        }
+    }
+    CachedCFG* c = calloc(1, sizeof(CachedCFG));
+    c->cfg = cfg;
+    shd_list_append(CachedCFG*, fa->cfgs, c);
+    _shd_unlock_ir_arena(a);
+    return cfg;
+}
+
+Scheduler* shd_get_scheduler(CFG* cfg) {
+    IrArena* a = cfg->function->arena;
+    _shd_lock_ir_arena(a);
+    CachedCFG* c = find_cached_cfg(get_fn_analyses(cfg->function), cfg);
+    assert(c && "this CFG does not come from shd_get_cfg");
+    Scheduler* scheduler = c->scheduler;
+    _shd_unlock_ir_arena(a);
+    if (scheduler)
+        return scheduler;
+
+    // the loop tree is cached too, and other analyses are likely to want it as well
+    scheduler = new_scheduler_with_loop_tree(cfg, shd_get_loop_tree(cfg));
+
+    _shd_lock_ir_arena(a);
+    if (c->scheduler) {
+        destroy_scheduler(scheduler);
+        scheduler = c->scheduler;
+    } else
+        c->scheduler = scheduler;
+    _shd_unlock_ir_arena(a);
+    return scheduler;
+}
+
+LoopTree* shd_get_loop_tree(CFG* cfg) {
+    IrArena* a = cfg->function->arena;
+    _shd_lock_ir_arena(a);
+    CachedCFG* c = find_cached_cfg(get_fn_analyses(cfg->function), cfg);
+    assert(c && "this CFG does not come from shd_get_cfg");
+    LoopTree* lt = c->loop_tree;
+    _shd_unlock_ir_arena(a);
+    if (lt)
+        return lt;
+
+    lt = build_loop_tree(cfg);
+
+    _shd_lock_ir_arena(a);
+    if (c->loop_tree) {
+        destroy_loop_tree(lt);
+        lt = c->loop_tree;
+    } else
+        c->loop_tree = lt;
+    _shd_unlock_ir_arena(a);
+    return lt;
+}
+
+Liveness* shd_get_liveness(CFG* cfg) {
+    IrArena* a = cfg->function->arena;
+    _shd_lock_ir_arena(a);
+    CachedCFG* c = find_cached_cfg(get_fn_analyses(cfg->function), cfg);
+    assert(c && "this CFG does not come from shd_get_cfg");
+    Liveness* liveness = c->liveness;
+    _shd_unlock_ir_arena(a);
+    if (liveness)
+        return liveness;
+
+    liveness = compute_liveness(cfg, shd_get_scheduler(cfg));
+
+    _shd_lock_ir_arena(a);
+    if (c->liveness) {
+        destroy_liveness(liveness);
+        liveness = c->liveness;
+    } else
+        c->liveness = liveness;
+    _shd_unlock_ir_arena(a);
+    return liveness;
+}
+
+const UsesMap* shd_get_fn_uses_map(const Node* fn) {
+    assert(fn && fn->tag == Function_TAG);
+    IrArena* a = fn->arena;
+    _shd_lock_ir_arena(a);
+    const UsesMap* uses = get_fn_analyses(fn)->uses;
+    _shd_unlock_ir_arena(a);
+    if (uses)
+        return uses;
+
+    uses = create_fn_uses_map(fn, (NcDeclaration | NcType));
+
+    _shd_lock_ir_arena(a);
+    FnAnalyses* fa = get_fn_analyses(fn);
+    if (fa->uses) {
+        destroy_uses_map(uses);
+        uses = fa->uses;
+    } else
+        fa->uses = uses;
+    _shd_unlock_ir_arena(a);
+    return uses;
+}
+
+static CachedCallGraph* find_cached_callgraph(AnalysisCache* cache, Module* mod) {
+    for (size_t i = 0; i < shd_list_count(cache->callgraphs); i++) {
+        CachedCallGraph* c = &shd_read_list(CachedCallGraph, cache->callgraphs)[i];
+        if (c->module == mod)
+            return c;
+    }
+    return NULL;
+}
+
+CallGraph* shd_get_callgraph(Module* mod) {
+    IrArena* a = shd_module_get_arena(mod);
+    _shd_lock_ir_arena(a);
+    size_t decls_count = shd_list_count(mod->decls);
+    CachedCallGraph* c = find_cached_callgraph(get_cache(a), mod);
+    if (c && c->decls_count == decls_count) {
+        CallGraph* graph = c->graph;
+        _shd_unlock_ir_arena(a);
+        return graph;
+    }
+    _shd_unlock_ir_arena(a);
+
+    CallGraph* graph = new_callgraph(mod);
+
+    _shd_lock_ir_arena(a);
+    c = find_cached_callgraph(a->analyses, mod);
+    if (c && c->decls_count == decls_count) {
+        destroy_callgraph(graph);
+        graph = c->graph;
+    } else if (c) {
+        destroy_callgraph(c->graph);
+        c->graph = graph;
+        c->decls_count = decls_count;
+    } else {
+        CachedCallGraph new = { .module = mod, .decls_count = decls_count, .graph = graph };
+        shd_list_append(CachedCallGraph, a->analyses->callgraphs, new);
+    }
+    _shd_unlock_ir_arena(a);
+    return graph;
+}
+
+void shd_invalidate_fn_analyses(const Node* fn) {
+    IrArena* a = fn->arena;
+    _shd_lock_ir_arena(a);
+    FnAnalyses** found = a->analyses ? shd_node_map_find(FnAnalyses*, a->analyses->fns, fn) : NULL;
+    if (found) {
+        FnAnalyses* fa = *found;
+        for (size_t i = 0; i < shd_list_count(fa->cfgs); i++)
+            destroy_cached_cfg(shd_read_list(CachedCFG*, fa->cfgs)[i]);
+        shd_clear_list(fa->cfgs);
+        if (fa->uses) {
+            destroy_uses_map(fa->uses);
+            fa->uses = NULL;
+        }
+    }
+    _shd_unlock_ir_arena(a);
+}
+
+void shd_invalidate_callgraphs(IrArena* a) {
+    _shd_lock_ir_arena(a);
+    if (a->analyses) {
+        for (size_t i = 0; i < shd_list_count(a->analyses->callgraphs); i++)
+            destroy_callgraph(shd_read_list(CachedCallGraph, a->analyses->callgraphs)[i].graph);
+        shd_clear_list(a->analyses->callgraphs);
+    }
+    _shd_unlock_ir_arena(a);
+}
+
+void _shd_destroy_analysis_cache(IrArena* a) {
+    AnalysisCache* cache = a->analyses;
+    if (!cache)
+        return;
+    size_t i = 0;
+    FnAnalyses* fa;
+    while (shd_node_map_iter(cache->fns, &i, NULL, &fa)) {
+        for (size_t j = 0; j < shd_list_count(fa->cfgs); j++)
+            destroy_cached_cfg(shd_read_list(CachedCFG*, fa->cfgs)[j]);
+        shd_destroy_list(fa->cfgs);
+        if (fa->uses)
+            destroy_uses_map(fa->uses);
+        free(fa);
+    }
+    shd_destroy_node_map(cache->fns);
+    for (size_t j = 0; j < shd_list_count(cache->callgraphs); j++)
+        destroy_callgraph(shd_read_list(CachedCallGraph, cache->callgraphs)[j].graph);
+    shd_destroy_list(cache->callgraphs);
+    free(cache);
+    a->analyses = NULL;
+}
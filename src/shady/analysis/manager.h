@@ -0,0 +1,40 @@
+#ifndef SHADY_ANALYSIS_MANAGER_H
+#define SHADY_ANALYSIS_MANAGER_H
+
+#include "shady/ir.h"
+
+#include "cfg.h"
+#include "scheduler.h"
+#include "looptree.h"
+#include "liveness.h"
+#include "uses.h"
+#include "callgraph.h"
+
+/// Analyses computed on demand and cached in the @ref IrArena of what they describe.
+/// Since nodes are immutable once their arena has been rewritten from, a result stays valid until that arena is destroyed,
+/// which is also when it gets freed: callers must not destroy what these return.
+/// Code that does change a function in place (ie shd_set_abstraction_body) is responsible for calling @ref shd_invalidate_fn_analyses.
+/// The cache is guarded by the arena lock, so concurrent queries are only safe in arenas created with thread_safe set.
+
+/// Only whole-function CFGs are cached, @p config.lt must be NULL.
+CFG* shd_get_cfg(const Node* fn, CFGBuildConfig config);
+#define shd_get_fn_cfg(fn) shd_get_cfg(fn, default_forward_cfg_build())
+/// @p cfg must have been obtained from @ref shd_get_cfg
+Scheduler* shd_get_scheduler(CFG* cfg);
+/// @p cfg must have been obtained from @ref shd_get_cfg
+LoopTree* shd_get_loop_tree(CFG* cfg);
+/// @p cfg must have been obtained from @ref shd_get_cfg, values are placed by @ref shd_get_scheduler
+Liveness* shd_get_liveness(CFG* cfg);
+/// Uses of nodes within @p fn, operands of class NcDeclaration and NcType are not tracked.
+const UsesMap* shd_get_fn_uses_map(const Node* fn);
+/// @p mod must be sealed, since new declarations would not show up in the cached graph.
+CallGraph* shd_get_callgraph(Module* mod);
+
+/// Drops everything cached about @p fn.
+void shd_invalidate_fn_analyses(const Node* fn);
+/// Drops the call graphs cached for the modules of @p a, for passes that add or remove calls in place.
+void shd_invalidate_callgraphs(IrArena* a);
+
+void _shd_destroy_analysis_cache(IrArena* a);
+
+#endif
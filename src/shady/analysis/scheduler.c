@@ -1,18 +1,36 @@
 #include "scheduler.h"
+#include "looptree.h"
 
 #include "shady/visit.h"
 
-#include "dict.h"
-#include <stdlib.h>
+#include "../node_map.h"
+
+#include "list.h"
 
-KeyHash shd_hash_node(Node** pnode);
-bool shd_compare_node(Node** pa, Node** pb);
+#include <stdlib.h>
+#include <stddef.h>
+#include <assert.h>
 
 struct Scheduler_ {
     Visitor v;
+    IterativeVisitor iv;
+    Visitor uses_v;
     CFNode* result;
     CFG* cfg;
-    struct Dict* scheduled;
+    /// Earliest legal block for every node, as decided by its operands.
+    NodeMap* early;
+    /// Latest legal block for every node, the common dominator of wherever its users went. Only lives during new_scheduler.
+    NodeMap* late;
+    /// Where every node reachable from the blocks of the CFG finally goes.
+    NodeMap* placement;
+    /// @ref List of const @ref Node*, operands before users. Only lives during new_scheduler.
+    struct List* order;
+    /// Loop nesting of every CFNode, by rpo index.
+    int* loop_depth;
+    /// Movable nodes that must not be computed on paths where their users don't run, see is_speculatable.
+    NodeMap* sink_only;
+    /// Whether the node being scheduled has an operand in sink_only
+    bool depends_on_sink_only;
 };
 
 static void schedule_after(CFNode** scheduled, CFNode* req) {
@@ -37,48 +55,204 @@ static void visit_operand(Scheduler* s, NodeClass nc, String opname, const Node*
         // We only care about mem and value dependencies
         case NcMem:
         case NcValue:
-            schedule_after(&s->result, schedule_instruction(s, op));
+        case NcJump: {
+            CFNode** found = shd_node_map_find(CFNode*, s->early, op);
+            assert(found && "operands are scheduled first");
+            schedule_after(&s->result, *found);
+            if (shd_node_map_contains(s->sink_only, op))
+                s->depends_on_sink_only = true;
             break;
+        }
         default:
             break;
     }
 }
 
+#define SCHEDULER_FROM_ITERATIVE_VISITOR(iv) ((Scheduler*) ((char*) (iv) - offsetof(Scheduler, iv)))
+#define SCHEDULER_FROM_USES_VISITOR(v) ((Scheduler*) ((char*) (v) - offsetof(Scheduler, uses_v)))
+
+static bool should_schedule(IterativeVisitor* iv, const Node* n) {
+    Scheduler* s = SCHEDULER_FROM_ITERATIVE_VISITOR(iv);
+    return !shd_node_map_contains(s->early, n);
+}
+
+/// Pure computations only depend on their operands, so they can go anywhere between their earliest and latest legal
+/// block. Everything else stays where its mem or its abstraction puts it.
+static bool is_movable(const Node* n) {
+    switch (n->tag) {
+        case PrimOp_TAG:
+            // implicit derivatives need the quad to be converged, that's only guaranteed where the sample was written
+            return n->payload.prim_op.op != sample_texture_op;
+        case PtrCompositeElement_TAG:
+        case PtrArrayElementOffset_TAG:
+        case Composite_TAG:
+        case Fill_TAG:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/// Whether computing @p n where its users don't run is harmless. Divisions can trap, dynamic extracts can go out of
+/// bounds and subgroup operations depend on which lanes are active: those have to stay under whatever guards their users.
+static bool is_speculatable(const Node* n) {
+    if (n->tag != PrimOp_TAG)
+        return true;
+    Op op = n->payload.prim_op.op;
+    if (shd_get_primop_class(op) & (OcSubgroup_intrinsic | OcMask))
+        return false;
+    switch (op) {
+        case div_op:
+        case mod_op:
+        case extract_dynamic_op:
+            return false;
+        default:
+            return true;
+    }
+}
+
+/// Called once all the dependencies of n are scheduled
+static void schedule_post_order(IterativeVisitor* iv, const Node* n) {
+    Scheduler* s = SCHEDULER_FROM_ITERATIVE_VISITOR(iv);
+    s->result = NULL;
+    s->depends_on_sink_only = false;
+
+    if (n->tag == Param_TAG) {
+        schedule_after(&s->result, cfg_lookup(s->cfg, n->payload.param.abs));
+    } else if (n->tag == BasicBlock_TAG) {
+        schedule_after(&s->result, cfg_lookup(s->cfg, n));
+    } else if (n->tag == AbsMem_TAG) {
+        schedule_after(&s->result, cfg_lookup(s->cfg, n->payload.abs_mem.abs));
+    }
+
+    shd_visit_node_operands(&s->v, 0, n);
+    shd_node_map_insert(CFNode*, s->early, n, s->result);
+    // whatever uses a value that can't be hoisted can't be hoisted either, or it would drag that value along
+    if (is_movable(n) && (!is_speculatable(n) || s->depends_on_sink_only))
+        shd_node_set_insert(s->sink_only, n);
+    if (s->order)
+        shd_list_append(const Node*, s->order, n);
+}
+
+/// Walks up the dominator tree from @p late to @p early, keeping the block with the shallowest loop nesting.
+/// Ties go to the latest block, so values aren't computed on paths that don't need them.
+static CFNode* pick_placement(Scheduler* s, CFNode* early, CFNode* late) {
+    assert(cfg_is_dominated(late, early));
+    CFNode* best = late;
+    for (CFNode* n = late; n != early;) {
+        n = n->idom;
+        if (s->loop_depth[n->rpo_index] < s->loop_depth[best->rpo_index])
+            best = n;
+    }
+    return best;
+}
+
+static void record_use(Visitor* v, NodeClass nc, String opname, const Node* op, size_t i) {
+    Scheduler* s = SCHEDULER_FROM_USES_VISITOR(v);
+    if (nc != NcValue || !is_movable(op))
+        return;
+    CFNode** late = shd_node_map_find(CFNode*, s->late, op);
+    CFNode* new_late = late ? least_common_ancestor(*late, s->result) : s->result;
+    shd_node_map_insert(CFNode*, s->late, op, new_late);
+}
+
+/// Users come before their operands in reverse post-order, so by the time a node gets placed, all of its users are.
+static void place_nodes(Scheduler* s) {
+    size_t count = shd_list_count(s->order);
+    const Node** order = shd_read_list(const Node*, s->order);
+    for (size_t i = count; i > 0; i--) {
+        const Node* n = order[i - 1];
+        CFNode* placement = *shd_node_map_find(CFNode*, s->early, n);
+        if (placement && is_movable(n)) {
+            CFNode** late = shd_node_map_find(CFNode*, s->late, n);
+            if (late && shd_node_map_contains(s->sink_only, n))
+                placement = *late;
+            else if (late)
+                placement = pick_placement(s, placement, *late);
+        }
+        shd_node_map_insert(CFNode*, s->placement, n, placement);
+        if (placement) {
+            s->result = placement;
+            shd_visit_node_operands(&s->uses_v, 0, n);
+        }
+    }
+}
+
+static void compute_loop_depths(Scheduler* s, LoopTree* lt) {
+    CFG* cfg = s->cfg;
+    for (size_t i = 0; i < cfg->size; i++) {
+        CFNode* n = cfg->rpo[i];
+        s->loop_depth[i] = n->node ? looptree_lookup(lt, n->node)->depth : 0;
+    }
+}
+
 Scheduler* new_scheduler(CFG* cfg) {
+    LoopTree* lt = build_loop_tree(cfg);
+    Scheduler* s = new_scheduler_with_loop_tree(cfg, lt);
+    destroy_loop_tree(lt);
+    return s;
+}
+
+Scheduler* new_scheduler_with_loop_tree(CFG* cfg, LoopTree* lt) {
     Scheduler* s = calloc(sizeof(Scheduler), 1);
     *s = (Scheduler) {
         .v = {
             .visit_op_fn = (VisitOpFn) visit_operand,
         },
+        .iv = {
+            // We only care about mem and value dependencies, and the jumps that carry them
+            .exclude = (NodeClass) ~(NcMem | NcValue | NcJump),
+            .filter_fn = should_schedule,
+            .visit_post_fn = schedule_post_order,
+        },
+        .uses_v = {
+            .visit_op_fn = (VisitOpFn) record_use,
+        },
         .cfg = cfg,
-        .scheduled = shd_new_dict(const Node*, CFNode*, (HashFn) shd_hash_node, (CmpFn) shd_compare_node),
+        .early = shd_new_node_map(CFNode*),
+        .late = shd_new_node_map(CFNode*),
+        .placement = shd_new_node_map(CFNode*),
+        .sink_only = shd_new_node_set(),
+        .order = shd_new_list(const Node*),
+        .loop_depth = calloc(sizeof(int), cfg->size),
     };
+
+    compute_loop_depths(s, lt);
+    // mem chains can be very long, so the dependencies are walked with an explicit stack rather than recursively
+    for (size_t i = 0; i < cfg->size; i++) {
+        const Node* abs = cfg->rpo[i]->node;
+        if (abs && get_abstraction_body(abs))
+            shd_visit_iteratively(&s->iv, shd_singleton(get_abstraction_body(abs)));
+    }
+    place_nodes(s);
+
+    shd_destroy_list(s->order);
+    s->order = NULL;
+    shd_destroy_node_map(s->late);
+    s->late = NULL;
     return s;
 }
 
 CFNode* schedule_instruction(Scheduler* s, const Node* n) {
     //assert(n && is_instruction(n));
-    CFNode** found = shd_dict_find_value(const Node*, CFNode*, s->scheduled, n);
+    CFNode** found = shd_node_map_find(CFNode*, s->placement, n);
     if (found)
         return *found;
 
-    Scheduler s2 = *s;
-    s2.result = NULL;
-
-    if (n->tag == Param_TAG) {
-        schedule_after(&s2.result, cfg_lookup(s->cfg, n->payload.param.abs));
-    } else if (n->tag == BasicBlock_TAG) {
-        schedule_after(&s2.result, cfg_lookup(s->cfg, n));
-    } else if (n->tag == AbsMem_TAG) {
-        schedule_after(&s2.result, cfg_lookup(s->cfg, n->payload.abs_mem.abs));
-    }
-
-    shd_visit_node_operands(&s2.v, 0, n);
-    shd_dict_insert(const Node*, CFNode*, s->scheduled, n, s2.result);
-    return s2.result;
+    // nothing in the CFG uses this, so there is no later block to pick than the earliest one
+    found = shd_node_map_find(CFNode*, s->early, n);
+    if (found)
+        return *found;
+    shd_visit_iteratively(&s->iv, (Nodes) { .count = 1, .nodes = &n });
+    found = shd_node_map_find(CFNode*, s->early, n);
+    assert(found);
+    return *found;
 }
 
 void destroy_scheduler(Scheduler* s) {
-    shd_destroy_dict(s->scheduled);
+    shd_destroy_node_map(s->early);
+    shd_destroy_node_map(s->placement);
+    shd_destroy_node_map(s->sink_only);
+    free(s->loop_depth);
     free(s);
 }
@@ -3,10 +3,13 @@
 
 #include "shady/ir.h"
 #include "cfg.h"
+#include "looptree.h"
 
 typedef struct Scheduler_ Scheduler;
 
 Scheduler* new_scheduler(CFG*);
+/// Same as @ref new_scheduler, with the loop tree of the CFG provided rather than built and thrown away
+Scheduler* new_scheduler_with_loop_tree(CFG*, LoopTree*);
 void destroy_scheduler(Scheduler*);
 
 /// Returns the CFNode where that instruction should be placed, or NULL if it can be computed at the top-level
@@ -1,5 +1,7 @@
 #include "uses.h"
 
+#include "../node_map.h"
+
 #include "log.h"
 
 #include "shady/visit.h"
@@ -8,82 +10,63 @@
 #include <assert.h>
 #include <string.h>
 
-KeyHash shd_hash_node(Node** pnode);
-bool shd_compare_node(Node** pa, Node** pb);
-
 struct UsesMap_ {
-    struct Dict* map;
+    NodeMap* map;
     Arena* a;
 };
 
+/// The uses of one node. Keeping the tail and the count around makes appending a use constant time.
+typedef struct {
+    const Use* first;
+    Use* last;
+    size_t count;
+} NodeUses;
+
 typedef struct {
-    Visitor v;
+    IterativeVisitor v;
     UsesMap* map;
-    NodeClass exclude;
-    struct Dict* seen;
-    const Node* user;
 } UsesMapVisitor;
 
-static Use* get_last_use(UsesMap* map, const Node* n) {
-    Use* use = (Use*) get_first_use(map, n);
-    if (!use)
-        return NULL;
-    while (use->next_use)
-        use = (Use*) use->next_use;
-    assert(use);
-    return use;
-}
-
-static void uses_visit_node(UsesMapVisitor* v, const Node* n) {
-    if (!shd_dict_find_key(const Node*, v->seen, n)) {
-        shd_set_insert_get_result(const Node*, v->seen, n);
-        UsesMapVisitor nv = *v;
-        nv.user = n;
-        shd_visit_node_operands(&nv.v, v->exclude, n);
-    }
-}
-
-static void uses_visit_op(UsesMapVisitor* v, NodeClass class, String op_name, const Node* op, size_t i) {
-    Use* use = shd_arena_alloc(v->map->a, sizeof(Use));
-    memset(use, 0, sizeof(Use));
+static void uses_visit_edge(UsesMapVisitor* v, const Node* user, NodeClass class, String op_name, const Node* op, size_t i) {
+    Use* use = shd_arena_alloc_uninit(v->map->a, sizeof(Use));
     *use = (Use) {
-        .user = v->user,
+        .user = user,
         .operand_class = class,
         .operand_name = op_name,
         .operand_index = i,
         .next_use = NULL,
     };
 
-    Use* last_use = get_last_use(v->map, op);
-    if (last_use)
-        last_use->next_use = use;
-    else
-        shd_dict_insert(const Node*, const Use*, v->map->map, op, use);
-
-    uses_visit_node(v, op);
+    NodeUses* uses = shd_node_map_find(NodeUses, v->map->map, op);
+    if (uses) {
+        uses->last->next_use = use;
+        uses->last = use;
+        uses->count++;
+    } else {
+        NodeUses new_uses = { .first = use, .last = use, .count = 1 };
+        shd_node_map_insert(NodeUses, v->map->map, op, new_uses);
+    }
 }
 
 static const UsesMap* create_uses_map_(const Node* root, const Module* m, NodeClass exclude) {
     UsesMap* uses = calloc(sizeof(UsesMap), 1);
     *uses = (UsesMap) {
-        .map = shd_new_dict(const Node*, Use*, (HashFn) shd_hash_node, (CmpFn) shd_compare_node),
+        .map = shd_new_node_map(NodeUses),
         .a = shd_new_arena(),
     };
 
     UsesMapVisitor v = {
-        .v = { .visit_op_fn = (VisitOpFn) uses_visit_op },
+        .v = {
+            .exclude = exclude,
+            .visit_edge_fn = (IterativeVisitEdgeFn) uses_visit_edge,
+        },
         .map = uses,
-        .exclude = exclude,
-        .seen = shd_new_set(const Node*, (HashFn) shd_hash_node, (CmpFn) shd_compare_node),
     };
+    // the mem chains of big blocks are too long to recurse over
     if (root)
-        uses_visit_node(&v, root);
-    if (m) {
-        Nodes nodes = shd_module_get_declarations(m);
-        for (size_t i = 0; i < nodes.count; i++)
-            uses_visit_node(&v, nodes.nodes[i]);
-    }
-    shd_destroy_dict(v.seen);
+        shd_visit_iteratively(&v.v, shd_singleton(root));
+    if (m)
+        shd_visit_iteratively(&v.v, shd_module_get_declarations(m));
     return uses;
 }
 
@@ -97,13 +80,20 @@ const UsesMap* create_module_uses_map(const Module* m, NodeClass exclude) {
 
 void destroy_uses_map(const UsesMap* map) {
     shd_destroy_arena(map->a);
-    shd_destroy_dict(map->map);
+    shd_destroy_node_map(map->map);
     free((void*) map);
 }
 
 const Use* get_first_use(const UsesMap* map, const Node* n) {
-    const Use** found = shd_dict_find_value(const Node*, const Use*, map->map, n);
+    const NodeUses* found = shd_node_map_find(NodeUses, map->map, n);
     if (found)
-        return *found;
+        return found->first;
     return NULL;
+}
+
+size_t get_uses_count(const UsesMap* map, const Node* n) {
+    const NodeUses* found = shd_node_map_find(NodeUses, map->map, n);
+    if (found)
+        return found->count;
+    return 0;
 }
\ No newline at end of file
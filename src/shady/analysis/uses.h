@@ -23,5 +23,6 @@ struct Use_ {
 };
 
 const Use* get_first_use(const UsesMap*, const Node*);
+size_t get_uses_count(const UsesMap*, const Node*);
 
 #endif
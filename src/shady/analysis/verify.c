@@ -1,6 +1,7 @@
 #include "verify.h"
 #include "free_frontier.h"
 #include "cfg.h"
+#include "manager.h"
 
 #include "log.h"
 #include "dict.h"
@@ -8,14 +9,21 @@
 
 #include "shady/visit.h"
 #include "../ir_private.h"
+#include "../node_map.h"
 #include "../type.h"
 
+#include "arena.h"
+
+#include <stdlib.h>
+#include <stddef.h>
 #include <assert.h>
 
 typedef struct {
     Visitor visitor;
     const IrArena* arena;
     struct Dict* once;
+    /// Set when the contents of functions are checked while fingerprinting them instead
+    bool skip_functions;
 } ArenaVerifyVisitor;
 
 static void visit_verify_same_arena(ArenaVerifyVisitor* visitor, const Node* node) {
@@ -23,52 +31,161 @@ static void visit_verify_same_arena(ArenaVerifyVisitor* visitor, const Node* nod
     if (shd_dict_find_key(const Node*, visitor->once, node))
         return;
     shd_set_insert_get_result(const Node*, visitor->once, node);
+    if (visitor->skip_functions && node->tag == Function_TAG)
+        return;
     shd_visit_node_operands(&visitor->visitor, 0, node);
 }
 
 KeyHash shd_hash_node(const Node**);
 bool shd_compare_node(const Node**, const Node**);
 
-static void verify_same_arena(Module* mod) {
+static void verify_same_arena(Module* mod, bool skip_functions) {
     const IrArena* arena = shd_module_get_arena(mod);
     ArenaVerifyVisitor visitor = {
         .visitor = {
             .visit_node_fn = (VisitNodeFn) visit_verify_same_arena,
         },
         .arena = arena,
-        .once = shd_new_set(const Node*, (HashFn) shd_hash_node, (CmpFn) shd_compare_node)
+        .once = shd_new_set(const Node*, (HashFn) shd_hash_node, (CmpFn) shd_compare_node),
+        .skip_functions = skip_functions,
     };
     shd_visit_module(&visitor.visitor, mod);
     shd_destroy_dict(visitor.once);
 }
 
-static void verify_scoping(const CompilerConfig* config, Module* mod) {
-    struct List* cfgs = build_cfgs(mod, structured_scope_cfg_build());
-    for (size_t i = 0; i < shd_list_count(cfgs); i++) {
-        CFG* cfg = shd_read_list(CFG*, cfgs)[i];
-        Scheduler* scheduler = new_scheduler(cfg);
-        struct Dict* set = free_frontier(scheduler, cfg, cfg->entry->node);
-        if (shd_dict_count(set) > 0) {
-            shd_log_fmt(ERROR, "Leaking variables in ");
-            shd_log_node(ERROR, cfg->entry->node);
-            shd_log_fmt(ERROR, ":\n");
-
-            size_t j = 0;
-            const Node* leaking;
-            while (shd_dict_iter(set, &j, &leaking, NULL)) {
-                shd_log_node(ERROR, leaking);
-                shd_error_print("\n");
-            }
+KeyHash _shd_hash_node_pod_payload(const Node* node);
+KeyHash shd_hash_string(const char** string);
 
-            shd_log_fmt(ERROR, "Problematic module:\n");
-            shd_log_module(ERROR, config, mod);
-            shd_error_die();
+/// Structural hash of everything a function contains, that does not depend on which arena it lives in.
+/// Nominal nodes stand for the order in which the traversal first reaches them, declarations for their name.
+/// Since the traversal order only depends on the structure, two copies of a function get the same fingerprint, as long
+/// as their arenas are configured the same.
+typedef struct {
+    IterativeVisitor iv;
+    Visitor operands;
+    const IrArena* arena;
+    /// Node -> uint64_t
+    NodeMap* refs;
+    size_t nominal_count;
+    uint64_t current;
+    uint64_t fingerprint;
+} Fingerprinter;
+
+#define FINGERPRINTER_FROM_ITERATIVE_VISITOR(v) ((Fingerprinter*) ((char*) (v) - offsetof(Fingerprinter, iv)))
+#define FINGERPRINTER_FROM_OPERANDS_VISITOR(v) ((Fingerprinter*) ((char*) (v) - offsetof(Fingerprinter, operands)))
+
+static uint64_t mix_fingerprint(uint64_t h, uint64_t v) {
+    h ^= v + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+    return h;
+}
+
+static bool fingerprint_filter(IterativeVisitor* iv, const Node* node) {
+    Fingerprinter* f = FINGERPRINTER_FROM_ITERATIVE_VISITOR(iv);
+    assert(f->arena == node->arena);
+    if (shd_is_node_nominal(node)) {
+        uint64_t ref = mix_fingerprint(node->tag, ++f->nominal_count);
+        shd_node_map_insert(uint64_t, f->refs, node, ref);
+    }
+    return true;
+}
+
+static void fingerprint_operand(Visitor* v, NodeClass class, String name, const Node* op, size_t i) {
+    Fingerprinter* f = FINGERPRINTER_FROM_OPERANDS_VISITOR(v);
+    assert(f->arena == op->arena);
+    // hashed by contents, the same literal can have several addresses (ie if visitors are linked in twice)
+    uint64_t h = mix_fingerprint(mix_fingerprint(class, shd_hash_string(&name)), i);
+    uint64_t* ref = shd_node_map_find(uint64_t, f->refs, op);
+    if (ref) {
+        h = mix_fingerprint(h, *ref);
+    } else if (is_declaration(op)) {
+        String decl_name = get_declaration_name(op);
+        h = mix_fingerprint(h, shd_hash_string(&decl_name));
+    } else {
+        // still being expanded, only reachable through a cycle, so the traversal order already accounts for it
+        h = mix_fingerprint(h, op->tag);
+    }
+    f->current = mix_fingerprint(f->current, h);
+}
+
+static void fingerprint_post(IterativeVisitor* iv, const Node* node) {
+    Fingerprinter* f = FINGERPRINTER_FROM_ITERATIVE_VISITOR(iv);
+    f->current = mix_fingerprint(node->tag, _shd_hash_node_pod_payload(node));
+    shd_visit_node_operands(&f->operands, 0, node);
+    if (shd_is_node_nominal(node)) {
+        uint64_t ref = *shd_node_map_find(uint64_t, f->refs, node);
+        f->fingerprint = mix_fingerprint(f->fingerprint, mix_fingerprint(ref, f->current));
+    } else
+        shd_node_map_insert(uint64_t, f->refs, node, f->current);
+}
+
+/// What verification finds depends on how the arena types and folds things, not just on the nodes
+static uint64_t fingerprint_arena_config(const ArenaConfig* config) {
+    uint64_t h = 0;
+    h = mix_fingerprint(h, config->name_bound);
+    h = mix_fingerprint(h, config->check_op_classes);
+    h = mix_fingerprint(h, config->check_types);
+    h = mix_fingerprint(h, config->allow_fold);
+    h = mix_fingerprint(h, config->validate_builtin_types);
+    h = mix_fingerprint(h, config->is_simt);
+    for (size_t i = 0; i < NumAddressSpaces; i++) {
+        h = mix_fingerprint(h, config->address_spaces[i].physical);
+        h = mix_fingerprint(h, config->address_spaces[i].allowed);
+    }
+    h = mix_fingerprint(h, config->specializations.subgroup_mask_representation);
+    for (size_t i = 0; i < 3; i++)
+        h = mix_fingerprint(h, config->specializations.workgroup_size[i]);
+    h = mix_fingerprint(h, config->memory.ptr_size);
+    h = mix_fingerprint(h, config->memory.word_size);
+    h = mix_fingerprint(h, config->optimisations.inline_single_use_bbs);
+    h = mix_fingerprint(h, config->optimisations.fold_static_control_flow);
+    h = mix_fingerprint(h, config->optimisations.delete_unreachable_structured_cases);
+    h = mix_fingerprint(h, config->optimisations.weaken_non_leaking_allocas);
+    return h;
+}
+
+/// Also checks that everything in the function comes from its arena, like verify_same_arena does
+static uint64_t fingerprint_function(const Node* fn) {
+    Arena* scratch = shd_get_scratch_arena();
+    ArenaMark mark = shd_arena_mark(scratch);
+    Fingerprinter f = {
+        .iv = {
+            .exclude = NcDeclaration,
+            .filter_fn = fingerprint_filter,
+            .visit_post_fn = fingerprint_post,
+        },
+        .operands = {
+            .visit_op_fn = (VisitOpFn) fingerprint_operand,
+        },
+        .arena = fn->arena,
+        .refs = shd_new_node_map_in(uint64_t, scratch),
+        .fingerprint = fingerprint_arena_config(shd_get_arena_config(fn->arena)),
+    };
+    shd_visit_iteratively(&f.iv, shd_singleton(fn));
+    shd_arena_rewind(scratch, mark);
+    return f.fingerprint;
+}
+
+static void verify_fn_scoping(const CompilerConfig* config, Module* mod, const Node* fn) {
+    CFG* cfg = shd_get_cfg(fn, structured_scope_cfg_build());
+    Scheduler* scheduler = shd_get_scheduler(cfg);
+    struct Dict* set = free_frontier(scheduler, cfg, cfg->entry->node);
+    if (shd_dict_count(set) > 0) {
+        shd_log_fmt(ERROR, "Leaking variables in ");
+        shd_log_node(ERROR, cfg->entry->node);
+        shd_log_fmt(ERROR, ":\n");
+
+        size_t j = 0;
+        const Node* leaking;
+        while (shd_dict_iter(set, &j, &leaking, NULL)) {
+            shd_log_node(ERROR, leaking);
+            shd_error_print("\n");
         }
-        shd_destroy_dict(set);
-        destroy_scheduler(scheduler);
-        destroy_cfg(cfg);
+
+        shd_log_fmt(ERROR, "Problematic module:\n");
+        shd_log_module(ERROR, config, mod);
+        shd_error_die();
     }
-    shd_destroy_list(cfgs);
+    shd_destroy_dict(set);
 }
 
 static void verify_nominal_node(const Node* fn, const Node* n) {
@@ -135,35 +252,74 @@ static void verify_schedule_visitor(ScheduleContext* ctx, const Node* node) {
     shd_visit_node_operands(&ctx->visitor, NcTerminator | NcDeclaration, node);
 }
 
-static void verify_bodies(const CompilerConfig* config, Module* mod) {
-    struct List* cfgs = build_cfgs(mod, structured_scope_cfg_build());
-    for (size_t i = 0; i < shd_list_count(cfgs); i++) {
-        CFG* cfg = shd_read_list(CFG*, cfgs)[i];
-
-        for (size_t j = 0; j < cfg->size; j++) {
-            CFNode* n = cfg->rpo[j];
-            if (n->node->tag == BasicBlock_TAG) {
-                verify_nominal_node(cfg->entry->node, n->node);
-            }
+static void verify_fn_bodies(const Node* fn) {
+    CFG* cfg = shd_get_cfg(fn, structured_scope_cfg_build());
+    for (size_t j = 0; j < cfg->size; j++) {
+        CFNode* n = cfg->rpo[j];
+        if (n->node->tag == BasicBlock_TAG) {
+            verify_nominal_node(cfg->entry->node, n->node);
         }
-
-        destroy_cfg(cfg);
     }
-    shd_destroy_list(cfgs);
+}
 
+typedef struct VerifyCache_ {
+    /// Set of the fingerprints of the functions that passed verification
+    struct Dict* verified;
+} VerifyCache;
+
+static KeyHash hash_fingerprint(uint64_t* fingerprint) {
+    return shd_hash_murmur(fingerprint, sizeof(uint64_t));
+}
+
+static bool compare_fingerprints(uint64_t* a, uint64_t* b) {
+    return *a == *b;
+}
+
+VerifyCache* new_verify_cache(void) {
+    VerifyCache* cache = calloc(1, sizeof(VerifyCache));
+    cache->verified = shd_new_set(uint64_t, (HashFn) hash_fingerprint, (CmpFn) compare_fingerprints);
+    return cache;
+}
+
+void destroy_verify_cache(VerifyCache* cache) {
+    shd_destroy_dict(cache->verified);
+    free(cache);
+}
+
+static void verify_module_impl(const CompilerConfig* config, Module* mod, VerifyCache* cache) {
+    verify_same_arena(mod, cache != NULL);
+    // before we normalize the IR, scopes are broken because decls appear where they should not
+    // TODO add a normalized flag to the IR and check grammar is adhered to strictly
+    bool check_types = shd_module_get_arena(mod)->config.check_types;
     Nodes decls = shd_module_get_declarations(mod);
     for (size_t i = 0; i < decls.count; i++) {
         const Node* decl = decls.nodes[i];
-        verify_nominal_node(NULL, decl);
+        if (decl->tag != Function_TAG)
+            continue;
+        uint64_t fingerprint = 0;
+        if (cache) {
+            // always computed, as it's what checks the function's contents are in the right arena
+            fingerprint = fingerprint_function(decl);
+            if (!check_types || shd_dict_find_key(uint64_t, cache->verified, fingerprint))
+                continue;
+        } else if (!check_types)
+            continue;
+        verify_fn_scoping(config, mod, decl);
+        verify_fn_bodies(decl);
+        if (cache)
+            shd_set_insert_get_result(uint64_t, cache->verified, fingerprint);
+    }
+
+    if (check_types) {
+        for (size_t i = 0; i < decls.count; i++)
+            verify_nominal_node(NULL, decls.nodes[i]);
     }
 }
 
 void verify_module(const CompilerConfig* config, Module* mod) {
-    verify_same_arena(mod);
-    // before we normalize the IR, scopes are broken because decls appear where they should not
-    // TODO add a normalized flag to the IR and check grammar is adhered to strictly
-    if (shd_module_get_arena(mod)->config.check_types) {
-        verify_scoping(config, mod);
-        verify_bodies(config, mod);
-    }
+    verify_module_impl(config, mod, NULL);
+}
+
+void verify_module_incremental(const CompilerConfig* config, Module* mod, VerifyCache* cache) {
+    verify_module_impl(config, mod, cache);
 }
@@ -6,4 +6,12 @@
 typedef struct CompilerConfig_ CompilerConfig;
 void verify_module(const CompilerConfig*, Module*);
 
+/// Remembers which functions passed verification, by a structural fingerprint that survives the arena copy of a pass.
+typedef struct VerifyCache_ VerifyCache;
+VerifyCache* new_verify_cache(void);
+void destroy_verify_cache(VerifyCache*);
+
+/// Same checks as verify_module, but the per-function ones are skipped for functions identical to one already in @p cache.
+void verify_module_incremental(const CompilerConfig*, Module*, VerifyCache*);
+
 #endif
@@ -1,4 +1,5 @@
 #include "ir_private.h"
+#include "node_map.h"
 #include "log.h"
 #include "portability.h"
 
@@ -24,6 +25,62 @@ const Node* shd_lookup_annotation(const Node* decl, const char* name) {
     return search_annotations(decl, name, &i);
 }
 
+static String well_known_annotation_names[] = {
+    NULL,
+#define A(name) #name,
+    WELL_KNOWN_ANNOTATIONS(A)
+#undef A
+};
+
+static_assert(sizeof(well_known_annotation_names) / sizeof(String) <= 64, "Well-known annotations need to fit in a 64-bit mask");
+
+WellKnownAnnotation shd_well_known_annotation_from_string(const char* string) {
+#define A(n) if (strcmp(string, #n) == 0) return Ann##n;
+    WELL_KNOWN_ANNOTATIONS(A)
+#undef A
+    return AnnNone;
+}
+
+String shd_get_well_known_annotation_name(WellKnownAnnotation a) {
+    return well_known_annotation_names[a];
+}
+
+static uint64_t get_annotation_mask(const Node* decl) {
+    IrArena* arena = decl->arena;
+    Nodes annotations = get_declaration_annotations(decl);
+    _shd_lock_ir_arena(arena);
+    AnnotationMask* cached = shd_node_map_find(AnnotationMask, arena->annotation_masks, decl);
+    if (cached && cached->annotations == annotations.nodes && cached->count == annotations.count) {
+        uint64_t mask = cached->mask;
+        _shd_unlock_ir_arena(arena);
+        return mask;
+    }
+    _shd_unlock_ir_arena(arena);
+
+    AnnotationMask new = {
+        .annotations = annotations.nodes,
+        .count = annotations.count,
+        .mask = 0,
+    };
+    for (size_t i = 0; i < annotations.count; i++) {
+        WellKnownAnnotation a = shd_well_known_annotation_from_string(get_annotation_name(annotations.nodes[i]));
+        if (a != AnnNone)
+            new.mask |= 1ull << a;
+    }
+    _shd_lock_ir_arena(arena);
+    shd_node_map_insert(AnnotationMask, arena->annotation_masks, decl, new);
+    _shd_unlock_ir_arena(arena);
+    return new.mask;
+}
+
+const Node* shd_lookup_well_known_annotation(const Node* decl, WellKnownAnnotation a) {
+    assert(decl && a != AnnNone);
+    if (!(get_annotation_mask(decl) & (1ull << a)))
+        return NULL;
+    size_t i = 0;
+    return search_annotations(decl, well_known_annotation_names[a], &i);
+}
+
 const Node* shd_lookup_annotation_list(Nodes annotations, const char* name) {
     for (size_t i = 0; i < annotations.count; i++) {
         if (strcmp(get_annotation_name(annotations.nodes[i]), name) == 0) {
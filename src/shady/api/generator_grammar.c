@@ -56,6 +56,7 @@ static void generate_node_type(Growy* g, json_object* nodes) {
     shd_growy_append_formatted(g, "struct Node_ {\n");
     shd_growy_append_formatted(g, "\tIrArena* arena;\n");
     shd_growy_append_formatted(g, "\tNodeId id;\n");
+    shd_growy_append_formatted(g, "\tuint32_t hash;\n");
     shd_growy_append_formatted(g, "\tconst Type* type;\n");
     shd_growy_append_formatted(g, "\tNodeTag tag;\n");
     shd_growy_append_formatted(g, "\tunion NodesUnion {\n");
@@ -68,7 +68,7 @@ Builtin shd_get_builtin_by_spv_id(SpvBuiltIn id) {
 }
 
 Builtin shd_get_decl_builtin(const Node* decl) {
-    const Node* a = shd_lookup_annotation(decl, "Builtin");
+    const Node* a = shd_lookup_well_known_annotation(decl, AnnBuiltin);
     if (!a)
         return BuiltinsCount;
     String payload = shd_get_annotation_string_payload(a);
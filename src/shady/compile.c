@@ -1,6 +1,7 @@
 #include "ir_private.h"
 #include "shady/driver.h"
 #include "shady/ir.h"
+#include "shady/visit.h"
 
 #include "passes/passes.h"
 #include "analysis/verify.h"
@@ -11,14 +12,68 @@
 
 #include "util.h"
 #include "log.h"
+#include "list.h"
+#include "growy.h"
+#include "portability.h"
+#include "threading.h"
 
 #include <stdbool.h>
+#include <stdlib.h>
+
+typedef struct {
+    const char* src;
+    TargetConfig target;
+    bool cleanup;
+    size_t size;
+    char* data;
+} BuiltinModuleBinary;
+
+/// Binary form of the embedded slim modules parsed so far on this thread, until shd_destroy_compiler_thread_caches.
+/// The front-end output only depends on the source and the target, so there is no need to parse them on every compilation.
+static SHADY_THREAD_LOCAL struct List* builtin_modules = NULL;
+
+static bool same_target(const TargetConfig* a, const TargetConfig* b) {
+    return a->memory.ptr_size == b->memory.ptr_size && a->memory.word_size == b->memory.word_size;
+}
+
+static Module* load_builtin_module(const CompilerConfig* config, const char* src, String name) {
+    if (!builtin_modules)
+        builtin_modules = shd_new_list(BuiltinModuleBinary);
+    bool cleanup = config->optimisations.cleanup.after_every_pass;
+    for (size_t i = 0; i < shd_list_count(builtin_modules); i++) {
+        BuiltinModuleBinary* entry = &shd_read_list(BuiltinModuleBinary, builtin_modules)[i];
+        if (entry->src == src && entry->cleanup == cleanup && same_target(&entry->target, &config->target)) {
+            Module* m = shd_deserialize_module(entry->size, entry->data, name);
+            assert(m);
+            return m;
+        }
+    }
 
-static void add_scheduler_source(const CompilerConfig* config, Module* dst) {
     SlimParserConfig pconfig = {
         .front_end = true,
     };
-    Module* builtin_scheduler_mod = shd_parse_slim_module(config, &pconfig, shady_scheduler_src, "builtin_scheduler");
+    Module* m = shd_parse_slim_module(config, &pconfig, src, name);
+    BuiltinModuleBinary entry = {
+        .src = src,
+        .target = config->target,
+        .cleanup = cleanup,
+    };
+    shd_serialize_module(m, &entry.size, &entry.data);
+    shd_list_append(BuiltinModuleBinary, builtin_modules, entry);
+    return m;
+}
+
+void shd_destroy_compiler_thread_caches(void) {
+    if (!builtin_modules)
+        return;
+    for (size_t i = 0; i < shd_list_count(builtin_modules); i++)
+        free(shd_read_list(BuiltinModuleBinary, builtin_modules)[i].data);
+    shd_destroy_list(builtin_modules);
+    builtin_modules = NULL;
+}
+
+static void add_scheduler_source(const CompilerConfig* config, Module* dst) {
+    Module* builtin_scheduler_mod = load_builtin_module(config, shady_scheduler_src, "builtin_scheduler");
     shd_debug_print("Adding builtin scheduler code");
     shd_module_link(dst, builtin_scheduler_mod);
     shd_destroy_ir_arena(shd_module_get_arena(builtin_scheduler_mod));
@@ -30,43 +85,252 @@ static void add_scheduler_source(const CompilerConfig* config, Module* dst) {
 #define SHADY_RUN_VERIFY 1
 #endif
 
+typedef struct {
+    String pass_name;
+    uint64_t pass_ns;
+    uint64_t verify_ns;
+    uint64_t cleanup_ns;
+    size_t cleanup_rounds;
+    IrArenaStats before;
+    IrArenaStats after;
+    /// node_set lookups made by the pass and its cleanup, across all the arenas involved, including the copies they
+    /// made and destroyed along the way
+    size_t node_lookups;
+    size_t node_hits;
+} PassStats;
+
+/// Collects the statistics of every pass while shd_run_compiler_passes is running, if they are enabled
+static SHADY_THREAD_LOCAL struct List* pass_stats_log = NULL;
+
+/// Functions already verified while shd_run_compiler_passes is running, most passes leave most functions unchanged
+static SHADY_THREAD_LOCAL VerifyCache* verify_cache = NULL;
+
+static void run_verify(const CompilerConfig* config, Module* mod) {
+    if (verify_cache)
+        verify_module_incremental(config, mod, verify_cache);
+    else
+        verify_module(config, mod);
+}
+
+static SHADY_THREAD_LOCAL ThreadPool* pass_thread_pool = NULL;
+
+ThreadPool* shd_get_pass_thread_pool(void) {
+    return pass_thread_pool;
+}
+
+/// Arena of the module the current pass reads from, if passes may rewrite into it directly (ie it isn't the caller's)
+static SHADY_THREAD_LOCAL IrArena* in_place_arena = NULL;
+
+bool shd_is_pass_owned_module(Module* m) {
+    return in_place_arena && shd_module_get_arena(m) == in_place_arena;
+}
+
+IrArena* shd_get_pass_dst_arena(const CompilerConfig* config, Module* src) {
+    IrArena* a = shd_module_get_arena(src);
+    if (config->optimisations.in_place.enabled && shd_is_pass_owned_module(src))
+        return a;
+    ArenaConfig aconfig = *shd_get_arena_config(a);
+    return shd_new_ir_arena(&aconfig);
+}
+
+typedef struct {
+    IterativeVisitor visitor;
+    size_t count;
+} LiveNodesCounter;
+
+static void count_live_node(LiveNodesCounter* counter, SHADY_UNUSED const Node* node) {
+    counter->count++;
+}
+
+Module* shd_compact_module(const CompilerConfig* config, Module* src) {
+    IrArena* a = shd_module_get_arena(src);
+    if (!shd_is_pass_owned_module(src))
+        return shd_import(config, src);
+
+    LiveNodesCounter counter = {
+        .visitor = { .visit_post_fn = (IterativeVisitNodeFn) count_live_node },
+    };
+    shd_visit_iteratively(&counter.visitor, shd_module_get_declarations(src));
+    size_t total = _shd_get_ir_arena_stats(a).nodes_count;
+    if (total == 0 || counter.count >= total)
+        return src;
+    double dead = (double) (total - counter.count) / (double) total;
+    if (dead < config->optimisations.in_place.compaction_threshold)
+        return src;
+    shd_debugv_print("Compacting arena: %zu out of %zu nodes are dead\n", total - counter.count, total);
+    return shd_import(config, src);
+}
+
+/// @p destroyed_before is _shd_get_destroyed_ir_arenas_stats from when @p src_before was taken, @p src must not have
+/// been destroyed since then
+static void count_node_lookups(PassStats* stats, IrArena* src, IrArenaStats src_before, IrArenaStats destroyed_before, IrArena* dst) {
+    IrArenaStats src_after = _shd_get_ir_arena_stats(src);
+    stats->node_lookups += src_after.node_lookups - src_before.node_lookups;
+    stats->node_hits += src_after.node_hits - src_before.node_hits;
+    IrArenaStats destroyed_after = _shd_get_destroyed_ir_arenas_stats();
+    stats->node_lookups += destroyed_after.node_lookups - destroyed_before.node_lookups;
+    stats->node_hits += destroyed_after.node_hits - destroyed_before.node_hits;
+    if (dst != src) {
+        IrArenaStats dst_after = _shd_get_ir_arena_stats(dst);
+        stats->node_lookups += dst_after.node_lookups;
+        stats->node_hits += dst_after.node_hits;
+    }
+}
+
+static double ns_to_ms(uint64_t ns) {
+    return (double) ns / 1000000.0;
+}
+
+static void print_pass_stats_header(void) {
+    shd_error_print("%-40s %10s %10s %10s %6s %10s %10s %10s %10s %7s\n", "pass", "pass ms", "verify ms", "cleanup ms", "rounds", "nodes in", "nodes out", "KiB in", "KiB out", "hits %");
+}
+
+static void print_pass_stats(const PassStats* stats) {
+    double hit_rate = stats->node_lookups ? 100.0 * (double) stats->node_hits / (double) stats->node_lookups : 0.0;
+    shd_error_print("%-40s %10.3f %10.3f %10.3f %6zu %10zu %10zu %10zu %10zu %7.2f\n", stats->pass_name,
+                    ns_to_ms(stats->pass_ns), ns_to_ms(stats->verify_ns), ns_to_ms(stats->cleanup_ns), stats->cleanup_rounds,
+                    stats->before.nodes_count, stats->after.nodes_count, stats->before.bytes / 1024, stats->after.bytes / 1024, hit_rate);
+}
+
+static void record_pass_stats(const PassStats* stats) {
+    // passes run outside of shd_run_compiler_passes (ie by the emitters) just get reported straight away
+    if (!pass_stats_log) {
+        print_pass_stats_header();
+        print_pass_stats(stats);
+        return;
+    }
+    shd_list_append(PassStats, pass_stats_log, *stats);
+}
+
+static void write_pass_stats_json(String filename, struct List* log) {
+    Growy* g = shd_new_growy();
+    shd_growy_append_formatted(g, "[\n");
+    for (size_t i = 0; i < shd_list_count(log); i++) {
+        PassStats stats = shd_read_list(PassStats, log)[i];
+        shd_growy_append_formatted(g, "  { \"pass\": \"%s\", \"pass_ms\": %f, \"verify_ms\": %f, \"cleanup_ms\": %f, \"cleanup_rounds\": %zu, "
+                                      "\"nodes_before\": %zu, \"nodes_after\": %zu, \"bytes_before\": %zu, \"bytes_after\": %zu, "
+                                      "\"node_set_lookups\": %zu, \"node_set_hits\": %zu }%s\n",
+                                   stats.pass_name, ns_to_ms(stats.pass_ns), ns_to_ms(stats.verify_ns), ns_to_ms(stats.cleanup_ns), stats.cleanup_rounds,
+                                   stats.before.nodes_count, stats.after.nodes_count, stats.before.bytes, stats.after.bytes,
+                                   stats.node_lookups, stats.node_hits, i + 1 < shd_list_count(log) ? "," : "");
+    }
+    shd_growy_append_formatted(g, "]\n");
+    if (!shd_write_file(filename, shd_growy_size(g), shd_growy_data(g)))
+        shd_error_print("Failed to write pass statistics to '%s'\n", filename);
+    shd_destroy_growy(g);
+}
+
+static void report_pass_stats(const CompilerConfig* config, struct List* log) {
+    PassStats total = { .pass_name = "total" };
+    print_pass_stats_header();
+    for (size_t i = 0; i < shd_list_count(log); i++) {
+        PassStats stats = shd_read_list(PassStats, log)[i];
+        print_pass_stats(&stats);
+        if (i == 0)
+            total.before = stats.before;
+        total.after = stats.after;
+        total.pass_ns += stats.pass_ns;
+        total.verify_ns += stats.verify_ns;
+        total.cleanup_ns += stats.cleanup_ns;
+        total.cleanup_rounds += stats.cleanup_rounds;
+        total.node_lookups += stats.node_lookups;
+        total.node_hits += stats.node_hits;
+    }
+    print_pass_stats(&total);
+    if (config->pass_stats.json_output)
+        write_pass_stats_json(config->pass_stats.json_output, log);
+}
+
 void shd_run_pass_impl(const CompilerConfig* config, Module** pmod, IrArena* initial_arena, RewritePass pass, String pass_name) {
+    bool record = config->pass_stats.enabled;
+    PassStats stats = { .pass_name = pass_name };
+    IrArena* old_arena = shd_module_get_arena(*pmod);
+    IrArenaStats destroyed_before = { 0 };
+    if (record) {
+        stats.before = _shd_get_ir_arena_stats(old_arena);
+        destroyed_before = _shd_get_destroyed_ir_arenas_stats();
+    }
+
+    // the module we were handed belongs to the caller, only the copies made since then can be mutated
+    IrArena* prev_in_place_arena = in_place_arena;
+    in_place_arena = old_arena != initial_arena ? old_arena : NULL;
+
+    uint64_t start = shd_get_time_nano();
     Module* old_mod = NULL;
     old_mod = *pmod;
     *pmod = pass(config, *pmod);
     (*pmod)->sealed = true;
+    if (record) {
+        stats.pass_ns = shd_get_time_nano() - start;
+        count_node_lookups(&stats, old_arena, stats.before, destroyed_before, shd_module_get_arena(*pmod));
+    }
     shd_debugvv_print("After pass %s: \n", pass_name);
-    if (SHADY_RUN_VERIFY)
-        verify_module(config, *pmod);
+    if (SHADY_RUN_VERIFY) {
+        start = shd_get_time_nano();
+        run_verify(config, *pmod);
+        stats.verify_ns += shd_get_time_nano() - start;
+    }
     if (shd_module_get_arena(old_mod) != shd_module_get_arena(*pmod) && shd_module_get_arena(old_mod) != initial_arena)
         shd_destroy_ir_arena(shd_module_get_arena(old_mod));
     old_mod = *pmod;
-    if (config->optimisations.cleanup.after_every_pass)
-        *pmod = shd_cleanup(config, *pmod);
+    // cleanup and compaction work on what the pass produced, which is ours unless the pass returned its input untouched
+    in_place_arena = shd_module_get_arena(*pmod) != initial_arena ? shd_module_get_arena(*pmod) : NULL;
+    if (config->optimisations.cleanup.after_every_pass) {
+        IrArena* pass_arena = shd_module_get_arena(*pmod);
+        IrArenaStats pass_arena_stats = record ? _shd_get_ir_arena_stats(pass_arena) : (IrArenaStats) { 0 };
+        destroyed_before = _shd_get_destroyed_ir_arenas_stats();
+        start = shd_get_time_nano();
+        *pmod = shd_cleanup_count_rounds(config, *pmod, &stats.cleanup_rounds);
+        if (record) {
+            stats.cleanup_ns = shd_get_time_nano() - start;
+            count_node_lookups(&stats, pass_arena, pass_arena_stats, destroyed_before, shd_module_get_arena(*pmod));
+        }
+    } else if (config->optimisations.in_place.enabled && in_place_arena) {
+        *pmod = shd_compact_module(config, *pmod);
+    }
+    in_place_arena = prev_in_place_arena;
     shd_log_module(DEBUGVV, config, *pmod);
-    if (SHADY_RUN_VERIFY)
-        verify_module(config, *pmod);
+    if (SHADY_RUN_VERIFY) {
+        start = shd_get_time_nano();
+        run_verify(config, *pmod);
+        stats.verify_ns += shd_get_time_nano() - start;
+    }
+    if (record) {
+        stats.after = _shd_get_ir_arena_stats(shd_module_get_arena(*pmod));
+        record_pass_stats(&stats);
+    }
     if (shd_module_get_arena(old_mod) != shd_module_get_arena(*pmod) && shd_module_get_arena(old_mod) != initial_arena)
         shd_destroy_ir_arena(shd_module_get_arena(old_mod));
     if (config->hooks.after_pass.fn)
         config->hooks.after_pass.fn(config->hooks.after_pass.uptr, pass_name, *pmod);
 }
 
-void shd_apply_opt_impl(const CompilerConfig* config, bool* todo, Module** m, OptPass pass, String pass_name) {
-    bool changed = pass(config, m);
+void shd_apply_opt_impl(const CompilerConfig* config, bool* todo, Module* m, Node* fn, OptPass pass, String pass_name) {
+    bool changed = pass(config, m, fn);
     *todo |= changed;
 
     if (getenv("SHADY_DUMP_CLEAN_ROUNDS") && changed) {
-        shd_log_fmt(DEBUGVV, "%s changed something:\n", pass_name);
-        shd_log_module(DEBUGVV, config, *m);
+        shd_log_fmt(DEBUGVV, "%s changed something in %s:\n", pass_name, shd_get_abstraction_name(fn));
+        shd_log_module(DEBUGVV, config, m);
     }
 }
 
 CompilationResult shd_run_compiler_passes(CompilerConfig* config, Module** pmod) {
     IrArena* initial_arena = (*pmod)->arena;
+    if (config->pass_stats.enabled)
+        pass_stats_log = shd_new_list(PassStats);
+    if (SHADY_RUN_VERIFY)
+        verify_cache = new_verify_cache();
+    // the threads are started once for all the passes, rather than by each one that can use them
+    bool own_thread_pool = false;
+    size_t threads_count = shd_get_hardware_concurrency();
+    if (!pass_thread_pool && shd_get_arena_config(initial_arena)->thread_safe && threads_count > 1) {
+        pass_thread_pool = shd_new_thread_pool(threads_count);
+        own_thread_pool = true;
+    }
 
-    // we don't want to mess with the original module
-    *pmod = shd_import(config, *pmod);
+    // we don't want to mess with the original module, and what isn't reachable would be carried through every pass
+    *pmod = shd_import_live_declarations(config, *pmod);
     shd_log_fmt(DEBUG, "After import:\n");
     shd_log_module(DEBUG, config, *pmod);
 
@@ -97,6 +361,7 @@ CompilationResult shd_run_compiler_passes(CompilerConfig* config, Module** pmod)
     RUN_PASS(shd_pass_lift_indirect_targets)
 
     RUN_PASS(shd_pass_specialize_execution_model)
+    RUN_PASS(shd_pass_eliminate_dead_declarations)
 
     //RUN_PASS(shd_pass_opt_stack)
 
@@ -138,6 +403,20 @@ CompilationResult shd_run_compiler_passes(CompilerConfig* config, Module** pmod)
 
     RUN_PASS(shd_pass_restructurize)
 
+    if (pass_stats_log) {
+        report_pass_stats(config, pass_stats_log);
+        shd_destroy_list(pass_stats_log);
+        pass_stats_log = NULL;
+    }
+    if (verify_cache) {
+        destroy_verify_cache(verify_cache);
+        verify_cache = NULL;
+    }
+    if (own_thread_pool) {
+        shd_destroy_thread_pool(pass_thread_pool);
+        pass_thread_pool = NULL;
+    }
+
     return CompilationNoError;
 }
 
@@ -0,0 +1,267 @@
+#include "shady/driver.h"
+#include "shady/ir/module.h"
+
+#include "portability.h"
+#include "growy.h"
+#include "util.h"
+#include "list.h"
+#include "log.h"
+
+// generated at build time from the sources of the compiler
+#include "compiler_version.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define CACHE_ENTRY_MAGIC 0x43444853u // 'SHDC'
+#define CACHE_ENTRY_VERSION 2
+#define CACHE_ENTRY_EXTENSION ".shdc"
+
+/// Followed by the full key, then the payload.
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key_hash;
+    uint64_t key_size;
+    uint64_t payload_size;
+} CacheEntryHeader;
+
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t size) {
+    const uint8_t* bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static void append_string(Growy* g, String str) {
+    // tell NULL and "" apart
+    uint8_t present = str != NULL;
+    shd_growy_append_object(g, present);
+    if (str)
+        shd_growy_append_bytes(g, strlen(str) + 1, str);
+}
+
+#define KEY_FIELD(f) shd_growy_append_bytes(g, sizeof(config->f), (const char*) &config->f)
+
+/// Only the fields that can change the output take part, field by field so padding doesn't get in the way.
+/// Logging, statistics and the cache settings themselves are left out on purpose. The ArenaConfig of the module comes in
+/// with its binary form, which writes it field by field too.
+static void append_compiler_config(Growy* g, const CompilerConfig* config) {
+    KEY_FIELD(dynamic_scheduling);
+    KEY_FIELD(per_thread_stack_size);
+    KEY_FIELD(target_spirv_version.major);
+    KEY_FIELD(target_spirv_version.minor);
+    KEY_FIELD(input_cf.restructure_with_heuristics);
+    KEY_FIELD(input_cf.add_scope_annotations);
+    KEY_FIELD(input_cf.has_scope_annotations);
+    KEY_FIELD(lower.emulate_generic_ptrs);
+    KEY_FIELD(lower.emulate_physical_memory);
+    KEY_FIELD(lower.emulate_subgroup_ops);
+    KEY_FIELD(lower.emulate_subgroup_ops_extended_types);
+    KEY_FIELD(lower.int64);
+    KEY_FIELD(lower.decay_ptrs);
+    KEY_FIELD(hacks.spv_shuffle_instead_of_broadcast_first);
+    KEY_FIELD(hacks.force_join_point_lifting);
+    KEY_FIELD(optimisations.cleanup.after_every_pass);
+    KEY_FIELD(optimisations.cleanup.delete_unused_instructions);
+    KEY_FIELD(optimisations.inline_everything);
+    KEY_FIELD(optimisations.in_place.enabled);
+    KEY_FIELD(optimisations.in_place.compaction_threshold);
+    KEY_FIELD(printf_trace.memory_accesses);
+    KEY_FIELD(printf_trace.stack_accesses);
+    KEY_FIELD(printf_trace.god_function);
+    KEY_FIELD(printf_trace.stack_size);
+    KEY_FIELD(printf_trace.subgroup_ops);
+    KEY_FIELD(shader_diagnostics.max_top_iterations);
+    append_string(g, config->specialization.entry_point);
+    KEY_FIELD(specialization.execution_model);
+    KEY_FIELD(specialization.subgroup_size);
+    KEY_FIELD(target.memory.ptr_size);
+    KEY_FIELD(target.memory.word_size);
+}
+
+#undef KEY_FIELD
+
+bool shd_is_compile_cache_enabled(const CompilerConfig* config) {
+    // an observer of the passes would not see them run on a hit
+    return config->cache.directory && !config->hooks.after_pass.fn;
+}
+
+CompileCacheKey shd_compile_cache_key(const CompilerConfig* config, Module* mod, String variant) {
+    // not worth serializing the module for
+    if (!shd_is_compile_cache_enabled(config))
+        return (CompileCacheKey) { 0 };
+
+    Growy* g = shd_new_growy();
+    append_string(g, SHADY_COMPILER_VERSION);
+    append_compiler_config(g, config);
+    append_string(g, variant);
+
+    // the binary form is deterministic and already carries the grammar hash, which makes it a good content address
+    size_t size;
+    char* data;
+    shd_serialize_module(mod, &size, &data);
+    shd_growy_append_bytes(g, size, data);
+    free(data);
+
+    CompileCacheKey key = {
+        .hash = hash_bytes(14695981039346656037ull, shd_growy_data(g), shd_growy_size(g)),
+        .size = shd_growy_size(g),
+    };
+    key.data = shd_growy_deconstruct(g);
+    return key;
+}
+
+void shd_destroy_compile_cache_key(CompileCacheKey key) {
+    free(key.data);
+}
+
+static String get_entry_filename(const CompilerConfig* config, CompileCacheKey key) {
+    return shd_format_string_new("%s/%016llx" CACHE_ENTRY_EXTENSION, config->cache.directory, (unsigned long long) key.hash);
+}
+
+bool shd_compile_cache_lookup(const CompilerConfig* config, CompileCacheKey key, size_t* size, char** output) {
+    if (!shd_is_compile_cache_enabled(config) || !key.data)
+        return false;
+
+    String filename = get_entry_filename(config, key);
+    size_t file_size;
+    const void* file_data;
+    bool found = shd_map_file(filename, &file_size, &file_data);
+    if (found) {
+        const char* bytes = file_data;
+        CacheEntryHeader header;
+        bool well_formed = file_size >= sizeof(header);
+        if (well_formed) {
+            memcpy(&header, bytes, sizeof(header));
+            well_formed = header.magic == CACHE_ENTRY_MAGIC && header.version == CACHE_ENTRY_VERSION && header.key_size <= file_size - sizeof(header) && header.payload_size == file_size - sizeof(header) - header.key_size;
+        }
+        // the entry might be for another key with the same hash
+        found = well_formed && header.key_hash == key.hash && header.key_size == key.size && memcmp(bytes + sizeof(header), key.data, key.size) == 0;
+        if (found) {
+            *size = (size_t) header.payload_size;
+            *output = malloc(*size);
+            memcpy(*output, bytes + sizeof(header) + header.key_size, *size);
+            // this is what keeps the entry from being evicted
+            shd_touch_file(filename);
+        }
+        shd_unmap_file(file_data, file_size);
+        if (!well_formed) {
+            shd_warn_print("Evicting malformed compile cache entry '%s'\n", filename);
+            remove(filename);
+        }
+    }
+    shd_debugv_print("Compile cache %s for %016llx\n", found ? "hit" : "miss", (unsigned long long) key.hash);
+    free((void*) filename);
+    return found;
+}
+
+void shd_compile_cache_evict(const CompilerConfig* config, CompileCacheKey key) {
+    if (!shd_is_compile_cache_enabled(config) || !key.data)
+        return;
+    String filename = get_entry_filename(config, key);
+    // it might not be there anymore, that's fine
+    if (remove(filename) == 0)
+        shd_debugv_print("Evicted compile cache entry '%s'\n", filename);
+    free((void*) filename);
+}
+
+typedef struct {
+    String name;
+    size_t size;
+    uint64_t last_modified;
+} CacheEntry;
+
+typedef struct {
+    struct List* entries;
+    size_t total_size;
+} CacheContents;
+
+static void collect_cache_entry(CacheContents* contents, const char* filename, size_t size, uint64_t last_modified) {
+    if (!shd_string_ends_with(filename, CACHE_ENTRY_EXTENSION))
+        return;
+    CacheEntry entry = {
+        .name = shd_format_string_new("%s", filename),
+        .size = size,
+        .last_modified = last_modified,
+    };
+    shd_list_append(CacheEntry, contents->entries, entry);
+    contents->total_size += size;
+}
+
+static int compare_cache_entries(const void* a, const void* b) {
+    uint64_t ta = ((const CacheEntry*) a)->last_modified;
+    uint64_t tb = ((const CacheEntry*) b)->last_modified;
+    return ta < tb ? -1 : ta > tb;
+}
+
+static void evict_cache_entries(const CompilerConfig* config) {
+    CacheContents contents = { .entries = shd_new_list(CacheEntry) };
+    if (!shd_list_files(config->cache.directory, (FileVisitFn) collect_cache_entry, &contents)) {
+        shd_destroy_list(contents.entries);
+        return;
+    }
+
+    size_t count = shd_list_count(contents.entries);
+    CacheEntry* entries = shd_read_list(CacheEntry, contents.entries);
+    if (contents.total_size > config->cache.max_size) {
+        qsort(entries, count, sizeof(CacheEntry), compare_cache_entries);
+        for (size_t i = 0; i < count && contents.total_size > config->cache.max_size; i++) {
+            String filename = shd_format_string_new("%s/%s", config->cache.directory, entries[i].name);
+            // another process might have gotten to it first, that's fine
+            if (remove(filename) == 0)
+                shd_debugv_print("Evicted compile cache entry '%s'\n", filename);
+            contents.total_size -= entries[i].size;
+            free((void*) filename);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++)
+        free((void*) entries[i].name);
+    shd_destroy_list(contents.entries);
+}
+
+void shd_compile_cache_store(const CompilerConfig* config, CompileCacheKey key, size_t size, const char* data) {
+    if (!shd_is_compile_cache_enabled(config) || !key.data)
+        return;
+
+    if (!shd_create_directory(config->cache.directory)) {
+        shd_warn_print("Could not create compile cache directory '%s'\n", config->cache.directory);
+        return;
+    }
+
+    CacheEntryHeader header = {
+        .magic = CACHE_ENTRY_MAGIC,
+        .version = CACHE_ENTRY_VERSION,
+        .key_hash = key.hash,
+        .key_size = key.size,
+        .payload_size = size,
+    };
+
+    // written under a unique name and then moved in place, so concurrent readers never see a partial entry
+    String filename = get_entry_filename(config, key);
+    String tmp_filename = shd_format_string_new("%s.%llx.tmp", filename, (unsigned long long) shd_get_time_nano());
+    FILE* f = fopen(tmp_filename, "wb");
+    bool ok = f != NULL;
+    if (ok) {
+        ok &= fwrite(&header, sizeof(header), 1, f) == 1;
+        ok &= fwrite(key.data, key.size, 1, f) == 1;
+        ok &= size == 0 || fwrite(data, size, 1, f) == 1;
+        ok &= fclose(f) == 0;
+    }
+    if (ok)
+        ok = shd_replace_file(tmp_filename, filename);
+    if (!ok) {
+        shd_warn_print("Could not write compile cache entry '%s'\n", filename);
+        remove(tmp_filename);
+    }
+    free((void*) tmp_filename);
+    free((void*) filename);
+
+    if (ok)
+        evict_cache_entries(config);
+}
@@ -0,0 +1,9 @@
+# Writes ${OUTPUT}, which defines SHADY_COMPILER_VERSION as a hash of the contents of every file listed in ${SOURCES_LIST}
+file(STRINGS ${SOURCES_LIST} SOURCES)
+set(HASHES "")
+foreach (SOURCE ${SOURCES})
+    file(SHA256 ${SOURCE} SOURCE_HASH)
+    string(APPEND HASHES "${SOURCE_HASH}\n")
+endforeach ()
+string(SHA256 VERSION "${HASHES}")
+file(WRITE ${OUTPUT} "#define SHADY_COMPILER_VERSION \"${VERSION}\"\n")
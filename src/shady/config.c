@@ -30,7 +30,10 @@ CompilerConfig shd_default_compiler_config(void) {
             .cleanup = {
                 .after_every_pass = true,
                 .delete_unused_instructions = true,
-            }
+            },
+            .in_place = {
+                .compaction_threshold = 0.5f,
+            },
         },
 
         /*.shader_diagnostics = {
@@ -43,6 +46,10 @@ CompilerConfig shd_default_compiler_config(void) {
 
         .target = shd_default_target_config(),
 
+        .cache = {
+            .max_size = 256 MiB,
+        },
+
         .specialization = {
             .subgroup_size = 8,
             .entry_point = NULL
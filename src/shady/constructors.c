@@ -5,6 +5,7 @@
 #include "portability.h"
 
 #include "dict.h"
+#include "threading.h"
 #include "shady/visit.h"
 
 #include <string.h>
@@ -19,6 +20,15 @@ const Node* _shd_fold_node_operand(NodeTag tag, NodeClass nc, String opname, con
 
 const Type* _shd_check_type_generated(IrArena* a, const Node* node);
 
+KeyHash _shd_hash_node_uncached(const Node* node);
+
+static void count_node_set_event(IrArena* arena, volatile uint32_t* counter) {
+    if (arena->concurrency)
+        shd_atomic_fetch_add_u32(counter, 1);
+    else
+        (*counter)++;
+}
+
 Node* _shd_create_node_helper(IrArena* arena, Node node, bool* pfresh) {
     pre_construction_validation(arena, &node);
     if (arena->config.check_types)
@@ -28,12 +38,20 @@ Node* _shd_create_node_helper(IrArena* arena, Node node, bool* pfresh) {
         *pfresh = false;
 
     Node* ptr = &node;
-    Node** found = shd_dict_find_key(Node*, arena->node_set, ptr);
-    // sanity check nominal nodes to be unique, check for duplicates in structural nodes
-    if (shd_is_node_nominal(&node))
-        assert(!found);
-    else if (found)
-        return *found;
+    // nominal nodes are hashed by address, so they can't be looked up before being placed in the arena
+    bool nominal = shd_is_node_nominal(&node);
+    if (!nominal) {
+        node.hash = _shd_hash_node_uncached(&node);
+        LockedIrArenaSet locked = _shd_lock_ir_arena_set(arena, IrArenaNodeSet, &ptr);
+        Node** found = shd_dict_find_key(Node*, locked.set, ptr);
+        Node* existing = found ? *found : NULL;
+        _shd_unlock_ir_arena_set(locked);
+        count_node_set_event(arena, &arena->node_lookups);
+        if (existing) {
+            count_node_set_event(arena, &arena->node_hits);
+            return existing;
+        }
+    }
 
     if (pfresh)
         *pfresh = true;
@@ -42,7 +60,9 @@ Node* _shd_create_node_helper(IrArena* arena, Node node, bool* pfresh) {
         Node* folded = (Node*) _shd_fold_node(arena, ptr);
         if (folded != ptr) {
             // The folding process simplified the node, we store a mapping to that simplified node and bail out !
-            shd_set_insert_get_result(Node*, arena->node_set, folded);
+            LockedIrArenaSet locked = _shd_lock_ir_arena_set(arena, IrArenaNodeSet, &folded);
+            shd_set_insert_get_result(Node*, locked.set, folded);
+            _shd_unlock_ir_arena_set(locked);
             return folded;
         }
     }
@@ -51,10 +71,32 @@ Node* _shd_create_node_helper(IrArena* arena, Node node, bool* pfresh) {
         assert(is_type(node.type));
 
     // place the node in the arena and return it
-    Node* alloc = (Node*) shd_arena_alloc(arena->arena, sizeof(Node));
+    Arena* allocator = _shd_get_ir_arena_allocator(arena);
+    ArenaMark mark = shd_arena_mark(allocator);
+    Node* alloc = (Node*) shd_arena_alloc(allocator, sizeof(Node));
     *alloc = node;
+    if (nominal)
+        alloc->hash = _shd_hash_node_uncached(alloc);
+
+    // the set was unlocked while folding, on thread-safe arenas another thread might have built the same node since
+    LockedIrArenaSet locked = _shd_lock_ir_arena_set(arena, IrArenaNodeSet, &alloc);
+    if (!nominal && arena->concurrency) {
+        Node** found = shd_dict_find_key(Node*, locked.set, alloc);
+        if (found) {
+            Node* existing = *found;
+            _shd_unlock_ir_arena_set(locked);
+            // we only allocated the node itself since the mark, and the allocator is private to this thread
+            shd_arena_rewind(allocator, mark);
+            if (pfresh)
+                *pfresh = false;
+            return existing;
+        }
+    }
     alloc->id = _shd_allocate_node_id(arena, alloc);
-    shd_set_insert_get_result(const Node*, arena->node_set, alloc);
+    bool inserted = shd_set_insert_get_result(const Node*, locked.set, alloc);
+    _shd_unlock_ir_arena_set(locked);
+    // sanity check nominal nodes to be unique
+    assert(inserted);
 
     return alloc;
 }
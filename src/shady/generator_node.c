@@ -57,7 +57,7 @@ static void generate_node_payload_hash_fn(Growy* g, json_object* src, json_objec
                 String op_name = json_object_get_string(json_object_object_get(op, "name"));
                 bool ignore = json_object_get_boolean(json_object_object_get(op, "ignore"));
                 if (!ignore) {
-                    shd_growy_append_formatted(g, "\t\thash = hash ^ shd_hash_murmur(&payload.%s, sizeof(payload.%s));\n", op_name, op_name);
+                    shd_growy_append_formatted(g, "\t\thash = shd_hash_combine(hash, shd_hash_murmur(&payload.%s, sizeof(payload.%s)));\n", op_name, op_name);
                 }
             }
             shd_growy_append_formatted(g, "\t\tbreak;\n");
@@ -72,6 +72,60 @@ static void generate_node_payload_hash_fn(Growy* g, json_object* src, json_objec
     shd_growy_append_formatted(g, "}\n");
 }
 
+/// Unlike _shd_hash_node_payload, this leaves out the node operands and hashes strings by contents,
+/// so it gives the same result for copies of a node living in different arenas.
+static void generate_node_payload_pod_hash_fn(Growy* g, json_object* src, json_object* nodes) {
+    shd_growy_append_formatted(g, "KeyHash _shd_hash_node_pod_payload(const Node* node) {\n");
+    shd_growy_append_formatted(g, "\tKeyHash hash = 0;\n");
+    shd_growy_append_formatted(g, "\tswitch (node->tag) { \n");
+    assert(json_object_get_type(nodes) == json_type_array);
+    for (size_t i = 0; i < json_object_array_length(nodes); i++) {
+        json_object* node = json_object_array_get_idx(nodes, i);
+        String name = json_object_get_string(json_object_object_get(node, "name"));
+        String snake_name = json_object_get_string(json_object_object_get(node, "snake_name"));
+        void* alloc = NULL;
+        if (!snake_name) {
+            snake_name = to_snake_case(name);
+            alloc = (void*) snake_name;
+        }
+        json_object* ops = json_object_object_get(node, "ops");
+        if (ops) {
+            assert(json_object_get_type(ops) == json_type_array);
+            shd_growy_append_formatted(g, "\tcase %s_TAG: {\n", name);
+            shd_growy_append_formatted(g, "\t\t%s payload = node->payload.%s;\n", name, snake_name);
+            for (size_t j = 0; j < json_object_array_length(ops); j++) {
+                json_object* op = json_object_array_get_idx(ops, j);
+                String op_name = json_object_get_string(json_object_object_get(op, "name"));
+                String class = json_object_get_string(json_object_object_get(op, "class"));
+                String type = json_object_get_string(json_object_object_get(op, "type"));
+                bool list = json_object_get_boolean(json_object_object_get(op, "list"));
+                bool ignore = json_object_get_boolean(json_object_object_get(op, "ignore"));
+                if (ignore)
+                    continue;
+                if ((class && strcmp(class, "string") == 0) || (!class && type && strcmp(type, "String") == 0)) {
+                    if (list) {
+                        shd_growy_append_formatted(g, "\t\tfor (size_t i = 0; i < payload.%s.count; i++)\n", op_name);
+                        shd_growy_append_formatted(g, "\t\t\thash = shd_hash_combine(hash, shd_hash_string(&payload.%s.strings[i]));\n", op_name);
+                    } else
+                        shd_growy_append_formatted(g, "\t\thash = shd_hash_combine(hash, shd_hash_string(&payload.%s));\n", op_name);
+                } else if (!class) {
+                    // by value rather than over its bytes, so padding or unused bits can't make equal nodes hash
+                    // differently. The cast only compiles for scalars and enums, which these fields all are.
+                    shd_growy_append_formatted(g, "\t\thash = shd_hash_combine(hash, shd_hash_murmur(&(uint64_t) { (uint64_t) payload.%s }, sizeof(uint64_t)));\n", op_name);
+                }
+            }
+            shd_growy_append_formatted(g, "\t\tbreak;\n");
+            shd_growy_append_formatted(g, "\t}\n");
+        }
+        if (alloc)
+            free(alloc);
+    }
+    shd_growy_append_formatted(g, "\t\tdefault: break;\n");
+    shd_growy_append_formatted(g, "\t}\n");
+    shd_growy_append_formatted(g, "\treturn hash;\n");
+    shd_growy_append_formatted(g, "}\n");
+}
+
 static void generate_node_payload_cmp_fn(Growy* g, json_object* src, json_object* nodes) {
     shd_growy_append_formatted(g, "bool _shd_compare_node_payload(const Node* a, const Node* b) {\n");
     shd_growy_append_formatted(g, "\tbool eq = true;\n");
@@ -209,6 +263,7 @@ void generate(Growy* g, json_object* src) {
     generate_node_is_nominal(g, nodes);
     generate_node_has_payload_array(g, nodes);
     generate_node_payload_hash_fn(g, src, nodes);
+    generate_node_payload_pod_hash_fn(g, src, nodes);
     generate_node_payload_cmp_fn(g, src, nodes);
     generate_bit_enum_classifier(g, "get_node_class_from_tag", "NodeClass", "Nc", "NodeTag", "", "_TAG", nodes);
 
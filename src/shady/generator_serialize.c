@@ -0,0 +1,135 @@
+#include "generator.h"
+
+#include <stdint.h>
+
+/// Mixes the names and layouts of all the nodes, so binaries written against another version of the grammar get rejected
+static uint32_t hash_grammar(json_object* nodes) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < json_object_array_length(nodes); i++) {
+        json_object* node = json_object_array_get_idx(nodes, i);
+        String str = json_object_to_json_string_ext(node, JSON_C_TO_STRING_PLAIN);
+        for (size_t j = 0; str[j]; j++) {
+            hash ^= (uint8_t) str[j];
+            hash *= 16777619u;
+        }
+    }
+    return hash;
+}
+
+static void generate_write_payload_fn(Growy* g, json_object* nodes) {
+    shd_growy_append_formatted(g, "static void write_payload_generated(Serializer* s, const Node* node) {\n");
+    shd_growy_append_formatted(g, "\tswitch (node->tag) { \n");
+    for (size_t i = 0; i < json_object_array_length(nodes); i++) {
+        json_object* node = json_object_array_get_idx(nodes, i);
+        if (has_custom_ctor(node))
+            continue;
+
+        String name = json_object_get_string(json_object_object_get(node, "name"));
+        String snake_name = json_object_get_string(json_object_object_get(node, "snake_name"));
+        void* alloc = NULL;
+        if (!snake_name) {
+            snake_name = to_snake_case(name);
+            alloc = (void*) snake_name;
+        }
+        shd_growy_append_formatted(g, "\t\tcase %s_TAG: {\n", name);
+        json_object* ops = json_object_object_get(node, "ops");
+        if (ops) {
+            shd_growy_append_formatted(g, "\t\t\t%s payload = node->payload.%s;\n", name, snake_name);
+            for (size_t j = 0; j < json_object_array_length(ops); j++) {
+                json_object* op = json_object_array_get_idx(ops, j);
+                String op_name = json_object_get_string(json_object_object_get(op, "name"));
+                if (json_object_get_boolean(json_object_object_get(op, "ignore")))
+                    continue;
+                bool list = json_object_get_boolean(json_object_object_get(op, "list"));
+                String class = json_object_get_string(json_object_object_get(op, "class"));
+                String type = json_object_get_string(json_object_object_get(op, "type"));
+                if ((class && strcmp(class, "string") == 0) || (type && strcmp(type, "String") == 0)) {
+                    if (list)
+                        shd_growy_append_formatted(g, "\t\t\twrite_strings(s, payload.%s);\n", op_name);
+                    else
+                        shd_growy_append_formatted(g, "\t\t\twrite_string(s, payload.%s);\n", op_name);
+                } else if (!class) {
+                    assert(!list);
+                    shd_growy_append_formatted(g, "\t\t\twrite_pod(s, &payload.%s, sizeof(payload.%s));\n", op_name, op_name);
+                } else if (list) {
+                    shd_growy_append_formatted(g, "\t\t\twrite_nodes(s, payload.%s);\n", op_name);
+                } else {
+                    shd_growy_append_formatted(g, "\t\t\twrite_node(s, payload.%s);\n", op_name);
+                }
+            }
+        }
+        shd_growy_append_formatted(g, "\t\t\tbreak;\n");
+        shd_growy_append_formatted(g, "\t\t}\n");
+        if (alloc)
+            free(alloc);
+    }
+    shd_growy_append_formatted(g, "\t\tdefault: assert(false);\n");
+    shd_growy_append_formatted(g, "\t}\n");
+    shd_growy_append_formatted(g, "}\n\n");
+}
+
+static void generate_read_payload_fn(Growy* g, json_object* nodes) {
+    shd_growy_append_formatted(g, "static const Node* read_payload_generated(Deserializer* d, NodeTag tag) {\n");
+    shd_growy_append_formatted(g, "\tswitch (tag) { \n");
+    for (size_t i = 0; i < json_object_array_length(nodes); i++) {
+        json_object* node = json_object_array_get_idx(nodes, i);
+        if (has_custom_ctor(node))
+            continue;
+
+        String name = json_object_get_string(json_object_object_get(node, "name"));
+        String snake_name = json_object_get_string(json_object_object_get(node, "snake_name"));
+        void* alloc = NULL;
+        if (!snake_name) {
+            snake_name = to_snake_case(name);
+            alloc = (void*) snake_name;
+        }
+        shd_growy_append_formatted(g, "\t\tcase %s_TAG: {\n", name);
+        json_object* ops = json_object_object_get(node, "ops");
+        if (ops) {
+            shd_growy_append_formatted(g, "\t\t\t%s payload;\n", name);
+            shd_growy_append_formatted(g, "\t\t\tmemset(&payload, 0, sizeof(payload));\n");
+            for (size_t j = 0; j < json_object_array_length(ops); j++) {
+                json_object* op = json_object_array_get_idx(ops, j);
+                String op_name = json_object_get_string(json_object_object_get(op, "name"));
+                if (json_object_get_boolean(json_object_object_get(op, "ignore")))
+                    continue;
+                bool list = json_object_get_boolean(json_object_object_get(op, "list"));
+                String class = json_object_get_string(json_object_object_get(op, "class"));
+                String type = json_object_get_string(json_object_object_get(op, "type"));
+                if ((class && strcmp(class, "string") == 0) || (type && strcmp(type, "String") == 0)) {
+                    if (list)
+                        shd_growy_append_formatted(g, "\t\t\tpayload.%s = read_strings(d);\n", op_name);
+                    else
+                        shd_growy_append_formatted(g, "\t\t\tpayload.%s = read_string(d);\n", op_name);
+                } else if (!class) {
+                    shd_growy_append_formatted(g, "\t\t\tread_pod(d, &payload.%s, sizeof(payload.%s));\n", op_name, op_name);
+                } else if (list) {
+                    shd_growy_append_formatted(g, "\t\t\tpayload.%s = read_nodes(d);\n", op_name);
+                } else {
+                    shd_growy_append_formatted(g, "\t\t\tpayload.%s = read_node(d);\n", op_name);
+                }
+            }
+            // nothing gets built out of a corrupt record
+            shd_growy_append_formatted(g, "\t\t\tif (d->failed)\n");
+            shd_growy_append_formatted(g, "\t\t\t\treturn NULL;\n");
+            shd_growy_append_formatted(g, "\t\t\treturn %s(d->arena, payload);\n", snake_name);
+        } else
+            shd_growy_append_formatted(g, "\t\t\treturn %s(d->arena);\n", snake_name);
+        shd_growy_append_formatted(g, "\t\t}\n");
+        if (alloc)
+            free(alloc);
+    }
+    shd_growy_append_formatted(g, "\t\tdefault: return NULL;\n");
+    shd_growy_append_formatted(g, "\t}\n");
+    shd_growy_append_formatted(g, "}\n\n");
+}
+
+void generate(Growy* g, json_object* src) {
+    generate_header(g, src);
+
+    json_object* nodes = json_object_object_get(src, "nodes");
+    assert(json_object_get_type(nodes) == json_type_array);
+    shd_growy_append_formatted(g, "static const uint32_t serialized_grammar_hash = 0x%08xu;\n\n", hash_grammar(nodes));
+    generate_write_payload_fn(g, nodes);
+    generate_read_payload_fn(g, nodes);
+}
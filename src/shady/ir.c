@@ -1,8 +1,12 @@
 #include "ir_private.h"
+#include "node_map.h"
+#include "analysis/manager.h"
 #include "portability.h"
 
 #include "list.h"
 #include "dict.h"
+#include "log.h"
+#include "threading.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -22,6 +26,104 @@ bool shd_compare_string(const char** a, const char** b);
 KeyHash shd_hash_node(const Node**);
 bool shd_compare_node(const Node** a, const Node** b);
 
+#define SHARDS_BITS 6
+#define SHARDS_COUNT (1 << SHARDS_BITS)
+
+// ids index a three-level table: a directory that's part of IrArenaConcurrency, then tables of pages, then pages of
+// nodes, the last two get installed when the first id that falls in them is handed out
+#define ID_PAGE_BITS 12
+#define ID_PAGE_SIZE (1 << ID_PAGE_BITS)
+#define ID_TABLE_BITS 12
+#define ID_TABLE_SIZE (1 << ID_TABLE_BITS)
+#define ID_DIRECTORY_SIZE (1 << (32 - ID_TABLE_BITS - ID_PAGE_BITS))
+
+typedef struct {
+    Mutex* lock;
+    struct Dict* set;
+} IrArenaShard;
+
+typedef struct {
+    const void* thread;
+    Arena* arena;
+} ThreadAllocator;
+
+/// State for thread-safe arenas: the interning sets are split in shards with a lock each, ids are handed out atomically
+/// and every thread bump-allocates from its own arena.
+typedef struct IrArenaConcurrency_ {
+    IrArenaShard shards[IrArenaSetsCount][SHARDS_COUNT];
+    Mutex* lock;
+
+    /// Tells apart arenas that happened to be allocated at the same address, for the thread-local allocator cache
+    uint32_t serial;
+    Mutex* allocators_lock;
+    struct List* allocators;
+
+    volatile uint32_t ids_count;
+    /// Tables of ID_TABLE_SIZE pages of ID_PAGE_SIZE nodes
+    void* volatile id_tables[ID_DIRECTORY_SIZE];
+} IrArenaConcurrency;
+
+static volatile uint32_t arenas_serial = 0;
+
+static SHADY_THREAD_LOCAL struct {
+    uint32_t serial;
+    Arena* arena;
+} cached_allocator;
+
+/// node_set counters of the arenas this thread destroyed, so statistics can account for short-lived copies
+static SHADY_THREAD_LOCAL IrArenaStats destroyed_arenas_stats;
+
+static struct Dict* new_set(IrArenaSet which) {
+    switch (which) {
+        case IrArenaNodeSet: return shd_new_set(const Node*, (HashFn) shd_hash_node, (CmpFn) shd_compare_node);
+        case IrArenaStringSet: return shd_new_set(const char*, (HashFn) shd_hash_string, (CmpFn) shd_compare_string);
+        case IrArenaNodesSet: return shd_new_set(Nodes, (HashFn) shd_hash_nodes, (CmpFn) shd_compare_nodes);
+        case IrArenaStringsSet: return shd_new_set(Strings, (HashFn) shd_hash_strings, (CmpFn) shd_compare_strings);
+        default: assert(false);
+    }
+    return NULL;
+}
+
+static IrArenaConcurrency* new_concurrency(void) {
+    IrArenaConcurrency* c = calloc(1, sizeof(IrArenaConcurrency));
+    for (size_t i = 0; i < IrArenaSetsCount; i++) {
+        for (size_t j = 0; j < SHARDS_COUNT; j++) {
+            c->shards[i][j] = (IrArenaShard) {
+                .lock = shd_new_mutex(),
+                .set = new_set(i),
+            };
+        }
+    }
+    c->lock = shd_new_mutex();
+    c->serial = shd_atomic_fetch_add_u32(&arenas_serial, 1) + 1;
+    c->allocators_lock = shd_new_mutex();
+    c->allocators = shd_new_list(ThreadAllocator);
+    return c;
+}
+
+static void destroy_concurrency(IrArenaConcurrency* c) {
+    for (size_t i = 0; i < IrArenaSetsCount; i++) {
+        for (size_t j = 0; j < SHARDS_COUNT; j++) {
+            shd_destroy_mutex(c->shards[i][j].lock);
+            shd_destroy_dict(c->shards[i][j].set);
+        }
+    }
+    shd_destroy_mutex(c->lock);
+    shd_destroy_mutex(c->allocators_lock);
+    for (size_t i = 0; i < shd_list_count(c->allocators); i++)
+        shd_destroy_arena(shd_read_list(ThreadAllocator, c->allocators)[i].arena);
+    shd_destroy_list(c->allocators);
+    for (size_t i = 0; i < ID_DIRECTORY_SIZE; i++) {
+        void** table = c->id_tables[i];
+        if (!table)
+            continue;
+        for (size_t j = 0; j < ID_TABLE_SIZE; j++)
+            free(table[j]);
+        free(table);
+    }
+    free(c);
+}
+
 IrArena* shd_new_ir_arena(const ArenaConfig* config) {
     IrArena* arena = malloc(sizeof(IrArena));
     *arena = (IrArena) {
@@ -30,22 +132,67 @@ IrArena* shd_new_ir_arena(const ArenaConfig* config) {
 
         .modules = shd_new_list(Module*),
 
-        .node_set = shd_new_set(const Node*, (HashFn) shd_hash_node, (CmpFn) shd_compare_node),
-        .string_set = shd_new_set(const char*, (HashFn) shd_hash_string, (CmpFn) shd_compare_string),
+        .node_set = new_set(IrArenaNodeSet),
+        .string_set = new_set(IrArenaStringSet),
 
-        .nodes_set   = shd_new_set(Nodes, (HashFn) shd_hash_nodes, (CmpFn) shd_compare_nodes),
-        .strings_set = shd_new_set(Strings, (HashFn) shd_hash_strings, (CmpFn) shd_compare_strings),
+        .nodes_set   = new_set(IrArenaNodesSet),
+        .strings_set = new_set(IrArenaStringsSet),
 
         .ids = shd_new_growy(),
+        .annotation_masks = shd_new_node_map(AnnotationMask),
+
+        .concurrency = config->thread_safe ? new_concurrency() : NULL,
     };
     return arena;
 }
 
 const Node* shd_get_node_by_id(const IrArena* a, NodeId id) {
-    return ((const Node**) shd_growy_data(a->ids))[id];
+    assert(id > 0 && "ids start at 1");
+    IrArenaConcurrency* c = a->concurrency;
+    if (c) {
+        void* volatile* table = shd_atomic_load_ptr(&c->id_tables[id >> (ID_TABLE_BITS + ID_PAGE_BITS)]);
+        assert(table);
+        const Node** page = shd_atomic_load_ptr(&table[(id >> ID_PAGE_BITS) & (ID_TABLE_SIZE - 1)]);
+        assert(page);
+        return page[id & (ID_PAGE_SIZE - 1)];
+    }
+    return ((const Node**) shd_growy_data(a->ids))[id - 1];
+}
+
+static DictStats get_node_set_stats(IrArena* arena) {
+    if (!arena->concurrency)
+        return shd_dict_stats(arena->node_set);
+    DictStats total = { 0 };
+    for (size_t i = 0; i < SHARDS_COUNT; i++) {
+        DictStats stats = shd_dict_stats(arena->concurrency->shards[IrArenaNodeSet][i].set);
+        total.entries_count += stats.entries_count;
+        total.thombstones_count += stats.thombstones_count;
+        total.buckets_count += stats.buckets_count;
+        total.collisions_count += stats.collisions_count;
+        total.total_probe_length += stats.total_probe_length;
+        if (stats.max_probe_length > total.max_probe_length)
+            total.max_probe_length = stats.max_probe_length;
+    }
+    return total;
+}
+
+static void log_node_set_stats(IrArena* arena) {
+    DictStats stats = get_node_set_stats(arena);
+    size_t entries = stats.entries_count ? stats.entries_count : 1;
+    shd_debugv_print("node_set: %zu nodes in %zu buckets (%zu thombstones), %.2f%% collisions, average probe length %.3f, max probe length %zu\n",
+                     stats.entries_count, stats.buckets_count, stats.thombstones_count,
+                     100.0 * (double) stats.collisions_count / (double) entries,
+                     (double) stats.total_probe_length / (double) entries,
+                     stats.max_probe_length);
 }
 
 void shd_destroy_ir_arena(IrArena* arena) {
+    if (shd_log_get_level() >= DEBUGV)
+        log_node_set_stats(arena);
+    destroyed_arenas_stats.node_lookups += arena->node_lookups;
+    destroyed_arenas_stats.node_hits += arena->node_hits;
+
+    _shd_destroy_analysis_cache(arena);
     for (size_t i = 0; i < shd_list_count(arena->modules); i++) {
         shd_destroy_module(shd_read_list(Module*, arena->modules)[i]);
     }
@@ -55,6 +202,9 @@ void shd_destroy_ir_arena(IrArena* arena) {
     shd_destroy_dict(arena->string_set);
     shd_destroy_dict(arena->nodes_set);
     shd_destroy_dict(arena->node_set);
+    shd_destroy_node_map(arena->annotation_masks);
+    if (arena->concurrency)
+        destroy_concurrency(arena->concurrency);
     shd_destroy_arena(arena->arena);
     shd_destroy_growy(arena->ids);
     free(arena);
@@ -64,27 +214,150 @@ const ArenaConfig* shd_get_arena_config(const IrArena* a) {
     return &a->config;
 }
 
+/// Returns what @p slot points to, allocating @p count zeroed pointers for it first if it's still NULL
+static void* get_or_install_id_table(void* volatile* slot, size_t count) {
+    void* table = shd_atomic_load_ptr(slot);
+    if (!table) {
+        table = calloc(count, sizeof(void*));
+        // someone else might have installed one in the meantime
+        if (!shd_atomic_cas_ptr(slot, NULL, table)) {
+            free(table);
+            table = shd_atomic_load_ptr(slot);
+        }
+    }
+    return table;
+}
+
 NodeId _shd_allocate_node_id(IrArena* arena, const Node* n) {
+    IrArenaConcurrency* c = arena->concurrency;
+    if (c) {
+        NodeId id = shd_atomic_fetch_add_u32(&c->ids_count, 1) + 1;
+        void* volatile* table = get_or_install_id_table(&c->id_tables[id >> (ID_TABLE_BITS + ID_PAGE_BITS)], ID_TABLE_SIZE);
+        const Node** page = get_or_install_id_table(&table[(id >> ID_PAGE_BITS) & (ID_TABLE_SIZE - 1)], ID_PAGE_SIZE);
+        page[id & (ID_PAGE_SIZE - 1)] = n;
+        return id;
+    }
     shd_growy_append_object(arena->ids, n);
     return shd_growy_size(arena->ids) / sizeof(const Node*);
 }
 
+static KeyHash hash_set_key(IrArenaSet which, const void* key) {
+    switch (which) {
+        case IrArenaNodeSet: return shd_hash_node((const Node**) key);
+        case IrArenaStringSet: return shd_hash_string((const char**) key);
+        case IrArenaNodesSet: return shd_hash_nodes((Nodes*) key);
+        case IrArenaStringsSet: return shd_hash_strings((Strings*) key);
+        default: assert(false);
+    }
+    return 0;
+}
+
+LockedIrArenaSet _shd_lock_ir_arena_set(IrArena* arena, IrArenaSet which, const void* key) {
+    IrArenaConcurrency* c = arena->concurrency;
+    if (!c) {
+        struct Dict* sets[] = { arena->node_set, arena->string_set, arena->nodes_set, arena->strings_set };
+        return (LockedIrArenaSet) { .set = sets[which], .lock = NULL };
+    }
+    // the node hash of nominal nodes is just their address, so mix it before picking the shard with the top bits
+    KeyHash hash = hash_set_key(which, key) * 0x9E3779B1u;
+    IrArenaShard* shard = &c->shards[which][hash >> (32 - SHARDS_BITS)];
+    shd_mutex_lock(shard->lock);
+    return (LockedIrArenaSet) { .set = shard->set, .lock = shard->lock };
+}
+
+void _shd_unlock_ir_arena_set(LockedIrArenaSet locked) {
+    if (locked.lock)
+        shd_mutex_unlock(locked.lock);
+}
+
+void _shd_lock_ir_arena(IrArena* arena) {
+    if (arena->concurrency)
+        shd_mutex_lock(arena->concurrency->lock);
+}
+
+void _shd_unlock_ir_arena(IrArena* arena) {
+    if (arena->concurrency)
+        shd_mutex_unlock(arena->concurrency->lock);
+}
+
+IrArenaStats _shd_get_ir_arena_stats(const IrArena* arena) {
+    IrArenaStats stats = {
+        .nodes_count = shd_growy_size(arena->ids) / sizeof(const Node*),
+        .bytes = shd_arena_reserved_bytes(arena->arena),
+        .node_lookups = arena->node_lookups,
+        .node_hits = arena->node_hits,
+    };
+    IrArenaConcurrency* c = arena->concurrency;
+    if (c) {
+        stats.nodes_count = c->ids_count;
+        shd_mutex_lock(c->allocators_lock);
+        for (size_t i = 0; i < shd_list_count(c->allocators); i++)
+            stats.bytes += shd_arena_reserved_bytes(shd_read_list(ThreadAllocator, c->allocators)[i].arena);
+        shd_mutex_unlock(c->allocators_lock);
+    }
+    return stats;
+}
+
+IrArenaStats _shd_get_destroyed_ir_arenas_stats(void) {
+    return destroyed_arenas_stats;
+}
+
+void _shd_add_destroyed_ir_arenas_stats(IrArenaStats stats) {
+    destroyed_arenas_stats.node_lookups += stats.node_lookups;
+    destroyed_arenas_stats.node_hits += stats.node_hits;
+}
+
+Arena* _shd_get_ir_arena_allocator(IrArena* arena) {
+    IrArenaConcurrency* c = arena->concurrency;
+    if (!c)
+        return arena->arena;
+    if (cached_allocator.serial == c->serial)
+        return cached_allocator.arena;
+
+    // the address of a thread-local identifies the thread, if a dead thread's address gets reused, so does its arena
+    const void* thread = &cached_allocator;
+    Arena* found = NULL;
+    shd_mutex_lock(c->allocators_lock);
+    for (size_t i = 0; i < shd_list_count(c->allocators); i++) {
+        ThreadAllocator allocator = shd_read_list(ThreadAllocator, c->allocators)[i];
+        if (allocator.thread == thread) {
+            found = allocator.arena;
+            break;
+        }
+    }
+    if (!found) {
+        found = shd_new_arena();
+        ThreadAllocator allocator = { .thread = thread, .arena = found };
+        shd_list_append(ThreadAllocator, c->allocators, allocator);
+    }
+    shd_mutex_unlock(c->allocators_lock);
+
+    cached_allocator.serial = c->serial;
+    cached_allocator.arena = found;
+    return found;
+}
+
 Nodes shd_nodes(IrArena* arena, size_t count, const Node* in_nodes[]) {
     Nodes tmp = {
         .count = count,
         .nodes = in_nodes
     };
-    const Nodes* found = shd_dict_find_key(Nodes, arena->nodes_set, tmp);
-    if (found)
-        return *found;
+    LockedIrArenaSet locked = _shd_lock_ir_arena_set(arena, IrArenaNodesSet, &tmp);
+    const Nodes* found = shd_dict_find_key(Nodes, locked.set, tmp);
+    if (found) {
+        Nodes nodes = *found;
+        _shd_unlock_ir_arena_set(locked);
+        return nodes;
+    }
 
     Nodes nodes;
     nodes.count = count;
-    nodes.nodes = shd_arena_alloc(arena->arena, sizeof(Node*) * count);
+    nodes.nodes = shd_arena_alloc(_shd_get_ir_arena_allocator(arena), sizeof(Node*) * count);
     for (size_t i = 0; i < count; i++)
         nodes.nodes[i] = in_nodes[i];
 
-    shd_set_insert_get_result(Nodes, arena->nodes_set, nodes);
+    shd_set_insert_get_result(Nodes, locked.set, nodes);
+    _shd_unlock_ir_arena_set(locked);
     return nodes;
 }
 
@@ -93,17 +366,22 @@ Strings shd_strings(IrArena* arena, size_t count, const char* in_strs[]) {
         .count = count,
         .strings = in_strs,
     };
-    const Strings* found = shd_dict_find_key(Strings, arena->strings_set, tmp);
-    if (found)
-        return *found;
+    LockedIrArenaSet locked = _shd_lock_ir_arena_set(arena, IrArenaStringsSet, &tmp);
+    const Strings* found = shd_dict_find_key(Strings, locked.set, tmp);
+    if (found) {
+        Strings strings = *found;
+        _shd_unlock_ir_arena_set(locked);
+        return strings;
+    }
 
     Strings strings;
     strings.count = count;
-    strings.strings = shd_arena_alloc(arena->arena, sizeof(const char*) * count);
+    strings.strings = shd_arena_alloc(_shd_get_ir_arena_allocator(arena), sizeof(const char*) * count);
     for (size_t i = 0; i < count; i++)
         strings.strings[i] = in_strs[i];
 
-    shd_set_insert_get_result(Strings, arena->strings_set, strings);
+    shd_set_insert_get_result(Strings, locked.set, strings);
+    _shd_unlock_ir_arena_set(locked);
     return strings;
 }
 
@@ -164,20 +442,66 @@ bool shd_find_in_nodes(Nodes nodes, const Node* n) {
     return false;
 }
 
+static void nodes_builder_reserve(NodesBuilder* builder, size_t count) {
+    if (count <= builder->space)
+        return;
+    size_t new_space = builder->space ? builder->space * 2 : 8;
+    while (new_space < count)
+        new_space *= 2;
+    builder->nodes = realloc(builder->nodes, sizeof(const Node*) * new_space);
+    builder->space = new_space;
+}
+
+NodesBuilder shd_nodes_builder_from(Nodes initial) {
+    NodesBuilder builder = { 0 };
+    shd_nodes_builder_append_nodes(&builder, initial);
+    return builder;
+}
+
+void shd_nodes_builder_append(NodesBuilder* builder, const Node* n) {
+    nodes_builder_reserve(builder, builder->count + 1);
+    builder->nodes[builder->count++] = n;
+}
+
+void shd_nodes_builder_append_nodes(NodesBuilder* builder, Nodes nodes) {
+    if (nodes.count == 0)
+        return;
+    nodes_builder_reserve(builder, builder->count + nodes.count);
+    memcpy(builder->nodes + builder->count, nodes.nodes, sizeof(const Node*) * nodes.count);
+    builder->count += nodes.count;
+}
+
+void shd_nodes_builder_set(NodesBuilder* builder, size_t i, const Node* n) {
+    assert(i < builder->count);
+    builder->nodes[i] = n;
+}
+
+Nodes shd_nodes_builder_finish(IrArena* arena, NodesBuilder* builder) {
+    Nodes nodes = shd_nodes(arena, builder->count, builder->nodes);
+    free(builder->nodes);
+    *builder = (NodesBuilder) { 0 };
+    return nodes;
+}
+
 /// takes care of structural sharing
 static const char* string_impl(IrArena* arena, size_t size, const char* zero_terminated) {
     if (!zero_terminated)
         return NULL;
     const char* ptr = zero_terminated;
-    const char** found = shd_dict_find_key(const char*, arena->string_set, ptr);
-    if (found)
-        return *found;
+    LockedIrArenaSet locked = _shd_lock_ir_arena_set(arena, IrArenaStringSet, &ptr);
+    const char** found = shd_dict_find_key(const char*, locked.set, ptr);
+    if (found) {
+        const char* str = *found;
+        _shd_unlock_ir_arena_set(locked);
+        return str;
+    }
 
-    char* new_str = (char*) shd_arena_alloc(arena->arena, strlen(zero_terminated) + 1);
+    char* new_str = (char*) shd_arena_alloc(_shd_get_ir_arena_allocator(arena), strlen(zero_terminated) + 1);
     strncpy(new_str, zero_terminated, size);
     new_str[size] = '\0';
 
-    shd_set_insert_get_result(const char*, arena->string_set, new_str);
+    shd_set_insert_get_result(const char*, locked.set, new_str);
+    _shd_unlock_ir_arena_set(locked);
     return new_str;
 }
 
@@ -10,6 +10,14 @@
 #include "stdlib.h"
 #include "stdio.h"
 
+/// Which well-known annotations a declaration has, declarations sometimes get their annotations replaced after
+/// construction so we remember which list the mask was computed from.
+typedef struct {
+    const Node** annotations;
+    size_t count;
+    uint64_t mask;
+} AnnotationMask;
+
 typedef struct IrArena_ {
     Arena* arena;
     ArenaConfig config;
@@ -22,16 +30,38 @@ typedef struct IrArena_ {
 
     struct Dict* nodes_set;
     struct Dict* strings_set;
+
+    /// decl -> which well-known annotations it has, see annotation.c
+    struct NodeMap_* annotation_masks;
+
+    /// How many structural nodes were looked up in node_set, and how many of those were already there
+    volatile uint32_t node_lookups;
+    volatile uint32_t node_hits;
+
+    /// Only present when config.thread_safe is set, replaces the sets, the id table and the allocator above, see ir.c
+    struct IrArenaConcurrency_* concurrency;
+
+    /// Cached analyses of the functions and modules in this arena, created on demand, see analysis/manager.c
+    struct AnalysisCache_* analyses;
 } IrArena_;
 
+typedef struct AnalysisCache_ AnalysisCache;
+
 struct Module_ {
     IrArena* arena;
     String name;
     struct List* decls;
+    /// Name -> declaration index, kept in sync with decls
+    struct Dict* decls_by_name;
+    /// Interned copy of decls, decls are only appended outside of _shd_module_retain_decls, so it stays valid as long as
+    /// the count matches
+    Nodes decls_view;
     bool sealed;
 };
 
 void _shd_module_add_decl(Module* m, Node* node);
+/// Replaces the declarations of @p m with @p decls, which must be some of them: drops the others, and reorders the rest.
+void _shd_module_retain_decls(Module* m, size_t count, Node* decls[]);
 void shd_destroy_module(Module* m);
 
 struct BodyBuilder_ {
@@ -45,6 +75,46 @@ struct BodyBuilder_ {
 
 NodeId _shd_allocate_node_id(IrArena* arena, const Node* n);
 
+typedef enum {
+    IrArenaNodeSet,
+    IrArenaStringSet,
+    IrArenaNodesSet,
+    IrArenaStringsSet,
+    IrArenaSetsCount
+} IrArenaSet;
+
+typedef struct {
+    struct Dict* set;
+    struct Mutex_* lock;
+} LockedIrArenaSet;
+
+/// Gives access to the (shard of the) interning set that @p key belongs to, must be released before constructing any other node.
+/// On arenas that are not thread-safe this is just the set, and no locking takes place.
+LockedIrArenaSet _shd_lock_ir_arena_set(IrArena* arena, IrArenaSet which, const void* key);
+void _shd_unlock_ir_arena_set(LockedIrArenaSet locked);
+
+/// Guards the module list, module contents and the other bits of bookkeeping that are not hash-consed.
+void _shd_lock_ir_arena(IrArena* arena);
+void _shd_unlock_ir_arena(IrArena* arena);
+
+/// The arena IR objects should be allocated from by the calling thread.
+Arena* _shd_get_ir_arena_allocator(IrArena* arena);
+
+typedef struct {
+    size_t nodes_count;
+    size_t bytes;
+    size_t node_lookups;
+    size_t node_hits;
+} IrArenaStats;
+
+IrArenaStats _shd_get_ir_arena_stats(const IrArena* arena);
+/// Sum of the node_set counters of every arena destroyed by the calling thread so far, and of those handed over to it
+/// with _shd_add_destroyed_ir_arenas_stats. The other fields are left at 0.
+IrArenaStats _shd_get_destroyed_ir_arenas_stats(void);
+/// Counts @p stats as destroyed by the calling thread, for threads working on its behalf (ie in a thread pool) to report
+/// the arenas they destroyed, see rewrite_module_parallel.
+void _shd_add_destroyed_ir_arenas_stats(IrArenaStats stats);
+
 struct List;
 Nodes shd_list_to_nodes(IrArena* arena, struct List* list);
 
@@ -1,18 +1,26 @@
 #include "ir_private.h"
 
 #include "list.h"
+#include "dict.h"
 #include "portability.h"
 
 #include <string.h>
 
+KeyHash shd_hash_string(const char** string);
+bool shd_compare_string(const char** a, const char** b);
+
 Module* shd_new_module(IrArena* arena, String name) {
-    Module* m = shd_arena_alloc(arena->arena, sizeof(Module));
+    Module* m = shd_arena_alloc(_shd_get_ir_arena_allocator(arena), sizeof(Module));
     *m = (Module) {
         .arena = arena,
         .name = string(arena, name),
         .decls = shd_new_list(Node*),
+        .decls_by_name = shd_new_dict(String, Node*, (HashFn) shd_hash_string, (CmpFn) shd_compare_string),
+        .decls_view = shd_empty(arena),
     };
+    _shd_lock_ir_arena(arena);
     shd_list_append(Module*, arena->modules, m);
+    _shd_unlock_ir_arena(arena);
     return m;
 }
 
@@ -25,26 +33,53 @@ String shd_module_get_name(const Module* m) {
 }
 
 Nodes shd_module_get_declarations(const Module* m) {
+    IrArena* arena = shd_module_get_arena(m);
+    _shd_lock_ir_arena(arena);
     size_t count = shd_list_count(m->decls);
-    const Node** start = shd_read_list(const Node*, m->decls);
-    return shd_nodes(shd_module_get_arena(m), count, start);
+    if (m->decls_view.count != count) {
+        const Node** start = shd_read_list(const Node*, m->decls);
+        // this is a cache, so it's fine to update it through a const pointer
+        ((Module*) m)->decls_view = shd_nodes(arena, count, start);
+    }
+    Nodes decls = m->decls_view;
+    _shd_unlock_ir_arena(arena);
+    return decls;
 }
 
 void _shd_module_add_decl(Module* m, Node* node) {
     assert(is_declaration(node));
-    assert(!shd_module_get_declaration(m, get_declaration_name(node)) && "duplicate declaration");
+    String name = get_declaration_name(node);
+    _shd_lock_ir_arena(m->arena);
+    bool fresh = shd_dict_insert_get_result(String, Node*, m->decls_by_name, name, node);
+    assert(fresh && "duplicate declaration");
     shd_list_append(Node*, m->decls, node);
+    _shd_unlock_ir_arena(m->arena);
 }
 
-Node* shd_module_get_declaration(const Module* m, String name) {
-    Nodes existing_decls = shd_module_get_declarations(m);
-    for (size_t i = 0; i < existing_decls.count; i++) {
-        if (strcmp(get_declaration_name(existing_decls.nodes[i]), name) == 0)
-            return (Node*) existing_decls.nodes[i];
+void _shd_module_retain_decls(Module* m, size_t count, Node* decls[]) {
+    _shd_lock_ir_arena(m->arena);
+    assert(count <= shd_list_count(m->decls));
+    shd_clear_list(m->decls);
+    shd_dict_clear(m->decls_by_name);
+    for (size_t i = 0; i < count; i++) {
+        String name = get_declaration_name(decls[i]);
+        bool fresh = shd_dict_insert_get_result(String, Node*, m->decls_by_name, name, decls[i]);
+        assert(fresh && "duplicate declaration");
+        shd_list_append(Node*, m->decls, decls[i]);
     }
-    return NULL;
+    m->decls_view = shd_nodes(m->arena, count, (const Node**) decls);
+    _shd_unlock_ir_arena(m->arena);
+}
+
+Node* shd_module_get_declaration(const Module* m, String name) {
+    _shd_lock_ir_arena(m->arena);
+    Node** found = shd_dict_find_value(String, Node*, m->decls_by_name, name);
+    Node* decl = found ? *found : NULL;
+    _shd_unlock_ir_arena(m->arena);
+    return decl;
 }
 
 void shd_destroy_module(Module* m) {
     shd_destroy_list(m->decls);
+    shd_destroy_dict(m->decls_by_name);
 }
@@ -338,29 +338,25 @@ const char* shd_get_node_tag_string(NodeTag tag) {
 const bool node_type_has_payload[];
 
 KeyHash _shd_hash_node_payload(const Node* node);
+KeyHash shd_hash_string(const char** string);
 
-KeyHash shd_hash_node(Node** pnode) {
-    const Node* node = *pnode;
-    KeyHash combined;
-
+KeyHash _shd_hash_node_uncached(const Node* node) {
     if (shd_is_node_nominal(node)) {
         size_t ptr = (size_t) node;
         uint32_t upper = ptr >> 32;
         uint32_t lower = ptr;
-        combined = upper ^ lower;
-        goto end;
+        return upper ^ lower;
     }
 
-    KeyHash tag_hash = shd_hash_murmur(&node->tag, sizeof(NodeTag));
-    KeyHash payload_hash = 0;
-
-    if (node_type_has_payload[node->tag]) {
-        payload_hash = _shd_hash_node_payload(node);
-    }
-    combined = tag_hash ^ payload_hash;
+    KeyHash hash = shd_hash_murmur(&node->tag, sizeof(NodeTag));
+    if (node_type_has_payload[node->tag])
+        hash = shd_hash_combine(hash, _shd_hash_node_payload(node));
+    return hash;
+}
 
-    end:
-    return combined;
+/// The hash is computed once in _shd_create_node_helper and stored in the node, all the nodes out there come from it.
+KeyHash shd_hash_node(Node** pnode) {
+    return (*pnode)->hash;
 }
 
 bool _shd_compare_node_payload(const Node*, const Node*);
@@ -0,0 +1,180 @@
+#include "node_map.h"
+
+#include "shady/ir.h"
+
+#include "arena.h"
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define NODE_MAP_PAGE_BITS 8
+#define NODE_MAP_PAGE_SIZE (1 << NODE_MAP_PAGE_BITS)
+#define NODE_MAP_PAGE_MASK (NODE_MAP_PAGE_SIZE - 1)
+
+inline static size_t align_offset(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+struct NodeMap_ {
+    /// If set, the map and its pages live in there instead of the heap
+    Arena* arena;
+
+    size_t value_size;
+    size_t value_offset;
+    size_t entry_size;
+
+    size_t count;
+
+    /// Each page holds NODE_MAP_PAGE_SIZE entries, an entry is a key followed by its value.
+    /// A NULL key marks an empty entry.
+    size_t pages_count;
+    char** pages;
+};
+
+NodeMap* shd_new_node_map_impl(Arena* arena, size_t value_size, size_t value_align) {
+    size_t value_offset = align_offset(sizeof(const Node*), value_align ? value_align : 1);
+    size_t entry_align = value_align > alignof(const Node*) ? value_align : alignof(const Node*);
+    NodeMap* map = arena ? shd_arena_alloc_uninit(arena, sizeof(NodeMap)) : malloc(sizeof(NodeMap));
+    *map = (NodeMap) {
+        .arena = arena,
+        .value_size = value_size,
+        .value_offset = value_offset,
+        .entry_size = align_offset(value_offset + value_size, entry_align),
+        .count = 0,
+        .pages_count = 0,
+        .pages = NULL,
+    };
+    return map;
+}
+
+NodeMap* shd_clone_node_map(const NodeMap* source) {
+    // clones always go on the heap, the source might be in an arena about to be rewound
+    NodeMap* map = malloc(sizeof(NodeMap));
+    *map = *source;
+    map->arena = NULL;
+    map->pages = calloc(source->pages_count, sizeof(char*));
+    size_t page_bytes = source->entry_size * NODE_MAP_PAGE_SIZE;
+    for (size_t i = 0; i < source->pages_count; i++) {
+        if (!source->pages[i])
+            continue;
+        map->pages[i] = malloc(page_bytes);
+        memcpy(map->pages[i], source->pages[i], page_bytes);
+    }
+    return map;
+}
+
+void shd_destroy_node_map(NodeMap* map) {
+    if (map->arena)
+        return;
+    for (size_t i = 0; i < map->pages_count; i++)
+        free(map->pages[i]);
+    free(map->pages);
+    free(map);
+}
+
+void shd_node_map_clear(NodeMap* map) {
+    for (size_t i = 0; i < map->pages_count; i++) {
+        if (map->arena) {
+            if (map->pages[i])
+                memset(map->pages[i], 0, NODE_MAP_PAGE_SIZE * map->entry_size);
+            continue;
+        }
+        free(map->pages[i]);
+        map->pages[i] = NULL;
+    }
+    map->count = 0;
+}
+
+size_t shd_node_map_count(const NodeMap* map) {
+    return map->count;
+}
+
+static const Node** get_entry(const NodeMap* map, NodeId id) {
+    size_t page = id >> NODE_MAP_PAGE_BITS;
+    if (page >= map->pages_count || !map->pages[page])
+        return NULL;
+    return (const Node**) (map->pages[page] + (id & NODE_MAP_PAGE_MASK) * map->entry_size);
+}
+
+static const Node** get_or_create_entry(NodeMap* map, NodeId id) {
+    size_t page = id >> NODE_MAP_PAGE_BITS;
+    if (page >= map->pages_count) {
+        size_t new_count = map->pages_count ? map->pages_count : 1;
+        while (new_count <= page)
+            new_count *= 2;
+        if (map->arena) {
+            char** pages = shd_arena_alloc(map->arena, new_count * sizeof(char*));
+            if (map->pages_count)
+                memcpy(pages, map->pages, map->pages_count * sizeof(char*));
+            map->pages = pages;
+        } else {
+            map->pages = realloc(map->pages, new_count * sizeof(char*));
+            memset(&map->pages[map->pages_count], 0, (new_count - map->pages_count) * sizeof(char*));
+        }
+        map->pages_count = new_count;
+    }
+    if (!map->pages[page])
+        map->pages[page] = map->arena ? shd_arena_alloc(map->arena, NODE_MAP_PAGE_SIZE * map->entry_size) : calloc(NODE_MAP_PAGE_SIZE, map->entry_size);
+    return (const Node**) (map->pages[page] + (id & NODE_MAP_PAGE_MASK) * map->entry_size);
+}
+
+void* shd_node_map_find_impl(const NodeMap* map, const Node* key) {
+    assert(map->value_size > 0 && "use shd_node_map_contains on sets");
+    const Node** entry = get_entry(map, key->id);
+    // keys from another arena might have the same id, so we also check for identity
+    if (!entry || *entry != key)
+        return NULL;
+    return (void*) ((char*) entry + map->value_offset);
+}
+
+bool shd_node_map_contains(const NodeMap* map, const Node* key) {
+    const Node** entry = get_entry(map, key->id);
+    return entry && *entry == key;
+}
+
+bool shd_node_map_insert_impl(NodeMap* map, const Node* key, const void* value) {
+    assert(key);
+    const Node** entry = get_or_create_entry(map, key->id);
+    // ids are only unique within an arena, overwriting the entry would silently lose the other key
+    if (*entry && (*entry)->arena != key->arena)
+        shd_error("All the keys in a NodeMap must come from the same arena");
+    bool fresh = *entry == NULL;
+    *entry = key;
+    if (map->value_size)
+        memcpy((char*) entry + map->value_offset, value, map->value_size);
+    if (fresh)
+        map->count++;
+    return fresh;
+}
+
+bool shd_node_map_remove(NodeMap* map, const Node* key) {
+    const Node** entry = get_entry(map, key->id);
+    if (!entry || *entry != key)
+        return false;
+    *entry = NULL;
+    map->count--;
+    return true;
+}
+
+bool shd_node_map_iter(const NodeMap* map, size_t* iterator_state, const Node** key, void* value) {
+    while (true) {
+        size_t page = *iterator_state >> NODE_MAP_PAGE_BITS;
+        if (page >= map->pages_count)
+            return false;
+        if (!map->pages[page]) {
+            *iterator_state = (page + 1) << NODE_MAP_PAGE_BITS;
+            continue;
+        }
+        const Node** entry = (const Node**) (map->pages[page] + (*iterator_state & NODE_MAP_PAGE_MASK) * map->entry_size);
+        (*iterator_state)++;
+        if (!*entry)
+            continue;
+        if (key)
+            *key = *entry;
+        if (value && map->value_size)
+            memcpy(value, (char*) entry + map->value_offset, map->value_size);
+        return true;
+    }
+}
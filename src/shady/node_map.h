@@ -0,0 +1,46 @@
+#ifndef SHADY_NODE_MAP_H
+#define SHADY_NODE_MAP_H
+
+#include "shady/ir/base.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdalign.h>
+
+/// Side-table keyed by the dense @ref NodeId of nodes.
+/// Lookups are an array index instead of a structural hash + probe, which is what makes this cheaper than a @ref Dict
+/// keyed with shd_hash_node. Storage is paged so that sparse maps (ie the per-abstraction children of a Rewriter) only
+/// pay for the ranges of ids they actually touch.
+/// All the keys in a given map must come from the same @ref IrArena, inserting a key whose id is taken by a key from
+/// another arena is a fatal error.
+typedef struct NodeMap_ NodeMap;
+
+#define shd_new_node_map(T) shd_new_node_map_impl(NULL, sizeof(T), alignof(T))
+#define shd_new_node_set() shd_new_node_map_impl(NULL, 0, 1)
+/// Maps allocated in an @ref Arena (ie the scratch one) don't need to be destroyed, their storage goes away with it.
+#define shd_new_node_map_in(T, arena) shd_new_node_map_impl(arena, sizeof(T), alignof(T))
+#define shd_new_node_set_in(arena) shd_new_node_map_impl(arena, 0, 1)
+typedef struct Arena_ Arena;
+NodeMap* shd_new_node_map_impl(Arena* arena, size_t value_size, size_t value_align);
+
+NodeMap* shd_clone_node_map(const NodeMap* source);
+void shd_destroy_node_map(NodeMap* map);
+void shd_node_map_clear(NodeMap* map);
+
+size_t shd_node_map_count(const NodeMap* map);
+
+#define shd_node_map_find(T, map, key) ((T*) shd_node_map_find_impl(map, key))
+void* shd_node_map_find_impl(const NodeMap* map, const Node* key);
+bool shd_node_map_contains(const NodeMap* map, const Node* key);
+
+/// Returns true if the key was not present before, overwrites the existing value otherwise.
+#define shd_node_map_insert(T, map, key, value) shd_node_map_insert_impl(map, key, (const void*) &(value))
+#define shd_node_set_insert(map, key) shd_node_map_insert_impl(map, key, NULL)
+bool shd_node_map_insert_impl(NodeMap* map, const Node* key, const void* value);
+
+bool shd_node_map_remove(NodeMap* map, const Node* key);
+
+/// Iterates in increasing NodeId order. @p iterator_state should be initialised to zero.
+bool shd_node_map_iter(const NodeMap* map, size_t* iterator_state, const Node** key, void* value);
+
+#endif
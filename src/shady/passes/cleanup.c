@@ -1,12 +1,15 @@
 #include "shady/pass.h"
+#include "shady/visit.h"
 
 #include "../analysis/uses.h"
 #include "../analysis/leak.h"
+#include "../analysis/manager.h"
 #include "../ir_private.h"
 #include "../type.h"
 
 #include "portability.h"
 #include "log.h"
+#include "list.h"
 
 #pragma GCC diagnostic error "-Wswitch"
 
@@ -42,17 +45,18 @@ static bool is_used_as_value(const UsesMap* map, const Node* instr) {
     return false;
 }
 
+/// A control block that immediately joins on its own join point, which never leaks, does nothing
+static bool is_control_trivial(const UsesMap* map, const Node* control) {
+    if (!is_control_static(map, control))
+        return false;
+    const Node* control_inside = control->payload.control.inside;
+    const Node* term = get_abstraction_body(control_inside);
+    return term->tag == Join_TAG && term->payload.join.join_point == shd_first(get_abstraction_params(control_inside));
+}
+
 static const Node* process(Context* ctx, const Node* old) {
     Rewriter* r = &ctx->rewriter;
     IrArena* a = r->dst_arena;
-    if (old->tag == Function_TAG || old->tag == Constant_TAG) {
-        Context c = *ctx;
-        c.map = create_fn_uses_map(old, NcType | NcDeclaration);
-        const Node* new = shd_recreate_node(&c.rewriter, old);
-        destroy_uses_map(c.map);
-        return new;
-    }
-
     switch (old->tag) {
         case BasicBlock_TAG: {
             size_t uses = count_calls(ctx->map, old);
@@ -77,19 +81,12 @@ static const Node* process(Context* ctx, const Node* old) {
         }
         case Control_TAG: {
             Control payload = old->payload.control;
-            if (is_control_static(ctx->map, old)) {
+            if (is_control_trivial(ctx->map, old)) {
                 const Node* control_inside = payload.inside;
-                const Node* term = get_abstraction_body(control_inside);
-                if (term->tag == Join_TAG) {
-                    Join payload_join = term->payload.join;
-                    if (payload_join.join_point == shd_first(get_abstraction_params(control_inside))) {
-                        // if we immediately consume the join point and it's never leaked, this control block does nothing and can be eliminated
-                        shd_register_processed(r, shd_get_abstraction_mem(control_inside), shd_rewrite_node(r, payload.mem));
-                        shd_register_processed(r, control_inside, NULL);
-                        *ctx->todo = true;
-                        return shd_rewrite_node(r, term);
-                    }
-                }
+                shd_register_processed(r, shd_get_abstraction_mem(control_inside), shd_rewrite_node(r, payload.mem));
+                shd_register_processed(r, control_inside, NULL);
+                *ctx->todo = true;
+                return shd_rewrite_node(r, get_abstraction_body(control_inside));
             }
             break;
         }
@@ -117,17 +114,55 @@ static const Node* process(Context* ctx, const Node* old) {
     return shd_recreate_node(&ctx->rewriter, old);
 }
 
+/// Whether process() changes anything about @p node itself. Jumps and joins only change once a basic block or a control
+/// block they refer to does, so they don't need to be looked at.
+static bool can_simplify(const UsesMap* map, const Node* node) {
+    switch (node->tag) {
+        case BasicBlock_TAG: return node->arena->config.optimisations.inline_single_use_bbs && count_calls(map, node) <= 1;
+        case Control_TAG: return is_control_trivial(map, node);
+        case Load_TAG: return !is_used_as_value(map, node);
+        default: return false;
+    }
+}
+
+typedef struct {
+    IterativeVisitor iv;
+    const UsesMap* map;
+    bool found;
+} SimplificationFinder;
+
+static bool find_simplification(SimplificationFinder* finder, const Node* node) {
+    // once something is found, the rest of the function doesn't need to be expanded
+    if (finder->found)
+        return false;
+    finder->found = can_simplify(finder->map, node);
+    return !finder->found;
+}
+
 OptPass shd_opt_simplify;
 
-bool shd_opt_simplify(SHADY_UNUSED const CompilerConfig* config, Module** m) {
-    Module* src = *m;
+/// Constants are left alone: their values can't contain any of the nodes process() changes.
+bool shd_opt_simplify(SHADY_UNUSED const CompilerConfig* config, Module* m, Node* fn) {
+    const UsesMap* map = shd_get_fn_uses_map(fn);
+    // rewriting the body recreates its basic blocks and drops the function's analyses, even when nothing changes
+    SimplificationFinder finder = {
+        .iv = {
+            .exclude = NcDeclaration | NcType,
+            .filter_fn = (IterativeVisitFilterFn) find_simplification,
+        },
+        .map = map,
+    };
+    shd_visit_iteratively(&finder.iv, shd_singleton(get_abstraction_body(fn)));
+    if (!finder.found)
+        return false;
 
-    IrArena* a = shd_module_get_arena(src);
-    *m = shd_new_module(a, shd_module_get_name(*m));
     bool todo = false;
-    Context ctx = { .todo = &todo };
-    ctx.rewriter = shd_create_node_rewriter(src, *m, (RewriteNodeFn) process);
-    shd_rewrite_module(&ctx.rewriter);
+    Context ctx = {
+        .rewriter = shd_create_in_place_rewriter(m, (RewriteNodeFn) process),
+        .map = map,
+        .todo = &todo
+    };
+    shd_rewrite_fn_body_in_place(&ctx.rewriter, fn);
     shd_destroy_rewriter(&ctx.rewriter);
     return todo;
 }
@@ -136,27 +171,73 @@ OptPass shd_opt_demote_alloca;
 OptPass shd_opt_mem2reg;
 RewritePass shd_import;
 
-Module* shd_cleanup(const CompilerConfig* config, Module* const src) {
+static Module* import_and_destroy(const CompilerConfig* config, Module* m) {
+    Module* imported = shd_import(config, m);
+    shd_destroy_ir_arena(shd_module_get_arena(m));
+    return imported;
+}
+
+/// The optimisations are all function-local and rewrite bodies in place, so a round only needs to look at the
+/// functions that changed in the previous one, and the rest of the module is left untouched until the final import.
+/// Modules the pass manager doesn't own (see shd_is_pass_owned_module) are copied first, @p src itself never changes.
+Module* shd_cleanup_count_rounds(const CompilerConfig* config, Module* const src, size_t* rounds) {
     ArenaConfig aconfig = *shd_get_arena_config(shd_module_get_arena(src));
+    if (rounds)
+        *rounds = 0;
     if (!aconfig.check_types)
         return src;
-    bool todo;
     size_t r = 0;
     Module* m = src;
+    if (!shd_is_pass_owned_module(src))
+        m = shd_import(config, src);
     bool changed_at_all = false;
-    do {
-        todo = false;
-        shd_debugv_print("Cleanup round %d\n", r);
 
-        APPLY_OPT(shd_opt_demote_alloca);
-        APPLY_OPT(shd_opt_mem2reg);
-        APPLY_OPT(shd_opt_simplify);
+    struct List* worklist = shd_new_list(Node*);
+    struct List* next = shd_new_list(Node*);
+    Nodes decls = shd_module_get_declarations(m);
+    for (size_t i = 0; i < decls.count; i++) {
+        if (decls.nodes[i]->tag == Function_TAG && get_abstraction_body(decls.nodes[i]))
+            shd_list_append(Node*, worklist, decls.nodes[i]);
+    }
 
-        changed_at_all |= todo;
+    while (shd_list_count(worklist) > 0) {
+        shd_debugv_print("Cleanup round %d (%d functions)\n", r, shd_list_count(worklist));
+
+        for (size_t i = 0; i < shd_list_count(worklist); i++) {
+            Node* fn = shd_read_list(Node*, worklist)[i];
+            bool todo = false;
+            APPLY_OPT(shd_opt_demote_alloca);
+            APPLY_OPT(shd_opt_mem2reg);
+            APPLY_OPT(shd_opt_simplify);
+            if (todo)
+                shd_list_append(Node*, next, fn);
+        }
 
+        changed_at_all |= shd_list_count(next) > 0;
+        struct List* done = worklist;
+        worklist = next;
+        next = done;
+        shd_clear_list(next);
         r++;
-    } while (todo);
+    }
+    shd_destroy_list(worklist);
+    shd_destroy_list(next);
+
     if (changed_at_all)
         shd_debugv_print("After %d rounds of cleanup:\n", r);
+    if (rounds)
+        *rounds = r;
+    if (m != src) {
+        // the copy is ours, copying it again only gets rid of what the optimisations left behind
+        if (changed_at_all && !config->optimisations.in_place.enabled)
+            return import_and_destroy(config, m);
+        return m;
+    }
+    if (config->optimisations.in_place.enabled)
+        return shd_compact_module(config, m);
     return shd_import(config, m);
 }
+
+Module* shd_cleanup(const CompilerConfig* config, Module* const src) {
+    return shd_cleanup_count_rounds(config, src, NULL);
+}
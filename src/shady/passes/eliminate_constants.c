@@ -17,7 +17,7 @@ static const Node* process(Context* ctx, const Node* node) {
         case Constant_TAG:
             if (!node->payload.constant.value)
                 break;
-            if (!ctx->all && !shd_lookup_annotation(node, "Inline"))
+            if (!ctx->all && !shd_lookup_well_known_annotation(node, AnnInline))
                 break;
             return NULL;
         case RefDecl_TAG: {
@@ -33,9 +33,8 @@ static const Node* process(Context* ctx, const Node* node) {
     return shd_recreate_node(&ctx->rewriter, node);
 }
 
-static Module* eliminate_constants_(SHADY_UNUSED const CompilerConfig* config, Module* src, bool all) {
-    ArenaConfig aconfig = *shd_get_arena_config(shd_module_get_arena(src));
-    IrArena* a = shd_new_ir_arena(&aconfig);
+static Module* eliminate_constants_(const CompilerConfig* config, Module* src, bool all) {
+    IrArena* a = shd_get_pass_dst_arena(config, src);
     Module* dst = shd_new_module(a, shd_module_get_name(src));
     Context ctx = {
         .rewriter = shd_create_node_rewriter(src, dst, (RewriteNodeFn) process),
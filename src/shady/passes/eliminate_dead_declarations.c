@@ -0,0 +1,92 @@
+#include "shady/pass.h"
+#include "shady/visit.h"
+#include "shady/ir/annotation.h"
+
+#include "../node_map.h"
+
+#include "portability.h"
+#include "log.h"
+
+typedef struct {
+    IterativeVisitor visitor;
+    NodeMap* live;
+} LiveDeclarations;
+
+static void mark_live_declaration(LiveDeclarations* v, const Node* node) {
+    if (is_declaration(node))
+        shd_node_set_insert(v->live, node);
+}
+
+/// Declarations that must survive: the entry point we're specializing for if there is one, or everything the module
+/// exports otherwise, and whatever asks to be kept around for later passes.
+/// Internal declarations are runtime code that lowering passes look up by name, so we can't tell if they're dead yet.
+static bool is_root(const CompilerConfig* config, const Node* entry_point, const Node* decl) {
+    if (shd_lookup_well_known_annotation(decl, AnnRetainAfterSpecialization))
+        return true;
+    if (shd_lookup_well_known_annotation(decl, AnnInternal))
+        return true;
+    if (entry_point)
+        return decl == entry_point;
+    return shd_lookup_well_known_annotation(decl, AnnExported);
+}
+
+/// Set of the declarations of @p src reachable from the roots (see is_root), and from only the exported ones among them if @p exported_roots is set.
+static NodeMap* find_live_declarations(const CompilerConfig* config, Module* src, bool exported_roots) {
+    Nodes old_decls = shd_module_get_declarations(src);
+    const Node* entry_point = config->specialization.entry_point ? shd_module_get_declaration(src, config->specialization.entry_point) : NULL;
+
+    LiveDeclarations v = {
+        .visitor = { .visit_post_fn = (IterativeVisitNodeFn) mark_live_declaration },
+        .live = shd_new_node_set(),
+    };
+    size_t roots_count = 0;
+    LARRAY(const Node*, roots, old_decls.count + 1);
+    for (size_t i = 0; i < old_decls.count; i++) {
+        const Node* decl = old_decls.nodes[i];
+        if (exported_roots && !shd_lookup_well_known_annotation(decl, AnnExported))
+            continue;
+        if (is_root(config, entry_point, decl))
+            roots[roots_count++] = decl;
+    }
+    shd_visit_iteratively(&v.visitor, shd_nodes(shd_module_get_arena(src), roots_count, roots));
+    return v.live;
+}
+
+static Module* copy_live_declarations(Module* src, NodeMap* live, IrArena* a) {
+    Nodes old_decls = shd_module_get_declarations(src);
+    Module* dst = shd_new_module(a, shd_module_get_name(src));
+    Rewriter rewriter = shd_create_node_rewriter(src, dst, (RewriteNodeFn) shd_recreate_node);
+    // rewriting them in their original order keeps the output stable
+    for (size_t i = 0; i < old_decls.count; i++) {
+        if (shd_node_map_contains(live, old_decls.nodes[i]))
+            shd_rewrite_node(&rewriter, old_decls.nodes[i]);
+    }
+    shd_destroy_rewriter(&rewriter);
+    return dst;
+}
+
+/// Copies a subset of what shd_import would: with an entry point set, the other exported declarations, and whatever only
+/// they reach, are never imported in the first place.
+Module* shd_import_live_declarations(const CompilerConfig* config, Module* src) {
+    NodeMap* live = find_live_declarations(config, src, true);
+    shd_debugv_print("Importing %zu reachable declarations out of %zu\n", shd_node_map_count(live), shd_module_get_declarations(src).count);
+    ArenaConfig aconfig = *shd_get_arena_config(shd_module_get_arena(src));
+    Module* dst = copy_live_declarations(src, live, shd_new_ir_arena(&aconfig));
+    shd_destroy_node_map(live);
+    return dst;
+}
+
+Module* shd_pass_eliminate_dead_declarations(const CompilerConfig* config, Module* src) {
+    NodeMap* live = find_live_declarations(config, src, false);
+    size_t live_count = shd_node_map_count(live);
+    size_t decls_count = shd_module_get_declarations(src).count;
+    if (live_count == decls_count) {
+        shd_destroy_node_map(live);
+        return src;
+    }
+    shd_debugv_print("Eliminating %zu unreachable declarations out of %zu\n", decls_count - live_count, decls_count);
+
+    Module* dst = copy_live_declarations(src, live, shd_get_pass_dst_arena(config, src));
+    shd_destroy_node_map(live);
+    return dst;
+}
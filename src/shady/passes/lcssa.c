@@ -3,12 +3,14 @@
 
 #include "shady/rewrite.h"
 #include "../ir_private.h"
+#include "../node_map.h"
 #include "../analysis/cfg.h"
 #include "../analysis/scheduler.h"
 #include "../analysis/looptree.h"
 #include "../analysis/uses.h"
 #include "../analysis/leak.h"
 #include "../analysis/free_frontier.h"
+#include "../analysis/manager.h"
 
 #include "portability.h"
 #include "log.h"
@@ -54,9 +56,9 @@ static void find_liftable_loop_values(Context* ctx, const Node* old, Nodes* npar
 
     const LTNode* bb_loop = get_loop(looptree_lookup(ctx->loop_tree, old));
 
-    *nparams = shd_empty(a);
-    *lparams = shd_empty(a);
-    *nargs = shd_empty(a);
+    NodesBuilder nparams_builder = { 0 };
+    NodesBuilder lparams_builder = { 0 };
+    NodesBuilder nargs_builder = { 0 };
 
     struct Dict* fvs = free_frontier(ctx->scheduler, ctx->cfg, old);
     const Node* fv;
@@ -71,12 +73,15 @@ static void find_liftable_loop_values(Context* ctx, const Node* old, Nodes* npar
             shd_log_fmt(DEBUGV, " (%%%d) is used outside of the loop that defines it %s %s\n", fv->id, loop_name(defining_loop), loop_name(bb_loop));
             const Node* narg = shd_rewrite_node(&ctx->rewriter, fv);
             const Node* nparam = param(a, narg->type, "lcssa_phi");
-            *nparams = shd_nodes_append(a, *nparams, nparam);
-            *lparams = shd_nodes_append(a, *lparams, fv);
-            *nargs = shd_nodes_append(a, *nargs, narg);
+            shd_nodes_builder_append(&nparams_builder, nparam);
+            shd_nodes_builder_append(&lparams_builder, fv);
+            shd_nodes_builder_append(&nargs_builder, narg);
         }
     }
     shd_destroy_dict(fvs);
+    *nparams = shd_nodes_builder_finish(a, &nparams_builder);
+    *lparams = shd_nodes_builder_finish(a, &lparams_builder);
+    *nargs = shd_nodes_builder_finish(a, &nargs_builder);
 
     if (nparams->count > 0)
         shd_dict_insert(const Node*, Nodes, ctx->lifted_arguments, old, *nparams);
@@ -95,9 +100,9 @@ static const Node* process_abstraction_body(Context* ctx, const Node* old, const
     const CFNode* n = cfg_lookup(ctx->cfg, old);
 
     size_t children_count = 0;
-    LARRAY(const Node*, old_children, shd_list_count(n->dominates));
-    for (size_t i = 0; i < shd_list_count(n->dominates); i++) {
-        CFNode* c = shd_read_list(CFNode*, n->dominates)[i];
+    LARRAY(const Node*, old_children, n->dominates.count);
+    for (size_t i = 0; i < n->dominates.count; i++) {
+        CFNode* c = n->dominates.nodes[i];
         if (is_cfnode_structural_target(c))
             continue;
         old_children[children_count++] = c->node;
@@ -118,17 +123,17 @@ static const Node* process_abstraction_body(Context* ctx, const Node* old, const
 
     const Node* new = shd_rewrite_node(&ctx->rewriter, body);
 
-    ctx->rewriter.map = shd_clone_dict(ctx->rewriter.map);
+    ctx->rewriter.map = shd_clone_node_map(ctx->rewriter.map);
 
     for (size_t i = 0; i < children_count; i++) {
         for (size_t j = 0; j < lifted_params[i].count; j++) {
-            shd_dict_remove(const Node*, ctx->rewriter.map, lifted_params[i].nodes[j]);
+            shd_node_map_remove(ctx->rewriter.map, lifted_params[i].nodes[j]);
         }
         shd_register_processed_list(&ctx->rewriter, lifted_params[i], new_params[i]);
         new_children[i]->payload.basic_block.body = process_abstraction_body(ctx, old_children[i], get_abstraction_body(old_children[i]));
     }
 
-    shd_destroy_dict(ctx->rewriter.map);
+    shd_destroy_node_map(ctx->rewriter.map);
 
     return new;
 }
@@ -151,16 +156,12 @@ static const Node* process_node(Context* ctx, const Node* old) {
             ctx = &fn_ctx;
 
             ctx->current_fn = old;
-            ctx->cfg = build_fn_cfg(old);
-            ctx->scheduler = new_scheduler(ctx->cfg);
-            ctx->loop_tree = build_loop_tree(ctx->cfg);
+            ctx->cfg = shd_get_fn_cfg(old);
+            ctx->scheduler = shd_get_scheduler(ctx->cfg);
+            ctx->loop_tree = shd_get_loop_tree(ctx->cfg);
 
             Node* new = shd_recreate_node_head(&ctx->rewriter, old);
             new->payload.fun.body = process_abstraction_body(ctx, old, get_abstraction_body(old));
-
-            destroy_loop_tree(ctx->loop_tree);
-            destroy_scheduler(ctx->scheduler);
-            destroy_cfg(ctx->cfg);
             return new;
         }
         case Jump_TAG: {
@@ -6,6 +6,7 @@
 #include "../analysis/cfg.h"
 #include "../analysis/scheduler.h"
 #include "../analysis/free_frontier.h"
+#include "../analysis/manager.h"
 
 #include "log.h"
 #include "dict.h"
@@ -27,14 +28,11 @@ static const Node* process(Context* ctx, const Node* node) {
     switch (node->tag) {
         case Function_TAG: {
             Context fn_ctx = *ctx;
-            fn_ctx.cfg = build_fn_cfg(node);
-            fn_ctx.scheduler = new_scheduler(fn_ctx.cfg);
+            fn_ctx.cfg = shd_get_fn_cfg(node);
+            fn_ctx.scheduler = shd_get_scheduler(fn_ctx.cfg);
 
             Node* new_fn = shd_recreate_node_head(r, node);
             shd_recreate_node_body(&fn_ctx.rewriter, node, new_fn);
-
-            destroy_scheduler(fn_ctx.scheduler);
-            destroy_cfg(fn_ctx.cfg);
             return new_fn;
         }
         case BasicBlock_TAG: {
@@ -44,9 +42,10 @@ static const Node* process(Context* ctx, const Node* node) {
             struct Dict* frontier = free_frontier(ctx->scheduler, ctx->cfg, node);
             // insert_dict(const Node*, Dict*, ctx->lift, node, frontier);
 
-            Nodes additional_args = shd_empty(a);
-            Nodes new_params = shd_recreate_params(r, get_abstraction_params(node));
-            shd_register_processed_list(r, get_abstraction_params(node), new_params);
+            NodesBuilder additional_args_builder = { 0 };
+            Nodes recreated_params = shd_recreate_params(r, get_abstraction_params(node));
+            shd_register_processed_list(r, get_abstraction_params(node), recreated_params);
+            NodesBuilder new_params_builder = shd_nodes_builder_from(recreated_params);
             size_t i = 0;
             const Node* value;
 
@@ -55,15 +54,17 @@ static const Node* process(Context* ctx, const Node* node) {
 
             while (shd_dict_iter(frontier, &i, &value, NULL)) {
                 if (is_value(value)) {
-                    additional_args = shd_nodes_append(a, additional_args, value);
+                    shd_nodes_builder_append(&additional_args_builder, value);
                     const Type* t = shd_rewrite_node(r, value->type);
                     const Node* p = param(a, t, NULL);
-                    new_params = shd_nodes_append(a, new_params, p);
+                    shd_nodes_builder_append(&new_params_builder, p);
                     shd_register_processed(&bb_ctx.rewriter, value, p);
                 }
             }
 
             shd_destroy_dict(frontier);
+            Nodes additional_args = shd_nodes_builder_finish(a, &additional_args_builder);
+            Nodes new_params = shd_nodes_builder_finish(a, &new_params_builder);
             shd_dict_insert(const Node*, Nodes, ctx->lift, node, additional_args);
             Node* new_bb = basic_block(a, new_params, shd_get_abstraction_name_unsafe(node));
 
@@ -3,6 +3,7 @@
 
 #include "../type.h"
 #include "../ir_private.h"
+#include "../node_map.h"
 #include "shady/visit.h"
 
 #include "../transform/ir_gen_helpers.h"
@@ -11,13 +12,15 @@
 #include "../analysis/leak.h"
 #include "../analysis/verify.h"
 #include "../analysis/scheduler.h"
-#include "../analysis/free_frontier.h"
+#include "../analysis/liveness.h"
+#include "../analysis/manager.h"
 
 #include "log.h"
 #include "portability.h"
 #include "list.h"
 #include "dict.h"
 #include "util.h"
+#include "arena.h"
 
 #include <assert.h>
 
@@ -59,16 +62,114 @@ static const Node* add_spill_instrs(Context* ctx, BodyBuilder* builder, Nodes sp
     return gen_get_stack_size(builder);
 }
 
-static Nodes set2nodes(IrArena* a, struct Dict* set) {
-    size_t count = shd_dict_count(set);
-    LARRAY(const Node*, tmp, count);
-    size_t i = 0, j = 0;
-    const Node* key;
-    while (shd_dict_iter(set, &i, &key, NULL)) {
-        tmp[j++] = key;
+/// Spilling a value costs a push where the continuation is lifted, and a pop in the lifted function, both going through
+/// memory. Recomputing it costs an instruction for each node that has to be redone, which stays cheaper up to this many.
+#define MAX_REMAT_COST 4
+
+/// Input builtins don't change during an invocation, loading them again gives back the same value.
+static bool is_invariant_builtin_load(const Node* n) {
+    Builtin b;
+    if (n->tag != Load_TAG || !is_builtin_load_op(n, &b))
+        return false;
+    AddressSpace as = shd_get_builtin_address_space(b);
+    return as == AsInput || as == AsUInput;
+}
+
+static bool is_cheap_to_recompute(const Node* n) {
+    switch (n->tag) {
+        case PrimOp_TAG: {
+            Op op = n->payload.prim_op.op;
+            if (shd_get_primop_class(op) & (OcArithmetic | OcLogic | OcCompare | OcShift))
+                return true;
+            switch (op) {
+                case select_op:
+                case convert_op:
+                case reinterpret_op:
+                case extract_op:
+                case insert_op:
+                case subgroup_assume_uniform_op:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+        case PtrCompositeElement_TAG:
+        case PtrArrayElementOffset_TAG:
+            return true;
+        default:
+            return is_invariant_builtin_load(n);
+    }
+}
+
+/// @p storage holds the operands of nodes that don't keep them in a list already, so nothing gets interned for this.
+static Nodes get_recompute_operands(const Node* n, const Node* storage[2]) {
+    switch (n->tag) {
+        case PrimOp_TAG: return n->payload.prim_op.operands;
+        case PtrCompositeElement_TAG:
+            storage[0] = n->payload.ptr_composite_element.ptr;
+            storage[1] = n->payload.ptr_composite_element.index;
+            return (Nodes) { .count = 2, .nodes = storage };
+        case PtrArrayElementOffset_TAG:
+            storage[0] = n->payload.ptr_array_element_offset.ptr;
+            storage[1] = n->payload.ptr_array_element_offset.offset;
+            return (Nodes) { .count = 2, .nodes = storage };
+        case Load_TAG:
+            storage[0] = n->payload.load.ptr;
+            return (Nodes) { .count = 1, .nodes = storage };
+        default: shd_error("not a recomputable node")
+    }
+}
+
+typedef struct {
+    Scheduler* scheduler;
+    /// The values the lifted continuation needs
+    NodeMap* live;
+    /// const @ref Node* -> int, memoizes get_remat_cost
+    NodeMap* costs;
+} RematPlanner;
+
+/// What it takes to have @p n in the lifted function, past MAX_REMAT_COST it has to come from the stack.
+/// Live operands are free, since they are either spilled or recomputed anyways.
+static int get_remat_cost(RematPlanner* p, const Node* n) {
+    // top-level values are available everywhere
+    if (!schedule_instruction(p->scheduler, n))
+        return 0;
+    int* found = shd_node_map_find(int, p->costs, n);
+    if (found)
+        return *found;
+
+    int cost = MAX_REMAT_COST + 1;
+    if (is_cheap_to_recompute(n)) {
+        cost = 1;
+        const Node* storage[2];
+        Nodes ops = get_recompute_operands(n, storage);
+        for (size_t i = 0; i < ops.count && cost <= MAX_REMAT_COST; i++) {
+            if (!shd_node_map_contains(p->live, ops.nodes[i]))
+                cost += get_remat_cost(p, ops.nodes[i]);
+        }
+        if (cost > MAX_REMAT_COST)
+            cost = MAX_REMAT_COST + 1;
+    }
+    shd_node_map_insert(int, p->costs, n, cost);
+    return cost;
+}
+
+/// Pure nodes get recreated on their own when the body is rewritten, but builtin loads need a mem to go in the lifted
+/// function. They are re-emitted right after the spilled values are recovered.
+/// Other live values are spilled, or recomputed themselves: only the operands that aren't get looked into.
+static void reload_builtins(RematPlanner* p, Rewriter* r, BodyBuilder* bb, NodeMap* done, const Node* n) {
+    if (!schedule_instruction(p->scheduler, n) || !is_cheap_to_recompute(n) || !shd_node_set_insert(done, n))
+        return;
+    if (is_invariant_builtin_load(n)) {
+        shd_register_processed(r, n, gen_load(bb, shd_rewrite_node(r, n->payload.load.ptr)));
+        return;
+    }
+    const Node* storage[2];
+    Nodes ops = get_recompute_operands(n, storage);
+    for (size_t i = 0; i < ops.count; i++) {
+        if (!shd_node_map_contains(p->live, ops.nodes[i]))
+            reload_builtins(p, r, bb, done, ops.nodes[i]);
     }
-    assert(j == count);
-    return shd_nodes(a, count, tmp);
 }
 
 static LiftedCont* lambda_lift(Context* ctx, CFG* cfg, const Node* liftee) {
@@ -81,31 +182,51 @@ static LiftedCont* lambda_lift(Context* ctx, CFG* cfg, const Node* liftee) {
     const Node* obody = get_abstraction_body(liftee);
     String name = shd_get_abstraction_name_safe(liftee);
 
-    Scheduler* scheduler = new_scheduler(cfg);
-    struct Dict* frontier_set = free_frontier(scheduler, cfg, liftee);
-    Nodes frontier = set2nodes(a, frontier_set);
-    shd_destroy_dict(frontier_set);
-
-    size_t recover_context_size = frontier.count;
+    Scheduler* scheduler = shd_get_scheduler(cfg);
+    Nodes live = get_live_ins(a, shd_get_liveness(cfg), liftee);
+
+    // split what the continuation needs between what gets spilled and what gets recomputed
+    Arena* scratch = shd_get_scratch_arena();
+    ArenaMark mark = shd_arena_mark(scratch);
+    RematPlanner planner = {
+        .scheduler = scheduler,
+        .live = shd_new_node_set_in(scratch),
+        .costs = shd_new_node_map_in(int, scratch),
+    };
+    for (size_t i = 0; i < live.count; i++)
+        shd_node_set_insert(planner.live, live.nodes[i]);
+    LARRAY(const Node*, spilled_arr, live.count + 1);
+    LARRAY(const Node*, recomputed_arr, live.count + 1);
+    size_t spilled_count = 0, recomputed_count = 0;
+    for (size_t i = 0; i < live.count; i++) {
+        const Node* value = live.nodes[i];
+        if (get_remat_cost(&planner, value) <= MAX_REMAT_COST)
+            recomputed_arr[recomputed_count++] = value;
+        else
+            spilled_arr[spilled_count++] = value;
+    }
+    Nodes spilled = shd_nodes(a, spilled_count, spilled_arr);
+    Nodes recomputed = shd_nodes(a, recomputed_count, recomputed_arr);
 
-    destroy_scheduler(scheduler);
+    size_t recover_context_size = spilled.count;
 
     Context lifting_ctx = *ctx;
     lifting_ctx.rewriter = shd_create_decl_rewriter(&ctx->rewriter);
     Rewriter* r = &lifting_ctx.rewriter;
 
     Nodes ovariables = get_abstraction_params(liftee);
-    shd_debugv_print("lambda_lift: free (to-be-spilled) variables at '%s' (count=%d): ", shd_get_abstraction_name_safe(liftee), recover_context_size);
+    shd_debugv_print("lambda_lift: spilled variables at '%s' (count=%d): ", shd_get_abstraction_name_safe(liftee), recover_context_size);
     for (size_t i = 0; i < recover_context_size; i++) {
-        const Node* item = frontier.nodes[i];
-        if (!is_value(item)) {
-            //lambda_lift()
-            continue;
-        }
-        shd_debugv_print("%%%d", item->id);
+        shd_debugv_print("%%%d", spilled.nodes[i]->id);
         if (i + 1 < recover_context_size)
             shd_debugv_print(", ");
     }
+    shd_debugv_print(", recomputed (count=%d): ", recomputed.count);
+    for (size_t i = 0; i < recomputed.count; i++) {
+        shd_debugv_print("%%%d", recomputed.nodes[i]->id);
+        if (i + 1 < recomputed.count)
+            shd_debugv_print(", ");
+    }
     shd_debugv_print("\n");
 
     // Create and register new parameters for the lifted continuation
@@ -116,7 +237,7 @@ static LiftedCont* lambda_lift(Context* ctx, CFG* cfg, const Node* liftee) {
 
     LiftedCont* lifted_cont = calloc(sizeof(LiftedCont), 1);
     lifted_cont->old_cont = liftee;
-    lifted_cont->save_values = frontier;
+    lifted_cont->save_values = spilled;
     shd_dict_insert(const Node*, LiftedCont*, ctx->lifted, liftee, lifted_cont);
 
     shd_register_processed_list(r, ovariables, new_params);
@@ -133,7 +254,7 @@ static LiftedCont* lambda_lift(Context* ctx, CFG* cfg, const Node* liftee) {
     BodyBuilder* bb = begin_body_with_mem(a, shd_get_abstraction_mem(new_fn));
     gen_set_stack_size(bb, payload);
     for (size_t i = recover_context_size - 1; i < recover_context_size; i--) {
-        const Node* ovar = frontier.nodes[i];
+        const Node* ovar = spilled.nodes[i];
         // assert(ovar->tag == Variable_TAG);
 
         const Type* value_type = shd_rewrite_node(r, ovar->type);
@@ -149,6 +270,11 @@ static LiftedCont* lambda_lift(Context* ctx, CFG* cfg, const Node* liftee) {
         shd_register_processed(r, ovar, recovered_value);
     }
 
+    NodeMap* reloaded = shd_new_node_set_in(scratch);
+    for (size_t i = 0; i < recomputed.count; i++)
+        reload_builtins(&planner, r, bb, reloaded, recomputed.nodes[i]);
+    shd_arena_rewind(scratch, mark);
+
     shd_register_processed(r, shd_get_abstraction_mem(liftee), bb_mem(bb));
     shd_register_processed(r, liftee, new_fn);
     const Node* substituted = shd_rewrite_node(r, obody);
@@ -170,16 +296,13 @@ static const Node* process_node(Context* ctx, const Node* node) {
                 ctx = (Context*) ctx->rewriter.parent;
 
             Context fn_ctx = *ctx;
-            fn_ctx.cfg = build_fn_cfg(node);
-            fn_ctx.uses = create_fn_uses_map(node, (NcDeclaration | NcType));
-            fn_ctx.disable_lowering = shd_lookup_annotation(node, "Internal");
+            fn_ctx.cfg = shd_get_fn_cfg(node);
+            fn_ctx.uses = shd_get_fn_uses_map(node);
+            fn_ctx.disable_lowering = shd_lookup_well_known_annotation(node, AnnInternal);
             ctx = &fn_ctx;
 
             Node* new = shd_recreate_node_head(&ctx->rewriter, node);
             shd_recreate_node_body(&ctx->rewriter, node, new);
-
-            destroy_uses_map(ctx->uses);
-            destroy_cfg(ctx->cfg);
             return new;
         }
         default:
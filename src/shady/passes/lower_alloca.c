@@ -95,7 +95,7 @@ static const Node* process(Context* ctx, const Node* node) {
             ctx2.stack_size_on_entry = gen_get_stack_size(bb);
             shd_set_value_name((Node*) ctx2.stack_size_on_entry, "stack_size_before_alloca");
 
-            Node* nom_t = nominal_type(m, shd_empty(a), shd_format_string_arena(a->arena, "%s_stack_frame", shd_get_abstraction_name(node)));
+            Node* nom_t = nominal_type(m, shd_empty(a), shd_format_string_arena(_shd_get_ir_arena_allocator(a), "%s_stack_frame", shd_get_abstraction_name(node)));
             VContext vctx = {
                 .visitor = {
                     .visit_node_fn = (VisitNodeFn) search_operand_for_alloca,
@@ -163,9 +163,8 @@ static const Node* process(Context* ctx, const Node* node) {
     return shd_recreate_node(&ctx->rewriter, node);
 }
 
-Module* shd_pass_lower_alloca(SHADY_UNUSED const CompilerConfig* config, Module* src) {
-    ArenaConfig aconfig = *shd_get_arena_config(shd_module_get_arena(src));
-    IrArena* a = shd_new_ir_arena(&aconfig);
+Module* shd_pass_lower_alloca(const CompilerConfig* config, Module* src) {
+    IrArena* a = shd_get_pass_dst_arena(config, src);
     Module* dst = shd_new_module(a, shd_module_get_name(src));
     Context ctx = {
         .rewriter = shd_create_node_rewriter(src, dst, (RewriteNodeFn) process),
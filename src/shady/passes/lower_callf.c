@@ -25,7 +25,7 @@ static const Node* lower_callf_process(Context* ctx, const Node* old) {
 
     if (old->tag == Function_TAG) {
         Context ctx2 = *ctx;
-        ctx2.disable_lowering = shd_lookup_annotation(old, "Leaf");
+        ctx2.disable_lowering = shd_lookup_well_known_annotation(old, AnnLeaf);
         ctx2.return_jp = NULL;
 
         if (!ctx2.disable_lowering && get_abstraction_body(old)) {
@@ -107,7 +107,7 @@ static const Node* lower_callf_process(Context* ctx, const Node* old) {
             Call payload = old->payload.call;
             const Node* ocallee = payload.callee;
             // if we know the callee and it's a leaf - then we don't change the call
-            if (ocallee->tag == FnAddr_TAG && shd_lookup_annotation(ocallee->payload.fn_addr.fn, "Leaf"))
+            if (ocallee->tag == FnAddr_TAG && shd_lookup_well_known_annotation(ocallee->payload.fn_addr.fn, AnnLeaf))
                 break;
 
             const Type* ocallee_type = ocallee->type;
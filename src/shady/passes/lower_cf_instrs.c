@@ -2,6 +2,7 @@
 
 #include "../type.h"
 #include "../analysis/cfg.h"
+#include "../analysis/manager.h"
 
 #include "log.h"
 #include "portability.h"
@@ -25,11 +26,10 @@ static const Node* process_node(Context* ctx, const Node* node) {
     Context sub_ctx = *ctx;
     if (node->tag == Function_TAG) {
         Node* fun = shd_recreate_node_head(&ctx->rewriter, node);
-        sub_ctx.disable_lowering = shd_lookup_annotation(fun, "Structured");
+        sub_ctx.disable_lowering = shd_lookup_well_known_annotation(fun, AnnStructured);
         sub_ctx.current_fn = fun;
-        sub_ctx.cfg = build_fn_cfg(node);
+        sub_ctx.cfg = shd_get_fn_cfg(node);
         shd_set_abstraction_body(fun, shd_rewrite_node(&sub_ctx.rewriter, node->payload.fun.body));
-        destroy_cfg(sub_ctx.cfg);
         return fun;
     } else if (node->tag == Constant_TAG) {
         sub_ctx.cfg = NULL;
@@ -77,7 +77,7 @@ static const Node* rewrite_body(Context* ctx, const Node* old_entry_point, const
 static const Node* process(Context* ctx, const Node* node) {
     switch (node->tag) {
         case Function_TAG:
-            if (shd_lookup_annotation(node, "EntryPoint") && node->payload.fun.params.count > 0) {
+            if (shd_lookup_well_known_annotation(node, AnnEntryPoint) && node->payload.fun.params.count > 0) {
                 Node* new_entry_point = rewrite_entry_point_fun(ctx, node);
                 const Node* arg_struct = generate_arg_struct(&ctx->rewriter, node, new_entry_point);
                 shd_set_abstraction_body(new_entry_point, rewrite_body(ctx, node, new_entry_point, arg_struct));
@@ -91,8 +91,7 @@ static const Node* process(Context* ctx, const Node* node) {
 }
 
 Module* shd_pass_lower_entrypoint_args(const CompilerConfig* config, Module* src) {
-    ArenaConfig aconfig = *shd_get_arena_config(shd_module_get_arena(src));
-    IrArena* a = shd_new_ir_arena(&aconfig);
+    IrArena* a = shd_get_pass_dst_arena(config, src);
     Module* dst = shd_new_module(a, shd_module_get_name(src));
     Context ctx = {
         .rewriter = shd_create_node_rewriter(src, dst, (RewriteNodeFn) process),
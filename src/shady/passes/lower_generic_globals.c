@@ -42,9 +42,8 @@ static const Node* process(Context* ctx, const Node* node) {
     return shd_recreate_node(&ctx->rewriter, node);
 }
 
-Module* shd_pass_lower_generic_globals(SHADY_UNUSED const CompilerConfig* config, Module* src) {
-    ArenaConfig aconfig = *shd_get_arena_config(shd_module_get_arena(src));
-    IrArena* a = shd_new_ir_arena(&aconfig);
+Module* shd_pass_lower_generic_globals(const CompilerConfig* config, Module* src) {
+    IrArena* a = shd_get_pass_dst_arena(config, src);
     Module* dst = shd_new_module(a, shd_module_get_name(src));
     Context ctx = {
         .rewriter = shd_create_node_rewriter(src, dst, (RewriteNodeFn) process),
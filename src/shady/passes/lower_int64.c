@@ -87,6 +87,8 @@ Module* shd_pass_lower_int(const CompilerConfig* config, Module* src) {
         .rewriter = shd_create_node_rewriter(src, dst, (RewriteNodeFn) process),
         .config = config,
     };
+    ctx.rewriter.config.function_local = true;
+    ctx.rewriter.config.context_size = sizeof(Context);
     shd_rewrite_module(&ctx.rewriter);
     shd_destroy_rewriter(&ctx.rewriter);
     return dst;
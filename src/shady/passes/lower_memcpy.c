@@ -125,14 +125,15 @@ static const Node* process(Context* ctx, const Node* old) {
     return shd_recreate_node(&ctx->rewriter, old);
 }
 
-Module* shd_pass_lower_memcpy(SHADY_UNUSED const CompilerConfig* config, Module* src) {
-    ArenaConfig aconfig = *shd_get_arena_config(shd_module_get_arena(src));
-    IrArena* a = shd_new_ir_arena(&aconfig);
+Module* shd_pass_lower_memcpy(const CompilerConfig* config, Module* src) {
+    IrArena* a = shd_get_pass_dst_arena(config, src);
     Module* dst = shd_new_module(a, shd_module_get_name(src));
 
     Context ctx = {
             .rewriter = shd_create_node_rewriter(src, dst, (RewriteNodeFn) process)
     };
+    ctx.rewriter.config.function_local = true;
+    ctx.rewriter.config.context_size = sizeof(Context);
     shd_rewrite_module(&ctx.rewriter);
     shd_destroy_rewriter(&ctx.rewriter);
     return dst;
@@ -269,7 +269,7 @@ static const Node* gen_serdes_fn(Context* ctx, const Type* element_type, bool un
     const Type* return_value_t = qualified_type(a, (QualifiedType) { .is_uniform = !a->config.is_simt || (uniform_address && is_addr_space_uniform(a, as)), .type = element_type });
     Nodes return_ts = ser ? shd_empty(a) : shd_singleton(return_value_t);
 
-    String name = shd_format_string_arena(a->arena, "generated_%s_%s_%s_%s", ser ? "store" : "load", get_address_space_name(as), uniform_address ? "uniform" : "varying", name_type_safe(a, element_type));
+    String name = shd_format_string_arena(_shd_get_ir_arena_allocator(a), "generated_%s_%s_%s_%s", ser ? "store" : "load", get_address_space_name(as), uniform_address ? "uniform" : "varying", name_type_safe(a, element_type));
     Node* fun = function(ctx->rewriter.dst_module, params, name, mk_nodes(a, annotation(a, (Annotation) { .name = "Generated" }), annotation(a, (Annotation) { .name = "Leaf" })), return_ts);
     shd_dict_insert(const Node*, Node*, cache, element_type, fun);
 
@@ -336,7 +336,7 @@ static const Node* process_node(Context* ctx, const Node* old) {
         case GlobalVariable_TAG: {
             const GlobalVariable* old_gvar = &old->payload.global_variable;
             // Global variables into emulated address spaces become integer constants (to index into arrays used for emulation of said address space)
-            if (!shd_lookup_annotation(old, "Logical") && is_as_emulated(ctx, old_gvar->address_space)) {
+            if (!shd_lookup_well_known_annotation(old, AnnLogical) && is_as_emulated(ctx, old_gvar->address_space)) {
                 assert(false);
             }
             break;
@@ -374,7 +374,7 @@ static Nodes collect_globals(Context* ctx, AddressSpace as) {
         const Node* decl = old_decls.nodes[i];
         if (decl->tag != GlobalVariable_TAG) continue;
         if (decl->payload.global_variable.address_space != as) continue;
-        if (shd_lookup_annotation(decl, "Logical")) continue;
+        if (shd_lookup_well_known_annotation(decl, AnnLogical)) continue;
         collected[members_count] = decl;
         members_count++;
     }
@@ -388,7 +388,7 @@ static const Node* make_record_type(Context* ctx, AddressSpace as, Nodes collect
     Module* m = ctx->rewriter.dst_module;
 
     String as_name = get_address_space_name(as);
-    Node* global_struct_t = nominal_type(m, shd_singleton(annotation(a, (Annotation) { .name = "Generated" })), shd_format_string_arena(a->arena, "globals_physical_%s_t", as_name));
+    Node* global_struct_t = nominal_type(m, shd_singleton(annotation(a, (Annotation) { .name = "Generated" })), shd_format_string_arena(_shd_get_ir_arena_allocator(a), "globals_physical_%s_t", as_name));
 
     LARRAY(String, member_names, collected.count);
     LARRAY(const Type*, member_tys, collected.count);
@@ -475,7 +475,7 @@ static void construct_emulated_memory_array(Context* ctx, AddressSpace as) {
         .size = ref_decl_helper(a, constant_decl)
     });
 
-    Node* words_array = global_var(m, shd_nodes_append(a, annotations, annotation(a, (Annotation) { .name = "Logical" })), words_array_type, shd_format_string_arena(a->arena, "memory_%s", as_name), as);
+    Node* words_array = global_var(m, shd_nodes_append(a, annotations, annotation(a, (Annotation) { .name = "Logical" })), words_array_type, shd_format_string_arena(_shd_get_ir_arena_allocator(a), "memory_%s", as_name), as);
 
     *get_emulated_as_word_array(ctx, as) = ref_decl_helper(a, words_array);
 }
@@ -40,7 +40,7 @@ static const Node* gen_fn(Context* ctx, const Type* element_type, bool push) {
     const Node* value_param = push ? param(a, qualified_t, "value") : NULL;
     Nodes params = push ? shd_singleton(value_param) : shd_empty(a);
     Nodes return_ts = push ? shd_empty(a) : shd_singleton(qualified_t);
-    String name = shd_format_string_arena(a->arena, "generated_%s_%s", push ? "push" : "pop", name_type_safe(a, element_type));
+    String name = shd_format_string_arena(_shd_get_ir_arena_allocator(a), "generated_%s_%s", push ? "push" : "pop", name_type_safe(a, element_type));
     Node* fun = function(ctx->rewriter.dst_module, params, name, mk_nodes(a, annotation(a, (Annotation) { .name = "Generated" }), annotation(a, (Annotation) { .name = "Leaf" })), return_ts);
     shd_dict_insert(const Node*, Node*, cache, element_type, fun);
 
@@ -174,9 +174,8 @@ static const Node* process_node(Context* ctx, const Node* old) {
 KeyHash shd_hash_node(Node** pnode);
 bool shd_compare_node(Node** pa, Node** pb);
 
-Module* shd_pass_lower_stack(SHADY_UNUSED const CompilerConfig* config, Module* src) {
-    ArenaConfig aconfig = *shd_get_arena_config(shd_module_get_arena(src));
-    IrArena* a = shd_new_ir_arena(&aconfig);
+Module* shd_pass_lower_stack(const CompilerConfig* config, Module* src) {
+    IrArena* a = shd_get_pass_dst_arena(config, src);
     Module* dst = shd_new_module(a, shd_module_get_name(src));
 
     Context ctx = {
@@ -2,8 +2,8 @@
 
 #include "../type.h"
 #include "../transform/ir_gen_helpers.h"
+#include "../node_map.h"
 
-#include "dict.h"
 #include "portability.h"
 #include "log.h"
 
@@ -22,8 +22,7 @@ static const Node* process(Context* ctx, const Node* node) {
             Node* newfun = shd_recreate_node_head(r, node);
             if (get_abstraction_body(node)) {
                 Context functx = *ctx;
-                functx.rewriter.map = shd_clone_dict(functx.rewriter.map);
-                shd_dict_clear(functx.rewriter.map);
+                functx.rewriter.map = shd_new_node_map(Node*);
                 shd_register_processed_list(&functx.rewriter, get_abstraction_params(node), get_abstraction_params(newfun));
                 functx.bb = begin_body_with_mem(a, shd_get_abstraction_mem(newfun));
                 Node* post_prelude = basic_block(a, shd_empty(a), "post-prelude");
@@ -31,7 +30,7 @@ static const Node* process(Context* ctx, const Node* node) {
                 shd_set_abstraction_body(post_prelude, shd_rewrite_node(&functx.rewriter, get_abstraction_body(node)));
                 shd_set_abstraction_body(newfun, finish_body(functx.bb, jump_helper(a, bb_mem(functx.bb), post_prelude,
                                                                                     shd_empty(a))));
-                shd_destroy_dict(functx.rewriter.map);
+                shd_destroy_node_map(functx.rewriter.map);
             }
             return newfun;
         }
@@ -61,7 +60,7 @@ static const Node* process(Context* ctx, const Node* node) {
                     .size = ref_decl_helper(a, shd_rewrite_node(&ctx->rewriter, shd_module_get_declaration(ctx->rewriter.src_module, "SUBGROUPS_PER_WG")))
                 });
 
-                assert(shd_lookup_annotation(node, "Logical") && "All subgroup variables should be logical by now!");
+                assert(shd_lookup_well_known_annotation(node, AnnLogical) && "All subgroup variables should be logical by now!");
                 Node* new = global_var(ctx->rewriter.dst_module, shd_rewrite_nodes(&ctx->rewriter, node->payload.global_variable.annotations), atype, node->payload.global_variable.name, AsShared);
                 shd_register_processed(&ctx->rewriter, node, new);
 
@@ -88,8 +87,7 @@ static const Node* process(Context* ctx, const Node* node) {
 }
 
 Module* shd_pass_lower_subgroup_vars(const CompilerConfig* config, Module* src) {
-    ArenaConfig aconfig = *shd_get_arena_config(shd_module_get_arena(src));
-    IrArena* a = shd_new_ir_arena(&aconfig);
+    IrArena* a = shd_get_pass_dst_arena(config, src);
     Module* dst = shd_new_module(a, shd_module_get_name(src));
     Context ctx = {
         .rewriter = shd_create_node_rewriter(src, dst, (RewriteNodeFn) process),
@@ -7,6 +7,7 @@
 #include "../analysis/cfg.h"
 #include "../analysis/uses.h"
 #include "../analysis/leak.h"
+#include "../analysis/manager.h"
 #include "../transform/ir_gen_helpers.h"
 
 #include "log.h"
@@ -110,14 +111,14 @@ static const Node* process(Context* ctx, const Node* old) {
     switch (old->tag) {
         case Function_TAG: {
             Context ctx2 = *ctx;
-            ctx2.cfg = build_fn_cfg(old);
-            ctx2.uses = create_fn_uses_map(old, (NcDeclaration | NcType));
+            ctx2.cfg = shd_get_fn_cfg(old);
+            ctx2.uses = shd_get_fn_uses_map(old);
             ctx = &ctx2;
 
             const Node* entry_point_annotation = shd_lookup_annotation_list(old->payload.fun.annotations, "EntryPoint");
 
             // Leave leaf-calls alone :)
-            ctx2.disable_lowering = shd_lookup_annotation(old, "Leaf") || !old->payload.fun.body;
+            ctx2.disable_lowering = shd_lookup_well_known_annotation(old, AnnLeaf) || !old->payload.fun.body;
             if (ctx2.disable_lowering) {
                 Node* fun = shd_recreate_node_head(&ctx2.rewriter, old);
                 if (old->payload.fun.body) {
@@ -128,9 +129,6 @@ static const Node* process(Context* ctx, const Node* old) {
                     shd_register_processed(&ctx2.rewriter, shd_get_abstraction_mem(old), bb_mem(bb));
                     shd_set_abstraction_body(fun, finish_body(bb, shd_rewrite_node(&ctx2.rewriter, get_abstraction_body(old))));
                 }
-
-                destroy_uses_map(ctx2.uses);
-                destroy_cfg(ctx2.cfg);
                 return fun;
             }
 
@@ -140,7 +138,7 @@ static const Node* process(Context* ctx, const Node* old) {
             new_annotations = shd_nodes_append(a, new_annotations, annotation_value(a, (AnnotationValue) { .name = "FnId", .value = lower_fn_addr(ctx, old) }));
             new_annotations = shd_nodes_append(a, new_annotations, annotation(a, (Annotation) { .name = "Leaf" }));
 
-            String new_name = shd_format_string_arena(a->arena, "%s_indirect", old->payload.fun.name);
+            String new_name = shd_format_string_arena(_shd_get_ir_arena_allocator(a), "%s_indirect", old->payload.fun.name);
 
             Node* fun = function(ctx->rewriter.dst_module, shd_nodes(a, 0, NULL), new_name, shd_filter_out_annotation(a, new_annotations, "EntryPoint"), shd_nodes(a, 0, NULL));
             shd_register_processed(&ctx->rewriter, old, fun);
@@ -163,8 +161,6 @@ static const Node* process(Context* ctx, const Node* old) {
             }
             shd_register_processed(&ctx2.rewriter, shd_get_abstraction_mem(old), bb_mem(bb));
             shd_set_abstraction_body(fun, finish_body(bb, shd_rewrite_node(&ctx2.rewriter, get_abstraction_body(old))));
-            destroy_uses_map(ctx2.uses);
-            destroy_cfg(ctx2.cfg);
             return fun;
         }
         case FnAddr_TAG: return lower_fn_addr(ctx, old->payload.fn_addr.fn);
@@ -376,7 +372,7 @@ static void generate_top_level_dispatch_fn(Context* ctx) {
     for (size_t i = 0; i < old_decls.count; i++) {
         const Node* decl = old_decls.nodes[i];
         if (decl->tag == Function_TAG) {
-            if (shd_lookup_annotation(decl, "Leaf"))
+            if (shd_lookup_well_known_annotation(decl, AnnLeaf))
                 continue;
 
             const Node* fn_lit = shd_uint32_literal(a, get_fn_ptr(ctx, decl));
@@ -34,7 +34,7 @@ static const Node* process(Context* ctx, const Node* node) {
 
     switch (node->tag) {
         case GlobalVariable_TAG: {
-            const Node* ba = shd_lookup_annotation(node, "Builtin");
+            const Node* ba = shd_lookup_well_known_annotation(node, AnnBuiltin);
             if (ba) {
                 Nodes filtered_as = shd_rewrite_nodes(&ctx->rewriter, shd_filter_out_annotation(a, node->payload.global_variable.annotations, "Builtin"));
                 Builtin b = shd_get_builtin_by_name(shd_get_annotation_string_payload(ba));
@@ -56,7 +56,7 @@ static const Node* process(Context* ctx, const Node* node) {
         case Function_TAG: {
             Context ctx2 = *ctx;
             ctx2.is_entry_point = false;
-            const Node* epa = shd_lookup_annotation(node, "EntryPoint");
+            const Node* epa = shd_lookup_well_known_annotation(node, AnnEntryPoint);
             if (epa && strcmp(shd_get_annotation_string_payload(epa), "Compute") == 0) {
                 ctx2.is_entry_point = true;
                 assert(node->payload.fun.return_types.count == 0 && "entry points do not return at this stage");
@@ -69,7 +69,7 @@ static const Node* process(Context* ctx, const Node* node) {
                 // recreate the old entry point, but this time it's not the entry point anymore
                 Nodes nannotations = shd_filter_out_annotation(a, wannotations, "EntryPoint");
                 Nodes nparams = shd_recreate_params(&ctx->rewriter, node->payload.fun.params);
-                Node* inner = function(m, nparams, shd_format_string_arena(a->arena, "%s_wrapped", shd_get_abstraction_name(node)), nannotations, shd_empty(a));
+                Node* inner = function(m, nparams, shd_format_string_arena(_shd_get_ir_arena_allocator(a), "%s_wrapped", shd_get_abstraction_name(node)), nannotations, shd_empty(a));
                 shd_register_processed_list(&ctx->rewriter, node->payload.fun.params, nparams);
                 shd_register_processed(&ctx->rewriter, shd_get_abstraction_mem(node), shd_get_abstraction_mem(inner));
                 shd_set_abstraction_body(inner, shd_recreate_node(&ctx->rewriter, node->payload.fun.body));
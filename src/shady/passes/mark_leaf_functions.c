@@ -4,6 +4,7 @@
 #include "../analysis/cfg.h"
 #include "../analysis/uses.h"
 #include "../analysis/leak.h"
+#include "../analysis/manager.h"
 
 #include "dict.h"
 #include "portability.h"
@@ -98,8 +99,8 @@ static const Node* process(Context* ctx, const Node* node) {
             Context fn_ctx = *ctx;
             CGNode* fn_node = *shd_dict_find_value(const Node*, CGNode*, ctx->graph->fn2cgn, node);
             fn_ctx.is_leaf = is_leaf_fn(ctx, fn_node);
-            fn_ctx.cfg = build_fn_cfg(node);
-            fn_ctx.uses = create_fn_uses_map(node, (NcDeclaration | NcType));
+            fn_ctx.cfg = shd_get_fn_cfg(node);
+            fn_ctx.uses = shd_get_fn_uses_map(node);
             ctx = &fn_ctx;
 
             Nodes annotations = shd_rewrite_nodes(&ctx->rewriter, node->payload.fun.annotations);
@@ -115,9 +116,6 @@ static const Node* process(Context* ctx, const Node* node) {
                     .name = "Leaf",
                 }));
             }
-
-            destroy_uses_map(fn_ctx.uses);
-            destroy_cfg(fn_ctx.cfg);
             return new;
         }
         case Control_TAG: {
@@ -151,18 +149,16 @@ static const Node* process(Context* ctx, const Node* node) {
 KeyHash shd_hash_node(Node** pnode);
 bool shd_compare_node(Node** pa, Node** pb);
 
-Module* shd_pass_mark_leaf_functions(SHADY_UNUSED const CompilerConfig* config, Module* src) {
-    ArenaConfig aconfig = *shd_get_arena_config(shd_module_get_arena(src));
-    IrArena* a = shd_new_ir_arena(&aconfig);
+Module* shd_pass_mark_leaf_functions(const CompilerConfig* config, Module* src) {
+    IrArena* a = shd_get_pass_dst_arena(config, src);
     Module* dst = shd_new_module(a, shd_module_get_name(src));
     Context ctx = {
         .rewriter = shd_create_node_rewriter(src, dst, (RewriteNodeFn) process),
         .fns = shd_new_dict(const Node*, FnInfo, (HashFn) shd_hash_node, (CmpFn) shd_compare_node),
-        .graph = new_callgraph(src)
+        .graph = shd_get_callgraph(src)
     };
     shd_rewrite_module(&ctx.rewriter);
     shd_destroy_dict(ctx.fns);
-    destroy_callgraph(ctx.graph);
     shd_destroy_rewriter(&ctx.rewriter);
     return dst;
 }
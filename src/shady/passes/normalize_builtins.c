@@ -1,5 +1,7 @@
 #include "shady/pass.h"
 
+#include "passes.h"
+
 #include "../ir_private.h"
 #include "../type.h"
 #include "../transform/ir_gen_helpers.h"
@@ -51,28 +53,34 @@ static const Type* get_req_cast(Context* ctx, const Node* src) {
     return NULL;
 }
 
+Node* shd_rewrite_builtin_global(Rewriter* r, Node** builtins, const Node* old) {
+    GlobalVariable global_variable = old->payload.global_variable;
+    const Node* ba = shd_lookup_annotation_list(global_variable.annotations, "Builtin");
+    if (!ba)
+        return NULL;
+    Builtin b = shd_get_builtin_by_name(shd_get_annotation_string_payload(ba));
+    assert(b != BuiltinsCount);
+    if (builtins[b])
+        return builtins[b];
+    const Type* t = shd_get_builtin_type(r->dst_arena, b);
+    Node* ndecl = global_var(r->dst_module, shd_rewrite_nodes(r, global_variable.annotations), t, global_variable.name,
+                             shd_get_builtin_address_space(b));
+    shd_register_processed(r, old, ndecl);
+    // no 'init' for builtins, right ?
+    assert(!global_variable.init);
+    builtins[b] = ndecl;
+    return ndecl;
+}
+
 static const Node* process(Context* ctx, const Node* node) {
     Rewriter* r = &ctx->rewriter;
     IrArena* a = r->dst_arena;
 
     switch (node->tag) {
         case GlobalVariable_TAG: {
-            GlobalVariable global_variable = node->payload.global_variable;
-            const Node* ba = shd_lookup_annotation_list(global_variable.annotations, "Builtin");
-            if (ba) {
-                Builtin b = shd_get_builtin_by_name(shd_get_annotation_string_payload(ba));
-                assert(b != BuiltinsCount);
-                if (ctx->builtins[b])
-                    return ctx->builtins[b];
-                const Type* t = shd_get_builtin_type(a, b);
-                Node* ndecl = global_var(r->dst_module, shd_rewrite_nodes(r, global_variable.annotations), t, global_variable.name,
-                                         shd_get_builtin_address_space(b));
-                shd_register_processed(r, node, ndecl);
-                // no 'init' for builtins, right ?
-                assert(!global_variable.init);
-                ctx->builtins[b] = ndecl;
+            Node* ndecl = shd_rewrite_builtin_global(r, ctx->builtins, node);
+            if (ndecl)
                 return ndecl;
-            }
             break;
         }
         case Load_TAG: {
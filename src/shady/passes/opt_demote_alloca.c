@@ -6,6 +6,7 @@
 #include "../transform/ir_gen_helpers.h"
 #include "../analysis/uses.h"
 #include "../analysis/leak.h"
+#include "../analysis/manager.h"
 
 #include "log.h"
 #include "portability.h"
@@ -173,21 +174,6 @@ static const Node* process(Context* ctx, const Node* old) {
     IrArena* a = r->dst_arena;
 
     switch (old->tag) {
-        case Function_TAG: {
-            Node* fun = shd_recreate_node_head(&ctx->rewriter, old);
-            Context fun_ctx = *ctx;
-            fun_ctx.uses = create_fn_uses_map(old, (NcDeclaration | NcType));
-            fun_ctx.disable_lowering = shd_lookup_annotation_with_string_payload(old, "DisableOpt", "demote_alloca");
-            if (old->payload.fun.body)
-                shd_set_abstraction_body(fun, shd_rewrite_node(&fun_ctx.rewriter, old->payload.fun.body));
-            destroy_uses_map(fun_ctx.uses);
-            return fun;
-        }
-        case Constant_TAG: {
-            Context fun_ctx = *ctx;
-            fun_ctx.uses = NULL;
-            return shd_recreate_node(&fun_ctx.rewriter, old);
-        }
         case Load_TAG: {
             Load payload = old->payload.load;
             shd_rewrite_node(r, payload.mem);
@@ -234,22 +220,20 @@ static const Node* process(Context* ctx, const Node* old) {
 KeyHash shd_hash_node(const Node**);
 bool shd_compare_node(const Node**, const Node**);
 
-bool shd_opt_demote_alloca(SHADY_UNUSED const CompilerConfig* config, Module** m) {
+bool shd_opt_demote_alloca(SHADY_UNUSED const CompilerConfig* config, Module* m, Node* fn) {
     bool todo = false;
-    Module* src = *m;
-    IrArena* a = shd_module_get_arena(src);
-    Module* dst = shd_new_module(a, shd_module_get_name(src));
     Context ctx = {
-        .rewriter = shd_create_node_rewriter(src, dst, (RewriteNodeFn) process),
+        .rewriter = shd_create_in_place_rewriter(m, (RewriteNodeFn) process),
         .config = config,
+        .disable_lowering = shd_lookup_annotation_with_string_payload(fn, "DisableOpt", "demote_alloca"),
+        .uses = shd_get_fn_uses_map(fn),
         .arena = shd_new_arena(),
         .alloca_info = shd_new_dict(const Node*, AllocaInfo*, (HashFn) shd_hash_node, (CmpFn) shd_compare_node),
         .todo = &todo
     };
-    shd_rewrite_module(&ctx.rewriter);
+    shd_rewrite_fn_body_in_place(&ctx.rewriter, fn);
     shd_destroy_rewriter(&ctx.rewriter);
     shd_destroy_dict(ctx.alloca_info);
     shd_destroy_arena(ctx.arena);
-    *m = dst;
     return todo;
 }
@@ -2,8 +2,10 @@
 
 #include "../type.h"
 #include "../ir_private.h"
+#include "../node_map.h"
 
 #include "../analysis/callgraph.h"
+#include "../analysis/manager.h"
 
 #include "dict.h"
 #include "list.h"
@@ -33,9 +35,9 @@ static const Node* ignore_immediate_fn_addr(const Node* node) {
 }
 
 static bool is_call_potentially_inlineable(const Node* src_fn, const Node* dst_fn) {
-    if (shd_lookup_annotation(src_fn, "Internal"))
+    if (shd_lookup_well_known_annotation(src_fn, AnnInternal))
         return false;
-    if (shd_lookup_annotation(dst_fn, "NoInline"))
+    if (shd_lookup_well_known_annotation(dst_fn, AnnNoInline))
         return false;
     if (!dst_fn->payload.fun.body)
         return false;
@@ -43,11 +45,11 @@ static bool is_call_potentially_inlineable(const Node* src_fn, const Node* dst_f
 }
 
 static bool is_call_safely_removable(const Node* fn) {
-    if (shd_lookup_annotation(fn, "Internal"))
+    if (shd_lookup_well_known_annotation(fn, AnnInternal))
         return false;
-    if (shd_lookup_annotation(fn, "EntryPoint"))
+    if (shd_lookup_well_known_annotation(fn, AnnEntryPoint))
         return false;
-    if (shd_lookup_annotation(fn, "Exported"))
+    if (shd_lookup_well_known_annotation(fn, AnnExported))
         return false;
     return true;
 }
@@ -108,7 +110,7 @@ static const Node* inline_call(Context* ctx, const Node* ocallee, const Node* nm
 
     shd_log_fmt(DEBUG, "Inlining '%s' inside '%s'\n", shd_get_abstraction_name(ocallee), shd_get_abstraction_name(ctx->fun));
     Context inline_context = *ctx;
-    inline_context.rewriter.map = shd_clone_dict(inline_context.rewriter.map);
+    inline_context.rewriter.map = shd_clone_node_map(inline_context.rewriter.map);
 
     ctx = &inline_context;
     InlinedCall inlined_call = {
@@ -123,7 +125,7 @@ static const Node* inline_call(Context* ctx, const Node* ocallee, const Node* nm
 
     const Node* nbody = shd_rewrite_node(&inline_context.rewriter, get_abstraction_body(ocallee));
 
-    shd_destroy_dict(inline_context.rewriter.map);
+    shd_destroy_node_map(inline_context.rewriter.map);
 
     assert(is_terminator(nbody));
     return nbody;
@@ -150,14 +152,14 @@ static const Node* process(Context* ctx, const Node* node) {
             shd_register_processed(r, node, new);
 
             Context fn_ctx = *ctx;
-            fn_ctx.rewriter.map = shd_clone_dict(fn_ctx.rewriter.map);
+            fn_ctx.rewriter.map = shd_clone_node_map(fn_ctx.rewriter.map);
             fn_ctx.old_fun = node;
             fn_ctx.fun = new;
             fn_ctx.inlined_call = NULL;
             for (size_t i = 0; i < new->payload.fun.params.count; i++)
                 shd_register_processed(&fn_ctx.rewriter, node->payload.fun.params.nodes[i], new->payload.fun.params.nodes[i]);
             shd_recreate_node_body(&fn_ctx.rewriter, node, new);
-            shd_destroy_dict(fn_ctx.rewriter.map);
+            shd_destroy_node_map(fn_ctx.rewriter.map);
             return new;
         }
         case Call_TAG: {
@@ -176,7 +178,7 @@ static const Node* process(Context* ctx, const Node* node) {
                     // Prepare a join point to replace the old function return
                     Nodes nyield_types = strip_qualifiers(a, shd_rewrite_nodes(&ctx->rewriter, ocallee->payload.fun.return_types));
                     const Type* jp_type = join_point_type(a, (JoinPointType) { .yield_types = nyield_types });
-                    const Node* join_point = param(a, shd_as_qualified_type(jp_type, true), shd_format_string_arena(a->arena, "inlined_return_%s", shd_get_abstraction_name(ocallee)));
+                    const Node* join_point = param(a, shd_as_qualified_type(jp_type, true), shd_format_string_arena(_shd_get_ir_arena_allocator(a), "inlined_return_%s", shd_get_abstraction_name(ocallee)));
 
                     Node* control_case = case_(a, shd_singleton(join_point));
                     const Node* nbody = inline_call(ctx, ocallee, shd_get_abstraction_mem(control_case), nargs, join_point);
@@ -234,11 +236,9 @@ static void simplify_cf(const CompilerConfig* config, Module* src, Module* dst)
         .fun = NULL,
         .inlined_call = NULL,
     };
-    ctx.graph = new_callgraph(src);
+    ctx.graph = shd_get_callgraph(src);
 
     shd_rewrite_module(&ctx.rewriter);
-    if (ctx.graph)
-        destroy_callgraph(ctx.graph);
 
     shd_destroy_rewriter(&ctx.rewriter);
 }
@@ -6,6 +6,7 @@
 #include "../type.h"
 #include "../transform/ir_gen_helpers.h"
 #include "../analysis/cfg.h"
+#include "../analysis/manager.h"
 
 #include "log.h"
 #include "portability.h"
@@ -64,8 +65,8 @@ static const Node* get_last_stored_value(Context* ctx, const Node* ptr, const No
             case AbsMem_TAG: {
                 const Node* abs = mem->payload.abs_mem.abs;
                 CFNode* n = cfg_lookup(ctx->cfg, abs);
-                if (shd_list_count(n->pred_edges) == 1) {
-                    CFEdge e = shd_read_list(CFEdge, n->pred_edges)[0];
+                if (n->pred_edges.count == 1) {
+                    CFEdge e = n->pred_edges.edges[0];
                     mem = get_terminator_mem(e.terminator);
                     continue;
                 }
@@ -90,14 +91,6 @@ static const Node* process(Context* ctx, const Node* node) {
     Rewriter* r = &ctx->rewriter;
     IrArena* a = r->dst_arena;
     switch (node->tag) {
-        case Function_TAG: {
-            Node* new = shd_recreate_node_head(r, node);
-            Context fun_ctx = *ctx;
-            fun_ctx.cfg = build_fn_cfg(node);
-            shd_recreate_node_body(&fun_ctx.rewriter, node, new);
-            destroy_cfg(fun_ctx.cfg);
-            return new;
-        }
         case Load_TAG: {
             Load payload = node->payload.load;
             const Node* src = get_ptr_source(payload.ptr);
@@ -119,20 +112,14 @@ static const Node* process(Context* ctx, const Node* node) {
     return shd_recreate_node(r, node);
 }
 
-bool shd_opt_mem2reg(SHADY_UNUSED const CompilerConfig* config, Module** m) {
-    Module* src = *m;
-    IrArena* a = shd_module_get_arena(src);
-
-    Module* dst = NULL;
+bool shd_opt_mem2reg(SHADY_UNUSED const CompilerConfig* config, Module* m, Node* fn) {
     bool todo = false;
-    dst = shd_new_module(a, shd_module_get_name(src));
     Context ctx = {
-        .rewriter = shd_create_node_rewriter(src, dst, (RewriteNodeFn) process),
+        .rewriter = shd_create_in_place_rewriter(m, (RewriteNodeFn) process),
+        .cfg = shd_get_fn_cfg(fn),
         .todo = &todo
     };
-    shd_rewrite_module(&ctx.rewriter);
+    shd_rewrite_fn_body_in_place(&ctx.rewriter, fn);
     shd_destroy_rewriter(&ctx.rewriter);
-    assert(dst);
-    *m = dst;
     return todo;
 }
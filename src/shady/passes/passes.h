@@ -8,6 +8,10 @@
 
 RewritePass shd_import;
 RewritePass shd_cleanup;
+/// Same as shd_cleanup, and reports how many rounds of optimisations it took to converge
+Module* shd_cleanup_count_rounds(const CompilerConfig* config, Module* src, size_t* rounds);
+/// One of the optimisations cleanup runs: inlines basic blocks used only once, removes trivial controls and unused loads
+OptPass shd_opt_simplify;
 
 /// @}
 
@@ -33,6 +37,10 @@ RewritePass shd_pass_reconvergence_heuristics;
 /// Extracts unstructured basic blocks into separate functions (including spilling)
 RewritePass shd_pass_lift_indirect_targets;
 RewritePass shd_pass_normalize_builtins;
+/// Rewrites @p old, a global variable, into @p r's destination module if it's a @Builtin one. All the globals for the
+/// same builtin become one, with the type and address space the target expects whatever they were declared with.
+/// @p builtins holds these, indexed by Builtin and zeroed at first. Returns NULL for other globals.
+Node* shd_rewrite_builtin_global(Rewriter* r, Node** builtins, const Node* old);
 
 /// @}
 
@@ -102,6 +110,10 @@ RewritePass shd_pass_lower_nullptr;
 RewritePass shd_pass_eliminate_constants;
 /// Ditto but for @Inline ones only
 RewritePass shd_pass_eliminate_inlineable_constants;
+/// Drops the declarations that can't be reached from the entry point being specialized for (or the exported ones)
+RewritePass shd_pass_eliminate_dead_declarations;
+/// Like shd_import, but only copies the declarations shd_pass_eliminate_dead_declarations would keep
+RewritePass shd_import_live_declarations;
 /// Tags all functions that don't need special handling
 RewritePass shd_pass_mark_leaf_functions;
 /// In addition, also inlines function calls according to heuristics
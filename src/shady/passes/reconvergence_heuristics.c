@@ -2,10 +2,12 @@
 
 #include "../type.h"
 #include "../ir_private.h"
+#include "../node_map.h"
 #include "../transform/ir_gen_helpers.h"
 
 #include "../analysis/cfg.h"
 #include "../analysis/looptree.h"
+#include "../analysis/manager.h"
 
 #include "list.h"
 #include "dict.h"
@@ -52,8 +54,8 @@ static void gather_exiting_nodes(LoopTree* lt, const CFNode* entry, const CFNode
         return;
     }
 
-    for (size_t i = 0; i < shd_list_count(block->dominates); i++) {
-        const CFNode* target = shd_read_list(CFNode*, block->dominates)[i];
+    for (size_t i = 0; i < block->dominates.count; i++) {
+        const CFNode* target = block->dominates.nodes[i];
         gather_exiting_nodes(lt, entry, target, exiting_nodes);
     }
 }
@@ -164,7 +166,7 @@ static const Node* process_abstraction(Context* ctx, const Node* node) {
                 assert(exiting_node->node && exiting_node->node->tag != Function_TAG);
                 Nodes exit_wrapper_params = shd_recreate_params(&ctx->rewriter, get_abstraction_params(exiting_node->node));
 
-                Node* wrapper = basic_block(arena, exit_wrapper_params, shd_format_string_arena(arena->arena, "exit_wrapper_%d", i));
+                Node* wrapper = basic_block(arena, exit_wrapper_params, shd_format_string_arena(_shd_get_ir_arena_allocator(arena), "exit_wrapper_%d", i));
                 exits[i].wrapper = wrapper;
             }
 
@@ -183,13 +185,13 @@ static const Node* process_abstraction(Context* ctx, const Node* node) {
                 CFNode* exiting_node = shd_read_list(CFNode*, exiting_nodes)[i];
                 cached_exits[i] = shd_search_processed(rewriter, exiting_node->node);
                 if (cached_exits[i])
-                    shd_dict_remove(const Node*, rewriter->map, exiting_node->node);
+                    shd_node_map_remove(rewriter->map, exiting_node->node);
                 shd_register_processed(rewriter, exiting_node->node, exits[i].wrapper);
             }
             // ditto for the loop entry and the continue wrapper
             const Node** cached_entry = shd_search_processed(rewriter, node);
             if (cached_entry)
-                shd_dict_remove(const Node*, rewriter->map, node);
+                shd_node_map_remove(rewriter->map, node);
             shd_register_processed(rewriter, node, continue_wrapper);
 
             // make sure we haven't started rewriting this...
@@ -197,8 +199,8 @@ static const Node* process_abstraction(Context* ctx, const Node* node) {
             //     assert(!search_processed(rewriter, old_params.nodes[i]));
             // }
 
-            struct Dict* old_map = rewriter->map;
-            rewriter->map = shd_clone_dict(rewriter->map);
+            NodeMap* old_map = rewriter->map;
+            rewriter->map = shd_clone_node_map(rewriter->map);
             Nodes inner_loop_params = shd_recreate_params(rewriter, get_abstraction_params(node));
             shd_register_processed_list(rewriter, get_abstraction_params(node), inner_loop_params);
             Node* inner_control_case = case_(arena, shd_singleton(join_token_continue));
@@ -223,17 +225,17 @@ static const Node* process_abstraction(Context* ctx, const Node* node) {
 
             shd_set_abstraction_body(inner_control_case, loop_body);
 
-            shd_destroy_dict(rewriter->map);
+            shd_destroy_node_map(rewriter->map);
             rewriter->map = old_map;
             //register_processed_list(rewriter, get_abstraction_params(node), nparams);
 
             // restore the old context
             for (size_t i = 0; i < exiting_nodes_count; i++) {
-                shd_dict_remove(const Node*, rewriter->map, shd_read_list(CFNode *, exiting_nodes)[i]->node);
+                shd_node_map_remove(rewriter->map, shd_read_list(CFNode *, exiting_nodes)[i]->node);
                 if (cached_exits[i])
                     shd_register_processed(rewriter, shd_read_list(CFNode*, exiting_nodes)[i]->node, *cached_exits[i]);
             }
-            shd_dict_remove(const Node*, rewriter->map, node);
+            shd_node_map_remove(rewriter->map, node);
             if (cached_entry)
                 shd_register_processed(rewriter, node, *cached_entry);
 
@@ -241,10 +243,12 @@ static const Node* process_abstraction(Context* ctx, const Node* node) {
             BodyBuilder* inner_bb = begin_body_with_mem(arena, shd_get_abstraction_mem(loop_outer));
             Nodes inner_control_results = gen_control(inner_bb, inner_yield_types, inner_control_case);
             // make sure what was uniform still is
+            NodesBuilder uniform_results = shd_nodes_builder_from(inner_control_results);
             for (size_t j = 0; j < inner_control_results.count; j++) {
                 if (is_qualified_type_uniform(nparams.nodes[j]->type))
-                    inner_control_results = shd_change_node_at_index(arena, inner_control_results, j, prim_op_helper(arena, subgroup_assume_uniform_op, shd_empty(arena), shd_singleton(inner_control_results.nodes[j])));
+                    shd_nodes_builder_set(&uniform_results, j, prim_op_helper(arena, subgroup_assume_uniform_op, shd_empty(arena), shd_singleton(inner_control_results.nodes[j])));
             }
+            inner_control_results = shd_nodes_builder_finish(arena, &uniform_results);
             shd_set_abstraction_body(loop_outer, finish_body_with_jump(inner_bb, loop_outer, inner_control_results));
             Node* outer_control_case = case_(arena, shd_singleton(join_token_exit));
             shd_set_abstraction_body(outer_control_case, jump(arena, (Jump) {
@@ -259,7 +263,7 @@ static const Node* process_abstraction(Context* ctx, const Node* node) {
             for (size_t i = 0; i < exiting_nodes_count; i++) {
                 CFNode* exiting_node = shd_read_list(CFNode*, exiting_nodes)[i];
 
-                Node* exit_bb = basic_block(arena, shd_empty(arena), shd_format_string_arena(arena->arena, "exit_recover_values_%s", shd_get_abstraction_name_safe(exiting_node->node)));
+                Node* exit_bb = basic_block(arena, shd_empty(arena), shd_format_string_arena(_shd_get_ir_arena_allocator(arena), "exit_recover_values_%s", shd_get_abstraction_name_safe(exiting_node->node)));
                 BodyBuilder* exit_recover_bb = begin_body_with_mem(arena, shd_get_abstraction_mem(exit_bb));
 
                 const Node* recreated_exit = shd_rewrite_node(rewriter, exiting_node->node);
@@ -312,19 +316,15 @@ static const Node* process_node(Context* ctx, const Node* node) {
         case Function_TAG: {
             ctx = &new_context;
             ctx->current_fn = NULL;
-            if (!(shd_lookup_annotation(node, "Restructure") || ctx->config->input_cf.restructure_with_heuristics))
+            if (!(shd_lookup_well_known_annotation(node, AnnRestructure) || ctx->config->input_cf.restructure_with_heuristics))
                 break;
 
             ctx->current_fn = node;
-            ctx->fwd_cfg = build_fn_cfg(ctx->current_fn);
-            ctx->rev_cfg = build_fn_cfg_flipped(ctx->current_fn);
-            ctx->current_looptree = build_loop_tree(ctx->fwd_cfg);
+            ctx->fwd_cfg = shd_get_fn_cfg(ctx->current_fn);
+            ctx->rev_cfg = shd_get_cfg(ctx->current_fn, flipped_cfg_build());
+            ctx->current_looptree = shd_get_loop_tree(ctx->fwd_cfg);
 
             const Node* new = process_abstraction(ctx, node);;
-
-            destroy_cfg(ctx->fwd_cfg);
-            destroy_cfg(ctx->rev_cfg);
-            destroy_loop_tree(ctx->current_looptree);
             return new;
         }
         case Constant_TAG: {
@@ -334,12 +334,12 @@ static const Node* process_node(Context* ctx, const Node* node) {
             break;
         }
         case BasicBlock_TAG:
-            if (!ctx->current_fn || !(shd_lookup_annotation(ctx->current_fn, "Restructure") || ctx->config->input_cf.restructure_with_heuristics))
+            if (!ctx->current_fn || !(shd_lookup_well_known_annotation(ctx->current_fn, AnnRestructure) || ctx->config->input_cf.restructure_with_heuristics))
                 break;
             return process_abstraction(ctx, node);
         case Branch_TAG: {
             Branch payload = node->payload.branch;
-            if (!ctx->current_fn || !(shd_lookup_annotation(ctx->current_fn, "Restructure") || ctx->config->input_cf.restructure_with_heuristics))
+            if (!ctx->current_fn || !(shd_lookup_well_known_annotation(ctx->current_fn, AnnRestructure) || ctx->config->input_cf.restructure_with_heuristics))
                 break;
             assert(ctx->fwd_cfg);
 
@@ -352,8 +352,8 @@ static const Node* process_node(Context* ctx, const Node* node) {
             if (shd_list_count(current_loop->cf_nodes)) {
                 bool leaves_loop = false;
                 CFNode* current_node = cfg_lookup(ctx->fwd_cfg, ctx->current_abstraction);
-                for (size_t i = 0; i < shd_list_count(current_node->succ_edges); i++) {
-                    CFEdge edge = shd_read_list(CFEdge, current_node->succ_edges)[i];
+                for (size_t i = 0; i < current_node->succ_edges.count; i++) {
+                    CFEdge edge = current_node->succ_edges.edges[i];
                     LTNode* lt_target = looptree_lookup(ctx->current_looptree, edge.dst->node);
 
                     if (lt_target->parent != current_loop) {
@@ -432,7 +432,7 @@ static const Node* process_node(Context* ctx, const Node* node) {
                     .yield_types = yield_types
             }), true), "jp_postdom");
 
-            Node* pre_join = basic_block(a, exit_args, shd_format_string_arena(a->arena, "merge_%s_%s", shd_get_abstraction_name_safe(ctx->current_abstraction), shd_get_abstraction_name_safe(post_dominator)));
+            Node* pre_join = basic_block(a, exit_args, shd_format_string_arena(_shd_get_ir_arena_allocator(a), "merge_%s_%s", shd_get_abstraction_name_safe(ctx->current_abstraction), shd_get_abstraction_name_safe(post_dominator)));
             shd_set_abstraction_body(pre_join, join(a, (Join) {
                 .join_point = join_token,
                 .args = exit_args,
@@ -441,7 +441,7 @@ static const Node* process_node(Context* ctx, const Node* node) {
 
             const Node** cached = shd_search_processed(r, post_dominator);
             if (cached)
-                shd_dict_remove(const Node*, is_declaration(post_dominator) ? r->decls_map : r->map, post_dominator);
+                shd_node_map_remove(is_declaration(post_dominator) ? r->decls_map : r->map, post_dominator);
             for (size_t i = 0; i < old_params.count; i++) {
                 assert(!shd_search_processed(r, old_params.nodes[i]));
             }
@@ -461,7 +461,7 @@ static const Node* process_node(Context* ctx, const Node* node) {
             });
             shd_set_abstraction_body(control_case, inner_terminator);
 
-            shd_dict_remove(const Node*, is_declaration(post_dominator) ? r->decls_map : r->map, post_dominator);
+            shd_node_map_remove(is_declaration(post_dominator) ? r->decls_map : r->map, post_dominator);
             if (cached)
                 shd_register_processed(r, post_dominator, *cached);
 
@@ -470,10 +470,12 @@ static const Node* process_node(Context* ctx, const Node* node) {
             BodyBuilder* bb = begin_body_with_mem(a, shd_rewrite_node(r, node->payload.branch.mem));
             Nodes results = gen_control(bb, yield_types, control_case);
             // make sure what was uniform still is
+            NodesBuilder uniform_results = shd_nodes_builder_from(results);
             for (size_t j = 0; j < old_params.count; j++) {
                 if (uniform_param[j])
-                    results = shd_change_node_at_index(a, results, j, prim_op_helper(a, subgroup_assume_uniform_op, shd_empty(a), shd_singleton(results.nodes[j])));
+                    shd_nodes_builder_set(&uniform_results, j, prim_op_helper(a, subgroup_assume_uniform_op, shd_empty(a), shd_singleton(results.nodes[j])));
             }
+            results = shd_nodes_builder_finish(a, &uniform_results);
             return finish_body_with_jump(bb, join_target, results);
         }
         default: break;
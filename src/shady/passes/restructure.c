@@ -2,11 +2,11 @@
 
 #include "../type.h"
 #include "../transform/ir_gen_helpers.h"
+#include "../node_map.h"
 
 #include <setjmp.h>
 #include <string.h>
 
-#include "dict.h"
 #include "list.h"
 #include "portability.h"
 #include "log.h"
@@ -43,9 +43,9 @@ typedef struct {
     void* payload;
 } TmpAllocCleanupClosure;
 
-static TmpAllocCleanupClosure create_delete_dict_closure(struct Dict* d) {
+static TmpAllocCleanupClosure create_delete_node_map_closure(NodeMap* d) {
     return (TmpAllocCleanupClosure) {
-        .fn = (TmpAllocCleanupFn) shd_destroy_dict,
+        .fn = (TmpAllocCleanupFn) shd_destroy_node_map,
         .payload = d,
     };
 }
@@ -137,8 +137,8 @@ static const Node* handle_bb_callsite(Context* ctx, Jump jump, const Node* mem,
         BodyBuilder* bb = begin_body_with_mem(a, mem);
         TmpAllocCleanupClosure cj1 = create_cancel_body_closure(bb);
         shd_list_append(TmpAllocCleanupClosure, ctx->cleanup_stack, cj1);
-        struct Dict* tmp_processed = shd_clone_dict(ctx->rewriter.map);
-        TmpAllocCleanupClosure cj2 = create_delete_dict_closure(tmp_processed);
+        NodeMap* tmp_processed = shd_clone_node_map(ctx->rewriter.map);
+        TmpAllocCleanupClosure cj2 = create_delete_node_map_closure(tmp_processed);
         shd_list_append(TmpAllocCleanupClosure, ctx->cleanup_stack, cj2);
         ctx2.rewriter.map = tmp_processed;
         for (size_t i = 0; i < oargs.count; i++) {
@@ -157,7 +157,7 @@ static const Node* handle_bb_callsite(Context* ctx, Jump jump, const Node* mem,
         shd_set_abstraction_body(structured_target, structured);
 
         // forget we rewrote all that
-        shd_destroy_dict(tmp_processed);
+        shd_destroy_node_map(tmp_processed);
         shd_list_pop_impl(ctx->cleanup_stack);
         shd_list_pop_impl(ctx->cleanup_stack);
 
@@ -327,12 +327,9 @@ static const Node* process(Context* ctx, const Node* node) {
     assert(node->arena == ctx->rewriter.src_arena);
 
     if (is_declaration(node)) {
-        String name = get_declaration_name(node);
-        Nodes decls = shd_module_get_declarations(ctx->rewriter.dst_module);
-        for (size_t i = 0; i < decls.count; i++) {
-            if (strcmp(get_declaration_name(decls.nodes[i]), name) == 0)
-                return decls.nodes[i];
-        }
+        const Node* existing = shd_module_get_declaration(ctx->rewriter.dst_module, get_declaration_name(node));
+        if (existing)
+            return existing;
     }
 
     if (node->tag == Function_TAG) {
@@ -343,9 +340,9 @@ static const Node* process(Context* ctx, const Node* node) {
         Context ctx2 = *ctx;
         ctx2.dfs_stack = NULL;
         ctx2.control_stack = NULL;
-        bool is_builtin = shd_lookup_annotation(node, "Builtin");
+        bool is_builtin = shd_lookup_well_known_annotation(node, AnnBuiltin);
         bool is_leaf = false;
-        if (is_builtin || !node->payload.fun.body || shd_lookup_annotation(node, "Structured") || setjmp(ctx2.bail)) {
+        if (is_builtin || !node->payload.fun.body || shd_lookup_well_known_annotation(node, AnnStructured) || setjmp(ctx2.bail)) {
             ctx2.lower = false;
             ctx2.rewriter.map = ctx->rewriter.map;
             if (node->payload.fun.body)
@@ -362,8 +359,8 @@ static const Node* process(Context* ctx, const Node* node) {
             gen_store(bb, ptr, shd_int32_literal(a, 0));
             ctx2.level_ptr = ptr;
             ctx2.fn = new;
-            struct Dict* tmp_processed = shd_clone_dict(ctx->rewriter.map);
-            TmpAllocCleanupClosure cj2 = create_delete_dict_closure(tmp_processed);
+            NodeMap* tmp_processed = shd_clone_node_map(ctx->rewriter.map);
+            TmpAllocCleanupClosure cj2 = create_delete_node_map_closure(tmp_processed);
             shd_list_append(TmpAllocCleanupClosure, ctx->cleanup_stack, cj2);
             ctx2.rewriter.map = tmp_processed;
             shd_register_processed(&ctx2.rewriter, shd_get_abstraction_mem(node), bb_mem(bb));
@@ -372,7 +369,7 @@ static const Node* process(Context* ctx, const Node* node) {
             // We made it! Pop off the pending cleanup stuff and do it ourselves.
             shd_list_pop_impl(ctx->cleanup_stack);
             shd_list_pop_impl(ctx->cleanup_stack);
-            shd_destroy_dict(tmp_processed);
+            shd_destroy_node_map(tmp_processed);
         }
 
         //if (is_leaf)
@@ -401,7 +398,7 @@ static const Node* process(Context* ctx, const Node* node) {
             if (callee->tag == FnAddr_TAG) {
                 const Node* fn = shd_rewrite_node(&ctx->rewriter, callee->payload.fn_addr.fn);
                 // leave leaf calls alone
-                if (shd_lookup_annotation(fn, "Leaf")) {
+                if (shd_lookup_well_known_annotation(fn, AnnLeaf)) {
                     break;
                 }
             }
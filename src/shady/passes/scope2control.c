@@ -13,6 +13,7 @@
 #include "../analysis/cfg.h"
 #include "../analysis/scheduler.h"
 #include "../analysis/free_frontier.h"
+#include "../analysis/manager.h"
 #include "../transform/ir_gen_helpers.h"
 
 #include <string.h>
@@ -82,10 +83,10 @@ static void wrap_in_controls(Context* ctx, CFG* cfg, Node* nabs, const Node* oab
         return;
 
     CFNode* n = cfg_lookup(cfg, oabs);
-    size_t num_dom = shd_list_count(n->dominates);
+    size_t num_dom = n->dominates.count;
     LARRAY(Node*, nbbs, num_dom);
     for (size_t i = 0; i < num_dom; i++) {
-        CFNode* dominated = shd_read_list(CFNode*, n->dominates)[i];
+        CFNode* dominated = n->dominates.nodes[i];
         const Node* obb = dominated->node;
         assert(obb->tag == BasicBlock_TAG);
         Nodes nparams = remake_params(ctx, get_abstraction_params(obb));
@@ -100,7 +101,7 @@ static void wrap_in_controls(Context* ctx, CFG* cfg, Node* nabs, const Node* oab
     shd_register_processed(r, shd_get_abstraction_mem(oabs), shd_get_abstraction_mem(c));
 
     for (size_t k = 0; k < num_dom; k++) {
-        CFNode* dominated = shd_read_list(CFNode*, n->dominates)[k];
+        CFNode* dominated = n->dominates.nodes[k];
         const Node* obb = dominated->node;
         wrap_in_controls(ctx, cfg, nbbs[k], obb);
     }
@@ -124,10 +125,12 @@ static void wrap_in_controls(Context* ctx, CFG* cfg, Node* nabs, const Node* oab
         Nodes results = gen_control(bb, jp_type->payload.join_point_type.yield_types, control_case);
 
         Nodes original_params = get_abstraction_params(dst);
+        NodesBuilder uniform_results = shd_nodes_builder_from(results);
         for (size_t j = 0; j < results.count; j++) {
             if (is_qualified_type_uniform(original_params.nodes[j]->type))
-                results = shd_change_node_at_index(a, results, j, gen_primop_e(bb, subgroup_assume_uniform_op, shd_empty(a), shd_singleton(results.nodes[j])));
+                shd_nodes_builder_set(&uniform_results, j, gen_primop_e(bb, subgroup_assume_uniform_op, shd_empty(a), shd_singleton(results.nodes[j])));
         }
+        results = shd_nodes_builder_finish(a, &uniform_results);
 
         c = c2;
         shd_set_abstraction_body(c2, finish_body(bb, jump_helper(a, bb_mem(bb), shd_find_processed(r, dst), results)));
@@ -227,7 +230,7 @@ static void process_edge(Context* ctx, CFG* cfg, Scheduler* scheduler, CFEdge ed
                     });
                     const Node* join_token = param(a, shd_as_qualified_type(jp_type, false), shd_get_abstraction_name_unsafe(dst));
 
-                    Node* wrapper = basic_block(a, wrapper_params, shd_format_string_arena(a->arena, "wrapper_to_%s", shd_get_abstraction_name_safe(dst)));
+                    Node* wrapper = basic_block(a, wrapper_params, shd_format_string_arena(_shd_get_ir_arena_allocator(a), "wrapper_to_%s", shd_get_abstraction_name_safe(dst)));
                     wrapper->payload.basic_block.body = join(a, (Join) {
                         .args = join_args,
                         .join_point = join_token,
@@ -255,14 +258,13 @@ static void process_edge(Context* ctx, CFG* cfg, Scheduler* scheduler, CFEdge ed
 }
 
 static void prepare_function(Context* ctx, CFG* cfg, const Node* old_fn) {
-    Scheduler* scheduler = new_scheduler(cfg);
+    Scheduler* scheduler = shd_get_scheduler(cfg);
     for (size_t i = 0; i < cfg->size; i++) {
         CFNode* n = cfg->rpo[i];
-        for (size_t j = 0; j < shd_list_count(n->succ_edges); j++) {
-            process_edge(ctx, cfg, scheduler, shd_read_list(CFEdge, n->succ_edges)[j]);
+        for (size_t j = 0; j < n->succ_edges.count; j++) {
+            process_edge(ctx, cfg, scheduler, n->succ_edges.edges[j]);
         }
     }
-    destroy_scheduler(scheduler);
 }
 
 static const Node* process_node(Context* ctx, const Node* node) {
@@ -270,11 +272,10 @@ static const Node* process_node(Context* ctx, const Node* node) {
     Rewriter* r = &ctx->rewriter;
     switch (node->tag) {
         case Function_TAG: {
-            CFG* cfg = build_fn_cfg(node);
+            CFG* cfg = shd_get_fn_cfg(node);
             prepare_function(ctx, cfg, node);
             Node* decl = shd_recreate_node_head(r, node);
             wrap_in_controls(ctx, cfg, decl, node);
-            destroy_cfg(cfg);
             return decl;
         }
         case BasicBlock_TAG: {
@@ -4,6 +4,7 @@
 #include "../type.h"
 #include "../analysis/cfg.h"
 #include "../analysis/looptree.h"
+#include "../analysis/manager.h"
 #include "../transform/ir_gen_helpers.h"
 
 #include "log.h"
@@ -52,8 +53,8 @@ static void paint_dominated_up_to_postdom(CFNode* n, IrArena* a, Nodes* arr, con
     if (n->node == postdom)
         return;
 
-    for (size_t i = 0; i < shd_list_count(n->dominates); i++) {
-        CFNode* dominated = shd_read_list(CFNode*, n->dominates)[i];
+    for (size_t i = 0; i < n->dominates.count; i++) {
+        CFNode* dominated = n->dominates.nodes[i];
         paint_dominated_up_to_postdom(dominated, a, arr, postdom, prefix);
     }
 
@@ -65,14 +66,14 @@ static void visit_acyclic_cfg_domtree(CFNode* n, IrArena* a, Nodes* arr, CFG* fl
     if (ltn->parent != loop)
         return;
 
-    for (size_t i = 0; i < shd_list_count(n->dominates); i++) {
-        CFNode* dominated = shd_read_list(CFNode*, n->dominates)[i];
+    for (size_t i = 0; i < n->dominates.count; i++) {
+        CFNode* dominated = n->dominates.nodes[i];
         visit_acyclic_cfg_domtree(dominated, a, arr, flipped, loop, lt);
     }
 
     CFNode* src = n;
 
-    if (shd_list_count(src->succ_edges) < 2)
+    if (src->succ_edges.count < 2)
         return; // no divergence, no bother
 
     CFNode* f_src = cfg_lookup(flipped, src->node);
@@ -145,8 +146,8 @@ static bool loop_depth(LTNode* a) {
 }
 
 static Nodes* compute_scope_depth(IrArena* a, CFG* cfg) {
-    CFG* flipped = build_fn_cfg_flipped(cfg->entry->node);
-    LoopTree* lt = build_loop_tree(cfg);
+    CFG* flipped = shd_get_cfg(cfg->entry->node, flipped_cfg_build());
+    LoopTree* lt = shd_get_loop_tree(cfg);
 
     Nodes* arr = calloc(sizeof(Nodes), cfg->size);
     for (size_t i = 0; i < cfg->size; i++)
@@ -158,9 +159,6 @@ static Nodes* compute_scope_depth(IrArena* a, CFG* cfg) {
     for (size_t i = 0; i < cfg->size; i++)
         arr[i] = to_ids(a, arr[i]);
 
-    destroy_loop_tree(lt);
-    destroy_cfg(flipped);
-
     return arr;
 }
 
@@ -170,14 +168,13 @@ static const Node* process(Context* ctx, const Node* node) {
     switch (node->tag) {
         case Function_TAG: {
             Context fn_ctx = *ctx;
-            fn_ctx.cfg = build_fn_cfg(node);
+            fn_ctx.cfg = shd_get_fn_cfg(node);
             fn_ctx.depth_per_rpo = compute_scope_depth(a, fn_ctx.cfg);
             Node* new_fn = shd_recreate_node_head(r, node);
             BodyBuilder* bb = begin_body_with_mem(a, shd_get_abstraction_mem(new_fn));
             gen_ext_instruction(bb, "shady.scope", 0, unit_type(a), shd_empty(a));
             shd_register_processed(r, shd_get_abstraction_mem(node), bb_mem(bb));
             shd_set_abstraction_body(new_fn, finish_body(bb, shd_rewrite_node(&fn_ctx.rewriter, get_abstraction_body(node))));
-            destroy_cfg(fn_ctx.cfg);
             free(fn_ctx.depth_per_rpo);
             return new_fn;
         }
@@ -32,7 +32,7 @@ static const Node* process(Context* ctx, const Node* node) {
             BodyBuilder* bb = begin_body_with_mem(a, shd_get_abstraction_mem(fun));
             if (!ctx2.disable_lowering) {
                 ctx2.stack_size_on_entry = gen_get_stack_size(bb);
-                shd_set_value_name((Node*) ctx2.stack_size_on_entry, shd_format_string_arena(a->arena, "saved_stack_ptr_entering_%s", shd_get_abstraction_name(fun)));
+                shd_set_value_name((Node*) ctx2.stack_size_on_entry, shd_format_string_arena(_shd_get_ir_arena_allocator(a), "saved_stack_ptr_entering_%s", shd_get_abstraction_name(fun)));
             }
             shd_register_processed(&ctx2.rewriter, shd_get_abstraction_mem(node), bb_mem(bb));
             if (node->payload.fun.body)
@@ -59,9 +59,8 @@ static const Node* process(Context* ctx, const Node* node) {
     return shd_recreate_node(r, node);
 }
 
-Module* shd_pass_setup_stack_frames(SHADY_UNUSED const CompilerConfig* config, Module* src) {
-    ArenaConfig aconfig = *shd_get_arena_config(shd_module_get_arena(src));
-    IrArena* a = shd_new_ir_arena(&aconfig);
+Module* shd_pass_setup_stack_frames(const CompilerConfig* config, Module* src) {
+    IrArena* a = shd_get_pass_dst_arena(config, src);
     Module* dst = shd_new_module(a, shd_module_get_name(src));
     Context ctx = {
         .rewriter = shd_create_node_rewriter(src, dst, (RewriteNodeFn) process),
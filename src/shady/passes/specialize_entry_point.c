@@ -31,7 +31,7 @@ static const Node* process(Context* ctx, const Node* node) {
             break;
         }
         case GlobalVariable_TAG: {
-            const Node* ba = shd_lookup_annotation(node, "Builtin");
+            const Node* ba = shd_lookup_well_known_annotation(node, AnnBuiltin);
             if (ba) {
                 Builtin b = shd_get_builtin_by_name(shd_get_annotation_string_payload(ba));
                 switch (b) {
@@ -67,14 +67,7 @@ static const Node* process(Context* ctx, const Node* node) {
 static const Node* find_entry_point(Module* m, const CompilerConfig* config) {
     if (!config->specialization.entry_point)
         return NULL;
-    const Node* found = NULL;
-    Nodes old_decls = shd_module_get_declarations(m);
-    for (size_t i = 0; i < old_decls.count; i++) {
-        if (strcmp(get_declaration_name(old_decls.nodes[i]), config->specialization.entry_point) == 0) {
-            assert(!found);
-            found = old_decls.nodes[i];
-        }
-    }
+    const Node* found = shd_module_get_declaration(m, config->specialization.entry_point);
     assert(found);
     return found;
 }
@@ -85,7 +78,7 @@ static void specialize_arena_config(const CompilerConfig* config, Module* src, A
         shd_error("Entry point not found")
     if (old_entry_point_decl->tag != Function_TAG)
         shd_error("%s is not a function", config->specialization.entry_point);
-    const Node* ep = shd_lookup_annotation(old_entry_point_decl, "EntryPoint");
+    const Node* ep = shd_lookup_well_known_annotation(old_entry_point_decl, AnnEntryPoint);
     if (!ep)
         shd_error("%s is not annotated with @EntryPoint", config->specialization.entry_point);
     switch (shd_execution_model_from_string(shd_get_annotation_string_payload(ep))) {
@@ -121,7 +114,7 @@ Module* shd_pass_specialize_entry_point(const CompilerConfig* config, Module* sr
     Nodes old_decls = shd_module_get_declarations(src);
     for (size_t i = 0; i < old_decls.count; i++) {
         const Node* old_decl = old_decls.nodes[i];
-        if (shd_lookup_annotation(old_decl, "RetainAfterSpecialization"))
+        if (shd_lookup_well_known_annotation(old_decl, AnnRetainAfterSpecialization))
             shd_rewrite_node(&ctx.rewriter, old_decl);
     }
 
@@ -275,9 +275,9 @@ static String emit_abs_body(PrinterCtx* ctx, const Node* abs) {
     if (cfnode) {
         Growy* g2 = shd_new_growy();
         Printer* p2 = shd_new_printer_from_growy(g2);
-        size_t count = cfnode->dominates->elements_count;
+        size_t count = cfnode->dominates.count;
         for (size_t i = 0; i < count; i++) {
-            const CFNode* dominated = shd_read_list(const CFNode*, cfnode->dominates)[i];
+            const CFNode* dominated = cfnode->dominates.nodes[i];
             assert(is_basic_block(dominated->node));
             PrinterCtx bb_ctx = *ctx;
             bb_ctx.printer = p2;
@@ -887,11 +887,11 @@ static void print_terminator(PrinterCtx* ctx, const Node* node) {
 
 static void print_decl(PrinterCtx* ctx, const Node* node) {
     assert(is_declaration(node));
-    if (!ctx->config.print_generated && shd_lookup_annotation(node, "Generated"))
+    if (!ctx->config.print_generated && shd_lookup_well_known_annotation(node, AnnGenerated))
         return;
-    if (!ctx->config.print_internal && shd_lookup_annotation(node, "Internal"))
+    if (!ctx->config.print_internal && shd_lookup_well_known_annotation(node, AnnInternal))
         return;
-    if (!ctx->config.print_builtin && shd_lookup_annotation(node, "Builtin"))
+    if (!ctx->config.print_builtin && shd_lookup_well_known_annotation(node, AnnBuiltin))
         return;
 
     PrinterCtx sub_ctx = *ctx;
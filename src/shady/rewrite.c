@@ -1,18 +1,19 @@
 #include "shady/rewrite.h"
+#include "shady/pass.h"
+#include "shady/visit.h"
 
 #include "log.h"
 #include "ir_private.h"
+#include "node_map.h"
 #include "portability.h"
+#include "threading.h"
 #include "type.h"
-
-#include "dict.h"
+#include "analysis/manager.h"
+#include "list.h"
 
 #include <assert.h>
 #include <string.h>
 
-KeyHash shd_hash_node(Node** pnode);
-bool shd_compare_node(Node** pa, Node** pb);
-
 Rewriter shd_create_rewriter_base(Module* src, Module* dst) {
     return (Rewriter) {
         .src_arena = src->arena,
@@ -23,9 +24,9 @@ Rewriter shd_create_rewriter_base(Module* src, Module* dst) {
             .search_map = true,
             .write_map = true,
         },
-        .map = shd_new_dict(const Node*, Node*, (HashFn) shd_hash_node, (CmpFn) shd_compare_node),
+        .map = shd_new_node_map(Node*),
         .own_decls = true,
-        .decls_map = shd_new_dict(const Node*, Node*, (HashFn) shd_hash_node, (CmpFn) shd_compare_node),
+        .decls_map = shd_new_node_map(Node*),
         .parent = NULL,
     };
 }
@@ -45,9 +46,9 @@ Rewriter shd_create_op_rewriter(Module* src, Module* dst, RewriteOpFn fn) {
 
 void shd_destroy_rewriter(Rewriter* r) {
     assert(r->map);
-    shd_destroy_dict(r->map);
+    shd_destroy_node_map(r->map);
     if (r->own_decls)
-        shd_destroy_dict(r->decls_map);
+        shd_destroy_node_map(r->decls_map);
 }
 
 Rewriter shd_create_importer(Module* src, Module* dst) {
@@ -56,7 +57,7 @@ Rewriter shd_create_importer(Module* src, Module* dst) {
 
 Rewriter shd_create_children_rewriter(Rewriter* parent) {
     Rewriter r = *parent;
-    r.map = shd_new_dict(const Node*, Node*, (HashFn) shd_hash_node, (CmpFn) shd_compare_node);
+    r.map = shd_new_node_map(Node*);
     r.parent = parent;
     r.own_decls = false;
     return r;
@@ -64,11 +65,29 @@ Rewriter shd_create_children_rewriter(Rewriter* parent) {
 
 Rewriter shd_create_decl_rewriter(Rewriter* parent) {
     Rewriter r = *parent;
-    r.map = shd_new_dict(const Node*, Node*, (HashFn) shd_hash_node, (CmpFn) shd_compare_node);
+    r.map = shd_new_node_map(Node*);
     r.own_decls = false;
     return r;
 }
 
+Rewriter shd_create_in_place_rewriter(Module* m, RewriteNodeFn fn) {
+    Rewriter r = shd_create_node_rewriter(m, m, fn);
+    r.config.in_place = true;
+    return r;
+}
+
+void shd_rewrite_fn_body_in_place(Rewriter* r, Node* fn) {
+    assert(r->config.in_place && fn->tag == Function_TAG && fn->arena == r->src_arena);
+    const Node* body = get_abstraction_body(fn);
+    if (!body)
+        return;
+    shd_register_processed_list(r, get_abstraction_params(fn), get_abstraction_params(fn));
+    shd_set_abstraction_body(fn, shd_rewrite_node(r, body));
+    shd_invalidate_fn_analyses(fn);
+    // calls might have been added or removed
+    shd_invalidate_callgraphs(fn->arena);
+}
+
 static bool should_memoize(const Node* node) {
     if (is_declaration(node))
         return false;
@@ -77,6 +96,113 @@ static bool should_memoize(const Node* node) {
     return true;
 }
 
+static const Node* rewrite_op_helper(Rewriter* rewriter, NodeClass class, String op_name, const Node* node);
+
+/// Declarations looked up so far by the head or body of the declaration being rewritten on this thread, in order.
+/// Only recorded while shd_rewrite_module runs in parallel, see rewrite_module_parallel.
+static SHADY_THREAD_LOCAL struct List* requested_decls = NULL;
+/// Old declaration -> DeclRequests, on the thread that rewrites the heads while shd_rewrite_module runs in parallel
+static SHADY_THREAD_LOCAL NodeMap* decls_requests = NULL;
+
+typedef struct {
+    struct List* head;
+    struct List* body;
+} DeclRequests;
+
+static DeclRequests* get_decl_requests(const Node* old) {
+    DeclRequests* found = shd_node_map_find(DeclRequests, decls_requests, old);
+    if (found)
+        return found;
+    DeclRequests requests = {
+        .head = shd_new_list(const Node*),
+        .body = shd_new_list(const Node*),
+    };
+    shd_node_map_insert(DeclRequests, decls_requests, old, requests);
+    return shd_node_map_find(DeclRequests, decls_requests, old);
+}
+
+/// Rewriting a node rewrites its mem operand first, and so on: on long mem chains that recursion gets as deep as the
+/// chain is long. Instead, we walk the part of the chain that wasn't rewritten yet with an explicit stack, and rewrite
+/// it oldest-first, so that every step finds its predecessor in the map straight away.
+/// The walk stops at anything already in the map, so mappings registered up front (ie for the AbsMem of a body, before
+/// rewriting it) are honoured, but the rewrite fn sees the chain before the node, see shd_rewrite_node.
+static void rewrite_mem_chain_iteratively(Rewriter* rewriter, const Node* node) {
+    // without memoization, the earlier steps would just get rewritten again
+    if (!rewriter->config.search_map || !rewriter->config.write_map)
+        return;
+    const Node* mem = NULL;
+    if (is_mem(node))
+        mem = shd_get_parent_mem(node);
+    else if (is_terminator(node))
+        mem = get_terminator_mem(node);
+
+    struct List* chain = NULL;
+    // we leave the AbsMem at the start of the chain to the regular logic, as it refers to the enclosing abstraction
+    while (mem && mem->tag != AbsMem_TAG && !shd_search_processed(rewriter, mem)) {
+        // most of the time the chain was already rewritten, this avoids allocating anything in that case
+        if (!chain)
+            chain = shd_new_list(const Node*);
+        shd_list_append(const Node*, chain, mem);
+        mem = shd_get_parent_mem(mem);
+    }
+    if (!chain)
+        return;
+
+    while (shd_list_count(chain) > 0) {
+        const Node* step = shd_list_pop(const Node*, chain);
+        rewrite_op_helper(rewriter, NcMem, "mem", step);
+    }
+    shd_destroy_list(chain);
+}
+
+/// How many calls to shd_rewrite_node_with_fn are running on this thread, see rewrite_values_iteratively
+static SHADY_THREAD_LOCAL size_t rewrite_depth = 0;
+/// Past this depth, the value operands of a node get rewritten from an explicit stack before the node itself
+#define MAX_REWRITE_DEPTH 256
+
+typedef struct {
+    IterativeVisitor visitor;
+    Rewriter* rewriter;
+    const Node* root;
+} ValuesWalk;
+
+static bool rewrite_values_filter(ValuesWalk* walk, const Node* node) {
+    if (node == walk->root)
+        return true;
+    // mem chains have their own walk, and nominal nodes (ie params) have to be mapped by whoever introduces them
+    if (!is_value(node) || is_mem(node) || shd_is_node_nominal(node))
+        return false;
+    return !shd_search_processed(walk->rewriter, node);
+}
+
+static void rewrite_values_post(ValuesWalk* walk, const Node* node) {
+    if (node != walk->root)
+        rewrite_op_helper(walk->rewriter, NcValue, "value", node);
+}
+
+/// Rewriting a value rewrites its operands first, and so on: on deep expressions (ie long chains of arithmetic) that
+/// recursion gets as deep as the expression. Once it's deep enough, we rewrite the values @p node depends on that
+/// aren't in the map yet with an explicit stack instead, operands first, so that the recursion on them ends right away.
+/// This only kicks in past MAX_REWRITE_DEPTH, so rewrite fns normally see values the same way they would recursively.
+static void rewrite_values_iteratively(Rewriter* rewriter, const Node* node) {
+    if (rewrite_depth < MAX_REWRITE_DEPTH || !rewriter->config.search_map || !rewriter->config.write_map)
+        return;
+    ValuesWalk walk = {
+        .visitor = {
+            .exclude = NcType | NcDeclaration | NcMem,
+            .filter_fn = (IterativeVisitFilterFn) rewrite_values_filter,
+            .visit_post_fn = (IterativeVisitNodeFn) rewrite_values_post,
+        },
+        .rewriter = rewriter,
+        .root = node,
+    };
+    // whatever the walk rewrites starts over from a shallow depth, so that it doesn't walk again for each of them
+    size_t depth = rewrite_depth;
+    rewrite_depth = 0;
+    shd_visit_iteratively(&walk.visitor, shd_singleton(node));
+    rewrite_depth = depth;
+}
+
 const Node* shd_rewrite_node_with_fn(Rewriter* rewriter, const Node* node, RewriteNodeFn fn) {
     assert(rewriter->rewrite_fn);
     if (!node)
@@ -88,7 +214,11 @@ const Node* shd_rewrite_node_with_fn(Rewriter* rewriter, const Node* node, Rewri
     if (found)
         return *found;
 
+    rewrite_mem_chain_iteratively(rewriter, node);
+    rewrite_values_iteratively(rewriter, node);
+    rewrite_depth++;
     const Node* rewritten = fn(rewriter, node);
+    rewrite_depth--;
     // assert(rewriter->dst_arena == rewritten->arena);
     if (is_declaration(node))
         return rewritten;
@@ -126,6 +256,7 @@ const Node* shd_rewrite_op_with_fn(Rewriter* rewriter, NodeClass class, String o
     if (found)
         return *found;
 
+    rewrite_mem_chain_iteratively(rewriter, node);
     const Node* rewritten = fn(rewriter, class, op_name, node);
     if (is_declaration(node))
         return rewritten;
@@ -168,13 +299,15 @@ static Nodes rewrite_ops_helper(Rewriter* rewriter, NodeClass class, String op_n
 
 static const Node** search_processed_(const Rewriter* ctx, const Node* old, bool deep) {
     if (is_declaration(old)) {
-        const Node** found = shd_dict_find_value(const Node*, const Node*, ctx->decls_map, old);
-        return found ? found : NULL;
+        // declarations map to themselves, the entry is only created once something refers to them
+        if (ctx->config.in_place && !shd_node_map_contains(ctx->decls_map, old))
+            shd_node_map_insert(const Node*, ctx->decls_map, old, old);
+        return shd_node_map_find(const Node*, ctx->decls_map, old);
     }
 
     while (ctx) {
         assert(ctx->map && "this rewriter has no processed cache");
-        const Node** found = shd_dict_find_value(const Node*, const Node*, ctx->map, old);
+        const Node** found = shd_node_map_find(const Node*, ctx->map, old);
         if (found)
             return found;
         if (deep)
@@ -186,6 +319,8 @@ static const Node** search_processed_(const Rewriter* ctx, const Node* old, bool
 }
 
 const Node** shd_search_processed(const Rewriter* ctx, const Node* old) {
+    if (requested_decls && is_declaration(old))
+        shd_list_append(const Node*, requested_decls, old);
     return search_processed_(ctx, old, true);
 }
 
@@ -220,9 +355,9 @@ void shd_register_processed(Rewriter* ctx, const Node* old, const Node* new) {
         shd_error("The same node got processed twice !");
     }
 #endif
-    struct Dict* map = is_declaration(old) ? ctx->decls_map : ctx->map;
+    NodeMap* map = is_declaration(old) ? ctx->decls_map : ctx->map;
     assert(map && "this rewriter has no processed cache");
-    bool r = shd_dict_insert_get_result(const Node*, const Node*, map, old, new);
+    bool r = shd_node_map_insert(const Node*, map, old, new);
     assert(r);
 }
 
@@ -232,18 +367,193 @@ void shd_register_processed_list(Rewriter* rewriter, Nodes old, Nodes new) {
         shd_register_processed(rewriter, old.nodes[i], new.nodes[i]);
 }
 
-KeyHash shd_hash_node(Node** pnode);
-bool shd_compare_node(Node** pa, Node** pb);
-
 #pragma GCC diagnostic error "-Wswitch"
 
 #include "rewrite_generated.c"
 
+typedef struct {
+    const Node* old;
+    Node* new;
+    /// Where the declarations its body looks up get recorded
+    struct List* requests;
+} FunctionToRewrite;
+
+typedef struct {
+    Rewriter* root;
+    struct List* functions;
+    volatile uint32_t next;
+    /// Lookups in the arenas each worker destroyed, for the thread running the pass to count them as its own
+    IrArenaStats* destroyed;
+    volatile uint32_t workers;
+} ParallelRewrite;
+
+static void rewrite_function_bodies(ParallelRewrite* job) {
+    IrArenaStats destroyed_before = _shd_get_destroyed_ir_arenas_stats();
+    // the passes cast the rewriter to their context, so each worker needs a copy of the whole thing
+    Rewriter* worker = malloc(job->root->config.context_size);
+    memcpy(worker, job->root, job->root->config.context_size);
+    *worker = shd_create_children_rewriter(job->root);
+    // the root's map is only read from while this runs, but looking up declarations might add to this one
+    worker->decls_map = shd_clone_node_map(job->root->decls_map);
+    worker->own_decls = true;
+
+    size_t count = shd_list_count(job->functions);
+    while (true) {
+        size_t i = shd_atomic_fetch_add_u32(&job->next, 1);
+        if (i >= count)
+            break;
+        FunctionToRewrite f = shd_read_list(FunctionToRewrite, job->functions)[i];
+        requested_decls = f.requests;
+        shd_recreate_node_body(worker, f.old, f.new);
+        requested_decls = NULL;
+    }
+
+    shd_destroy_rewriter(worker);
+    free(worker);
+
+    IrArenaStats destroyed_after = _shd_get_destroyed_ir_arenas_stats();
+    IrArenaStats* destroyed = &job->destroyed[shd_atomic_fetch_add_u32(&job->workers, 1)];
+    destroyed->node_lookups = destroyed_after.node_lookups - destroyed_before.node_lookups;
+    destroyed->node_hits = destroyed_after.node_hits - destroyed_before.node_hits;
+}
+
+typedef struct {
+    NodeMap* visited;
+    struct List* order;
+} DeclsOrder;
+
+/// Serial mode rewrites a declaration the first time it's looked up: its head, during which it gets added to the
+/// module, then its body, and whatever they look up that wasn't rewritten yet gets rewritten right there.
+static void order_like_serial_mode(DeclsOrder* o, const Node* old) {
+    if (!shd_node_set_insert(o->visited, old))
+        return;
+    DeclRequests* requests = shd_node_map_find(DeclRequests, decls_requests, old);
+    if (requests) {
+        for (size_t i = 0; i < shd_list_count(requests->head); i++)
+            order_like_serial_mode(o, shd_read_list(const Node*, requests->head)[i]);
+    }
+    shd_list_append(const Node*, o->order, old);
+    if (requests) {
+        for (size_t i = 0; i < shd_list_count(requests->body); i++)
+            order_like_serial_mode(o, shd_read_list(const Node*, requests->body)[i]);
+    }
+}
+
+/// Keeps the declarations of the destination module that serial mode would have created, in the order it would have
+/// created them in, so that both modes give the same module
+static void retain_decls_like_serial_mode(Rewriter* rewriter) {
+    DeclsOrder o = {
+        .visited = shd_new_node_set(),
+        .order = shd_new_list(const Node*),
+    };
+    Nodes old_decls = shd_module_get_declarations(rewriter->src_module);
+    for (size_t i = 0; i < old_decls.count; i++) {
+        if (shd_lookup_well_known_annotation(old_decls.nodes[i], AnnExported))
+            order_like_serial_mode(&o, old_decls.nodes[i]);
+    }
+
+    Nodes new_decls = shd_module_get_declarations(rewriter->dst_module);
+    NodeMap* rewritten = shd_new_node_set();
+    struct List* retained = shd_new_list(Node*);
+    for (size_t i = 0; i < shd_list_count(o.order); i++) {
+        const Node* old = shd_read_list(const Node*, o.order)[i];
+        const Node** new = shd_node_map_find(const Node*, rewriter->decls_map, old);
+        if (!new || !*new || !is_declaration(*new))
+            continue;
+        shd_list_append(Node*, retained, (Node*) *new);
+        shd_node_set_insert(rewritten, *new);
+    }
+    size_t i = 0;
+    const Node* old;
+    const Node* new;
+    while (shd_node_map_iter(rewriter->decls_map, &i, &old, &new)) {
+        if (new)
+            shd_node_set_insert(rewritten, new);
+    }
+    // anything else was created by the pass itself and goes last, serial mode would have interleaved it with the others
+    for (size_t j = 0; j < new_decls.count; j++) {
+        if (!shd_node_map_contains(rewritten, new_decls.nodes[j]))
+            shd_list_append(Node*, retained, (Node*) new_decls.nodes[j]);
+    }
+    _shd_module_retain_decls(rewriter->dst_module, shd_list_count(retained), shd_read_list(Node*, retained));
+
+    shd_destroy_list(retained);
+    shd_destroy_node_map(rewritten);
+    shd_destroy_list(o.order);
+    shd_destroy_node_map(o.visited);
+}
+
+static bool rewrite_module_parallel(Rewriter* rewriter) {
+    if (!rewriter->config.function_local || !rewriter->config.search_map || !rewriter->dst_arena->concurrency)
+        return false;
+    assert(rewriter->config.context_size >= sizeof(Rewriter));
+    ThreadPool* pool = shd_get_pass_thread_pool();
+    if (!pool || shd_get_thread_pool_size(pool) < 2)
+        return false;
+
+    // workers can't safely pull in declarations on demand, so every declaration head is created upfront. The lookups
+    // of declarations are recorded along the way, to get rid of the ones serial mode wouldn't have created afterwards.
+    NodeMap* outer_decls_requests = decls_requests;
+    decls_requests = shd_new_node_map(DeclRequests);
+    Nodes old_decls = shd_module_get_declarations(rewriter->src_module);
+    struct List* functions = shd_new_list(FunctionToRewrite);
+    struct List* others = shd_new_list(FunctionToRewrite);
+    for (size_t i = 0; i < old_decls.count; i++) {
+        const Node* old = old_decls.nodes[i];
+        // rewriting an earlier head might have processed this declaration entirely already
+        if (search_processed_(rewriter, old, true))
+            continue;
+        FunctionToRewrite entry = { .old = old, .new = shd_recreate_node_head(rewriter, old) };
+        if (old->tag == Function_TAG && old->payload.fun.body) {
+            entry.requests = get_decl_requests(old)->body;
+            shd_list_append(FunctionToRewrite, functions, entry);
+        } else
+            shd_list_append(FunctionToRewrite, others, entry);
+    }
+
+    for (size_t i = 0; i < shd_list_count(others); i++) {
+        FunctionToRewrite entry = shd_read_list(FunctionToRewrite, others)[i];
+        shd_recreate_node_body(rewriter, entry.old, entry.new);
+    }
+    shd_destroy_list(others);
+
+    ParallelRewrite job = {
+        .root = rewriter,
+        .functions = functions,
+        .next = 0,
+        .destroyed = calloc(shd_get_thread_pool_size(pool), sizeof(IrArenaStats)),
+    };
+    // the workers record what they look up in the lists of their functions instead
+    NodeMap* heads_requests = decls_requests;
+    decls_requests = NULL;
+    if (shd_list_count(functions) > 0)
+        shd_thread_pool_run(pool, (ThreadFn) rewrite_function_bodies, &job);
+    shd_destroy_list(functions);
+    for (size_t i = 0; i < job.workers; i++)
+        _shd_add_destroyed_ir_arenas_stats(job.destroyed[i]);
+    free(job.destroyed);
+    decls_requests = heads_requests;
+
+    retain_decls_like_serial_mode(rewriter);
+
+    size_t i = 0;
+    DeclRequests requests;
+    while (shd_node_map_iter(decls_requests, &i, NULL, &requests)) {
+        shd_destroy_list(requests.head);
+        shd_destroy_list(requests.body);
+    }
+    shd_destroy_node_map(decls_requests);
+    decls_requests = outer_decls_requests;
+    return true;
+}
+
 void shd_rewrite_module(Rewriter* rewriter) {
     assert(rewriter->dst_module != rewriter->src_module);
+    if (rewrite_module_parallel(rewriter))
+        return;
     Nodes old_decls = shd_module_get_declarations(rewriter->src_module);
     for (size_t i = 0; i < old_decls.count; i++) {
-        if (!shd_lookup_annotation(old_decls.nodes[i], "Exported")) continue;
+        if (!shd_lookup_well_known_annotation(old_decls.nodes[i], AnnExported)) continue;
         rewrite_op_helper(rewriter, NcDeclaration, "decl", old_decls.nodes[i]);
     }
 }
@@ -263,6 +573,9 @@ Nodes shd_recreate_params(Rewriter* rewriter, Nodes oparams) {
 }
 
 Node* shd_recreate_node_head(Rewriter* rewriter, const Node* old) {
+    struct List* outer_requests = requested_decls;
+    if (decls_requests)
+        requested_decls = get_decl_requests(old)->head;
     Node* new = NULL;
     switch (is_declaration(old)) {
         case GlobalVariable_TAG: {
@@ -302,11 +615,15 @@ Node* shd_recreate_node_head(Rewriter* rewriter, const Node* old) {
     }
     assert(new);
     shd_register_processed(rewriter, old, new);
+    requested_decls = outer_requests;
     return new;
 }
 
 void shd_recreate_node_body(Rewriter* rewriter, const Node* old, Node* new) {
     assert(is_declaration(new));
+    struct List* outer_requests = requested_decls;
+    if (decls_requests)
+        requested_decls = get_decl_requests(old)->body;
     switch (is_declaration(old)) {
         case GlobalVariable_TAG: {
             new->payload.global_variable.init = rewrite_op_helper(rewriter, NcValue, "init", old->payload.global_variable.init);
@@ -328,6 +645,7 @@ void shd_recreate_node_body(Rewriter* rewriter, const Node* old, Node* new) {
         }
         case NotADeclaration: shd_error("not a decl");
     }
+    requested_decls = outer_requests;
 }
 
 const Node* shd_recreate_node(Rewriter* rewriter, const Node* node) {
@@ -370,7 +688,7 @@ const Node* shd_recreate_node(Rewriter* rewriter, const Node* node) {
 void shd_dump_rewriter_map(Rewriter* r) {
     size_t i = 0;
     const Node* src, *dst;
-    while (shd_dict_iter(r->map, &i, &src, &dst)) {
+    while (shd_node_map_iter(r->map, &i, &src, &dst)) {
         shd_log_node(ERROR, src);
         shd_log_fmt(ERROR, " -> ");
         shd_log_node(ERROR, dst);
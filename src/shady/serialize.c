@@ -0,0 +1,605 @@
+#include "ir_private.h"
+#include "node_map.h"
+
+#include "shady/visit.h"
+
+#include "list.h"
+#include "dict.h"
+#include "growy.h"
+#include "log.h"
+#include "portability.h"
+
+#include <string.h>
+#include <assert.h>
+
+/// Layout: header, the ArenaConfig the module was built with (field by field, see write_arena_config), the string table,
+/// then one record per node, written so that every operand comes before its users. The bodies of nominal nodes are set
+/// by separate records, which breaks the cycles they're involved in. The declaration order of the module comes last.
+/// All values are written in host byte order, binary modules are a cache format rather than an interchange one.
+/// Corrupt input makes shd_deserialize_module return NULL rather than abort, since it usually comes from a cache on disk.
+#define BINARY_MODULE_MAGIC 0x42444853 // 'SHDB'
+#define BINARY_MODULE_VERSION 2
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t grammar_hash;
+    uint32_t strings_count;
+    uint32_t nodes_count;
+    uint32_t module_name;
+} BinaryModuleHeader;
+
+enum {
+    /// Sets the body (or init/value) of a nominal node written earlier: nominal id, body id
+    BodyRecord = 0xFFFFFFFE,
+    EndRecord = 0xFFFFFFFF,
+};
+
+KeyHash shd_hash_string(const char** string);
+bool shd_compare_string(const char** a, const char** b);
+
+typedef struct {
+    Growy* records;
+    Growy* strings;
+    struct Dict* string_ids;
+    uint32_t strings_count;
+    /// Node -> id of its last record. Ids start at 1, 0 marks a node whose operands are still being written.
+    NodeMap* ids;
+    uint32_t nodes_count;
+    /// Nominal nodes whose body gets written once everything else reachable has been
+    struct List* bodies;
+} Serializer;
+
+typedef struct {
+    IrArena* arena;
+    Module* module;
+    const char* data;
+    size_t size;
+    size_t cursor;
+    String* strings;
+    uint32_t strings_count;
+    const Node** nodes;
+    uint32_t nodes_count;
+    uint32_t loaded;
+    /// Set once the input turned out to be corrupt, reads return zeroes from then on
+    bool failed;
+} Deserializer;
+
+static void write_u32(Serializer* s, uint32_t value) {
+    shd_growy_append_object(s->records, value);
+}
+
+static void write_pod(Serializer* s, const void* data, size_t size) {
+    shd_growy_append_bytes(s->records, size, (const char*) data);
+}
+
+static uint32_t intern_string(Serializer* s, String str) {
+    if (!str)
+        return 0;
+    uint32_t* found = shd_dict_find_value(String, uint32_t, s->string_ids, str);
+    if (found)
+        return *found;
+    uint32_t id = ++s->strings_count;
+    shd_dict_insert(String, uint32_t, s->string_ids, str, id);
+    uint32_t len = (uint32_t) strlen(str);
+    shd_growy_append_object(s->strings, len);
+    shd_growy_append_bytes(s->strings, len, str);
+    return id;
+}
+
+static void write_string(Serializer* s, String str) {
+    write_u32(s, intern_string(s, str));
+}
+
+static void write_strings(Serializer* s, Strings strs) {
+    write_u32(s, (uint32_t) strs.count);
+    for (size_t i = 0; i < strs.count; i++)
+        write_string(s, strs.strings[i]);
+}
+
+static void write_node(Serializer* s, const Node* node) {
+    if (!node) {
+        write_u32(s, 0);
+        return;
+    }
+    uint32_t* id = shd_node_map_find(uint32_t, s->ids, node);
+    assert(id && *id && "operands are written before their users");
+    write_u32(s, *id);
+}
+
+static void write_nodes(Serializer* s, Nodes nodes) {
+    write_u32(s, (uint32_t) nodes.count);
+    for (size_t i = 0; i < nodes.count; i++)
+        write_node(s, nodes.nodes[i]);
+}
+
+static void fail(Deserializer* d, const char* reason) {
+    if (!d->failed)
+        shd_warn_print("Corrupt binary module: %s\n", reason);
+    d->failed = true;
+}
+
+static void read_pod(Deserializer* d, void* dst, size_t size) {
+    if (d->failed || size > d->size - d->cursor) {
+        fail(d, "truncated");
+        memset(dst, 0, size);
+        return;
+    }
+    memcpy(dst, d->data + d->cursor, size);
+    d->cursor += size;
+}
+
+static uint32_t read_u32(Deserializer* d) {
+    uint32_t value;
+    read_pod(d, &value, sizeof(value));
+    return value;
+}
+
+static String read_string(Deserializer* d) {
+    uint32_t id = read_u32(d);
+    if (id == 0)
+        return NULL;
+    if (id > d->strings_count) {
+        fail(d, "invalid string reference");
+        return NULL;
+    }
+    return d->strings[id - 1];
+}
+
+/// Every element of a list takes at least a u32, so this rejects counts the rest of the input can't hold
+static uint32_t read_count(Deserializer* d) {
+    uint32_t count = read_u32(d);
+    if (count > (d->size - d->cursor) / sizeof(uint32_t)) {
+        fail(d, "invalid list length");
+        return 0;
+    }
+    return count;
+}
+
+static Strings read_strings(Deserializer* d) {
+    uint32_t count = read_count(d);
+    LARRAY(String, strs, count + 1);
+    for (size_t i = 0; i < count; i++)
+        strs[i] = read_string(d);
+    return shd_strings(d->arena, count, strs);
+}
+
+static const Node* read_node(Deserializer* d) {
+    uint32_t id = read_u32(d);
+    if (id == 0)
+        return NULL;
+    if (id > d->loaded) {
+        fail(d, "invalid node reference");
+        return NULL;
+    }
+    return d->nodes[id - 1];
+}
+
+static Nodes read_nodes(Deserializer* d) {
+    uint32_t count = read_count(d);
+    LARRAY(const Node*, nodes, count + 1);
+    for (size_t i = 0; i < count; i++)
+        nodes[i] = read_node(d);
+    return shd_nodes(d->arena, count, nodes);
+}
+
+#include "serialize_generated.c"
+
+static const Node* get_nominal_body(const Node* node) {
+    switch (node->tag) {
+        case Function_TAG: return node->payload.fun.body;
+        case BasicBlock_TAG: return node->payload.basic_block.body;
+        case Constant_TAG: return node->payload.constant.value;
+        case GlobalVariable_TAG: return node->payload.global_variable.init;
+        case NominalType_TAG: return node->payload.nom_type.body;
+        default: return NULL;
+    }
+}
+
+static bool is_body_operand(const Node* user, String op_name) {
+    switch (user->tag) {
+        case Function_TAG:
+        case BasicBlock_TAG:
+        case NominalType_TAG: return strcmp(op_name, "body") == 0;
+        case Constant_TAG: return strcmp(op_name, "value") == 0;
+        case GlobalVariable_TAG: return strcmp(op_name, "init") == 0;
+        default: return false;
+    }
+}
+
+/// Nominal nodes are written without their bodies, these can only be set once the head exists (see BodyRecord)
+static void write_payload(Serializer* s, const Node* node) {
+    switch (node->tag) {
+        case Param_TAG: {
+            write_node(s, node->payload.param.type);
+            write_string(s, node->payload.param.name);
+            break;
+        }
+        case Function_TAG: {
+            write_string(s, node->payload.fun.name);
+            write_nodes(s, node->payload.fun.annotations);
+            write_nodes(s, node->payload.fun.params);
+            write_nodes(s, node->payload.fun.return_types);
+            break;
+        }
+        case BasicBlock_TAG: {
+            write_nodes(s, node->payload.basic_block.params);
+            write_string(s, node->payload.basic_block.name);
+            break;
+        }
+        case Constant_TAG: {
+            write_string(s, node->payload.constant.name);
+            write_nodes(s, node->payload.constant.annotations);
+            write_node(s, node->payload.constant.type_hint);
+            break;
+        }
+        case GlobalVariable_TAG: {
+            write_string(s, node->payload.global_variable.name);
+            write_nodes(s, node->payload.global_variable.annotations);
+            write_node(s, node->payload.global_variable.type);
+            write_pod(s, &node->payload.global_variable.address_space, sizeof(AddressSpace));
+            break;
+        }
+        case NominalType_TAG: {
+            write_string(s, node->payload.nom_type.name);
+            write_nodes(s, node->payload.nom_type.annotations);
+            break;
+        }
+        default: write_payload_generated(s, node);
+    }
+}
+
+static const Node* read_payload(Deserializer* d, NodeTag tag) {
+    IrArena* a = d->arena;
+    switch (tag) {
+        case Param_TAG: {
+            const Type* type = read_node(d);
+            String name = read_string(d);
+            if (d->failed)
+                return NULL;
+            return param(a, type, name);
+        }
+        case Function_TAG: {
+            String name = read_string(d);
+            Nodes annotations = read_nodes(d);
+            Nodes params = read_nodes(d);
+            Nodes return_types = read_nodes(d);
+            if (d->failed)
+                return NULL;
+            return function(d->module, params, name, annotations, return_types);
+        }
+        case BasicBlock_TAG: {
+            Nodes params = read_nodes(d);
+            String name = read_string(d);
+            if (d->failed)
+                return NULL;
+            return basic_block(a, params, name);
+        }
+        case Constant_TAG: {
+            String name = read_string(d);
+            Nodes annotations = read_nodes(d);
+            const Type* type_hint = read_node(d);
+            if (d->failed)
+                return NULL;
+            return constant(d->module, annotations, type_hint, name);
+        }
+        case GlobalVariable_TAG: {
+            String name = read_string(d);
+            Nodes annotations = read_nodes(d);
+            const Type* type = read_node(d);
+            AddressSpace as;
+            read_pod(d, &as, sizeof(as));
+            if (d->failed)
+                return NULL;
+            return global_var(d->module, annotations, type, name, as);
+        }
+        case NominalType_TAG: {
+            String name = read_string(d);
+            Nodes annotations = read_nodes(d);
+            if (d->failed)
+                return NULL;
+            return nominal_type(d->module, annotations, name);
+        }
+        default: {
+            const Node* node = read_payload_generated(d, tag);
+            if (!node)
+                fail(d, "unknown node tag");
+            return node;
+        }
+    }
+}
+
+static void read_body(Deserializer* d) {
+    Node* nominal = (Node*) read_node(d);
+    const Node* body = read_node(d);
+    if (!nominal) {
+        fail(d, "invalid body record");
+        return;
+    }
+    if (d->failed)
+        return;
+    switch (nominal->tag) {
+        case Function_TAG:
+        case BasicBlock_TAG: shd_set_abstraction_body(nominal, body); break;
+        case Constant_TAG: nominal->payload.constant.value = body; break;
+        case GlobalVariable_TAG: nominal->payload.global_variable.init = body; break;
+        case NominalType_TAG: nominal->payload.nom_type.body = body; break;
+        default: fail(d, "invalid body record");
+    }
+}
+
+typedef struct {
+    const Node* node;
+    bool expanded;
+} WriteFrame;
+
+typedef struct {
+    Visitor v;
+    Serializer* s;
+    const Node* user;
+    struct List* stack;
+} WriteTraversal;
+
+static void push_operand(WriteTraversal* t, SHADY_UNUSED NodeClass class, String op_name, const Node* op, SHADY_UNUSED size_t i) {
+    if (is_body_operand(t->user, op_name))
+        return;
+    WriteFrame frame = { .node = op, .expanded = false };
+    shd_list_append(WriteFrame, t->stack, frame);
+}
+
+static void write_body(Serializer* s, const Node* nominal);
+
+static void write_record(Serializer* s, const Node* node) {
+    write_u32(s, (uint32_t) node->tag);
+    write_payload(s, node);
+    uint32_t id = ++s->nodes_count;
+    shd_node_map_insert(uint32_t, s->ids, node, id);
+
+    if (!get_nominal_body(node))
+        return;
+    // types get checked as they are built, and looking into a nominal type requires its body to be set already
+    if (node->tag == NominalType_TAG)
+        write_body(s, node);
+    else
+        shd_list_append(const Node*, s->bodies, node);
+}
+
+/// Writes everything reachable from root that wasn't written yet, operands first.
+/// This has its own notion of which nodes are being written, so the body of a nominal type can mention the nodes that
+/// led to it: these get written again, which is harmless since the deserializer hash-conses them back into one node.
+static void write_reachable(Serializer* s, const Node* root) {
+    WriteTraversal t = {
+        .v = { .visit_op_fn = (VisitOpFn) push_operand },
+        .s = s,
+        .stack = shd_new_list(WriteFrame),
+    };
+    NodeMap* in_progress = shd_new_node_set();
+    WriteFrame root_frame = { .node = root, .expanded = false };
+    shd_list_append(WriteFrame, t.stack, root_frame);
+
+    while (shd_list_count(t.stack) > 0) {
+        WriteFrame frame = shd_list_pop(WriteFrame, t.stack);
+        const Node* node = frame.node;
+        if (frame.expanded) {
+            shd_node_map_remove(in_progress, node);
+            write_record(s, node);
+            continue;
+        }
+        uint32_t* id = shd_node_map_find(uint32_t, s->ids, node);
+        if (id && *id)
+            continue;
+        // only the bodies of nominal nodes can close a cycle, and these are written separately.
+        // Nominal nodes can't be written twice either, since that would make two distinct nodes out of them.
+        if (shd_node_map_contains(in_progress, node) || (id && shd_is_node_nominal(node)))
+            shd_error("Binary modules can't express nominal nodes that depend on themselves outside of their bodies");
+
+        uint32_t pending = 0;
+        shd_node_map_insert(uint32_t, s->ids, node, pending);
+        shd_node_set_insert(in_progress, node);
+        frame.expanded = true;
+        shd_list_append(WriteFrame, t.stack, frame);
+
+        // operands get pushed after the node, so they are all written before it is popped again
+        size_t operands_start = shd_list_count(t.stack);
+        t.user = node;
+        shd_visit_node_operands(&t.v, 0, node);
+        // reverse them so the first operand gets written first
+        WriteFrame* frames = shd_read_list(WriteFrame, t.stack);
+        for (size_t i = operands_start, j = shd_list_count(t.stack); i + 1 < j; i++, j--) {
+            WriteFrame tmp = frames[i];
+            frames[i] = frames[j - 1];
+            frames[j - 1] = tmp;
+        }
+    }
+
+    shd_destroy_node_map(in_progress);
+    shd_destroy_list(t.stack);
+}
+
+static void write_body(Serializer* s, const Node* nominal) {
+    const Node* body = get_nominal_body(nominal);
+    write_reachable(s, body);
+    write_u32(s, BodyRecord);
+    write_node(s, nominal);
+    write_node(s, body);
+}
+
+/// Written field by field, so that padding and the layout of the struct don't end up in the output
+static void write_arena_config(Growy* g, const ArenaConfig* config) {
+    uint32_t fields[] = {
+        config->name_bound,
+        config->check_op_classes,
+        config->check_types,
+        config->allow_fold,
+        config->validate_builtin_types,
+        config->is_simt,
+        config->thread_safe,
+        config->specializations.subgroup_mask_representation,
+        config->specializations.workgroup_size[0],
+        config->specializations.workgroup_size[1],
+        config->specializations.workgroup_size[2],
+        config->memory.ptr_size,
+        config->memory.word_size,
+        config->optimisations.inline_single_use_bbs,
+        config->optimisations.fold_static_control_flow,
+        config->optimisations.delete_unreachable_structured_cases,
+        config->optimisations.weaken_non_leaking_allocas,
+    };
+    shd_growy_append_object(g, fields);
+    for (size_t i = 0; i < NumAddressSpaces; i++) {
+        uint32_t as[] = { config->address_spaces[i].physical, config->address_spaces[i].allowed };
+        shd_growy_append_object(g, as);
+    }
+}
+
+static ArenaConfig read_arena_config(Deserializer* d) {
+    ArenaConfig config;
+    memset(&config, 0, sizeof(config));
+    config.name_bound = read_u32(d);
+    config.check_op_classes = read_u32(d);
+    config.check_types = read_u32(d);
+    config.allow_fold = read_u32(d);
+    config.validate_builtin_types = read_u32(d);
+    config.is_simt = read_u32(d);
+    config.thread_safe = read_u32(d);
+    config.specializations.subgroup_mask_representation = (SubgroupMaskRepresentation) read_u32(d);
+    for (size_t i = 0; i < 3; i++)
+        config.specializations.workgroup_size[i] = read_u32(d);
+    config.memory.ptr_size = (IntSizes) read_u32(d);
+    config.memory.word_size = (IntSizes) read_u32(d);
+    config.optimisations.inline_single_use_bbs = read_u32(d);
+    config.optimisations.fold_static_control_flow = read_u32(d);
+    config.optimisations.delete_unreachable_structured_cases = read_u32(d);
+    config.optimisations.weaken_non_leaking_allocas = read_u32(d);
+    for (size_t i = 0; i < NumAddressSpaces; i++) {
+        config.address_spaces[i].physical = read_u32(d);
+        config.address_spaces[i].allowed = read_u32(d);
+    }
+    return config;
+}
+
+void shd_serialize_module(Module* mod, size_t* size, char** output) {
+    Serializer s = {
+        .records = shd_new_growy(),
+        .strings = shd_new_growy(),
+        .string_ids = shd_new_dict(String, uint32_t, (HashFn) shd_hash_string, (CmpFn) shd_compare_string),
+        .ids = shd_new_node_map(uint32_t),
+        .bodies = shd_new_list(const Node*),
+    };
+    uint32_t module_name = intern_string(&s, shd_module_get_name(mod));
+
+    Nodes decls = shd_module_get_declarations(mod);
+    for (size_t i = 0; i < decls.count; i++)
+        write_reachable(&s, decls.nodes[i]);
+    // writing a body can uncover more nominal nodes with bodies
+    for (size_t i = 0; i < shd_list_count(s.bodies); i++)
+        write_body(&s, shd_read_list(const Node*, s.bodies)[i]);
+    write_u32(&s, EndRecord);
+    write_nodes(&s, decls);
+
+    BinaryModuleHeader header = {
+        .magic = BINARY_MODULE_MAGIC,
+        .version = BINARY_MODULE_VERSION,
+        .grammar_hash = serialized_grammar_hash,
+        .strings_count = s.strings_count,
+        .nodes_count = s.nodes_count,
+        .module_name = module_name,
+    };
+    Growy* g = shd_new_growy();
+    shd_growy_append_object(g, header);
+    write_arena_config(g, shd_get_arena_config(shd_module_get_arena(mod)));
+    shd_growy_append_bytes(g, shd_growy_size(s.strings), shd_growy_data(s.strings));
+    shd_growy_append_bytes(g, shd_growy_size(s.records), shd_growy_data(s.records));
+
+    shd_destroy_growy(s.records);
+    shd_destroy_growy(s.strings);
+    shd_destroy_dict(s.string_ids);
+    shd_destroy_node_map(s.ids);
+    shd_destroy_list(s.bodies);
+
+    *size = shd_growy_size(g);
+    *output = shd_growy_deconstruct(g);
+}
+
+Module* shd_deserialize_module(size_t size, const char* data, String name) {
+    BinaryModuleHeader header;
+    if (size < sizeof(header))
+        return NULL;
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != BINARY_MODULE_MAGIC || header.version != BINARY_MODULE_VERSION || header.grammar_hash != serialized_grammar_hash) {
+        shd_warn_print("Binary module was written by an incompatible version of shady\n");
+        return NULL;
+    }
+    // every string and every record takes at least a u32, this keeps corrupt counts from allocating too much below
+    if (header.strings_count > size / sizeof(uint32_t) || header.nodes_count > size / sizeof(uint32_t)) {
+        shd_warn_print("Corrupt binary module: invalid header\n");
+        return NULL;
+    }
+
+    Deserializer d = {
+        .data = data,
+        .size = size,
+        .cursor = sizeof(header),
+        .strings_count = header.strings_count,
+        .nodes_count = header.nodes_count,
+    };
+    ArenaConfig aconfig = read_arena_config(&d);
+    if (d.failed)
+        return NULL;
+    d.arena = shd_new_ir_arena(&aconfig);
+
+    d.strings = calloc(header.strings_count, sizeof(String));
+    for (size_t i = 0; i < header.strings_count && !d.failed; i++) {
+        uint32_t len = read_u32(&d);
+        if (len > d.size - d.cursor) {
+            fail(&d, "truncated");
+            break;
+        }
+        d.strings[i] = string_sized(d.arena, len, d.data + d.cursor);
+        d.cursor += len;
+    }
+
+    if (header.module_name > header.strings_count)
+        fail(&d, "invalid string reference");
+    if (!name)
+        name = header.module_name && !d.failed ? d.strings[header.module_name - 1] : "";
+    d.module = shd_new_module(d.arena, name);
+
+    // every record only refers to the ones before it, so the whole module is rebuilt in one go
+    d.nodes = calloc(header.nodes_count, sizeof(const Node*));
+    while (!d.failed) {
+        uint32_t tag = read_u32(&d);
+        if (d.failed || tag == EndRecord)
+            break;
+        if (tag == BodyRecord) {
+            read_body(&d);
+            continue;
+        }
+        if (d.loaded == d.nodes_count) {
+            fail(&d, "more nodes than advertised");
+            break;
+        }
+        const Node* node = read_payload(&d, (NodeTag) tag);
+        if (node)
+            d.nodes[d.loaded++] = node;
+    }
+
+    // dependencies between declarations can make them get created out of order
+    Nodes decls = read_nodes(&d);
+    if (!d.failed && decls.count != shd_list_count(d.module->decls))
+        fail(&d, "declarations don't match its contents");
+
+    Module* m = NULL;
+    if (!d.failed) {
+        m = d.module;
+        shd_clear_list(m->decls);
+        for (size_t i = 0; i < decls.count; i++)
+            shd_list_append(const Node*, m->decls, decls.nodes[i]);
+        m->decls_view = shd_empty(d.arena);
+    } else
+        shd_destroy_ir_arena(d.arena);
+
+    free(d.strings);
+    free((void*) d.nodes);
+    return m;
+}
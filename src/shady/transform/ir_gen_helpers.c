@@ -152,7 +152,7 @@ const Node* get_builtin(Module* m, Builtin b) {
         const Node* decl = decls.nodes[i];
         if (decl->tag != GlobalVariable_TAG)
             continue;
-        const Node* a = shd_lookup_annotation(decl, "Builtin");
+        const Node* a = shd_lookup_well_known_annotation(decl, AnnBuiltin);
         if (!a)
             continue;
         String builtin_name = shd_get_annotation_string_payload(a);
@@ -173,7 +173,7 @@ const Node* get_or_create_builtin(Module* m, Builtin b, String n) {
     IrArena* a = shd_module_get_arena(m);
     decl = global_var(m, shd_singleton(annotation_value_helper(a, "Builtin", string_lit_helper(a,
                                                                                                shd_get_builtin_name(b)))),
-                      shd_get_builtin_type(a, b), n ? n : shd_format_string_arena(a->arena, "builtin_%s",
+                      shd_get_builtin_type(a, b), n ? n : shd_format_string_arena(_shd_get_ir_arena_allocator(a), "builtin_%s",
                                                                                                                                                                                        shd_get_builtin_name(
                                                                                                                                                                                           b)), as);
     return decl;
@@ -190,7 +190,7 @@ bool is_builtin_load_op(const Node* n, Builtin* out) {
         if (src->tag == RefDecl_TAG)
             src = src->payload.ref_decl.decl;
         if (src->tag == GlobalVariable_TAG) {
-            const Node* a = shd_lookup_annotation(src, "Builtin");
+            const Node* a = shd_lookup_well_known_annotation(src, AnnBuiltin);
             if (a) {
                 String bn = shd_get_annotation_string_payload(a);
                 assert(bn);
@@ -206,14 +206,9 @@ bool is_builtin_load_op(const Node* n, Builtin* out) {
 }
 
 const Node* find_or_process_decl(Rewriter* rewriter, const char* name) {
-    Nodes old_decls = shd_module_get_declarations(rewriter->src_module);
-    for (size_t i = 0; i < old_decls.count; i++) {
-        const Node* decl = old_decls.nodes[i];
-        if (strcmp(get_declaration_name(decl), name) == 0) {
-            return shd_rewrite_node(rewriter, decl);
-        }
-    }
-    assert(false);
+    const Node* decl = shd_module_get_declaration(rewriter->src_module, name);
+    assert(decl);
+    return shd_rewrite_node(rewriter, decl);
 }
 
 const Node* access_decl(Rewriter* rewriter, const char* name) {
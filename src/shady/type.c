@@ -195,11 +195,11 @@ String name_type_safe(IrArena* arena, const Type* t) {
         case Type_NoRet_TAG: return "no_ret";
         case Type_Int_TAG: {
             if (t->payload.int_type.is_signed)
-                return shd_format_string_arena(arena->arena, "i%s", ((String[]) { "8", "16", "32", "64" })[t->payload.int_type.width]);
+                return shd_format_string_arena(_shd_get_ir_arena_allocator(arena), "i%s", ((String[]) { "8", "16", "32", "64" })[t->payload.int_type.width]);
             else
-                return shd_format_string_arena(arena->arena, "u%s", ((String[]) { "8", "16", "32", "64" })[t->payload.int_type.width]);
+                return shd_format_string_arena(_shd_get_ir_arena_allocator(arena), "u%s", ((String[]) { "8", "16", "32", "64" })[t->payload.int_type.width]);
         }
-        case Type_Float_TAG: return shd_format_string_arena(arena->arena, "f%s", ((String[]) { "16", "32", "64" })[t->payload.float_type.width]);
+        case Type_Float_TAG: return shd_format_string_arena(_shd_get_ir_arena_allocator(arena), "f%s", ((String[]) { "16", "32", "64" })[t->payload.float_type.width]);
         case Type_Bool_TAG: return "bool";
         case Type_TypeDeclRef_TAG: return t->payload.type_decl_ref.decl->payload.nom_type.name;
         default: break;
@@ -1,7 +1,11 @@
 #include "shady/ir.h"
 #include "log.h"
+#include "list.h"
 #include "shady/visit.h"
 #include "analysis/cfg.h"
+#include "analysis/manager.h"
+#include "node_map.h"
+#include "arena.h"
 
 #include <assert.h>
 
@@ -33,18 +37,17 @@ void shd_visit_ops(Visitor* visitor, NodeClass op_class, String op_name, Nodes o
 
 void shd_visit_function_rpo(Visitor* visitor, const Node* function) {
     assert(function->tag == Function_TAG);
-    CFG* cfg = build_fn_cfg(function);
+    CFG* cfg = shd_get_fn_cfg(function);
     assert(cfg->rpo[0]->node == function);
     for (size_t i = 0; i < cfg->size; i++) {
         const Node* node = cfg->rpo[i]->node;
         shd_visit_node(visitor, node);
     }
-    destroy_cfg(cfg);
 }
 
 void shd_visit_function_bodies_rpo(Visitor* visitor, const Node* function) {
     assert(function->tag == Function_TAG);
-    CFG* cfg = build_fn_cfg(function);
+    CFG* cfg = shd_get_fn_cfg(function);
     assert(cfg->rpo[0]->node == function);
     for (size_t i = 0; i < cfg->size; i++) {
         const Node* node = cfg->rpo[i]->node;
@@ -52,7 +55,79 @@ void shd_visit_function_bodies_rpo(Visitor* visitor, const Node* function) {
         if (get_abstraction_body(node))
             shd_visit_node(visitor, get_abstraction_body(node));
     }
-    destroy_cfg(cfg);
+}
+
+typedef struct {
+    const Node* node;
+    bool expanded;
+} IterativeVisitFrame;
+
+typedef struct {
+    Visitor v;
+    IterativeVisitor* visitor;
+    const Node* user;
+    NodeMap* expanded;
+    struct List* stack;
+} IterativeVisitContext;
+
+static void iterative_visit_op(IterativeVisitContext* ctx, NodeClass class, String op_name, const Node* op, size_t i) {
+    if (ctx->visitor->visit_edge_fn)
+        ctx->visitor->visit_edge_fn(ctx->visitor, ctx->user, class, op_name, op, i);
+    if (shd_node_map_contains(ctx->expanded, op))
+        return;
+    IterativeVisitFrame frame = { .node = op, .expanded = false };
+    shd_list_append(IterativeVisitFrame, ctx->stack, frame);
+}
+
+void shd_visit_iteratively(IterativeVisitor* visitor, Nodes roots) {
+    Arena* scratch = shd_get_scratch_arena();
+    ArenaMark mark = shd_arena_mark(scratch);
+    IterativeVisitContext ctx = {
+        .v = { .visit_op_fn = (VisitOpFn) iterative_visit_op },
+        .visitor = visitor,
+        .expanded = shd_new_node_set_in(scratch),
+        .stack = shd_new_list(IterativeVisitFrame),
+    };
+
+    // roots are pushed in reverse so they get popped in order
+    for (size_t i = roots.count; i > 0; i--) {
+        IterativeVisitFrame frame = { .node = roots.nodes[i - 1], .expanded = false };
+        if (frame.node)
+            shd_list_append(IterativeVisitFrame, ctx.stack, frame);
+    }
+
+    while (shd_list_count(ctx.stack) > 0) {
+        IterativeVisitFrame frame = shd_list_pop(IterativeVisitFrame, ctx.stack);
+        const Node* node = frame.node;
+        if (frame.expanded) {
+            if (visitor->visit_post_fn)
+                visitor->visit_post_fn(visitor, node);
+            continue;
+        }
+        // a node can be pushed by several users before it gets expanded
+        if (shd_node_map_contains(ctx.expanded, node))
+            continue;
+        if (visitor->filter_fn && !visitor->filter_fn(visitor, node))
+            continue;
+        shd_node_set_insert(ctx.expanded, node);
+        frame.expanded = true;
+        shd_list_append(IterativeVisitFrame, ctx.stack, frame);
+
+        // operands get pushed after the node, so they are all visited before it's popped again
+        size_t operands_start = shd_list_count(ctx.stack);
+        ctx.user = node;
+        shd_visit_node_operands(&ctx.v, visitor->exclude, node);
+        // reverse them so the first operand gets visited first, like a recursive visitor would
+        IterativeVisitFrame* frames = shd_read_list(IterativeVisitFrame, ctx.stack);
+        for (size_t i = operands_start, j = shd_list_count(ctx.stack); i + 1 < j; i++, j--) {
+            IterativeVisitFrame tmp = frames[i];
+            frames[i] = frames[j - 1];
+            frames[j - 1] = tmp;
+        }
+    }
+
+    shd_destroy_list(ctx.stack);
+    shd_arena_rewind(scratch, mark);
 }
 
 #pragma GCC diagnostic error "-Wswitch"
@@ -0,0 +1,79 @@
+#include "shady/ir.h"
+#include "shady/driver.h"
+
+#include "log.h"
+#include "threading.h"
+
+#include <stdlib.h>
+
+#define CHECK(x, failure_handler) { if (!(x)) { shd_error_print(#x " failed\n"); failure_handler; } }
+
+#define THREADS_COUNT 8
+// enough for the ids to span several pages of the id table
+#define VALUES_COUNT 4096
+
+typedef struct {
+    IrArena* arena;
+    const Node* values[VALUES_COUNT];
+    const Node* params[VALUES_COUNT];
+} Worker;
+
+static const Node* gen_binop(IrArena* a, Op op, const Node* lhs, const Node* rhs) {
+    return prim_op(a, (PrimOp) { .op = op, .type_arguments = shd_empty(a), .operands = mk_nodes(a, lhs, rhs) });
+}
+
+/// Every worker builds the same structural nodes in the same order, so they race to create each one of them
+static void build_nodes(Worker* w) {
+    IrArena* a = w->arena;
+    const Type* int_t = shd_as_qualified_type(shd_int32_type(a), false);
+    const Node* acc = shd_int32_literal(a, 0);
+    for (size_t i = 0; i < VALUES_COUNT; i++) {
+        acc = gen_binop(a, add_op, acc, shd_int32_literal(a, (int32_t) i));
+        w->values[i] = acc;
+        // nominal, so each worker gets its own
+        w->params[i] = param(a, int_t, "p");
+    }
+}
+
+// Nodes built concurrently in a thread-safe arena: identical ones must come out as the same node, every node must get
+// its own id, and looking that id up must give the node back
+int main(int argc, char** argv) {
+    shd_parse_common_args(&argc, argv);
+
+    TargetConfig target_config = shd_default_target_config();
+    ArenaConfig aconfig = shd_default_arena_config(&target_config);
+    aconfig.thread_safe = true;
+    IrArena* a = shd_new_ir_arena(&aconfig);
+
+    Worker* workers = calloc(THREADS_COUNT, sizeof(Worker));
+    Thread* threads[THREADS_COUNT];
+    for (size_t i = 0; i < THREADS_COUNT; i++) {
+        workers[i].arena = a;
+        threads[i] = shd_spawn_thread((ThreadFn) build_nodes, &workers[i]);
+    }
+    for (size_t i = 0; i < THREADS_COUNT; i++)
+        shd_join_thread(threads[i]);
+
+    for (size_t i = 0; i < THREADS_COUNT; i++) {
+        for (size_t j = 0; j < VALUES_COUNT; j++) {
+            CHECK(workers[i].values[j] == workers[0].values[j], exit(-1));
+            const Node* p = workers[i].params[j];
+            CHECK(i == 0 || p != workers[0].params[j], exit(-1));
+            CHECK(shd_get_node_by_id(a, p->id) == p, exit(-1));
+        }
+    }
+    for (size_t j = 0; j < VALUES_COUNT; j++)
+        CHECK(shd_get_node_by_id(a, workers[0].values[j]->id) == workers[0].values[j], exit(-1));
+
+    // the same nodes built again afterwards are found rather than created
+    Worker* again = calloc(1, sizeof(Worker));
+    again->arena = a;
+    build_nodes(again);
+    for (size_t j = 0; j < VALUES_COUNT; j++)
+        CHECK(again->values[j] == workers[0].values[j], exit(-1));
+
+    free(again);
+    free(workers);
+    shd_destroy_ir_arena(a);
+    return 0;
+}
@@ -155,6 +155,27 @@ static void test_body_builder_impure_block_with_control_flow(IrArena* a) {
     shd_dump_module(m);
 }
 
+static void test_nodes_builder(IrArena* a) {
+    NodesBuilder builder = { 0 };
+    const Node* expected[100];
+    for (size_t i = 0; i < 100; i++) {
+        expected[i] = shd_int32_literal(a, (int32_t) i);
+        shd_nodes_builder_append(&builder, expected[i]);
+    }
+    expected[42] = shd_int32_literal(a, -1);
+    shd_nodes_builder_set(&builder, 42, expected[42]);
+    Nodes built = shd_nodes_builder_finish(a, &builder);
+    // it's interned like any other list, so this finds the very same one
+    CHECK(built.nodes == shd_nodes(a, 100, expected).nodes, exit(-1));
+    CHECK(builder.count == 0 && !builder.nodes, exit(-1));
+
+    NodesBuilder from = shd_nodes_builder_from(shd_nodes(a, 50, expected));
+    shd_nodes_builder_append_nodes(&from, shd_nodes(a, 50, expected + 50));
+    CHECK(shd_nodes_builder_finish(a, &from).nodes == built.nodes, exit(-1));
+
+    CHECK(shd_nodes_builder_finish(a, &builder).nodes == shd_empty(a).nodes, exit(-1));
+}
+
 int main(int argc, char** argv) {
     shd_parse_common_args(&argc, argv);
 
@@ -165,5 +186,6 @@ int main(int argc, char** argv) {
     test_body_builder_fun_body(a);
     test_body_builder_impure_block(a);
     test_body_builder_impure_block_with_control_flow(a);
+    test_nodes_builder(a);
     shd_destroy_ir_arena(a);
 }
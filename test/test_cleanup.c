@@ -0,0 +1,67 @@
+#include "shady/ir.h"
+#include "shady/driver.h"
+
+#include "../shady/passes/passes.h"
+
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECK(x, failure_handler) { if (!(x)) { shd_error_print(#x " failed\n"); failure_handler; } }
+
+/// fn(x) jumps to a block that returns x, which cleanup inlines since that's its only use
+static Node* make_fn(Module* m) {
+    IrArena* a = shd_module_get_arena(m);
+    const Type* int_t = shd_as_qualified_type(shd_int32_type(a), false);
+    const Node* x = param(a, int_t, "x");
+    Node* fn = function(m, shd_singleton(x), "fn", shd_singleton(annotation(a, (Annotation) { .name = "Exported" })), shd_singleton(int_t));
+    Node* next = basic_block(a, shd_empty(a), "next");
+    shd_set_abstraction_body(next, fn_ret(a, (Return) { .mem = shd_get_abstraction_mem(next), .args = shd_singleton(x) }));
+    shd_set_abstraction_body(fn, jump_helper(a, shd_get_abstraction_mem(fn), next, shd_empty(a)));
+    return fn;
+}
+
+static const Node* find_fn(Module* m) {
+    Nodes decls = shd_module_get_declarations(m);
+    for (size_t i = 0; i < decls.count; i++) {
+        if (decls.nodes[i]->tag == Function_TAG && strcmp(decls.nodes[i]->payload.fun.name, "fn") == 0)
+            return decls.nodes[i];
+    }
+    return NULL;
+}
+
+// Cleanup rewrites function bodies in place: checks it does so on a copy of a module it was handed by its owner, and
+// that the worklist stops once a round changes nothing
+int main(int argc, char** argv) {
+    shd_parse_common_args(&argc, argv);
+
+    CompilerConfig config = shd_default_compiler_config();
+    ArenaConfig aconfig = shd_default_arena_config(&config.target);
+    IrArena* a = shd_new_ir_arena(&aconfig);
+    Module* m = shd_new_module(a, "test_module");
+    Node* fn = make_fn(m);
+    const Node* old_body = get_abstraction_body(fn);
+
+    size_t rounds;
+    Module* cleaned = shd_cleanup_count_rounds(&config, m, &rounds);
+    CHECK(shd_module_get_arena(cleaned) != a, exit(-1));
+    CHECK(get_abstraction_body(fn) == old_body, exit(-1));
+    const Node* cleaned_fn = find_fn(cleaned);
+    CHECK(cleaned_fn && get_abstraction_body(cleaned_fn)->tag == Return_TAG, exit(-1));
+    // one round inlining the block, one finding nothing left to do
+    CHECK(rounds == 2, exit(-1));
+    shd_destroy_ir_arena(shd_module_get_arena(cleaned));
+
+    // the module is ours, so the optimisations can be used on it directly
+    CHECK(shd_opt_simplify(&config, m, fn), exit(-1));
+    CHECK(find_fn(m) == fn, exit(-1));
+    CHECK(get_abstraction_body(fn)->tag == Return_TAG, exit(-1));
+    // with nothing left to simplify, the body isn't rebuilt either
+    const Node* simplified_body = get_abstraction_body(fn);
+    CHECK(!shd_opt_simplify(&config, m, fn), exit(-1));
+    CHECK(get_abstraction_body(fn) == simplified_body, exit(-1));
+
+    shd_destroy_ir_arena(a);
+    return 0;
+}
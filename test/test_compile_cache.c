@@ -0,0 +1,118 @@
+#include "shady/ir.h"
+#include "shady/driver.h"
+
+#include "log.h"
+#include "portability.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECK(x, failure_handler) { if (!(x)) { shd_error_print(#x " failed\n"); failure_handler; } }
+
+enum {
+    EntrySize = 1000
+};
+
+static void store_entry(const CompilerConfig* config, CompileCacheKey key, char fill) {
+    char data[EntrySize];
+    memset(data, fill, EntrySize);
+    shd_compile_cache_store(config, key, EntrySize, data);
+}
+
+static bool lookup_entry(const CompilerConfig* config, CompileCacheKey key, char fill) {
+    size_t size;
+    char* data;
+    if (!shd_compile_cache_lookup(config, key, &size, &data))
+        return false;
+    bool matches = size == EntrySize;
+    for (size_t i = 0; matches && i < size; i++)
+        matches &= data[i] == fill;
+    free(data);
+    return matches;
+}
+
+/// Compares everything that went into the keys, and frees the second one.
+static bool same_key(CompileCacheKey a, CompileCacheKey b) {
+    bool same = a.hash == b.hash && a.size == b.size && memcmp(a.data, b.data, a.size) == 0;
+    shd_destroy_compile_cache_key(b);
+    return same;
+}
+
+// file systems tend to have coarse timestamps, this makes sure the next access doesn't share one with the last
+static void wait_for_clock(void) {
+    uint64_t start = shd_get_time_nano();
+    while (shd_get_time_nano() - start < 50000000);
+}
+
+// Checks the keys tell apart what they need to, that entries come back intact and only for their own key, and that
+// eviction drops the oldest ones, or the ones it's told to
+int main(int argc, char** argv) {
+    shd_parse_common_args(&argc, argv);
+    CHECK(argc == 3, shd_error_print("Usage: test_compile_cache <input.slim> <cache directory>\n"); exit(-1));
+    String input = argv[1];
+
+    CompilerConfig config = shd_default_compiler_config();
+    config.cache.directory = argv[2];
+    Module* mod;
+    CHECK(shd_driver_load_source_file_from_filename(&config, input, "test", &mod) == NoError, exit(-1));
+
+    CompileCacheKey key = shd_compile_cache_key(&config, mod, "a");
+    CHECK(same_key(key, shd_compile_cache_key(&config, mod, "a")), exit(-1));
+    CHECK(!same_key(key, shd_compile_cache_key(&config, mod, "b")), exit(-1));
+    CompilerConfig other_config = config;
+    other_config.specialization.subgroup_size *= 2;
+    CHECK(!same_key(key, shd_compile_cache_key(&other_config, mod, "a")), exit(-1));
+    // these don't change the output
+    other_config = config;
+    other_config.logging.print_internal = !other_config.logging.print_internal;
+    other_config.cache.max_size /= 2;
+    CHECK(same_key(key, shd_compile_cache_key(&other_config, mod, "a")), exit(-1));
+    shd_destroy_compile_cache_key(key);
+
+    CompileCacheKey keys[3];
+    for (size_t i = 0; i < 3; i++)
+        keys[i] = shd_compile_cache_key(&config, mod, shd_fmt_string_irarena(shd_module_get_arena(mod), "entry%zu", i));
+
+    // a zero budget evicts everything, including leftovers from a previous run
+    config.cache.max_size = 0;
+    store_entry(&config, keys[0], 'x');
+    CHECK(!lookup_entry(&config, keys[0], 'x'), exit(-1));
+
+    // room for two entries, but not three: entries also hold their key, and a small header
+    config.cache.max_size = (keys[0].size + EntrySize) * 5 / 2;
+    store_entry(&config, keys[0], 'a');
+    wait_for_clock();
+    store_entry(&config, keys[1], 'b');
+    wait_for_clock();
+    CHECK(lookup_entry(&config, keys[1], 'b'), exit(-1));
+    wait_for_clock();
+    // a lookup counts as a use, so 1 should go before 0 now
+    CHECK(lookup_entry(&config, keys[0], 'a'), exit(-1));
+    wait_for_clock();
+    store_entry(&config, keys[2], 'c');
+    CHECK(lookup_entry(&config, keys[2], 'c'), exit(-1));
+    CHECK(lookup_entry(&config, keys[0], 'a'), exit(-1));
+    CHECK(!lookup_entry(&config, keys[1], 'b'), exit(-1));
+
+    // hashes can collide, finding an entry under the same one is not enough
+    CompileCacheKey colliding = keys[1];
+    colliding.hash = keys[2].hash;
+    CHECK(!lookup_entry(&config, colliding, 'c'), exit(-1));
+    CHECK(lookup_entry(&config, keys[2], 'c'), exit(-1));
+
+    // entries callers can't use get evicted for good
+    shd_compile_cache_evict(&config, keys[2]);
+    CHECK(!lookup_entry(&config, keys[2], 'c'), exit(-1));
+    CHECK(lookup_entry(&config, keys[0], 'a'), exit(-1));
+    store_entry(&config, keys[2], 'c');
+
+    // no directory means no caching at all
+    config.cache.directory = NULL;
+    CHECK(!lookup_entry(&config, keys[2], 'c'), exit(-1));
+
+    for (size_t i = 0; i < 3; i++)
+        shd_destroy_compile_cache_key(keys[i]);
+    shd_destroy_ir_arena(shd_module_get_arena(mod));
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include "shady/ir.h"
+#include "shady/driver.h"
+
+#include "../shady/analysis/cfg.h"
+
+#include "log.h"
+#include "list.h"
+#include "portability.h"
+
+#include <stdlib.h>
+
+#define CHECK(x, failure_handler) { if (!(x)) { shd_error_print(#x " failed\n"); failure_handler; } }
+
+static uint32_t next_random(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static bool has_tail_pred(CFNode* n) {
+    for (size_t j = 0; j < n->pred_edges.count; j++) {
+        if (n->pred_edges.edges[j].type == StructuredTailEdge)
+            return true;
+    }
+    return false;
+}
+
+static CFNode* reference_lca(CFNode** idoms, CFNode* i, CFNode* j) {
+    while (i->rpo_index != j->rpo_index) {
+        while (i->rpo_index < j->rpo_index) j = idoms[j->rpo_index];
+        while (i->rpo_index > j->rpo_index) i = idoms[i->rpo_index];
+    }
+    return i;
+}
+
+/// The iterative algorithm compute_domtree used before, as a reference. The results are indexed by RPO.
+static void compute_reference_idoms(CFG* cfg, CFNode** idoms) {
+    for (size_t i = 0; i < cfg->size; i++) {
+        CFNode* n = cfg->rpo[i];
+        idoms[i] = NULL;
+        if (n == cfg->entry)
+            continue;
+        for (size_t j = 0; j < n->pred_edges.count; j++) {
+            CFEdge e = n->pred_edges.edges[j];
+            if (e.src->rpo_index < n->rpo_index) {
+                idoms[i] = e.src;
+                break;
+            }
+        }
+    }
+
+    bool todo = true;
+    while (todo) {
+        todo = false;
+        for (size_t i = 0; i < cfg->size; i++) {
+            CFNode* n = cfg->rpo[i];
+            if (n == cfg->entry || has_tail_pred(n))
+                continue;
+            CFNode* new_idom = NULL;
+            for (size_t j = 0; j < n->pred_edges.count; j++) {
+                CFEdge e = n->pred_edges.edges[j];
+                if (e.type == StructuredTailEdge)
+                    continue;
+                new_idom = new_idom ? reference_lca(idoms, new_idom, e.src) : e.src;
+            }
+            if (idoms[i] != new_idom) {
+                idoms[i] = new_idom;
+                todo = true;
+            }
+        }
+    }
+}
+
+static bool reference_is_dominated(CFNode** idoms, CFNode* a, CFNode* b) {
+    while (a) {
+        if (a == b)
+            return true;
+        a = idoms[a->rpo_index];
+    }
+    return false;
+}
+
+static void check_cfg(CFG* cfg) {
+    CFNode** idoms = malloc(sizeof(CFNode*) * cfg->size);
+    compute_reference_idoms(cfg, idoms);
+    for (size_t i = 0; i < cfg->size; i++) {
+        CFNode* n = cfg->rpo[i];
+        CHECK(n->idom == idoms[i], exit(-1));
+        for (size_t j = 0; j < cfg->size; j++)
+            CHECK(cfg_is_dominated(n, cfg->rpo[j]) == reference_is_dominated(idoms, n, cfg->rpo[j]), exit(-1));
+    }
+    free(idoms);
+}
+
+static const Node* random_jump(IrArena* a, uint32_t* rng, const Node* mem, Node** blocks, size_t count) {
+    return jump_helper(a, mem, blocks[next_random(rng) % count], shd_empty(a));
+}
+
+/// Every block has an edge to a later one, or returns, so that each of them reaches an exit and the flipped CFG is whole.
+static const Node* random_terminator(IrArena* a, uint32_t* rng, const Node* cond, const Node* selector, Node** blocks, size_t count, size_t i) {
+    const Node* mem = shd_get_abstraction_mem(blocks[i]);
+    if (i + 1 == count)
+        return fn_ret(a, (Return) { .mem = mem, .args = shd_empty(a) });
+    const Node* forward = jump_helper(a, mem, blocks[i + 1 + next_random(rng) % (count - i - 1)], shd_empty(a));
+    switch (next_random(rng) % 4) {
+        case 0: return fn_ret(a, (Return) { .mem = mem, .args = shd_empty(a) });
+        case 1: return forward;
+        case 2: return branch(a, (Branch) {
+            .mem = mem,
+            .condition = cond,
+            .true_jump = forward,
+            .false_jump = random_jump(a, rng, mem, blocks, count),
+        });
+        default: {
+            size_t cases_count = 1 + next_random(rng) % 3;
+            LARRAY(const Node*, values, cases_count);
+            LARRAY(const Node*, jumps, cases_count);
+            for (size_t j = 0; j < cases_count; j++) {
+                values[j] = shd_uint32_literal(a, j);
+                jumps[j] = random_jump(a, rng, mem, blocks, count);
+            }
+            return br_switch(a, (Switch) {
+                .mem = mem,
+                .switch_value = selector,
+                .case_values = shd_nodes(a, cases_count, values),
+                .case_jumps = shd_nodes(a, cases_count, jumps),
+                .default_jump = forward,
+            });
+        }
+    }
+}
+
+static void test_random_cfgs(IrArena* a, uint32_t* rng, size_t iterations) {
+    Module* m = shd_new_module(a, "test_module");
+    for (size_t iteration = 0; iteration < iterations; iteration++) {
+        const Node* cond = param(a, shd_as_qualified_type(bool_type(a), false), "cond");
+        const Node* selector = param(a, shd_as_qualified_type(shd_uint32_type(a), false), "selector");
+        Node* fn = function(m, mk_nodes(a, cond, selector), shd_fmt_string_irarena(a, "fn%zu", iteration), shd_empty(a), shd_empty(a));
+
+        size_t count = 1 + next_random(rng) % 48;
+        LARRAY(Node*, blocks, count);
+        for (size_t i = 0; i < count; i++)
+            blocks[i] = basic_block(a, shd_empty(a), shd_fmt_string_irarena(a, "bb%zu", i));
+        for (size_t i = 0; i < count; i++)
+            shd_set_abstraction_body(blocks[i], random_terminator(a, rng, cond, selector, blocks, count, i));
+        shd_set_abstraction_body(fn, jump_helper(a, shd_get_abstraction_mem(fn), blocks[0], shd_empty(a)));
+
+        CFG* cfg = build_fn_cfg(fn);
+        check_cfg(cfg);
+        destroy_cfg(cfg);
+        cfg = build_fn_cfg_flipped(fn);
+        check_cfg(cfg);
+        destroy_cfg(cfg);
+    }
+}
+
+/// Real functions have structured control flow in them, which comes with its own rules for dominance.
+static void test_module_cfgs(const CompilerConfig* config, String filename) {
+    Module* mod;
+    CHECK(shd_driver_load_source_file_from_filename(config, filename, "test", &mod) == NoError, exit(-1));
+    CFGBuildConfig build_configs[] = { default_forward_cfg_build(), structured_scope_cfg_build() };
+    for (size_t i = 0; i < sizeof(build_configs) / sizeof(build_configs[0]); i++) {
+        struct List* cfgs = build_cfgs(mod, build_configs[i]);
+        for (size_t j = 0; j < shd_list_count(cfgs); j++) {
+            CFG* cfg = shd_read_list(CFG*, cfgs)[j];
+            check_cfg(cfg);
+            destroy_cfg(cfg);
+        }
+        shd_destroy_list(cfgs);
+    }
+    shd_destroy_ir_arena(shd_module_get_arena(mod));
+}
+
+// Checks the dominator trees against the reference implementation, on random CFGs and on any modules given as arguments
+int main(int argc, char** argv) {
+    shd_parse_common_args(&argc, argv);
+
+    TargetConfig target_config = shd_default_target_config();
+    ArenaConfig aconfig = shd_default_arena_config(&target_config);
+    IrArena* a = shd_new_ir_arena(&aconfig);
+    uint32_t rng = 0x5ADE5EEDu;
+    test_random_cfgs(a, &rng, 1000);
+    shd_destroy_ir_arena(a);
+
+    CompilerConfig config = shd_default_compiler_config();
+    for (int i = 1; i < argc; i++)
+        test_module_cfgs(&config, argv[i]);
+    return 0;
+}
@@ -0,0 +1,116 @@
+#include "shady/ir.h"
+#include "shady/driver.h"
+#include "shady/visit.h"
+
+#include "../shady/passes/passes.h"
+#include "../shady/transform/ir_gen_helpers.h"
+
+#include "log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECK(x, failure_handler) { if (!(x)) { shd_error_print(#x " failed\n"); failure_handler; } }
+
+typedef struct {
+    IterativeVisitor v;
+    size_t pushes;
+    size_t pops;
+    size_t builtin_loads;
+    size_t increments;
+} NodeCounter;
+
+static void count_node(NodeCounter* c, const Node* n) {
+    switch (n->tag) {
+        case PushStack_TAG: c->pushes++; break;
+        case PopStack_TAG: c->pops++; break;
+        case Load_TAG: {
+            Builtin b;
+            if (is_builtin_load_op(n, &b) && b == BuiltinSubgroupLocalInvocationId)
+                c->builtin_loads++;
+            break;
+        }
+        case PrimOp_TAG: {
+            PrimOp payload = n->payload.prim_op;
+            const Node* rhs = payload.operands.count == 2 ? payload.operands.nodes[1] : NULL;
+            if (payload.op == add_op && rhs && rhs->tag == IntLiteral_TAG && shd_get_int_literal_value(*shd_resolve_to_int_literal(rhs), false) == 1)
+                c->increments++;
+            break;
+        }
+        default: break;
+    }
+}
+
+static NodeCounter count_nodes(const Node* fn) {
+    NodeCounter c = {
+        .v = {
+            // stay within the function
+            .exclude = NcDeclaration | NcType,
+            .visit_post_fn = (IterativeVisitNodeFn) count_node,
+        },
+    };
+    shd_visit_iteratively(&c.v, shd_singleton(get_abstraction_body(fn)));
+    return c;
+}
+
+static const Node* gen_binop(IrArena* a, Op op, const Node* lhs, const Node* rhs) {
+    return prim_op(a, (PrimOp) { .op = op, .type_arguments = shd_empty(a), .operands = mk_nodes(a, lhs, rhs) });
+}
+
+// Lifts the tail of a control that needs a parameter, a value computed from it, and a builtin: only the parameter should
+// go through the stack, the other two get computed again in the lifted function
+int main(int argc, char** argv) {
+    shd_parse_common_args(&argc, argv);
+
+    CompilerConfig config = shd_default_compiler_config();
+    config.hacks.force_join_point_lifting = true;
+    ArenaConfig aconfig = shd_default_arena_config(&config.target);
+    IrArena* a = shd_new_ir_arena(&aconfig);
+    Module* m = shd_new_module(a, "test_module");
+
+    const Type* int_t = shd_as_qualified_type(shd_int32_type(a), false);
+    const Node* x = param(a, int_t, "x");
+    Node* fn = function(m, shd_singleton(x), "fn", shd_singleton(annotation(a, (Annotation) { .name = "Exported" })), shd_singleton(int_t));
+    BodyBuilder* bb = begin_body_with_mem(a, shd_get_abstraction_mem(fn));
+    const Node* local_id = gen_builtin_load(m, bb, BuiltinSubgroupLocalInvocationId);
+    const Node* incremented = gen_binop(a, add_op, x, shd_int32_literal(a, 1));
+
+    // the increment is used on both sides of the control, so it is computed before it
+    begin_control_t control = begin_control(bb, shd_singleton(shd_int32_type(a)));
+    BodyBuilder* inside = begin_body_with_mem(a, shd_get_abstraction_mem(control.case_));
+    shd_set_abstraction_body(control.case_, finish_body_with_join(inside, control.jp, shd_singleton(incremented)));
+
+    const Node* sum = gen_binop(a, add_op, gen_binop(a, add_op, x, incremented), gen_binop(a, add_op, local_id, shd_first(control.results)));
+    shd_set_abstraction_body(fn, finish_body_with_return(bb, shd_singleton(sum)));
+
+    Module* lifted = shd_pass_lift_indirect_targets(&config, m);
+
+    const Node* lifted_fn = NULL;
+    const Node* new_fn = NULL;
+    Nodes decls = shd_module_get_declarations(lifted);
+    for (size_t i = 0; i < decls.count; i++) {
+        const Node* decl = decls.nodes[i];
+        if (decl->tag != Function_TAG)
+            continue;
+        if (strcmp(decl->payload.fun.name, "fn") == 0)
+            new_fn = decl;
+        else {
+            CHECK(!lifted_fn, exit(-1));
+            lifted_fn = decl;
+        }
+    }
+    CHECK(new_fn && lifted_fn, exit(-1));
+
+    // x is spilled...
+    NodeCounter before = count_nodes(new_fn);
+    CHECK(before.pushes == 1, exit(-1));
+    NodeCounter after = count_nodes(lifted_fn);
+    CHECK(after.pops == 1, exit(-1));
+    // ... while the increment and the builtin are not
+    CHECK(after.increments == 1, exit(-1));
+    CHECK(after.builtin_loads == 1, exit(-1));
+
+    shd_destroy_ir_arena(shd_module_get_arena(lifted));
+    shd_destroy_ir_arena(a);
+    return 0;
+}
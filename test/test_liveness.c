@@ -0,0 +1,78 @@
+#include "shady/ir.h"
+#include "shady/driver.h"
+
+#include "../shady/analysis/cfg.h"
+#include "../shady/analysis/scheduler.h"
+#include "../shady/analysis/liveness.h"
+
+#include "log.h"
+
+#include <stdlib.h>
+
+#define CHECK(x, failure_handler) { if (!(x)) { shd_error_print(#x " failed\n"); failure_handler; } }
+
+static void check_live_ins(IrArena* a, Liveness* liveness, const Node* abs, size_t count, const Node** expected) {
+    Nodes live = get_live_ins(a, liveness, abs);
+    CHECK(live.count == count, exit(-1));
+    for (size_t i = 0; i < count; i++) {
+        bool found = false;
+        for (size_t j = 0; j < live.count; j++)
+            found |= live.nodes[j] == expected[i];
+        CHECK(found, exit(-1));
+    }
+}
+
+static const Node* gen_binop(IrArena* a, Op op, const Node* lhs, const Node* rhs) {
+    return prim_op(a, (PrimOp) { .op = op, .type_arguments = shd_empty(a), .operands = mk_nodes(a, lhs, rhs) });
+}
+
+// A counted loop: checks where its values get placed, and what is live at the start of each block as a result
+int main(int argc, char** argv) {
+    shd_parse_common_args(&argc, argv);
+
+    TargetConfig target_config = shd_default_target_config();
+    ArenaConfig aconfig = shd_default_arena_config(&target_config);
+    IrArena* a = shd_new_ir_arena(&aconfig);
+    Module* m = shd_new_module(a, "test_module");
+
+    const Type* int_t = shd_as_qualified_type(shd_int32_type(a), false);
+    const Node* x = param(a, int_t, "x");
+    Node* fn = function(m, shd_singleton(x), "fn", shd_empty(a), shd_singleton(int_t));
+    const Node* i = param(a, int_t, "i");
+    Node* header = basic_block(a, shd_singleton(i), "header");
+    Node* body = basic_block(a, shd_empty(a), "body");
+    Node* exit_bb = basic_block(a, shd_empty(a), "exit");
+
+    const Node* cond = gen_binop(a, lt_op, i, x);
+    const Node* next = gen_binop(a, add_op, i, shd_int32_literal(a, 1));
+    const Node* sum = gen_binop(a, add_op, x, i);
+    shd_set_abstraction_body(fn, jump_helper(a, shd_get_abstraction_mem(fn), header, shd_singleton(shd_int32_literal(a, 0))));
+    const Node* header_mem = shd_get_abstraction_mem(header);
+    shd_set_abstraction_body(header, branch(a, (Branch) {
+        .mem = header_mem,
+        .condition = cond,
+        .true_jump = jump_helper(a, header_mem, body, shd_empty(a)),
+        .false_jump = jump_helper(a, header_mem, exit_bb, shd_empty(a)),
+    }));
+    shd_set_abstraction_body(body, jump_helper(a, shd_get_abstraction_mem(body), header, shd_singleton(next)));
+    shd_set_abstraction_body(exit_bb, fn_ret(a, (Return) { .mem = shd_get_abstraction_mem(exit_bb), .args = shd_singleton(sum) }));
+
+    CFG* cfg = build_fn_cfg(fn);
+    Scheduler* scheduler = new_scheduler(cfg);
+    // the increment is needed on every iteration, the sum only once the loop is done with
+    CHECK(schedule_instruction(scheduler, cond) == cfg_lookup(cfg, header), exit(-1));
+    CHECK(schedule_instruction(scheduler, next) == cfg_lookup(cfg, body), exit(-1));
+    CHECK(schedule_instruction(scheduler, sum) == cfg_lookup(cfg, exit_bb), exit(-1));
+
+    Liveness* liveness = compute_liveness(cfg, scheduler);
+    check_live_ins(a, liveness, fn, 0, NULL);
+    check_live_ins(a, liveness, header, 1, (const Node*[]) { x });
+    check_live_ins(a, liveness, body, 2, (const Node*[]) { x, i });
+    check_live_ins(a, liveness, exit_bb, 2, (const Node*[]) { x, i });
+    destroy_liveness(liveness);
+
+    destroy_scheduler(scheduler);
+    destroy_cfg(cfg);
+    shd_destroy_ir_arena(a);
+    return 0;
+}
@@ -0,0 +1,8 @@
+# Compiles ${SRC}/${T} once as usual and once with --parallel-passes, the two outputs must be identical
+string(REPLACE "/" "_" T_FILE ${T})
+execute_process(COMMAND ${COMPILER} ${SRC}/${T} ${TARGS} -o ${DST}/${T_FILE}.serial.spv COMMAND_ERROR_IS_FATAL ANY)
+execute_process(COMMAND ${COMPILER} ${SRC}/${T} ${TARGS} --parallel-passes -o ${DST}/${T_FILE}.parallel.spv COMMAND_ERROR_IS_FATAL ANY)
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${DST}/${T_FILE}.serial.spv ${DST}/${T_FILE}.parallel.spv RESULT_VARIABLE DIFFERENT)
+if (DIFFERENT)
+    message(FATAL_ERROR "${T} compiles differently with --parallel-passes")
+endif ()
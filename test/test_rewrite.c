@@ -0,0 +1,134 @@
+#include "shady/ir.h"
+#include "shady/driver.h"
+#include "shady/rewrite.h"
+
+#include "log.h"
+
+#include <stdlib.h>
+
+#define CHECK(x, failure_handler) { if (!(x)) { shd_error_print(#x " failed\n"); failure_handler; } }
+
+// long enough that rewriting it recursively would take a lot of stack
+#define CHAIN_LENGTH 100000
+
+typedef struct {
+    Rewriter rewriter;
+    /// Index of the comment the rewrite fn should see next
+    size_t next;
+    bool in_order;
+} Context;
+
+static const Node* rewrite_in_order(Context* ctx, const Node* node) {
+    if (node->tag == Comment_TAG) {
+        size_t i = strtoull(node->payload.comment.string, NULL, 10);
+        ctx->in_order &= i == ctx->next;
+        ctx->next = i + 1;
+    }
+    return shd_recreate_node(&ctx->rewriter, node);
+}
+
+/// fn(x) goes through a chain of numbered comments, and returns x
+static Node* make_fn(Module* m, String name) {
+    IrArena* a = shd_module_get_arena(m);
+    const Type* int_t = shd_as_qualified_type(shd_int32_type(a), false);
+    const Node* x = param(a, int_t, "x");
+    Node* fn = function(m, shd_singleton(x), name, shd_empty(a), shd_singleton(int_t));
+    const Node* mem = shd_get_abstraction_mem(fn);
+    for (size_t i = 0; i < CHAIN_LENGTH; i++)
+        mem = comment(a, (Comment) { .mem = mem, .string = shd_fmt_string_irarena(a, "%zu", i) });
+    shd_set_abstraction_body(fn, fn_ret(a, (Return) { .mem = mem, .args = shd_singleton(x) }));
+    return fn;
+}
+
+/// Finds the comment that @p skip steps before the return of @p body
+static const Node* walk_back(const Node* body, size_t skip) {
+    const Node* mem = body->payload.fn_ret.mem;
+    for (size_t i = 0; i < skip; i++) {
+        CHECK(mem->tag == Comment_TAG, exit(-1));
+        mem = mem->payload.comment.mem;
+    }
+    return mem;
+}
+
+/// Rewrites the body of @p fn the way passes lifting code into a new function do: the params and the AbsMem get mapped
+/// up front, here onto a prologue in the new function. The comment numbered @p replaced, if any, gets mapped to a
+/// replacement after the prologue.
+static const Node* rewrite_body(Context* ctx, Node* fn, size_t replaced, const Node** prologue) {
+    Rewriter* r = &ctx->rewriter;
+    IrArena* a = r->dst_arena;
+    Nodes params = shd_recreate_params(r, get_abstraction_params(fn));
+    shd_register_processed_list(r, get_abstraction_params(fn), params);
+    Node* new_fn = function(r->dst_module, params, shd_get_abstraction_name(fn), shd_empty(a), shd_rewrite_nodes(r, fn->payload.fun.return_types));
+    *prologue = comment(a, (Comment) { .mem = shd_get_abstraction_mem(new_fn), .string = "prologue" });
+    shd_register_processed(r, shd_get_abstraction_mem(fn), *prologue);
+    if (replaced < CHAIN_LENGTH) {
+        const Node* old_step = walk_back(get_abstraction_body(fn), CHAIN_LENGTH - 1 - replaced);
+        shd_register_processed(r, old_step, comment(a, (Comment) { .mem = *prologue, .string = "replacement" }));
+    }
+    shd_set_abstraction_body(new_fn, shd_rewrite_node(r, get_abstraction_body(fn)));
+    return get_abstraction_body(new_fn);
+}
+
+/// fn(x) returns x + 1 + 1 ... + 1, as one long chain of adds
+static Node* make_value_chain_fn(Module* m, String name) {
+    IrArena* a = shd_module_get_arena(m);
+    const Type* int_t = shd_as_qualified_type(shd_int32_type(a), false);
+    const Node* x = param(a, int_t, "x");
+    Node* fn = function(m, shd_singleton(x), name, shd_empty(a), shd_singleton(int_t));
+    const Node* acc = x;
+    for (size_t i = 0; i < CHAIN_LENGTH; i++)
+        acc = prim_op(a, (PrimOp) { .op = add_op, .type_arguments = shd_empty(a), .operands = mk_nodes(a, acc, shd_int32_literal(a, 1)) });
+    shd_set_abstraction_body(fn, fn_ret(a, (Return) { .mem = shd_get_abstraction_mem(fn), .args = shd_singleton(acc) }));
+    return fn;
+}
+
+// Long mem chains are rewritten without recursion, oldest first: checks the rewrite fn sees them in that order, and
+// that mappings registered ahead of time for nodes of the chain are used rather than rewritten over. Deep value chains
+// don't recurse all the way either.
+int main(int argc, char** argv) {
+    shd_parse_common_args(&argc, argv);
+
+    TargetConfig target_config = shd_default_target_config();
+    ArenaConfig aconfig = shd_default_arena_config(&target_config);
+    IrArena* a = shd_new_ir_arena(&aconfig);
+    Module* m = shd_new_module(a, "test_module");
+    Node* whole = make_fn(m, "whole");
+    Node* partial = make_fn(m, "partial");
+
+    IrArena* dst_arena = shd_new_ir_arena(&aconfig);
+    Module* dst = shd_new_module(dst_arena, "test_module");
+    Context ctx = {
+        .rewriter = shd_create_node_rewriter(m, dst, (RewriteNodeFn) rewrite_in_order),
+        .in_order = true,
+    };
+
+    // the whole chain gets rewritten, and starts from what its AbsMem was mapped to
+    const Node* prologue;
+    const Node* body = rewrite_body(&ctx, whole, CHAIN_LENGTH, &prologue);
+    CHECK(ctx.in_order && ctx.next == CHAIN_LENGTH, exit(-1));
+    CHECK(walk_back(body, CHAIN_LENGTH) == prologue, exit(-1));
+
+    // same with a step in the middle of the chain mapped in advance: the rewrite fn never sees it, or what comes before
+    size_t replaced = CHAIN_LENGTH / 2;
+    ctx.next = replaced + 1;
+    body = rewrite_body(&ctx, partial, replaced, &prologue);
+    CHECK(ctx.in_order && ctx.next == CHAIN_LENGTH, exit(-1));
+    const Node* replacement = walk_back(body, CHAIN_LENGTH - 1 - replaced);
+    CHECK(replacement->tag == Comment_TAG && replacement->payload.comment.mem == prologue, exit(-1));
+
+    // deep expressions don't take a lot of stack either, and come out the same
+    Node* values = make_value_chain_fn(m, "values");
+    body = rewrite_body(&ctx, values, CHAIN_LENGTH, &prologue);
+    const Node* acc = shd_first(body->payload.fn_ret.args);
+    for (size_t i = 0; i < CHAIN_LENGTH; i++) {
+        CHECK(acc->tag == PrimOp_TAG && acc->payload.prim_op.op == add_op, exit(-1));
+        CHECK(acc->arena == dst_arena, exit(-1));
+        acc = shd_first(acc->payload.prim_op.operands);
+    }
+    CHECK(acc->tag == Param_TAG && acc->arena == dst_arena, exit(-1));
+
+    shd_destroy_rewriter(&ctx.rewriter);
+    shd_destroy_ir_arena(dst_arena);
+    shd_destroy_ir_arena(a);
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include "shady/ir.h"
+#include "shady/driver.h"
+
+#include "../shady/analysis/cfg.h"
+#include "../shady/analysis/scheduler.h"
+
+#include "log.h"
+
+#include <stdlib.h>
+
+#define CHECK(x, failure_handler) { if (!(x)) { shd_error_print(#x " failed\n"); failure_handler; } }
+
+static const Node* gen_unop(IrArena* a, Op op, const Node* operand) {
+    return prim_op(a, (PrimOp) { .op = op, .type_arguments = shd_empty(a), .operands = shd_singleton(operand) });
+}
+
+static const Node* gen_binop(IrArena* a, Op op, const Node* lhs, const Node* rhs) {
+    return prim_op(a, (PrimOp) { .op = op, .type_arguments = shd_empty(a), .operands = mk_nodes(a, lhs, rhs) });
+}
+
+// A loop with a division guarded by a check on the divisor: loop-invariant values get hoisted out of the loop, but
+// not if that would compute them where the guard doesn't hold
+int main(int argc, char** argv) {
+    shd_parse_common_args(&argc, argv);
+
+    TargetConfig target_config = shd_default_target_config();
+    ArenaConfig aconfig = shd_default_arena_config(&target_config);
+    IrArena* a = shd_new_ir_arena(&aconfig);
+    Module* m = shd_new_module(a, "test_module");
+
+    const Type* int_t = shd_as_qualified_type(shd_int32_type(a), false);
+    const Node* x = param(a, int_t, "x");
+    const Node* n = param(a, int_t, "n");
+    Node* fn = function(m, mk_nodes(a, x, n), "fn", shd_empty(a), shd_singleton(int_t));
+    const Node* i = param(a, int_t, "i");
+    Node* header = basic_block(a, shd_singleton(i), "header");
+    Node* body = basic_block(a, shd_empty(a), "body");
+    Node* guarded = basic_block(a, shd_empty(a), "guarded");
+    const Node* v = param(a, int_t, "v");
+    Node* latch = basic_block(a, shd_singleton(v), "latch");
+    Node* exit_bb = basic_block(a, shd_empty(a), "exit");
+
+    const Node* zero = shd_int32_literal(a, 0);
+    const Node* invariant = gen_binop(a, mul_op, x, x);
+    const Node* quotient = gen_binop(a, div_op, x, n);
+    // only depends on invariant values, but goes through the division
+    const Node* offset_quotient = gen_binop(a, add_op, quotient, invariant);
+    const Node* uniform = gen_unop(a, subgroup_assume_uniform_op, x);
+    const Node* result = gen_binop(a, add_op, offset_quotient, uniform);
+
+    shd_set_abstraction_body(fn, jump_helper(a, shd_get_abstraction_mem(fn), header, shd_singleton(zero)));
+    const Node* header_mem = shd_get_abstraction_mem(header);
+    shd_set_abstraction_body(header, branch(a, (Branch) {
+        .mem = header_mem,
+        .condition = gen_binop(a, lt_op, i, x),
+        .true_jump = jump_helper(a, header_mem, body, shd_empty(a)),
+        .false_jump = jump_helper(a, header_mem, exit_bb, shd_empty(a)),
+    }));
+    const Node* body_mem = shd_get_abstraction_mem(body);
+    shd_set_abstraction_body(body, branch(a, (Branch) {
+        .mem = body_mem,
+        .condition = gen_binop(a, neq_op, n, zero),
+        .true_jump = jump_helper(a, body_mem, guarded, shd_empty(a)),
+        .false_jump = jump_helper(a, body_mem, latch, shd_singleton(zero)),
+    }));
+    shd_set_abstraction_body(guarded, jump_helper(a, shd_get_abstraction_mem(guarded), latch, shd_singleton(result)));
+    shd_set_abstraction_body(latch, jump_helper(a, shd_get_abstraction_mem(latch), header, shd_singleton(gen_binop(a, add_op, i, v))));
+    shd_set_abstraction_body(exit_bb, fn_ret(a, (Return) { .mem = shd_get_abstraction_mem(exit_bb), .args = shd_singleton(i) }));
+
+    CFG* cfg = build_fn_cfg(fn);
+    Scheduler* scheduler = new_scheduler(cfg);
+    CHECK(schedule_instruction(scheduler, invariant) == cfg_lookup(cfg, fn), exit(-1));
+    CHECK(schedule_instruction(scheduler, quotient) == cfg_lookup(cfg, guarded), exit(-1));
+    CHECK(schedule_instruction(scheduler, offset_quotient) == cfg_lookup(cfg, guarded), exit(-1));
+    CHECK(schedule_instruction(scheduler, uniform) == cfg_lookup(cfg, guarded), exit(-1));
+    CHECK(schedule_instruction(scheduler, result) == cfg_lookup(cfg, guarded), exit(-1));
+    destroy_scheduler(scheduler);
+    destroy_cfg(cfg);
+
+    shd_destroy_ir_arena(a);
+    return 0;
+}
@@ -0,0 +1,62 @@
+#include "shady/ir.h"
+#include "shady/driver.h"
+
+#include "log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECK(x, failure_handler) { if (!(x)) { shd_error_print(#x " failed\n"); failure_handler; } }
+
+// Saves a module to a binary file, loads it back and checks saving the result gives the exact same bytes
+int main(int argc, char** argv) {
+    shd_parse_common_args(&argc, argv);
+    CHECK(argc == 3, shd_error_print("Usage: test_serialize <input.slim> <output.shdb>\n"); exit(-1));
+    String input = argv[1];
+    String output = argv[2];
+
+    CompilerConfig config = shd_default_compiler_config();
+    Module* mod;
+    CHECK(shd_driver_load_source_file_from_filename(&config, input, "test", &mod) == NoError, exit(-1));
+
+    size_t size;
+    char* data;
+    shd_serialize_module(mod, &size, &data);
+
+    // goes through a file, so that the mmap path gets used
+    CHECK(shd_driver_save_binary_module(mod, output) == NoError, exit(-1));
+    Module* loaded;
+    CHECK(shd_driver_load_source_file_from_filename(&config, output, NULL, &loaded) == NoError, exit(-1));
+    CHECK(strcmp(shd_module_get_name(loaded), shd_module_get_name(mod)) == 0, exit(-1));
+
+    Nodes decls = shd_module_get_declarations(mod);
+    Nodes loaded_decls = shd_module_get_declarations(loaded);
+    CHECK(decls.count == loaded_decls.count, exit(-1));
+    for (size_t i = 0; i < decls.count; i++) {
+        CHECK(decls.nodes[i]->tag == loaded_decls.nodes[i]->tag, exit(-1));
+        CHECK(strcmp(get_declaration_name(decls.nodes[i]), get_declaration_name(loaded_decls.nodes[i])) == 0, exit(-1));
+    }
+
+    size_t loaded_size;
+    char* loaded_data;
+    shd_serialize_module(loaded, &loaded_size, &loaded_data);
+    CHECK(loaded_size == size, exit(-1));
+    CHECK(memcmp(loaded_data, data, size) == 0, exit(-1));
+
+    // truncated binaries get turned down, wherever they got cut off
+    for (size_t cut = 1; cut <= 4; cut++)
+        CHECK(shd_deserialize_module(size * cut / 5, data, NULL) == NULL, exit(-1));
+    CHECK(shd_deserialize_module(size - 1, data, NULL) == NULL, exit(-1));
+
+    // binaries from another build get turned down instead of misread
+    data[0] ^= 0xFF;
+    CHECK(shd_deserialize_module(size, data, NULL) == NULL, exit(-1));
+
+    free(data);
+    free(loaded_data);
+    shd_destroy_ir_arena(shd_module_get_arena(loaded));
+    shd_destroy_ir_arena(shd_module_get_arena(mod));
+    shd_info_print("%s: %zu bytes\n", input, size);
+    return 0;
+}
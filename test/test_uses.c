@@ -0,0 +1,55 @@
+#include "shady/ir.h"
+#include "shady/driver.h"
+
+#include "../shady/analysis/uses.h"
+
+#include "log.h"
+
+#include <stdlib.h>
+
+#define CHECK(x, failure_handler) { if (!(x)) { shd_error_print(#x " failed\n"); failure_handler; } }
+
+enum {
+    UsesCount = 100000
+};
+
+static void check_uses(const UsesMap* map, const Node* hot) {
+    CHECK(get_uses_count(map, hot) == UsesCount, exit(-1));
+    size_t count = 0;
+    for (const Use* use = get_first_use(map, hot); use; use = use->next_use) {
+        CHECK(use->user->tag == PrimOp_TAG && use->operand_index == 1, exit(-1));
+        count++;
+    }
+    CHECK(count == UsesCount, exit(-1));
+}
+
+// One constant used by a long chain of adds: building the uses map has to stay linear in the number of operands
+int main(int argc, char** argv) {
+    shd_parse_common_args(&argc, argv);
+
+    TargetConfig target_config = shd_default_target_config();
+    ArenaConfig aconfig = shd_default_arena_config(&target_config);
+    IrArena* a = shd_new_ir_arena(&aconfig);
+    Module* m = shd_new_module(a, "test_module");
+
+    const Node* p = param(a, shd_as_qualified_type(shd_int32_type(a), false), "p");
+    Node* fn = function(m, shd_singleton(p), "fn", shd_empty(a), shd_singleton(shd_as_qualified_type(shd_int32_type(a), false)));
+    const Node* hot = shd_int32_literal(a, 1);
+    const Node* acc = p;
+    for (size_t i = 0; i < UsesCount; i++)
+        acc = prim_op(a, (PrimOp) { .op = add_op, .type_arguments = shd_empty(a), .operands = mk_nodes(a, acc, hot) });
+    shd_set_abstraction_body(fn, fn_ret(a, (Return) { .mem = shd_get_abstraction_mem(fn), .args = shd_singleton(acc) }));
+
+    const UsesMap* fn_map = create_fn_uses_map(fn, NcDeclaration | NcType);
+    check_uses(fn_map, hot);
+    CHECK(get_uses_count(fn_map, acc) == 1, exit(-1));
+    CHECK(get_uses_count(fn_map, shd_int32_literal(a, 2)) == 0 && !get_first_use(fn_map, shd_int32_literal(a, 2)), exit(-1));
+    destroy_uses_map(fn_map);
+
+    const UsesMap* module_map = create_module_uses_map(m, NcType);
+    check_uses(module_map, hot);
+    destroy_uses_map(module_map);
+
+    shd_destroy_ir_arena(a);
+    return 0;
+}